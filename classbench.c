@@ -0,0 +1,250 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time the classification of a large number of
+ *           features against typical class expressions.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *kinds[] = { "city", "town", "village", "hamlet", "locality" };
+#define NUMKINDS (int)(sizeof(kinds)/sizeof(kinds[0]))
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/* numfeatures random points over 0 0 1000 1000, in <directory>/classbench_points */
+static int writePoints(const char *directory, int numfeatures)
+{
+  SHPHandle hSHP;
+  DBFHandle hDBF;
+  shapeObj shape;
+  lineObj line;
+  pointObj point;
+  char path[MS_MAXPATHLEN];
+  int i;
+
+  snprintf(path, sizeof(path), "%s/classbench_points.shp", directory);
+  hSHP = msSHPCreate(path, SHP_POINT);
+  snprintf(path, sizeof(path), "%s/classbench_points.dbf", directory);
+  hDBF = msDBFCreate(path);
+  if(!hSHP || !hDBF)
+    return MS_FAILURE;
+  msDBFAddField(hDBF, "kind", FTString, 10, 0);
+  msDBFAddField(hDBF, "population", FTInteger, 10, 0);
+  msDBFAddField(hDBF, "area", FTDouble, 12, 3);
+
+  srand(1);
+  line.numpoints = 1;
+  line.point = &point;
+  for(i=0; i<numfeatures; i++) {
+    point.x = rand() % 1000000 / 1000.0;
+    point.y = rand() % 1000000 / 1000.0;
+
+    msInitShape(&shape);
+    shape.type = MS_SHAPE_POINT;
+    shape.numlines = 1;
+    shape.line = &line;
+    msSHPWriteShape(hSHP, &shape);
+    msDBFWriteStringAttribute(hDBF, i, 0, kinds[rand() % NUMKINDS]);
+    msDBFWriteIntegerAttribute(hDBF, i, 1, rand() % 1000000);
+    msDBFWriteDoubleAttribute(hDBF, i, 2, rand() % 100000 / 100.0);
+  }
+
+  msSHPClose(hSHP);
+  msDBFClose(hDBF);
+  return MS_SUCCESS;
+}
+
+/*
+** The classes mix the expression kinds found in real mapfiles: logical
+** and numeric comparisons, string comparisons, IN lists, regular expressions
+** and a catch-all class, so most features are tested against several classes.
+*/
+static mapObj *loadMap(const char *directory)
+{
+  char *buffer;
+  size_t size = 2048 + strlen(directory);
+  mapObj *map;
+
+  buffer = (char *) msSmallMalloc(size);
+  snprintf(buffer, size,
+           "MAP\n"
+           "  EXTENT 0 0 1000 1000\n"
+           "  SIZE 1000 1000\n"
+           "  SHAPEPATH \"%s\"\n"
+           "  LAYER\n"
+           "    NAME \"points\"\n"
+           "    DATA \"classbench_points\"\n"
+           "    TYPE POINT\n"
+           "    STATUS ON\n"
+           "    CLASSITEM \"kind\"\n"
+           "    CLASS\n"
+           "      EXPRESSION ('[kind]' = 'city' AND [population] >= 500000)\n"
+           "    END\n"
+           "    CLASS\n"
+           "      EXPRESSION ([population] / ([area] + 1) > 5000)\n"
+           "    END\n"
+           "    CLASS\n"
+           "      EXPRESSION ('[kind]' IN 'town,village')\n"
+           "    END\n"
+           "    CLASS\n"
+           "      EXPRESSION ('[kind]' ~ '^ham')\n"
+           "    END\n"
+           "    CLASS\n"
+           "      EXPRESSION {city,locality}\n"
+           "    END\n"
+           "    CLASS\n"
+           "    END\n"
+           "  END\n"
+           "END\n", directory);
+
+  map = msLoadMapFromString(buffer, NULL);
+  msFree(buffer);
+  return map;
+}
+
+/* reads every feature, and classifies it when classcounts is set */
+static int readFeatures(mapObj *map, layerObj *layer, int *classcounts, int *numfeatures)
+{
+  shapeObj shape;
+  int status, c;
+
+  *numfeatures = 0;
+  if(msLayerOpen(layer) != MS_SUCCESS)
+    return MS_FAILURE;
+  status = msLayerWhichItems(layer, MS_FALSE, NULL);
+  if(status == MS_SUCCESS)
+    status = msLayerWhichShapes(layer, map->extent, MS_FALSE);
+
+  if(status == MS_SUCCESS) {
+    msInitShape(&shape);
+    while((status = msLayerNextShape(layer, &shape)) == MS_SUCCESS) {
+      if(classcounts) {
+        c = msShapeGetClass(layer, map, &shape, NULL, -1);
+        classcounts[c + 1]++; /* -1 is no class */
+      }
+      (*numfeatures)++;
+      msFreeShape(&shape);
+    }
+    if(status == MS_DONE)
+      status = MS_SUCCESS;
+  }
+
+  msLayerClose(layer);
+  return status;
+}
+
+int main(int argc, char *argv[])
+{
+  mapObj *map;
+  layerObj *layer;
+  struct mstimeval start;
+  double readtime = 0, classifytime = 0;
+  int numfeatures = 1000000, numruns = 3, i, c, numread = 0, status = MS_SUCCESS;
+  int *classcounts;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    classbench <directory> [<features>] [<runs>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <directory> is a writable directory for the generated shapefile.\n");
+    fprintf(stdout," <features>  (optional) is the number of features, default 1000000.\n");
+    fprintf(stdout," <runs>      (optional) is the number of passes to time, default 3.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) numfeatures = MS_MAX(atoi(argv[2]), 1);
+  if(argc >= 4) numruns = MS_MAX(atoi(argv[3]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  if(writePoints(argv[1], numfeatures) != MS_SUCCESS) {
+    fprintf(stdout, "Unable to write the shapefile in %s.\n", argv[1]);
+    msCleanup();
+    exit(1);
+  }
+
+  map = loadMap(argv[1]);
+  if(!map) {
+    msWriteError(stderr);
+    msCleanup();
+    exit(1);
+  }
+  layer = GET_LAYER(map, 0);
+  classcounts = (int *) msSmallCalloc(layer->numclasses + 1, sizeof(int));
+
+  /* the classification cost is the difference between reading and reading and classifying */
+  for(i=0; i<numruns && status == MS_SUCCESS; i++) {
+    msGettimeofday(&start, NULL);
+    status = readFeatures(map, layer, NULL, &numread);
+    readtime += elapsed(&start);
+
+    if(status == MS_SUCCESS) {
+      memset(classcounts, 0, (layer->numclasses + 1) * sizeof(int));
+      msGettimeofday(&start, NULL);
+      status = readFeatures(map, layer, classcounts, &numread);
+      classifytime += elapsed(&start);
+    }
+  }
+
+  if(status != MS_SUCCESS) {
+    msWriteError(stderr);
+  } else {
+    classifytime = MS_MAX(classifytime - readtime, 1.0e-9);
+    printf("%d features, %d classes\n", numread, layer->numclasses);
+    for(c=0; c<layer->numclasses; c++)
+      printf("  class %d: %d features\n", c, classcounts[c + 1]);
+    if(classcounts[0])
+      printf("  no class: %d features\n", classcounts[0]);
+    printf("read:     %8.1f ms/pass\n", readtime * 1.0e3 / numruns);
+    printf("classify: %8.1f ms/pass, %.2f Mfeatures/s\n", classifytime * 1.0e3 / numruns,
+           (double) numread * numruns / classifytime / 1.0e6);
+  }
+
+  msFree(classcounts);
+  msFreeMap(map);
+  msCleanup();
+
+  return status == MS_SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time feature queries with overlapping selections
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/* a gridsize x gridsize grid of points over 0 0 1000 1000, in <directory>/featurebench_points */
+static int writePoints(const char *directory, int gridsize)
+{
+  SHPHandle hSHP;
+  DBFHandle hDBF;
+  shapeObj shape;
+  lineObj line;
+  pointObj point;
+  char path[MS_MAXPATHLEN];
+  int i;
+
+  snprintf(path, sizeof(path), "%s/featurebench_points.shp", directory);
+  hSHP = msSHPCreate(path, SHP_POINT);
+  snprintf(path, sizeof(path), "%s/featurebench_points.dbf", directory);
+  hDBF = msDBFCreate(path);
+  if(!hSHP || !hDBF)
+    return MS_FAILURE;
+  msDBFAddField(hDBF, "id", FTInteger, 10, 0);
+
+  line.numpoints = 1;
+  line.point = &point;
+  for(i=0; i<gridsize*gridsize; i++) {
+    point.x = (i % gridsize + 0.5) * 1000.0 / gridsize;
+    point.y = (i / gridsize + 0.5) * 1000.0 / gridsize;
+
+    msInitShape(&shape);
+    shape.type = MS_SHAPE_POINT;
+    shape.numlines = 1;
+    shape.line = &line;
+    msSHPWriteShape(hSHP, &shape);
+    msDBFWriteIntegerAttribute(hDBF, i, 0, i);
+  }
+
+  msSHPClose(hSHP);
+  msDBFClose(hDBF);
+  return MS_SUCCESS;
+}
+
+/* numselections random squares of a quarter to half the extent, so most of them overlap */
+static int writeSelections(const char *directory, int numselections)
+{
+  SHPHandle hSHP;
+  DBFHandle hDBF;
+  shapeObj shape;
+  lineObj line;
+  pointObj points[5];
+  char path[MS_MAXPATHLEN];
+  int i;
+
+  snprintf(path, sizeof(path), "%s/featurebench_selections.shp", directory);
+  hSHP = msSHPCreate(path, SHP_POLYGON);
+  snprintf(path, sizeof(path), "%s/featurebench_selections.dbf", directory);
+  hDBF = msDBFCreate(path);
+  if(!hSHP || !hDBF)
+    return MS_FAILURE;
+  msDBFAddField(hDBF, "id", FTInteger, 10, 0);
+
+  srand(1);
+  line.numpoints = 5;
+  line.point = points;
+  for(i=0; i<numselections; i++) {
+    double size = 250 + rand() % 250;
+    double x = rand() % (int)(1000 - size), y = rand() % (int)(1000 - size);
+
+    points[0].x = x;        points[0].y = y;
+    points[1].x = x;        points[1].y = y + size;
+    points[2].x = x + size; points[2].y = y + size;
+    points[3].x = x + size; points[3].y = y;
+    points[4] = points[0];
+
+    msInitShape(&shape);
+    shape.type = MS_SHAPE_POLYGON;
+    shape.numlines = 1;
+    shape.line = &line;
+    msSHPWriteShape(hSHP, &shape);
+    msDBFWriteIntegerAttribute(hDBF, i, 0, i);
+  }
+
+  msSHPClose(hSHP);
+  msDBFClose(hDBF);
+  return MS_SUCCESS;
+}
+
+static mapObj *loadMap(const char *directory)
+{
+  char *buffer;
+  size_t size = 1024 + 2 * strlen(directory);
+  mapObj *map;
+
+  buffer = (char *) msSmallMalloc(size);
+  snprintf(buffer, size,
+           "MAP\n"
+           "  EXTENT 0 0 1000 1000\n"
+           "  SIZE 1000 1000\n"
+           "  SHAPEPATH \"%s\"\n"
+           "  LAYER\n"
+           "    NAME \"selections\"\n"
+           "    DATA \"featurebench_selections\"\n"
+           "    TYPE POLYGON\n"
+           "    STATUS ON\n"
+           "    TEMPLATE \"void\"\n"
+           "  END\n"
+           "  LAYER\n"
+           "    NAME \"points\"\n"
+           "    DATA \"featurebench_points\"\n"
+           "    TYPE POINT\n"
+           "    STATUS ON\n"
+           "    TOLERANCE 0\n"
+           "    TEMPLATE \"void\"\n"
+           "  END\n"
+           "END\n", directory);
+
+  map = msLoadMapFromString(buffer, NULL);
+  msFree(buffer);
+  return map;
+}
+
+int main(int argc, char *argv[])
+{
+  mapObj *map;
+  struct mstimeval start;
+  double seconds;
+  int gridsize = 300, numselections = 50, numruns = 3, i, numresults = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    featurebench <directory> [<grid>] [<selections>] [<runs>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <directory>  is a writable directory for the generated shapefiles.\n");
+    fprintf(stdout," <grid>       (optional) is the size of the grid of points, default 300.\n");
+    fprintf(stdout," <selections> (optional) is the number of overlapping selection\n");
+    fprintf(stdout,"              polygons, default 50.\n");
+    fprintf(stdout," <runs>       (optional) is the number of queries to time, default 3.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) gridsize = MS_MAX(atoi(argv[2]), 1);
+  if(argc >= 4) numselections = MS_MAX(atoi(argv[3]), 1);
+  if(argc >= 5) numruns = MS_MAX(atoi(argv[4]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  if(writePoints(argv[1], gridsize) != MS_SUCCESS || writeSelections(argv[1], numselections) != MS_SUCCESS) {
+    fprintf(stdout, "Unable to write the shapefiles in %s.\n", argv[1]);
+    msCleanup();
+    exit(1);
+  }
+
+  map = loadMap(argv[1]);
+  if(!map) {
+    msWriteError(stderr);
+    msCleanup();
+    exit(1);
+  }
+
+  /* select all the polygons, then the points they cover (mode=featurenquery) */
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numruns; i++) {
+    msInitQuery(&(map->query));
+    map->query.type = MS_QUERY_BY_RECT;
+    map->query.mode = MS_QUERY_MULTIPLE;
+    map->query.rect = map->extent;
+    map->query.slayer = msGetLayerIndex(map, "selections");
+    map->query.layer = msGetLayerIndex(map, "points");
+
+    if(msExecuteQuery(map) != MS_SUCCESS) {
+      msWriteError(stderr);
+      break;
+    }
+    numresults = GET_LAYER(map, map->query.layer)->resultcache->numresults;
+  }
+  seconds = elapsed(&start);
+
+  if(i == numruns) {
+    printf("%d selection polygons over %d points, %d points selected\n",
+           numselections, gridsize * gridsize, numresults);
+    printf("%8.1f ms/query over %d queries\n", seconds * 1.0e3 / numruns, numruns);
+  }
+
+  msFreeMap(map);
+  msCleanup();
+
+  return(i == numruns ? 0 : 1);
+}
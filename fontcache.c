@@ -39,13 +39,7 @@ typedef struct {
 } ft_cache;
 
 #ifdef USE_THREAD
-typedef struct ft_thread_cache ft_thread_cache;
-struct ft_thread_cache{
-  void* thread_id;
-  ft_thread_cache *next;
-  ft_cache cache;
-};
-ft_thread_cache *ft_caches;
+ft_cache *shared_ft_cache; /* used by all threads with MS_USE_GLOBAL_FT_CACHE */
 int use_global_ft_cache;
 #else
   ft_cache global_ft_cache;
@@ -100,58 +94,38 @@ void msFreeFontCache(ft_cache *c) {
   memset(c,0,sizeof(ft_cache));
 }
 
+#ifdef USE_THREAD
+/* called with the font cache of an exiting thread */
+static void msFreeThreadFontCache(void *c) {
+  msFreeFontCache((ft_cache*)c);
+  free(c);
+}
+#endif
+
 ft_cache* msGetFontCache() {
 #ifndef USE_THREAD
   return &global_ft_cache;
 #else
-  void* nThreadId = 0;
-  ft_thread_cache *prev = NULL, *cur = ft_caches;
-
-  if (!use_global_ft_cache)
-    nThreadId = msGetThreadId();
+  ft_cache *c;
 
-  if( cur != NULL && cur->thread_id == nThreadId )
-    return &cur->cache;
-
-  /* -------------------------------------------------------------------- */
-  /*      Search for cache for this thread                                */
-  /* -------------------------------------------------------------------- */
-  msAcquireLock( TLOCK_TTF );
-
-  cur = ft_caches;
-  while( cur != NULL && cur->thread_id != nThreadId ) {
-    prev = cur;
-    cur = cur->next;
-  }
-
-  /* -------------------------------------------------------------------- */
-  /*      If we found it, make sure it is pushed to the front of the      */
-  /*      link for faster finding next time, and return it.               */
-  /* -------------------------------------------------------------------- */
-  if( cur != NULL ) {
-    if( prev != NULL ) {
-      prev->next = cur->next;
-      cur->next = ft_caches;
-      ft_caches = cur;
+  if (use_global_ft_cache) {
+    msAcquireLock( TLOCK_TTF );
+    if (!shared_ft_cache) {
+      shared_ft_cache = msSmallMalloc(sizeof(ft_cache));
+      msInitFontCache(shared_ft_cache);
     }
-
+    c = shared_ft_cache;
     msReleaseLock( TLOCK_TTF );
-    return &cur->cache;
+    return c;
   }
 
-  /* -------------------------------------------------------------------- */
-  /*      Create a new context group for this thread.                     */
-  /* -------------------------------------------------------------------- */
-  cur = msSmallMalloc(sizeof(ft_thread_cache));
-  cur->next = NULL;
-  cur->thread_id = nThreadId;
-  msInitFontCache(&cur->cache);
-  cur->next = ft_caches;
-  ft_caches = cur;
-
-  msReleaseLock( TLOCK_TTF );
-
-  return &cur->cache;
+  c = msGetThreadSlot( TSLOT_TTF );
+  if (!c) {
+    c = msSmallMalloc(sizeof(ft_cache));
+    msInitFontCache(c);
+    msSetThreadSlot( TSLOT_TTF, c, msFreeThreadFontCache );
+  }
+  return c;
 #endif
 }
 
@@ -165,8 +139,6 @@ void msFontCacheSetup() {
     use_global_ft_cache = atoi(use_global_cache);
   else
     use_global_ft_cache = 0;
-
-  ft_caches = NULL;
 #endif
 }
 
@@ -175,16 +147,17 @@ void msFontCacheCleanup() {
   ft_cache *c = msGetFontCache();
   msFreeFontCache(c);
 #else
-  ft_thread_cache *cur,*next;
+  /* the caches of other threads go away with their threads */
+  ft_cache *c = msGetThreadSlot( TSLOT_TTF );
+  if (c) {
+    msSetThreadSlot( TSLOT_TTF, NULL, NULL );
+    msFreeThreadFontCache(c);
+  }
   msAcquireLock( TLOCK_TTF );
-  cur =  ft_caches;
-  while( cur != NULL ) {
-    msFreeFontCache(&cur->cache);
-    next = cur->next;
-    free(cur);
-    cur = next;
+  if (shared_ft_cache) {
+    msFreeThreadFontCache(shared_ft_cache);
+    shared_ft_cache = NULL;
   }
-  ft_caches = NULL;
   msReleaseLock( TLOCK_TTF );
 #endif
 }
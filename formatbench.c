@@ -0,0 +1,142 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to check and time msFormatDouble() against printf()
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define NUMVALUES 1000000
+
+static unsigned long long state = 88172645463325252ULL;
+
+static unsigned long long nextRandom(void)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+/* a mix of arbitrary bit patterns, decimal data, exact binary ties and coordinates */
+static double randomValue(void)
+{
+  unsigned long long bits;
+  double value;
+
+  switch(nextRandom() % 6) {
+    case 0:
+      bits = nextRandom();
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+    case 1:
+      return (double)(long long)(nextRandom() % 2000000001) / 1000000.0 - 1000.0;
+    case 2:
+      return (double)(long long)(nextRandom() % 100000000) / 8.0;
+    case 3:
+      return (double)(nextRandom() % 1000000) / 1e6 * 360 - 180;
+    case 4:
+      return ldexp((double)(nextRandom() >> 11), -(int)(nextRandom() % 70));
+    default:
+      return 500000.0 + (double)(nextRandom() % 100000000) / 100.0 + (double)(nextRandom() % 1000) / 7.0;
+  }
+}
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+  long i, numchecks = 10000000, mismatches = 0;
+  char formatted[512], expected[512];
+  double *values;
+  struct mstimeval start;
+  int precision, sink = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-h") == 0) {
+    fprintf(stdout, "usage: %s [number of values to check]\n", argv[0]);
+    exit(0);
+  }
+  if(argc > 1) numchecks = atol(argv[1]);
+
+  /* fixed precision must match printf() byte for byte, shortest must read back */
+  for(i=0; i<numchecks; i++) {
+    double value = randomValue();
+
+    precision = nextRandom() % 18;
+    msFormatDouble(formatted, sizeof(formatted), value, precision);
+    snprintf(expected, sizeof(expected), "%.*f", precision, value);
+    if(strcmp(formatted, expected) != 0 && mismatches++ < 10)
+      fprintf(stdout, "%.17g with %d decimals: '%s', printf() gives '%s'\n", value, precision, formatted, expected);
+
+    msFormatDouble(formatted, sizeof(formatted), value, -1);
+    if(value == value && strtod(formatted, NULL) != value && mismatches++ < 10)
+      fprintf(stdout, "%.17g shortest: '%s' doesn't read back\n", value, formatted);
+  }
+  fprintf(stdout, "%ld values checked, %ld mismatches\n\n", numchecks, mismatches);
+
+  values = (double *) msSmallMalloc(sizeof(double) * NUMVALUES);
+
+  for(i=0; i<NUMVALUES; i++) /* projected coordinates, full precision */
+    values[i] = 500000.0 + (double)(nextRandom() % 1000000000) / 1000.0 + (double)(nextRandom() % 1000) / 7.0;
+
+  msGettimeofday(&start, NULL);
+  for(i=0; i<NUMVALUES; i++) sink += snprintf(formatted, sizeof(formatted), "%f", values[i]);
+  fprintf(stdout, "printf(\"%%f\"):          %6.1f ns/value\n", elapsed(&start) * 1e9 / NUMVALUES);
+  msGettimeofday(&start, NULL);
+  for(i=0; i<NUMVALUES; i++) sink += msFormatDouble(formatted, sizeof(formatted), values[i], 6);
+  fprintf(stdout, "msFormatDouble(6):      %6.1f ns/value\n", elapsed(&start) * 1e9 / NUMVALUES);
+  msGettimeofday(&start, NULL);
+  for(i=0; i<NUMVALUES; i++) sink += snprintf(formatted, sizeof(formatted), "%.8f", values[i] / 5000);
+  fprintf(stdout, "printf(\"%%.8f\"):        %6.1f ns/value\n", elapsed(&start) * 1e9 / NUMVALUES);
+  msGettimeofday(&start, NULL);
+  for(i=0; i<NUMVALUES; i++) sink += msFormatDouble(formatted, sizeof(formatted), values[i] / 5000, 8);
+  fprintf(stdout, "msFormatDouble(8):      %6.1f ns/value\n", elapsed(&start) * 1e9 / NUMVALUES);
+  msGettimeofday(&start, NULL);
+  for(i=0; i<NUMVALUES; i++) sink += snprintf(formatted, sizeof(formatted), "%.17g", values[i]);
+  fprintf(stdout, "printf(\"%%.17g\"):       %6.1f ns/value\n", elapsed(&start) * 1e9 / NUMVALUES);
+  msGettimeofday(&start, NULL);
+  for(i=0; i<NUMVALUES; i++) sink += msFormatDouble(formatted, sizeof(formatted), values[i], -1);
+  fprintf(stdout, "msFormatDouble(-1):     %6.1f ns/value (full precision values)\n", elapsed(&start) * 1e9 / NUMVALUES);
+
+  for(i=0; i<NUMVALUES; i++) /* coordinates read from decimal data */
+    values[i] = (double)(500000000LL + (long long)(nextRandom() % 1000000000)) / 1000.0;
+  msGettimeofday(&start, NULL);
+  for(i=0; i<NUMVALUES; i++) sink += msFormatDouble(formatted, sizeof(formatted), values[i], -1);
+  fprintf(stdout, "msFormatDouble(-1):     %6.1f ns/value (3 decimal values)\n", elapsed(&start) * 1e9 / NUMVALUES);
+
+  free(values);
+
+  return (mismatches == 0 && sink != 0) ? 0 : 1;
+}
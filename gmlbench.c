@@ -0,0 +1,251 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time WFS GetFeature output of many features
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "mapows.h"
+#include "maptime.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define NUMVERTICES 24
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/*
+** Writes numfeatures small polygons of NUMVERTICES vertices on a grid
+** over the world, with five attributes each, to <basename>.shp/.shx/.dbf.
+*/
+static int writeShapefile(const char *basename, int numfeatures)
+{
+  SHPHandle hSHP;
+  DBFHandle hDBF;
+  shapeObj shape;
+  lineObj line;
+  pointObj points[NUMVERTICES + 1];
+  char path[MS_MAXPATHLEN], name[64];
+  int i, j, columns = (int) ceil(sqrt((double) numfeatures));
+  double cell = 360.0 / columns;
+
+  snprintf(path, sizeof(path), "%s.shp", basename);
+  hSHP = msSHPCreate(path, SHP_POLYGON);
+  snprintf(path, sizeof(path), "%s.dbf", basename);
+  hDBF = msDBFCreate(path);
+  if(!hSHP || !hDBF)
+    return MS_FAILURE;
+
+  msDBFAddField(hDBF, "id", FTInteger, 10, 0);
+  msDBFAddField(hDBF, "name", FTString, 32, 0);
+  msDBFAddField(hDBF, "kind", FTString, 16, 0);
+  msDBFAddField(hDBF, "value", FTDouble, 16, 6);
+  msDBFAddField(hDBF, "note", FTString, 64, 0);
+
+  line.numpoints = NUMVERTICES + 1;
+  line.point = points;
+  for(i=0; i<numfeatures; i++) {
+    double cx = -180 + (i % columns + 0.5) * cell, cy = -90 + (i / columns + 0.5) * cell / 2;
+
+    for(j=0; j<NUMVERTICES; j++) {
+      points[j].x = cx + cos(-2 * MS_PI * j / NUMVERTICES) * cell * 0.4;
+      points[j].y = cy + sin(-2 * MS_PI * j / NUMVERTICES) * cell * 0.2;
+    }
+    points[NUMVERTICES] = points[0];
+
+    msInitShape(&shape);
+    shape.type = MS_SHAPE_POLYGON;
+    shape.numlines = 1;
+    shape.line = &line;
+    msSHPWriteShape(hSHP, &shape);
+
+    snprintf(name, sizeof(name), "feature %d", i);
+    msDBFWriteIntegerAttribute(hDBF, i, 0, i);
+    msDBFWriteStringAttribute(hDBF, i, 1, name);
+    msDBFWriteStringAttribute(hDBF, i, 2, (i % 3) ? "area" : "zone & area");
+    msDBFWriteDoubleAttribute(hDBF, i, 3, i / 7.0);
+    msDBFWriteStringAttribute(hDBF, i, 4, "<generated by gmlbench>");
+  }
+
+  msSHPClose(hSHP);
+  msDBFClose(hDBF);
+  return MS_SUCCESS;
+}
+
+static mapObj *loadMap(const char *basename)
+{
+  char *buffer;
+  size_t size = 2048 + 2 * strlen(basename);
+  mapObj *map;
+
+  buffer = (char *) msSmallMalloc(size);
+  snprintf(buffer, size,
+           "MAP\n"
+           "  EXTENT -180 -90 180 90\n"
+           "  PROJECTION \"init=epsg:4326\" END\n"
+           "  WEB\n"
+           "    METADATA\n"
+           "      \"ows_title\" \"gmlbench\"\n"
+           "      \"ows_onlineresource\" \"http://localhost/gmlbench?\"\n"
+           "      \"ows_srs\" \"EPSG:4326\"\n"
+           "      \"ows_enable_request\" \"*\"\n"
+           "    END\n"
+           "  END\n"
+           "  LAYER\n"
+           "    NAME \"bench\"\n"
+           "    DATA \"%s\"\n"
+           "    TYPE POLYGON\n"
+           "    STATUS ON\n"
+           "    PROJECTION \"init=epsg:4326\" END\n"
+           "    METADATA\n"
+           "      \"gml_include_items\" \"all\"\n"
+           "      \"gml_featureid\" \"id\"\n"
+           "      \"gml_types\" \"auto\"\n"
+           "    END\n"
+           "  END\n"
+           "END\n", basename);
+
+  map = msLoadMapFromString(buffer, NULL);
+  msFree(buffer);
+  return map;
+}
+
+/* one GetFeature of the whole layer, returns the size of the response or -1 */
+static int runGetFeature(mapObj *map, const char *version, const char *outputformat)
+{
+  cgiRequestObj *request = msAllocCgiObj();
+  msIOContext *context;
+  int status, bytes;
+
+  request->type = MS_GET_REQUEST;
+  request->ParamNames[0] = msStrdup("SERVICE");
+  request->ParamValues[0] = msStrdup("WFS");
+  request->ParamNames[1] = msStrdup("VERSION");
+  request->ParamValues[1] = msStrdup(version);
+  request->ParamNames[2] = msStrdup("REQUEST");
+  request->ParamValues[2] = msStrdup("GetFeature");
+  request->ParamNames[3] = msStrdup("TYPENAME");
+  request->ParamValues[3] = msStrdup("bench");
+  request->ParamNames[4] = msStrdup("OUTPUTFORMAT");
+  request->ParamValues[4] = msStrdup(outputformat);
+  request->NumParams = 5;
+
+  msIO_installStdoutToBuffer();
+  status = msOWSDispatch(map, request, MS_TRUE);
+  context = msIO_getHandler((FILE *) "stdout");
+  bytes = ((msIOBuffer *) context->cbData)->data_offset;
+  msIO_resetHandlers();
+  msFreeCgiObj(request);
+
+  if(status != MS_SUCCESS) {
+    msWriteError(stderr);
+    msResetErrorList();
+    return -1;
+  }
+  return bytes;
+}
+
+int main(int argc, char *argv[])
+{
+  static const char *requests[][2] = {
+    {"1.0.0", "GML2"},
+    {"1.1.0", "text/xml; subtype=gml/3.1.1"},
+    {"2.0.0", "application/gml+xml; version=3.2"}
+  };
+  mapObj *map;
+  struct mstimeval start;
+  char basename[MS_MAXPATHLEN];
+  double seconds;
+  int numfeatures = 100000, numruns = 3, i, j, bytes = 0, failures = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    gmlbench <directory> [<features>] [<runs>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <directory> is a writable directory for the generated gmlbench.shp.\n");
+    fprintf(stdout," <features>  (optional) is the number of polygons, default 100000.\n");
+    fprintf(stdout," <runs>      (optional) is the number of GetFeature requests per\n");
+    fprintf(stdout,"             output format, default 3.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) numfeatures = MS_MAX(atoi(argv[2]), 1);
+  if(argc >= 4) numruns = MS_MAX(atoi(argv[3]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  snprintf(basename, sizeof(basename), "%s/gmlbench", argv[1]);
+  if(writeShapefile(basename, numfeatures) != MS_SUCCESS) {
+    fprintf(stdout, "Unable to write %s.shp.\n", basename);
+    msCleanup();
+    exit(1);
+  }
+
+  map = loadMap(basename);
+  if(!map) {
+    msWriteError(stderr);
+    msCleanup();
+    exit(1);
+  }
+
+  printf("GetFeature of %d polygons of %d vertices with 5 items\n", numfeatures, NUMVERTICES);
+  for(i=0; i<(int)(sizeof(requests) / sizeof(requests[0])); i++) {
+    msGettimeofday(&start, NULL);
+    for(j=0; j<numruns; j++) {
+      bytes = runGetFeature(map, requests[i][0], requests[i][1]);
+      if(bytes < 0) break;
+    }
+    seconds = elapsed(&start);
+
+    if(bytes < 0) {
+      printf("WFS %s: request failed\n", requests[i][0]);
+      failures++;
+      continue;
+    }
+    printf("WFS %s: %8.0f features/s %8.1f MB/s (%d bytes/response)\n", requests[i][0],
+           numfeatures * (double) numruns / seconds, bytes * (double) numruns / seconds / 1.0e6, bytes);
+  }
+
+  msFreeMap(map);
+  msCleanup();
+
+  return(failures ? 1 : 0);
+}
@@ -0,0 +1,159 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time the rendering of a map with many labels
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/*
+** A 1000x1000 map with one inline point layer holding numlabels labeled
+** points spread at random over the image, with markers and three label
+** priorities so that the marker and leader collision tests are exercised
+** as well.
+*/
+static char *buildMapfile(const char *fontset, int numlabels)
+{
+  size_t size = 1024 + strlen(fontset) + (size_t) numlabels * 80, len;
+  char *buffer = (char *) msSmallMalloc(size);
+  int i;
+
+  len = snprintf(buffer, size,
+                 "MAP\n"
+                 "  EXTENT 0 0 1000 1000\n"
+                 "  SIZE 1000 1000\n"
+                 "  IMAGETYPE png\n"
+                 "  FONTSET \"%s\"\n"
+                 "  SYMBOL NAME \"circle\" TYPE ELLIPSE FILLED TRUE POINTS 1 1 END END\n"
+                 "  LAYER\n"
+                 "    NAME \"labels\"\n"
+                 "    STATUS DEFAULT\n"
+                 "    TYPE POINT\n"
+                 "    PROCESSING \"ITEMS=priority\"\n"
+                 "    CLASS\n"
+                 "      STYLE SYMBOL \"circle\" SIZE 4 COLOR 0 0 0 END\n"
+                 "      LABEL\n"
+                 "        TYPE TRUETYPE FONT \"default\" SIZE 8 COLOR 0 0 0\n"
+                 "        POSITION AUTO PARTIALS FALSE\n"
+                 "        PRIORITY [priority]\n"
+                 "      END\n"
+                 "    END\n", fontset);
+
+  srand(1);
+  for(i=0; i<numlabels; i++) {
+    len += snprintf(buffer + len, size - len,
+                    "    FEATURE POINTS %d %d END ITEMS \"%d\" TEXT \"label %d\" END\n",
+                    rand() % 1000, rand() % 1000, 1 + i % 3, i);
+  }
+  snprintf(buffer + len, size - len, "  END\nEND\n");
+
+  return buffer;
+}
+
+int main(int argc, char *argv[])
+{
+  mapObj *map;
+  imageObj *image;
+  struct mstimeval start;
+  char *mapfile;
+  double rendertime;
+  int numlabels = 10000, numruns = 10, i, rendered = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    labelbench <fontset> [<labels>] [<runs>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <fontset> is a fontset file with a \"default\" font\n");
+    fprintf(stdout,"           (e.g. msautotest/misc/fonts.lst).\n");
+    fprintf(stdout," <labels>  (optional) is the number of labeled points, default 10000.\n");
+    fprintf(stdout," <runs>    (optional) is the number of renders to time, default 10.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) numlabels = MS_MAX(atoi(argv[2]), 1);
+  if(argc >= 4) numruns = MS_MAX(atoi(argv[3]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  mapfile = buildMapfile(argv[1], numlabels);
+  map = msLoadMapFromString(mapfile, NULL);
+  msFree(mapfile);
+  if(!map) {
+    msWriteError(stderr);
+    msCleanup();
+    exit(1);
+  }
+
+  /* the first render loads the font and symbol caches, don't time it */
+  image = msDrawMap(map, MS_FALSE);
+  if(!image) {
+    msWriteError(stderr);
+    msFreeMap(map);
+    msCleanup();
+    exit(1);
+  }
+  msFreeImage(image);
+
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numruns; i++) {
+    image = msDrawMap(map, MS_FALSE);
+    if(!image) {
+      msWriteError(stderr);
+      break;
+    }
+    rendered = map->labelcache.num_rendered_members;
+    msFreeImage(image);
+  }
+  rendertime = elapsed(&start);
+
+  printf("%d labeled points on a %dx%d map, %d labels placed\n",
+         numlabels, map->width, map->height, rendered);
+  printf("%8.1f ms/render over %d renders\n", rendertime * 1.0e3 / i, i);
+
+  msFreeMap(map);
+  msCleanup();
+
+  return(i == numruns ? 0 : 1);
+}
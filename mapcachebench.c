@@ -0,0 +1,137 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to compare the request rate of a long running
+ *           process with and without the mapfile cache (MS_MAPFILE_CACHE_SIZE).
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/*
+** One request as mapserv handles it: load the mapfile through
+** msLoadMapCached(), then optionally draw and encode the map.
+*/
+static int runRequests(const char *mapfile, int numrequests, int draw, double *seconds)
+{
+  struct mstimeval start;
+  mapObj *map;
+  imageObj *image;
+  unsigned char *buffer;
+  int i, size;
+
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numrequests; i++) {
+    map = msLoadMapCached(mapfile);
+    if(!map)
+      return MS_FAILURE;
+    if(draw) {
+      image = msDrawMap(map, MS_FALSE);
+      if(!image) {
+        msFreeMap(map);
+        return MS_FAILURE;
+      }
+      buffer = msSaveImageBuffer(image, &size, map->outputformat);
+      msFree(buffer);
+      msFreeImage(image);
+      if(!buffer) {
+        msFreeMap(map);
+        return MS_FAILURE;
+      }
+    }
+    msFreeMap(map);
+  }
+  *seconds = elapsed(&start);
+
+  return MS_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  int numrequests = 1000, draw, status = MS_SUCCESS;
+  double uncached[2], cached[2];
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    mapcachebench <mapfile> [<requests>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <mapfile>  is the mapfile to load, e.g. one of msautotest/wxs.\n");
+    fprintf(stdout," <requests> (optional) is the number of requests per run, default 1000.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) numrequests = MS_MAX(atoi(argv[2]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  /*
+  ** The cache reads MS_MAPFILE_CACHE_SIZE on first use, and
+  ** msMapFileCacheCleanup() resets it so the next run reads it again.
+  */
+  for(draw=0; draw<2 && status == MS_SUCCESS; draw++) {
+    putenv("MS_MAPFILE_CACHE_SIZE=0");
+    status = runRequests(argv[1], numrequests, draw, &uncached[draw]);
+    msMapFileCacheCleanup();
+
+    putenv("MS_MAPFILE_CACHE_SIZE=1");
+    if(status == MS_SUCCESS)
+      status = runRequests(argv[1], numrequests, draw, &cached[draw]);
+    msMapFileCacheCleanup();
+  }
+
+  if(status != MS_SUCCESS) {
+    msWriteError(stderr);
+  } else {
+    for(draw=0; draw<2; draw++) {
+      printf("%s:\n", draw ? "load, draw and encode" : "load only");
+      printf("  without cache: %10.1f requests/s\n", numrequests / uncached[draw]);
+      printf("  with cache:    %10.1f requests/s, %.1fx\n", numrequests / cached[draw],
+             uncached[draw] / cached[draw]);
+    }
+  }
+
+  msCleanup();
+  return status == MS_SUCCESS ? 0 : 1;
+}
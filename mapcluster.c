@@ -144,8 +144,6 @@ struct cluster_layer_info {
 };
 
 
-extern int yyparse(parseObj *p);
-
 /* evaluate the filter expression */
 int msClusterEvaluateFilter(expressionObj* expression, shapeObj *shape)
 {
@@ -158,7 +156,7 @@ int msClusterEvaluateFilter(expressionObj* expression, shapeObj *shape)
     p.expr->curtoken = p.expr->tokens; /* reset */
     p.type = MS_PARSE_TYPE_BOOLEAN;
 
-    status = yyparse(&p);
+    status = msEvalParse(&p);
 
     if (status != 0) {
       msSetError(MS_PARSEERR, "Failed to parse expression: %s", "msClusterEvaluateFilter", expression->string);
@@ -190,7 +188,7 @@ char *msClusterGetGroupText(expressionObj* expression, shapeObj *shape)
         p.expr->curtoken = p.expr->tokens; /* reset */
         p.type = MS_PARSE_TYPE_STRING;
 
-        status = yyparse(&p);
+        status = msEvalParse(&p);
 
         if (status != 0) {
           msSetError(MS_PARSEERR, "Failed to process text expression: %s", "msClusterGetGroupText", expression->string);
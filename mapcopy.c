@@ -345,6 +345,7 @@ int msCopyLabel(labelObj *dst, labelObj *src)
   MS_COPYSTELEM(wrap);
   MS_COPYSTELEM(align);
   MS_COPYSTELEM(maxlength);
+  MS_COPYSTELEM(minlength);
   MS_COPYSTELEM(minfeaturesize);
 
   MS_COPYSTELEM(minscaledenom);
@@ -430,6 +431,7 @@ int msCopyWeb(webObj *dst, webObj *src, mapObj *map)
   MS_COPYSTRING(dst->log, src->log);
   MS_COPYSTRING(dst->imagepath, src->imagepath);
   MS_COPYSTRING(dst->imageurl, src->imageurl);
+  MS_COPYSTRING(dst->temppath, src->temppath);
   dst->map = map;
 #ifndef __cplusplus
   MS_COPYSTRING(dst->template, src->template);
@@ -506,6 +508,8 @@ int msCopyStyle(styleObj *dst, styleObj *src)
   MS_COPYSTELEM(maxwidth);
   MS_COPYSTELEM(offsetx);
   MS_COPYSTELEM(offsety);
+  MS_COPYSTELEM(polaroffsetpixel);
+  MS_COPYSTELEM(polaroffsetangle);
   MS_COPYSTELEM(angle);
   MS_COPYSTELEM(autoangle);
   MS_COPYSTELEM(minvalue);
@@ -518,6 +522,7 @@ int msCopyStyle(styleObj *dst, styleObj *src)
   MS_COPYSTELEM(outlinewidth);
   MS_COPYSTELEM(minscaledenom);
   MS_COPYSTELEM(maxscaledenom);
+  MS_COPYSTELEM(position);
   /* TODO: add copy for bindings */
 
   return MS_SUCCESS;
@@ -616,6 +621,7 @@ int msCopyClass(classObj *dst, classObj *src, layerObj *layer)
 
   MS_COPYSTELEM(minscaledenom);
   MS_COPYSTELEM(maxscaledenom);
+  MS_COPYSTELEM(minfeaturesize);
   MS_COPYSTELEM(layer);
   MS_COPYSTELEM(debug);
 
@@ -864,6 +870,8 @@ int msCopyScalebar(scalebarObj *dst, scalebarObj *src)
   MS_COPYSTELEM(units);
   MS_COPYSTELEM(status);
   MS_COPYSTELEM(position);
+  MS_COPYSTELEM(offsetx);
+  MS_COPYSTELEM(offsety);
   MS_COPYSTELEM(transparent);
   MS_COPYSTELEM(interlace);
   MS_COPYSTELEM(postlabelcache);
@@ -1051,6 +1059,7 @@ int msCopyLayer(layerObj *dst, layerObj *src)
 
   MS_COPYSTELEM(sizeunits);
   MS_COPYSTELEM(maxfeatures);
+  MS_COPYSTELEM(minfeaturesize);
 
   MS_COPYCOLOR(&(dst->offsite), &(src->offsite));
 
@@ -1068,6 +1077,9 @@ int msCopyLayer(layerObj *dst, layerObj *src)
 
   MS_COPYSTRING(dst->tileindex, src->tileindex);
 
+  MS_COPYSTRING(dst->bandsitem, src->bandsitem);
+  MS_COPYSTELEM(bandsitemindex);
+
   return_value = msCopyProjection(&(dst->projection),&(src->projection));
   if (return_value != MS_SUCCESS) {
     msSetError(MS_MEMERR, "Failed to copy projection.", "msCopyLayer()");
@@ -1090,6 +1102,7 @@ int msCopyLayer(layerObj *dst, layerObj *src)
 
   MS_COPYSTRING(dst->connection, src->connection);
   MS_COPYSTELEM(connectiontype);
+  msCopyHashTable(&(dst->connectionoptions), &(src->connectionoptions));
 
   MS_COPYSTRING(dst->plugin_library, src->plugin_library);
   MS_COPYSTRING(dst->plugin_library_original, src->plugin_library_original);
@@ -1116,6 +1129,7 @@ int msCopyLayer(layerObj *dst, layerObj *src)
     msCopyHashTable(&(dst->metadata), &(src->metadata));
   }
   msCopyHashTable(&dst->validation,&src->validation);
+  msCopyHashTable(&(dst->bindvals), &(src->bindvals));
 
   MS_COPYSTELEM(dump);
   MS_COPYSTELEM(debug);
@@ -1155,6 +1169,24 @@ int msCopyLayer(layerObj *dst, layerObj *src)
     msCopyCompositer(&dst->compositer, src->compositer);
   }
 
+  return_value = msCopyExpression(&(dst->_geomtransform), &(src->_geomtransform));
+  if (return_value != MS_SUCCESS) {
+    msSetError(MS_MEMERR, "Failed to copy geomtransform.", "msCopyLayer()");
+    return MS_FAILURE;
+  }
+
+  MS_COPYSTRING(dst->utfitem, src->utfitem);
+  MS_COPYSTELEM(utfitemindex);
+  return_value = msCopyExpression(&(dst->utfdata), &(src->utfdata));
+  if (return_value != MS_SUCCESS) {
+    msSetError(MS_MEMERR, "Failed to copy utfdata.", "msCopyLayer()");
+    return MS_FAILURE;
+  }
+
+  if (src->sortBy.nProperties > 0) {
+    msLayerSetSort(dst, &(src->sortBy));
+  }
+
   return MS_SUCCESS;
 }
 
@@ -1182,6 +1214,9 @@ int msCopyMap(mapObj *dst, mapObj *src)
     if (msGrowMapLayers(dst) == NULL)
       return MS_FAILURE;
     initLayer((GET_LAYER(dst, i)), dst);
+    /* use the projection context of the new map rather than the one of */
+    /* the source map, so that both can be used from different threads */
+    msProjectionInheritContextFrom(&(GET_LAYER(dst, i)->projection), &(dst->projection));
 
     return_value = msCopyLayer((GET_LAYER(dst, i)), (GET_LAYER(src, i)));
     if (return_value != MS_SUCCESS) {
@@ -1209,6 +1244,8 @@ int msCopyMap(mapObj *dst, mapObj *src)
   MS_COPYSTELEM(imagequality);
 
   MS_COPYRECT(&(dst->extent), &(src->extent));
+  MS_COPYSTELEM(gt);
+  MS_COPYRECT(&(dst->saved_extent), &(src->saved_extent));
 
   MS_COPYSTELEM(cellsize);
   MS_COPYSTELEM(units);
@@ -1252,7 +1289,14 @@ int msCopyMap(mapObj *dst, mapObj *src)
     return MS_FAILURE;
   }
 
-  /* No need to copy latlon projection */
+  /* LATLON may be overridden in the mapfile, so replace the default one */
+  msFreeProjectionExceptContext(&(dst->latlon));
+  dst->latlon.args = (char **)msSmallMalloc(MS_MAXPROJARGS*sizeof(char *));
+  return_value = msCopyProjection(&(dst->latlon),&(src->latlon));
+  if (return_value != MS_SUCCESS) {
+    msSetError(MS_MEMERR, "Failed to copy latlon.", "msCopyMap()");
+    return MS_FAILURE;
+  }
 
   return_value = msCopyReferenceMap(&(dst->reference),&(src->reference),
                                     dst);
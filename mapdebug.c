@@ -63,57 +63,34 @@ debugInfoObj *msGetDebugInfoObj()
 
 #else
 
-static debugInfoObj *debuginfo_list = NULL;
-
-debugInfoObj *msGetDebugInfoObj()
+/* called with the debugInfoObj of an exiting thread */
+static void msFreeThreadDebugInfoObj(void *data)
 {
-  debugInfoObj *link;
-  void* thread_id;
-  debugInfoObj *ret_obj;
-
-  msAcquireLock( TLOCK_DEBUGOBJ );
+  debugInfoObj *debuginfo = (debugInfoObj *) data;
 
-  thread_id = msGetThreadId();
-
-  /* find link for this thread */
+  if (debuginfo->fp && debuginfo->debug_mode == MS_DEBUGMODE_FILE)
+    fclose(debuginfo->fp);
+  msFree(debuginfo->errorfile);
+  msFree(debuginfo);
+}
 
-  for( link = debuginfo_list;
-       link != NULL && link->thread_id != thread_id
-       && link->next != NULL && link->next->thread_id != thread_id;
-       link = link->next ) {}
+debugInfoObj *msGetDebugInfoObj()
+{
+  debugInfoObj *debuginfo;
 
-  /* If the target thread link is already at the head of the list were ok */
-  if( debuginfo_list != NULL && debuginfo_list->thread_id == thread_id ) {
-  }
+  debuginfo = (debugInfoObj *) msGetThreadSlot( TSLOT_DEBUGOBJ );
 
   /* We don't have one ... initialize one. */
-  else if( link == NULL || link->next == NULL ) {
-    debugInfoObj *new_link;
-
-    new_link = (debugInfoObj *) msSmallMalloc(sizeof(debugInfoObj));
-    new_link->next = debuginfo_list;
-    new_link->thread_id = thread_id;
-    new_link->global_debug_level = MS_DEBUGLEVEL_ERRORSONLY;
-    new_link->debug_mode = MS_DEBUGMODE_OFF;
-    new_link->errorfile = NULL;
-    new_link->fp = NULL;
-    debuginfo_list = new_link;
-  }
-
-  /* If the link is not already at the head of the list, promote it */
-  else if( link != NULL && link->next != NULL ) {
-    debugInfoObj *target = link->next;
-
-    link->next = link->next->next;
-    target->next = debuginfo_list;
-    debuginfo_list = target;
+  if( debuginfo == NULL ) {
+    debuginfo = (debugInfoObj *) msSmallMalloc(sizeof(debugInfoObj));
+    debuginfo->global_debug_level = MS_DEBUGLEVEL_ERRORSONLY;
+    debuginfo->debug_mode = MS_DEBUGMODE_OFF;
+    debuginfo->errorfile = NULL;
+    debuginfo->fp = NULL;
+    msSetThreadSlot( TSLOT_DEBUGOBJ, debuginfo, msFreeThreadDebugInfoObj );
   }
 
-  ret_obj = debuginfo_list;
-
-  msReleaseLock( TLOCK_DEBUGOBJ );
-
-  return ret_obj;
+  return debuginfo;
 }
 #endif
 
@@ -285,30 +262,12 @@ void msDebugCleanup()
 
 #ifdef USE_THREAD
   {
-    void*  thread_id = msGetThreadId();
-    debugInfoObj *link;
-
-    msAcquireLock( TLOCK_DEBUGOBJ );
-
-    /* find link for this thread */
-
-    for( link = debuginfo_list;
-         link != NULL && link->thread_id != thread_id
-         && link->next != NULL && link->next->thread_id != thread_id;
-         link = link->next ) {}
-
-    if( link->thread_id == thread_id ) {
-      /* presumably link is at head of list.  */
-      if( debuginfo_list == link )
-        debuginfo_list = link->next;
+    debugInfoObj *debuginfo = (debugInfoObj *) msGetThreadSlot( TSLOT_DEBUGOBJ );
 
-      free( link );
-    } else if( link->next != NULL && link->next->thread_id == thread_id ) {
-      debugInfoObj *next_link = link->next;
-      link->next = link->next->next;
-      free( next_link );
+    if( debuginfo != NULL ) {
+      msSetThreadSlot( TSLOT_DEBUGOBJ, NULL, NULL );
+      msFree( debuginfo );
     }
-    msReleaseLock( TLOCK_DEBUGOBJ );
   }
 #endif
 
@@ -35,6 +35,10 @@
 #include "mapfile.h"
 #include "mapows.h"
 
+#if defined(USE_THREAD) && !defined(_WIN32)
+#include <pthread.h>
+#endif
+
 
 /* msPrepareImage()
  *
@@ -210,6 +214,333 @@ static int msCompositeRasterBuffer(mapObj *map, imageObj *img, rasterBufferObj *
   return ret;
 }
 
+#if defined(USE_THREAD) && !defined(_WIN32)
+/*
+ * Parallel layer rendering, enabled with the MS_PARALLEL_LAYERS map CONFIG
+ * option set to the number of worker threads.
+ *
+ * Eligible layers are rendered by a pool of workers, each one drawing into
+ * a transparent image with its own copy of the map (PROJ contexts, symbol
+ * caches, layer connections and query state are not shareable between
+ * threads). msDrawMap() then merges the resulting buffers in layerorder,
+ * applying the layer compositing operators and filters, and draws the
+ * other layers itself in between, so that the stacking order and the
+ * content of the label cache are the same as in sequential mode. Pixels are
+ * not always bit identical: a layer drawn onto a transparent image and then
+ * merged goes through one more 8 bit premultiplied rounding step than a
+ * layer drawn directly, so antialiased edges and translucent fills can
+ * differ by a few levels per channel.
+ *
+ * Each worker gets a full msCopyMap() of the map for every request. The
+ * copies cannot be kept between requests since the source map is modified
+ * by the request, nor made by the workers themselves since copying a map
+ * touches the PROJ context of the source; their cost is reported at
+ * MS_DEBUGLEVEL_TUNING and by parallelbench.
+ */
+typedef struct {
+  int layerindex;
+  imageObj *image; /* layer rendered on a transparent background */
+  int status;
+  int done;
+  char *errormsg;
+} parallelLayerJob;
+
+typedef struct {
+  pthread_t thread;
+  mapObj *map; /* private copy of the map being drawn */
+  struct parallelLayerQueue *queue;
+} parallelLayerWorker;
+
+typedef struct parallelLayerQueue {
+  int width, height;
+  pointObj refpt;
+  parallelLayerJob *jobs;
+  int numjobs;
+  int nextjob;
+  int *jobindex; /* job of each layer, -1 if drawn sequentially */
+  int numlayers;
+  int abort;
+  parallelLayerWorker *workers;
+  int numworkers;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} parallelLayerQueue;
+
+/*
+ * Can this layer be drawn in its own image by a worker thread? Labels
+ * that go to the label cache must be added in layer order, and masks and
+ * alternate renderers rely on state shared through the mapObj. WFS layers
+ * are pre-downloaded into the source map's wfslayerinfo, which the worker's
+ * copy does not carry.
+ */
+static int msLayerCanDrawInParallel(mapObj *map, layerObj *lp)
+{
+  int i;
+
+  if(lp->postlabelcache || lp->connectiontype == MS_WMS ||
+      lp->connectiontype == MS_WFS)
+    return MS_FALSE;
+  /* keep layers whose connection or geometry depends on copied state */
+  /* sequential until drawing them from a map copy has been verified */
+  if(!msHashIsEmpty(&lp->bindvals) || !msHashIsEmpty(&lp->connectionoptions) ||
+      lp->_geomtransform.type != MS_GEOMTRANSFORM_NONE)
+    return MS_FALSE;
+  if(lp->mask || msLayerGetProcessingKey(lp, "RENDERER") ||
+      msLayerGetProcessingKey(lp, "FORCE_DRAW_LABEL_CACHE"))
+    return MS_FALSE;
+  if(lp->compositer && !lp->compositer->next && lp->compositer->opacity == 0)
+    return MS_FALSE; /* nothing to draw */
+  if(!msLayerIsVisible(map, lp))
+    return MS_FALSE;
+
+  if(lp->labelcache) {
+    for(i=0; i<lp->numclasses; i++) {
+      if(lp->class[i]->numlabels > 0)
+        return MS_FALSE;
+    }
+  }
+
+  for(i=0; i<map->numlayers; i++) {
+    layerObj *other = GET_LAYER(map, i);
+    if(other->mask && msGetLayerIndex(map, other->mask) == lp->index)
+      return MS_FALSE;
+  }
+
+  return MS_TRUE;
+}
+
+static void *msDrawLayerWorker(void *arg)
+{
+  parallelLayerWorker *worker = (parallelLayerWorker*)arg;
+  parallelLayerQueue *queue = worker->queue;
+  mapObj *map = worker->map;
+
+  while(1) {
+    parallelLayerJob *job;
+    layerObj *lp;
+    LayerCompositer *compositer;
+    imageObj *image;
+    int status = MS_FAILURE;
+    char *errormsg = NULL;
+
+    pthread_mutex_lock(&queue->mutex);
+    if(queue->abort || queue->nextjob >= queue->numjobs) {
+      pthread_mutex_unlock(&queue->mutex);
+      break;
+    }
+    job = &queue->jobs[queue->nextjob++];
+    /* output formats are shared with the images merged by the main thread */
+    image = msImageCreate(queue->width, queue->height, map->outputformat,
+                          NULL, NULL, map->resolution, map->defresolution, NULL);
+    pthread_mutex_unlock(&queue->mutex);
+
+    lp = GET_LAYER(map, job->layerindex);
+    if(image) {
+      image->map = map;
+      image->refpt = queue->refpt;
+
+      /* compositing is done when the image is merged by msDrawMap() */
+      compositer = lp->compositer;
+      lp->compositer = NULL;
+      status = msDrawLayer(map, lp, image);
+      lp->compositer = compositer;
+    }
+
+    if(status != MS_SUCCESS) {
+      errormsg = msGetErrorString(" ");
+      msResetErrorList();
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    if(status != MS_SUCCESS && image) {
+      msFreeImage(image);
+      image = NULL;
+    }
+    job->image = image;
+    job->status = status;
+    job->errormsg = errormsg;
+    job->done = MS_TRUE;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+  }
+
+  return NULL;
+}
+
+/*
+ * Waits for the workers and frees the queue.
+ */
+static void msDrawMapStopParallelLayers(parallelLayerQueue *queue)
+{
+  int i;
+
+  if(!queue)
+    return;
+
+  pthread_mutex_lock(&queue->mutex);
+  queue->abort = MS_TRUE;
+  pthread_mutex_unlock(&queue->mutex);
+
+  for(i=0; i<queue->numworkers; i++)
+    pthread_join(queue->workers[i].thread, NULL);
+
+  for(i=0; i<queue->numjobs; i++) {
+    if(queue->jobs[i].image)
+      msFreeImage(queue->jobs[i].image);
+    msFree(queue->jobs[i].errormsg);
+  }
+  for(i=0; i<queue->numworkers; i++)
+    msFreeMap(queue->workers[i].map);
+
+  pthread_mutex_destroy(&queue->mutex);
+  pthread_cond_destroy(&queue->cond);
+  msFree(queue->workers);
+  msFree(queue->jobs);
+  msFree(queue->jobindex);
+  msFree(queue);
+}
+
+/*
+ * Starts the worker threads if parallel rendering is enabled and applies
+ * to this map. Returns NULL if all layers are to be drawn sequentially.
+ */
+static parallelLayerQueue *msDrawMapStartParallelLayers(mapObj *map, imageObj *image)
+{
+  parallelLayerQueue *queue;
+  rendererVTableObj *renderer;
+  const char *value;
+  int i, numthreads, numjobs = 0;
+  struct mstimeval starttime = {0}, endtime = {0};
+
+  value = msGetConfigOption(map, "MS_PARALLEL_LAYERS");
+  if(!value || (numthreads = atoi(value)) < 2)
+    return NULL;
+
+  if(!MS_RENDERER_PLUGIN(image->format) || map->gt.need_geotransform)
+    return NULL;
+  renderer = MS_IMAGE_RENDERER(image);
+  if(!renderer->supports_pixel_buffer || !renderer->getRasterBufferHandle ||
+      !renderer->mergeRasterBuffer || !renderer->compositeRasterBuffer)
+    return NULL;
+
+  for(i=0; i<map->numlayers; i++) {
+    if(map->layerorder[i] != -1 &&
+        msLayerCanDrawInParallel(map, GET_LAYER(map, map->layerorder[i])))
+      numjobs++;
+  }
+  if(numjobs < 2)
+    return NULL;
+  if(numthreads > numjobs)
+    numthreads = numjobs;
+
+  queue = (parallelLayerQueue*)msSmallCalloc(1, sizeof(parallelLayerQueue));
+  queue->width = image->width;
+  queue->height = image->height;
+  queue->refpt = image->refpt;
+  queue->numlayers = map->numlayers;
+  queue->jobindex = (int*)msSmallMalloc(map->numlayers * sizeof(int));
+  queue->jobs = (parallelLayerJob*)msSmallCalloc(numjobs, sizeof(parallelLayerJob));
+  queue->workers = (parallelLayerWorker*)msSmallCalloc(numthreads, sizeof(parallelLayerWorker));
+  pthread_mutex_init(&queue->mutex, NULL);
+  pthread_cond_init(&queue->cond, NULL);
+
+  /* jobs are queued in layerorder, the order in which they are merged */
+  for(i=0; i<map->numlayers; i++)
+    queue->jobindex[i] = -1;
+  for(i=0; i<map->numlayers; i++) {
+    if(map->layerorder[i] != -1 &&
+        msLayerCanDrawInParallel(map, GET_LAYER(map, map->layerorder[i]))) {
+      queue->jobs[queue->numjobs].layerindex = map->layerorder[i];
+      queue->jobindex[map->layerorder[i]] = queue->numjobs++;
+    }
+  }
+
+  if(map->debug >= MS_DEBUGLEVEL_TUNING) msGettimeofday(&starttime, NULL);
+
+  /* the copies are made before any thread is started, map is not modified meanwhile */
+  for(i=0; i<numthreads; i++) {
+    parallelLayerWorker *worker = &queue->workers[queue->numworkers];
+    int j;
+
+    worker->queue = queue;
+    worker->map = msNewMapObj();
+    if(!worker->map || msCopyMap(worker->map, map) != MS_SUCCESS ||
+        !worker->map->outputformat ||
+        worker->map->outputformat->vtable != image->format->vtable) {
+      msFreeMap(worker->map);
+      break;
+    }
+    /* derived by msPrepareImage(), not copied */
+    for(j=0; j<map->numlayers; j++)
+      GET_LAYER(worker->map, j)->scalefactor = GET_LAYER(map, j)->scalefactor;
+
+    if(pthread_create(&worker->thread, NULL, msDrawLayerWorker, worker) != 0) {
+      msFreeMap(worker->map);
+      break;
+    }
+    queue->numworkers++;
+  }
+
+  if(queue->numworkers == 0) {
+    msResetErrorList();
+    msDrawMapStopParallelLayers(queue);
+    return NULL;
+  }
+
+  if(map->debug >= MS_DEBUGLEVEL_DEBUG)
+    msDebug("msDrawMap(): drawing %d layers with %d worker threads.\n",
+            queue->numjobs, queue->numworkers);
+  if(map->debug >= MS_DEBUGLEVEL_TUNING) {
+    msGettimeofday(&endtime, NULL);
+    msDebug("msDrawMap(): copying the map for %d worker threads, %.3fs\n",
+            queue->numworkers,
+            (endtime.tv_sec+endtime.tv_usec/1.0e6)-
+            (starttime.tv_sec+starttime.tv_usec/1.0e6) );
+  }
+
+  return queue;
+}
+
+/*
+ * Waits for the layer drawn by a worker and merges it into the map image.
+ */
+static int msDrawMapMergeParallelLayer(mapObj *map, parallelLayerQueue *queue, layerObj *lp, imageObj *image)
+{
+  parallelLayerJob *job = &queue->jobs[queue->jobindex[lp->index]];
+  rasterBufferObj rb;
+  int status;
+
+  pthread_mutex_lock(&queue->mutex);
+  while(!job->done)
+    pthread_cond_wait(&queue->cond, &queue->mutex);
+  pthread_mutex_unlock(&queue->mutex);
+
+  if(job->status != MS_SUCCESS) {
+    msSetError(MS_IMGERR, "%s", "msDrawLayer()",
+               job->errormsg ? job->errormsg : "Worker thread failed to draw layer.");
+    return MS_FAILURE;
+  }
+
+  msImageStartLayer(map, lp, image);
+  memset(&rb,0,sizeof(rasterBufferObj));
+  status = MS_IMAGE_RENDERER(job->image)->getRasterBufferHandle(job->image,&rb);
+  if(status == MS_SUCCESS) {
+    if(lp->compositer)
+      status = msCompositeRasterBuffer(map,image,&rb,lp->compositer);
+    else
+      status = MS_IMAGE_RENDERER(image)->mergeRasterBuffer(image,&rb,1.0,0,0,0,0,rb.width,rb.height);
+  }
+  msImageEndLayer(map,lp,image);
+
+  pthread_mutex_lock(&queue->mutex);
+  msFreeImage(job->image);
+  job->image = NULL;
+  pthread_mutex_unlock(&queue->mutex);
+
+  return status;
+}
+#endif /* USE_THREAD && !_WIN32 */
+
 /*
  * Generic function to render the map file.
  * The type of the image created is based on the imagetype parameter in the map file.
@@ -225,6 +556,9 @@ imageObj *msDrawMap(mapObj *map, int querymap)
   imageObj *image = NULL;
   struct mstimeval mapstarttime = {0}, mapendtime = {0};
   struct mstimeval starttime = {0}, endtime = {0};
+#if defined(USE_THREAD) && !defined(_WIN32)
+  parallelLayerQueue *parallel = NULL;
+#endif
 
 #if defined(USE_WMS_LYR) || defined(USE_WFS_LYR)
   enum MS_CONNECTION_TYPE lastconnectiontype;
@@ -347,6 +681,11 @@ imageObj *msDrawMap(mapObj *map, int querymap)
 
 #endif /* USE_WMS_LYR || USE_WFS_LYR */
 
+#if defined(USE_THREAD) && !defined(_WIN32)
+  if(!querymap)
+    parallel = msDrawMapStartParallelLayers(map, image);
+#endif
+
   /* OK, now we can start drawing */
   for(i=0; i<map->numlayers; i++) {
 
@@ -362,6 +701,23 @@ imageObj *msDrawMap(mapObj *map, int querymap)
 
       if(!msLayerIsVisible(map, lp)) continue;
 
+#if defined(USE_THREAD) && !defined(_WIN32)
+      if(parallel && parallel->jobindex[lp->index] != -1) {
+        status = msDrawMapMergeParallelLayer(map, parallel, lp, image);
+        if(status == MS_FAILURE) {
+          msSetError(MS_IMGERR, "Failed to draw layer named '%s'.", "msDrawMap()", lp->name);
+          msDrawMapStopParallelLayers(parallel);
+          msFreeImage(image);
+#if defined(USE_WMS_LYR) || defined(USE_WFS_LYR)
+          if (pasOWSReqInfo) {
+            msHTTPFreeRequestObj(pasOWSReqInfo, numOWSRequests);
+            msFree(pasOWSReqInfo);
+          }
+#endif /* USE_WMS_LYR || USE_WFS_LYR */
+          return(NULL);
+        }
+      } else
+#endif
       if(lp->connectiontype == MS_WMS) {
 #ifdef USE_WMS_LYR
         if(MS_RENDERER_PLUGIN(image->format) || MS_RENDERER_RAWDATA(image->format))
@@ -378,6 +734,9 @@ imageObj *msDrawMap(mapObj *map, int querymap)
                      "or another unexpected result in response to the GetMap request. Also check "
                      "and make sure that the layer's connection URL is valid.",
                      "msDrawMap()", lp->name);
+#if defined(USE_THREAD) && !defined(_WIN32)
+          msDrawMapStopParallelLayers(parallel);
+#endif
           msFreeImage(image);
           msHTTPFreeRequestObj(pasOWSReqInfo, numOWSRequests);
           msFree(pasOWSReqInfo);
@@ -387,6 +746,9 @@ imageObj *msDrawMap(mapObj *map, int querymap)
 
 #else /* ndef USE_WMS_LYR */
         msSetError(MS_WMSCONNERR, "MapServer not built with WMS Client support, unable to render layer '%s'.", "msDrawMap()", lp->name);
+#if defined(USE_THREAD) && !defined(_WIN32)
+        msDrawMapStopParallelLayers(parallel);
+#endif
         msFreeImage(image);
         return(NULL);
 #endif
@@ -397,6 +759,9 @@ imageObj *msDrawMap(mapObj *map, int querymap)
           status = msDrawLayer(map, lp, image);
         if(status == MS_FAILURE) {
           msSetError(MS_IMGERR, "Failed to draw layer named '%s'.", "msDrawMap()", lp->name);
+#if defined(USE_THREAD) && !defined(_WIN32)
+          msDrawMapStopParallelLayers(parallel);
+#endif
           msFreeImage(image);
 #if defined(USE_WMS_LYR) || defined(USE_WFS_LYR)
           if (pasOWSReqInfo) {
@@ -422,6 +787,9 @@ imageObj *msDrawMap(mapObj *map, int querymap)
 	if(map->debug >= MS_DEBUGLEVEL_V)
 	  msDebug("msDrawMap(): PROCESSING FORCE_DRAW_LABEL_CACHE=FLUSH found.\n");
 	if(msDrawLabelCache(map, image) != MS_SUCCESS) {
+#if defined(USE_THREAD) && !defined(_WIN32)
+	  msDrawMapStopParallelLayers(parallel);
+#endif
 	  msFreeImage(image);
 #if defined(USE_WMS_LYR) || defined(USE_WFS_LYR)
 	  if (pasOWSReqInfo) {
@@ -438,6 +806,10 @@ imageObj *msDrawMap(mapObj *map, int querymap)
     }
   }
 
+#if defined(USE_THREAD) && !defined(_WIN32)
+  msDrawMapStopParallelLayers(parallel);
+#endif
+
   if(map->scalebar.status == MS_EMBED && !map->scalebar.postlabelcache) {
 
     /* We need to temporarily restore the original extent for drawing */
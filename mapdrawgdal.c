@@ -1549,8 +1549,9 @@ LoadGDALImages( GDALDatasetH hDS, int band_numbers[4], int band_count,
 /*                       msGetGDALGeoTransform()                        */
 /*                                                                      */
 /*      Cover function that tries GDALGetGeoTransform(), a world        */
-/*      file or OWS extents.  It is assumed that TLOCK_GDAL is held     */
-/*      before this function is called.                                 */
+/*      file or OWS extents.  hDS must not be used concurrently by      */
+/*      another thread, which holds for the per-thread shared           */
+/*      datasets returned by msDrawRasterLayerLowOpenDataset().         */
 /************************************************************************/
 
 int msGetGDALGeoTransform( GDALDatasetH hDS, mapObj *map, layerObj *layer,
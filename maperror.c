@@ -98,62 +98,34 @@ errorObj *msGetErrorObj()
 
 #ifdef USE_THREAD
 
-typedef struct te_info {
-  struct te_info *next;
-  void*             thread_id;
-  errorObj        ms_error;
-} te_info_t;
+/* called with the errorObj of an exiting thread */
+static void msFreeThreadErrorObj(void *data)
+{
+  errorObj *ms_error = (errorObj *) data, *next_error;
 
-static te_info_t *error_list = NULL;
+  while(ms_error != NULL) {
+    next_error = ms_error->next;
+    free(ms_error);
+    ms_error = next_error;
+  }
+}
 
 errorObj *msGetErrorObj()
 {
-  te_info_t *link;
-  void*        thread_id;
-  errorObj   *ret_obj;
-
-  msAcquireLock( TLOCK_ERROROBJ );
-
-  thread_id = msGetThreadId();
-
-  /* find link for this thread */
-
-  for( link = error_list;
-       link != NULL && link->thread_id != thread_id
-       && link->next != NULL && link->next->thread_id != thread_id;
-       link = link->next ) {}
+  errorObj *ms_error;
 
-  /* If the target thread link is already at the head of the list were ok */
-  if( error_list != NULL && error_list->thread_id == thread_id ) {
-  }
+  ms_error = (errorObj *) msGetThreadSlot(TSLOT_ERROROBJ);
 
   /* We don't have one ... initialize one. */
-  else if( link == NULL || link->next == NULL ) {
-    te_info_t *new_link;
-    errorObj   error_obj = { MS_NOERR, "", "", 0 };
+  if(ms_error == NULL) {
+    errorObj error_obj = {MS_NOERR, "", "", MS_FALSE, 0, NULL};
 
-    new_link = (te_info_t *) malloc(sizeof(te_info_t));
-    new_link->next = error_list;
-    new_link->thread_id = thread_id;
-    new_link->ms_error = error_obj;
-
-    error_list = new_link;
+    ms_error = (errorObj *) msSmallMalloc(sizeof(errorObj));
+    *ms_error = error_obj;
+    msSetThreadSlot(TSLOT_ERROROBJ, ms_error, msFreeThreadErrorObj);
   }
 
-  /* If the link is not already at the head of the list, promote it */
-  else if( link != NULL && link->next != NULL ) {
-    te_info_t *target = link->next;
-
-    link->next = link->next->next;
-    target->next = error_list;
-    error_list = target;
-  }
-
-  ret_obj = &(error_list->ms_error);
-
-  msReleaseLock( TLOCK_ERROROBJ );
-
-  return ret_obj;
+  return ms_error;
 }
 #endif
 
@@ -235,36 +207,12 @@ void msResetErrorList()
   ms_error->errorcount = 0;
 
   /* -------------------------------------------------------------------- */
-  /*      Cleanup our entry in the thread list.  This is mainly           */
+  /*      Cleanup our entry in the thread slots.  This is mainly          */
   /*      imprortant when msCleanup() calls msResetErrorList().           */
   /* -------------------------------------------------------------------- */
 #ifdef USE_THREAD
-  {
-    void*  thread_id = msGetThreadId();
-    te_info_t *link;
-
-    msAcquireLock( TLOCK_ERROROBJ );
-
-    /* find link for this thread */
-
-    for( link = error_list;
-         link != NULL && link->thread_id != thread_id
-         && link->next != NULL && link->next->thread_id != thread_id;
-         link = link->next ) {}
-
-    if( link->thread_id == thread_id ) {
-      /* presumably link is at head of list.  */
-      if( error_list == link )
-        error_list = link->next;
-
-      free( link );
-    } else if( link->next != NULL && link->next->thread_id == thread_id ) {
-      te_info_t *next_link = link->next;
-      link->next = link->next->next;
-      free( next_link );
-    }
-    msReleaseLock( TLOCK_ERROROBJ );
-  }
+  msSetThreadSlot(TSLOT_ERROROBJ, NULL, NULL);
+  free(ms_error);
 #endif
 }
 
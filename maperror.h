@@ -163,9 +163,6 @@ extern "C" {
     debugMode   debug_mode;
     char        *errorfile;
     FILE        *fp;
-    /* The following 2 members are used only with USE_THREAD (but we won't #ifndef them) */
-    void* thread_id;
-    struct debug_info_obj *next;
   } debugInfoObj;
 
 
@@ -0,0 +1,773 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Compiled evaluation of expressions, avoiding yyparse() per feature
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *****************************************************************************/
+
+/*
+** The token list of an expression is compiled once into a typed tree, which
+** is then evaluated for every feature instead of running the bison parser
+** (mapparser.y) again. Only the logical, math and string parts of the grammar
+** are supported (no time or shape values): expressions using anything else,
+** or that the grammar would reject, are left to yyparse() so that errors and
+** results stay exactly the same.
+*/
+
+#include "mapserver.h"
+#include <math.h>
+
+extern int yyparse(parseObj *);
+
+enum { EXPR_LOGICAL, EXPR_MATH, EXPR_STRING };
+
+/* binding powers, following the precedence declarations of mapparser.y */
+#define EXPR_PREC_NOT 3
+#define EXPR_PREC_NEG 8
+
+typedef struct expressionNode expressionNode;
+struct expressionNode {
+  int op; /* token of the operator, function, literal or binding */
+  int type; /* EXPR_LOGICAL, EXPR_MATH or EXPR_STRING */
+  int canfail; /* the evaluation of this subtree may raise an error */
+  expressionNode *left, *right;
+
+  double dblval; /* numeric and boolean literals */
+  char *strval; /* string literals */
+  int index; /* item index of attribute bindings */
+
+  /* IN against a literal list */
+  char **list;
+  double *numbers;
+  int numlist;
+
+  /* RE and IRE against a literal pattern */
+  ms_regex_t regex;
+  int regex_status; /* 0: not precompiled, 1: compiled, -1: invalid pattern */
+};
+
+struct expressionProgram {
+  tokenListNodeObjPtr tokens; /* token list the program was compiled from */
+  expressionNode *root; /* NULL if the expression needs the full parser */
+};
+
+typedef struct {
+  tokenListNodeObjPtr token; /* next token to consume */
+} expressionCompiler;
+
+static void exprFreeNode(expressionNode *node)
+{
+  int i;
+
+  if(!node) return;
+  exprFreeNode(node->left);
+  exprFreeNode(node->right);
+  msFree(node->strval);
+  for(i=0; i<node->numlist; i++)
+    msFree(node->list[i]);
+  msFree(node->list);
+  msFree(node->numbers);
+  if(node->regex_status == 1) ms_regfree(&(node->regex));
+  free(node);
+}
+
+static expressionNode *exprNewNode(int op, int type)
+{
+  expressionNode *node = (expressionNode *) msSmallCalloc(1, sizeof(expressionNode));
+  node->op = op;
+  node->type = type;
+  return node;
+}
+
+/* split a comma separated list the way the IN operator of mapparser.y does */
+static char **exprSplitList(const char *string, int *count)
+{
+  const char *start = string, *delim;
+  char **list;
+  int n = 1;
+
+  for(delim = string; (delim = strchr(delim, ',')) != NULL; delim++) n++;
+  list = (char **) msSmallMalloc(n * sizeof(char *));
+
+  n = 0;
+  while((delim = strchr(start, ',')) != NULL) {
+    list[n] = (char *) msSmallMalloc(delim - start + 1);
+    strlcpy(list[n], start, delim - start + 1);
+    n++;
+    start = delim + 1;
+  }
+  list[n++] = msStrdup(start);
+
+  *count = n;
+  return list;
+}
+
+static int exprBinaryPrecedence(int token)
+{
+  switch(token) {
+    case MS_TOKEN_LOGICAL_OR:
+      return 1;
+    case MS_TOKEN_LOGICAL_AND:
+      return 2;
+    case MS_TOKEN_COMPARISON_EQ:
+    case MS_TOKEN_COMPARISON_NE:
+    case MS_TOKEN_COMPARISON_GT:
+    case MS_TOKEN_COMPARISON_LT:
+    case MS_TOKEN_COMPARISON_GE:
+    case MS_TOKEN_COMPARISON_LE:
+    case MS_TOKEN_COMPARISON_IEQ:
+    case MS_TOKEN_COMPARISON_RE:
+    case MS_TOKEN_COMPARISON_IRE:
+    case MS_TOKEN_COMPARISON_IN:
+      return 4;
+    case '+':
+    case '-':
+      return 6;
+    case '*':
+    case '/':
+    case '%':
+      return 7;
+    case '^':
+      return 9;
+  }
+  return -1;
+}
+
+/* type of a binary operation, or -1 if mapparser.y has no rule for it */
+static int exprBinaryType(int op, int ltype, int rtype)
+{
+  switch(op) {
+    case MS_TOKEN_LOGICAL_AND:
+    case MS_TOKEN_LOGICAL_OR:
+      if(ltype != EXPR_STRING && rtype != EXPR_STRING) return EXPR_LOGICAL;
+      break;
+    case MS_TOKEN_COMPARISON_EQ:
+      if(ltype == rtype) return EXPR_LOGICAL;
+      break;
+    case MS_TOKEN_COMPARISON_NE:
+    case MS_TOKEN_COMPARISON_GT:
+    case MS_TOKEN_COMPARISON_LT:
+    case MS_TOKEN_COMPARISON_GE:
+    case MS_TOKEN_COMPARISON_LE:
+    case MS_TOKEN_COMPARISON_IEQ:
+      if(ltype == rtype && ltype != EXPR_LOGICAL) return EXPR_LOGICAL;
+      break;
+    case MS_TOKEN_COMPARISON_RE:
+    case MS_TOKEN_COMPARISON_IRE:
+      if(ltype == EXPR_STRING && rtype == EXPR_STRING) return EXPR_LOGICAL;
+      break;
+    case MS_TOKEN_COMPARISON_IN:
+      if(ltype != EXPR_LOGICAL && rtype == EXPR_STRING) return EXPR_LOGICAL;
+      break;
+    case '+':
+      if(ltype == rtype && ltype != EXPR_LOGICAL) return ltype;
+      break;
+    case '-':
+    case '*':
+    case '/':
+    case '%':
+    case '^':
+      if(ltype == EXPR_MATH && rtype == EXPR_MATH) return EXPR_MATH;
+      break;
+  }
+  return -1;
+}
+
+static expressionNode *exprCompile(expressionCompiler *c, int minprec);
+
+static int exprExpect(expressionCompiler *c, int token)
+{
+  if(!c->token || c->token->token != token) return MS_FAILURE;
+  c->token = c->token->next;
+  return MS_SUCCESS;
+}
+
+/* function arguments: '(' exp [',' exp] ')' with the given types */
+static expressionNode *exprCompileFunction(expressionCompiler *c, int op, int type, int argtype1, int argtype2)
+{
+  expressionNode *node = exprNewNode(op, type);
+
+  if(exprExpect(c, '(') != MS_SUCCESS) goto fail;
+  node->left = exprCompile(c, 0);
+  if(!node->left || node->left->type != argtype1) goto fail;
+  if(argtype2 >= 0) {
+    if(exprExpect(c, ',') != MS_SUCCESS) goto fail;
+    node->right = exprCompile(c, 0);
+    if(!node->right || node->right->type != argtype2) goto fail;
+  }
+  if(exprExpect(c, ')') != MS_SUCCESS) goto fail;
+
+  node->canfail = node->left->canfail || (node->right && node->right->canfail);
+  return node;
+
+fail:
+  exprFreeNode(node);
+  return NULL;
+}
+
+static expressionNode *exprCompilePrimary(expressionCompiler *c)
+{
+  tokenListNodeObjPtr token = c->token;
+  expressionNode *node = NULL;
+
+  if(!token) return NULL;
+  c->token = token->next;
+
+  switch(token->token) {
+    case MS_TOKEN_LITERAL_BOOLEAN:
+      node = exprNewNode(token->token, EXPR_LOGICAL);
+      node->dblval = token->tokenval.dblval;
+      break;
+    case MS_TOKEN_LITERAL_NUMBER:
+      node = exprNewNode(token->token, EXPR_MATH);
+      node->dblval = token->tokenval.dblval;
+      break;
+    case MS_TOKEN_LITERAL_STRING:
+      node = exprNewNode(token->token, EXPR_STRING);
+      node->strval = msStrdup(token->tokenval.strval);
+      break;
+    case MS_TOKEN_BINDING_DOUBLE:
+    case MS_TOKEN_BINDING_INTEGER:
+      node = exprNewNode(token->token, EXPR_MATH);
+      node->index = token->tokenval.bindval.index;
+      break;
+    case MS_TOKEN_BINDING_STRING:
+      node = exprNewNode(token->token, EXPR_STRING);
+      node->index = token->tokenval.bindval.index;
+      break;
+    case MS_TOKEN_BINDING_MAP_CELLSIZE:
+    case MS_TOKEN_BINDING_DATA_CELLSIZE:
+      node = exprNewNode(token->token, EXPR_MATH);
+      break;
+    case MS_TOKEN_LOGICAL_NOT: {
+      expressionNode *operand = exprCompile(c, EXPR_PREC_NOT+1);
+      if(!operand) return NULL;
+      if(operand->type == EXPR_STRING) {
+        exprFreeNode(operand);
+        return NULL;
+      }
+      node = exprNewNode(token->token, EXPR_LOGICAL);
+      node->left = operand;
+      node->canfail = operand->canfail;
+      break;
+    }
+    case '-':
+      /* mapparser.y leaves the operand of unary minus as is */
+      node = exprCompile(c, EXPR_PREC_NEG+1);
+      if(node && node->type != EXPR_MATH) {
+        exprFreeNode(node);
+        return NULL;
+      }
+      break;
+    case '(':
+      node = exprCompile(c, 0);
+      if(node && exprExpect(c, ')') != MS_SUCCESS) {
+        exprFreeNode(node);
+        return NULL;
+      }
+      break;
+    case MS_TOKEN_FUNCTION_LENGTH:
+      node = exprCompileFunction(c, token->token, EXPR_MATH, EXPR_STRING, -1);
+      break;
+    case MS_TOKEN_FUNCTION_ROUND:
+      node = exprCompileFunction(c, token->token, EXPR_MATH, EXPR_MATH, EXPR_MATH);
+      break;
+    case MS_TOKEN_FUNCTION_TOSTRING:
+      node = exprCompileFunction(c, token->token, EXPR_STRING, EXPR_MATH, EXPR_STRING);
+      break;
+    case MS_TOKEN_FUNCTION_COMMIFY:
+    case MS_TOKEN_FUNCTION_UPPER:
+    case MS_TOKEN_FUNCTION_LOWER:
+    case MS_TOKEN_FUNCTION_INITCAP:
+    case MS_TOKEN_FUNCTION_FIRSTCAP:
+      node = exprCompileFunction(c, token->token, EXPR_STRING, EXPR_STRING, -1);
+      break;
+    default: /* time, shapes, spatial operators... */
+      return NULL;
+  }
+
+  return node;
+}
+
+static expressionNode *exprCompile(expressionCompiler *c, int minprec)
+{
+  expressionNode *left, *right, *node;
+  int op, prec, type;
+
+  left = exprCompilePrimary(c);
+  if(!left) return NULL;
+
+  while(c->token) {
+    op = c->token->token;
+    prec = exprBinaryPrecedence(op);
+    if(prec < 0 || prec < minprec) break;
+    c->token = c->token->next;
+
+    right = exprCompile(c, (op == '^') ? prec : prec+1); /* '^' is right associative */
+    if(!right) {
+      exprFreeNode(left);
+      return NULL;
+    }
+
+    type = exprBinaryType(op, left->type, right->type);
+    if(type < 0) {
+      exprFreeNode(left);
+      exprFreeNode(right);
+      return NULL;
+    }
+
+    node = exprNewNode(op, type);
+    node->left = left;
+    node->right = right;
+    node->canfail = left->canfail || right->canfail;
+    if(op == '/' && !(right->op == MS_TOKEN_LITERAL_NUMBER && right->dblval != 0.0))
+      node->canfail = MS_TRUE;
+
+    if(right->op == MS_TOKEN_LITERAL_STRING) {
+      if(op == MS_TOKEN_COMPARISON_IN) {
+        int i;
+        node->list = exprSplitList(right->strval, &(node->numlist));
+        node->numbers = (double *) msSmallMalloc(node->numlist * sizeof(double));
+        for(i=0; i<node->numlist; i++)
+          node->numbers[i] = atof(node->list[i]);
+      } else if(op == MS_TOKEN_COMPARISON_RE || op == MS_TOKEN_COMPARISON_IRE) {
+        int flags = MS_REG_EXTENDED|MS_REG_NOSUB;
+        if(op == MS_TOKEN_COMPARISON_IRE) flags |= MS_REG_ICASE;
+        node->regex_status = (ms_regcomp(&(node->regex), right->strval, flags) == 0) ? 1 : -1;
+      }
+    }
+
+    left = node;
+  }
+
+  return left;
+}
+
+static int exprEvalLogical(expressionNode *node, parseObj *p, int *value);
+static int exprEvalMath(expressionNode *node, parseObj *p, double *value);
+static int exprEvalString(expressionNode *node, parseObj *p, char **value, int *owned);
+
+/* truth value of a logical or math operand, as used by AND, OR */
+static int exprEvalTruth(expressionNode *node, parseObj *p, int *value)
+{
+  if(node->type == EXPR_LOGICAL) {
+    int v;
+    if(exprEvalLogical(node, p, &v) != MS_SUCCESS) return MS_FAILURE;
+    *value = (v == MS_TRUE);
+  } else {
+    double d;
+    if(exprEvalMath(node, p, &d) != MS_SUCCESS) return MS_FAILURE;
+    *value = (d != 0);
+  }
+  return MS_SUCCESS;
+}
+
+static int exprMatchRegex(expressionNode *node, const char *string, const char *pattern)
+{
+  ms_regex_t re;
+  int flags = MS_REG_EXTENDED|MS_REG_NOSUB, match;
+
+  if(MS_STRING_IS_NULL_OR_EMPTY(string) == MS_TRUE) return MS_FALSE;
+
+  if(node->regex_status == 1)
+    return (ms_regexec(&(node->regex), string, 0, NULL, 0) == 0) ? MS_TRUE : MS_FALSE;
+  if(node->regex_status == -1)
+    return MS_FALSE;
+
+  if(node->op == MS_TOKEN_COMPARISON_IRE) flags |= MS_REG_ICASE;
+  if(ms_regcomp(&re, pattern, flags) != 0) return MS_FALSE;
+  match = (ms_regexec(&re, string, 0, NULL, 0) == 0) ? MS_TRUE : MS_FALSE;
+  ms_regfree(&re);
+
+  return match;
+}
+
+static int exprMatchList(expressionNode *node, const char *string, double number, const char *liststring)
+{
+  char **list = node->list;
+  int i, n = node->numlist, match = MS_FALSE;
+
+  if(!list) list = exprSplitList(liststring, &n);
+
+  for(i=0; i<n && !match; i++) {
+    if(string)
+      match = (strcmp(string, list[i]) == 0);
+    else
+      match = (number == (node->list ? node->numbers[i] : atof(list[i])));
+  }
+
+  if(!node->list) {
+    for(i=0; i<n; i++) msFree(list[i]);
+    msFree(list);
+  }
+
+  return match ? MS_TRUE : MS_FALSE;
+}
+
+static int exprEvalComparison(expressionNode *node, parseObj *p, int *value)
+{
+  int cmp = 0;
+
+  switch(node->left->type) {
+    case EXPR_LOGICAL: { /* only EQ */
+      int l, r;
+      if(exprEvalLogical(node->left, p, &l) != MS_SUCCESS || exprEvalLogical(node->right, p, &r) != MS_SUCCESS)
+        return MS_FAILURE;
+      *value = (l == r) ? MS_TRUE : MS_FALSE;
+      return MS_SUCCESS;
+    }
+    case EXPR_MATH: {
+      double l, r;
+      if(exprEvalMath(node->left, p, &l) != MS_SUCCESS) return MS_FAILURE;
+      if(node->op == MS_TOKEN_COMPARISON_IN) {
+        char *list;
+        int owned;
+        if(exprEvalString(node->right, p, &list, &owned) != MS_SUCCESS) return MS_FAILURE;
+        *value = exprMatchList(node, NULL, l, list);
+        if(owned) free(list);
+        return MS_SUCCESS;
+      }
+      if(exprEvalMath(node->right, p, &r) != MS_SUCCESS) return MS_FAILURE;
+      switch(node->op) {
+        case MS_TOKEN_COMPARISON_NE:
+          *value = (l != r);
+          break;
+        case MS_TOKEN_COMPARISON_GT:
+          *value = (l > r);
+          break;
+        case MS_TOKEN_COMPARISON_LT:
+          *value = (l < r);
+          break;
+        case MS_TOKEN_COMPARISON_GE:
+          *value = (l >= r);
+          break;
+        case MS_TOKEN_COMPARISON_LE:
+          *value = (l <= r);
+          break;
+        default: /* EQ, IEQ */
+          *value = (l == r);
+          break;
+      }
+      *value = *value ? MS_TRUE : MS_FALSE;
+      return MS_SUCCESS;
+    }
+    case EXPR_STRING: {
+      char *l, *r;
+      int lowned, rowned;
+      if(exprEvalString(node->left, p, &l, &lowned) != MS_SUCCESS) return MS_FAILURE;
+      if(exprEvalString(node->right, p, &r, &rowned) != MS_SUCCESS) {
+        if(lowned) free(l);
+        return MS_FAILURE;
+      }
+      switch(node->op) {
+        case MS_TOKEN_COMPARISON_RE:
+        case MS_TOKEN_COMPARISON_IRE:
+          *value = exprMatchRegex(node, l, r);
+          break;
+        case MS_TOKEN_COMPARISON_IN:
+          *value = exprMatchList(node, l, 0, r);
+          break;
+        case MS_TOKEN_COMPARISON_IEQ:
+          cmp = strcasecmp(l, r);
+          break;
+        default:
+          cmp = strcmp(l, r);
+          break;
+      }
+      if(lowned) free(l);
+      if(rowned) free(r);
+      if(node->op == MS_TOKEN_COMPARISON_RE || node->op == MS_TOKEN_COMPARISON_IRE || node->op == MS_TOKEN_COMPARISON_IN)
+        return MS_SUCCESS;
+      break;
+    }
+  }
+
+  /* string comparisons */
+  switch(node->op) {
+    case MS_TOKEN_COMPARISON_NE:
+      *value = (cmp != 0);
+      break;
+    case MS_TOKEN_COMPARISON_GT:
+      *value = (cmp > 0);
+      break;
+    case MS_TOKEN_COMPARISON_LT:
+      *value = (cmp < 0);
+      break;
+    case MS_TOKEN_COMPARISON_GE:
+      *value = (cmp >= 0);
+      break;
+    case MS_TOKEN_COMPARISON_LE:
+      *value = (cmp <= 0);
+      break;
+    default: /* EQ, IEQ */
+      *value = (cmp == 0);
+      break;
+  }
+  *value = *value ? MS_TRUE : MS_FALSE;
+
+  return MS_SUCCESS;
+}
+
+static int exprEvalLogical(expressionNode *node, parseObj *p, int *value)
+{
+  int l, r;
+
+  switch(node->op) {
+    case MS_TOKEN_LITERAL_BOOLEAN:
+      *value = node->dblval;
+      return MS_SUCCESS;
+    case MS_TOKEN_LOGICAL_AND:
+    case MS_TOKEN_LOGICAL_OR:
+      if(exprEvalTruth(node->left, p, &l) != MS_SUCCESS) return MS_FAILURE;
+      /* mapparser.y evaluates both sides, so only short-circuit if that can't raise an error */
+      if(!node->right->canfail && l == (node->op == MS_TOKEN_LOGICAL_OR)) {
+        *value = l;
+        return MS_SUCCESS;
+      }
+      if(exprEvalTruth(node->right, p, &r) != MS_SUCCESS) return MS_FAILURE;
+      *value = (node->op == MS_TOKEN_LOGICAL_OR) ? (l || r) : (l && r);
+      return MS_SUCCESS;
+    case MS_TOKEN_LOGICAL_NOT:
+      if(node->left->type == EXPR_LOGICAL) {
+        if(exprEvalLogical(node->left, p, &l) != MS_SUCCESS) return MS_FAILURE;
+        *value = !l;
+      } else {
+        double d;
+        if(exprEvalMath(node->left, p, &d) != MS_SUCCESS) return MS_FAILURE;
+        *value = !d;
+      }
+      return MS_SUCCESS;
+    default:
+      return exprEvalComparison(node, p, value);
+  }
+}
+
+static int exprEvalMath(expressionNode *node, parseObj *p, double *value)
+{
+  double l, r;
+
+  switch(node->op) {
+    case MS_TOKEN_LITERAL_NUMBER:
+      *value = node->dblval;
+      return MS_SUCCESS;
+    case MS_TOKEN_BINDING_DOUBLE:
+    case MS_TOKEN_BINDING_INTEGER:
+      *value = atof(p->shape->values[node->index]);
+      return MS_SUCCESS;
+    case MS_TOKEN_BINDING_MAP_CELLSIZE:
+      *value = p->dblval;
+      return MS_SUCCESS;
+    case MS_TOKEN_BINDING_DATA_CELLSIZE:
+      *value = p->dblval2;
+      return MS_SUCCESS;
+    case MS_TOKEN_FUNCTION_LENGTH: {
+      char *s;
+      int owned;
+      if(exprEvalString(node->left, p, &s, &owned) != MS_SUCCESS) return MS_FAILURE;
+      *value = strlen(s);
+      if(owned) free(s);
+      return MS_SUCCESS;
+    }
+  }
+
+  if(exprEvalMath(node->left, p, &l) != MS_SUCCESS || exprEvalMath(node->right, p, &r) != MS_SUCCESS)
+    return MS_FAILURE;
+
+  switch(node->op) {
+    case '+':
+      *value = l + r;
+      break;
+    case '-':
+      *value = l - r;
+      break;
+    case '*':
+      *value = l * r;
+      break;
+    case '%':
+      *value = (int)l % (int)r;
+      break;
+    case '/':
+      if(r == 0.0) {
+        msSetError(MS_PARSEERR, "%s", "yyparse()", "Division by zero.");
+        return MS_FAILURE;
+      }
+      *value = l / r;
+      break;
+    case '^':
+      *value = pow(l, r);
+      break;
+    case MS_TOKEN_FUNCTION_ROUND:
+      *value = (MS_NINT(l/r))*r;
+      break;
+  }
+
+  return MS_SUCCESS;
+}
+
+/* *value is only to be freed by the caller if *owned is set */
+static int exprEvalString(expressionNode *node, parseObj *p, char **value, int *owned)
+{
+  char *s, *s2;
+  int sowned, s2owned;
+
+  *owned = MS_FALSE;
+  switch(node->op) {
+    case MS_TOKEN_LITERAL_STRING:
+      *value = node->strval;
+      return MS_SUCCESS;
+    case MS_TOKEN_BINDING_STRING:
+      *value = p->shape->values[node->index];
+      if(!*value) *value = ""; /* as msStrdup() would */
+      return MS_SUCCESS;
+    case MS_TOKEN_FUNCTION_TOSTRING: {
+      double d;
+      size_t size;
+      if(exprEvalMath(node->left, p, &d) != MS_SUCCESS) return MS_FAILURE;
+      if(exprEvalString(node->right, p, &s, &sowned) != MS_SUCCESS) return MS_FAILURE;
+      size = strlen(s) + 64;
+      *value = (char *) msSmallMalloc(size);
+      snprintf(*value, size, s, d);
+      if(sowned) free(s);
+      *owned = MS_TRUE;
+      return MS_SUCCESS;
+    }
+    case '+':
+      if(exprEvalString(node->left, p, &s, &sowned) != MS_SUCCESS) return MS_FAILURE;
+      if(exprEvalString(node->right, p, &s2, &s2owned) != MS_SUCCESS) {
+        if(sowned) free(s);
+        return MS_FAILURE;
+      }
+      *value = (char *) msSmallMalloc(strlen(s) + strlen(s2) + 1);
+      sprintf(*value, "%s%s", s, s2);
+      if(sowned) free(s);
+      if(s2owned) free(s2);
+      *owned = MS_TRUE;
+      return MS_SUCCESS;
+  }
+
+  /* functions modifying their argument */
+  if(exprEvalString(node->left, p, &s, &sowned) != MS_SUCCESS) return MS_FAILURE;
+  if(!sowned) s = msStrdup(s);
+  switch(node->op) {
+    case MS_TOKEN_FUNCTION_COMMIFY:
+      s = msCommifyString(s);
+      break;
+    case MS_TOKEN_FUNCTION_UPPER:
+      msStringToUpper(s);
+      break;
+    case MS_TOKEN_FUNCTION_LOWER:
+      msStringToLower(s);
+      break;
+    case MS_TOKEN_FUNCTION_INITCAP:
+      msStringInitCap(s);
+      break;
+    case MS_TOKEN_FUNCTION_FIRSTCAP:
+      msStringFirstCap(s);
+      break;
+  }
+  *value = s;
+  *owned = MS_TRUE;
+
+  return MS_SUCCESS;
+}
+
+void msFreeExpressionProgram(expressionObj *expression)
+{
+  if(!expression || !expression->program) return;
+  exprFreeNode(expression->program->root);
+  free(expression->program);
+  expression->program = NULL;
+}
+
+/*
+** Drop-in replacement for yyparse(p): evaluates p->expr for p->shape and
+** sets p->result, returning 0 on success. The expression is compiled the
+** first time it is evaluated with its current token list.
+*/
+int msEvalParse(parseObj *p)
+{
+  expressionObj *expression = p->expr;
+  expressionNode *root;
+
+  if(p->type == MS_PARSE_TYPE_SHAPE || expression->tokens == NULL)
+    return yyparse(p);
+
+  if(expression->program == NULL || expression->program->tokens != expression->tokens) {
+    expressionCompiler c;
+
+    msFreeExpressionProgram(expression);
+    expression->program = (struct expressionProgram *) msSmallCalloc(1, sizeof(struct expressionProgram));
+    expression->program->tokens = expression->tokens;
+
+    c.token = expression->tokens;
+    expression->program->root = exprCompile(&c, 0);
+    if(expression->program->root && c.token != NULL) { /* trailing tokens */
+      exprFreeNode(expression->program->root);
+      expression->program->root = NULL;
+    }
+  }
+
+  root = expression->program->root;
+  if(root == NULL) {
+    p->expr->curtoken = p->expr->tokens; /* reset */
+    return yyparse(p);
+  }
+
+  switch(root->type) {
+    case EXPR_LOGICAL: {
+      int value;
+      if(exprEvalLogical(root, p, &value) != MS_SUCCESS) return MS_FAILURE;
+      if(p->type == MS_PARSE_TYPE_BOOLEAN)
+        p->result.intval = value;
+      else
+        p->result.strval = msStrdup(value ? "true" : "false");
+      break;
+    }
+    case EXPR_MATH: {
+      double value;
+      if(exprEvalMath(root, p, &value) != MS_SUCCESS) return MS_FAILURE;
+      if(p->type == MS_PARSE_TYPE_BOOLEAN) {
+        p->result.intval = (value != 0) ? MS_TRUE : MS_FALSE;
+      } else {
+        p->result.strval = (char *) msSmallMalloc(64); /* large enough for a double */
+        snprintf(p->result.strval, 64, "%g", value);
+      }
+      break;
+    }
+    case EXPR_STRING: {
+      char *value;
+      int owned;
+      if(exprEvalString(root, p, &value, &owned) != MS_SUCCESS) return MS_FAILURE;
+      if(p->type == MS_PARSE_TYPE_BOOLEAN) {
+        p->result.intval = MS_TRUE; /* string is not NULL */
+        if(owned) free(value);
+      } else
+        p->result.strval = owned ? value : msStrdup(value);
+      break;
+    }
+  }
+
+  return MS_SUCCESS;
+}
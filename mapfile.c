@@ -35,6 +35,7 @@
 #include <assert.h>
 #include <ctype.h>
 #include <float.h>
+#include <sys/stat.h>
 
 #include "mapserver.h"
 #include "mapfile.h"
@@ -1913,6 +1914,7 @@ void msInitExpression(expressionObj *exp)
   exp->compiled = MS_FALSE;
   exp->flags = 0;
   exp->tokens = exp->curtoken = NULL;
+  exp->program = NULL;
 }
 
 void msFreeExpressionTokens(expressionObj *exp)
@@ -1922,6 +1924,8 @@ void msFreeExpressionTokens(expressionObj *exp)
 
   if(!exp) return;
 
+  msFreeExpressionProgram(exp);
+
   if(exp->tokens) {
     node = exp->tokens;
     while (node != NULL) {
@@ -3539,6 +3543,7 @@ int initLayer(layerObj *layer, mapObj *map)
 
   layer->classitem = NULL;
   layer->classitemindex = -1;
+  layer->classindex = NULL;
 
   layer->units = MS_METERS;
   if(msInitProjection(&(layer->projection)) == -1) return(-1);
@@ -3677,6 +3682,8 @@ int freeLayer(layerObj *layer)
   if(msLayerIsOpen(layer))
     msLayerClose(layer);
 
+  msLayerFreeClassIndex(layer);
+
   msFree(layer->name);
   msFree(layer->encoding);
   msFree(layer->group);
@@ -6040,6 +6047,7 @@ int msFreeLabelCache(labelCacheObj *cache)
 
   cache->num_allocated_rendered_members = cache->num_rendered_members = 0;
   msFree(cache->rendered_text_symbols);
+  msFreeLabelCacheIndex(cache);
 
   return MS_SUCCESS;
 }
@@ -6076,6 +6084,7 @@ int msInitLabelCache(labelCacheObj *cache)
   cache->gutter = 0;
   cache->num_allocated_rendered_members = cache->num_rendered_members = 0;
   cache->rendered_text_symbols = NULL;
+  cache->index = NULL;
 
   return MS_SUCCESS;
 }
@@ -6587,6 +6596,115 @@ mapObj *msLoadMap(const char *filename, const char *new_mappath)
   return map;
 }
 
+/*
+** Per process cache of parsed mapfiles, so that long running processes (e.g.
+** FastCGI mapserv) don't parse the same mapfile over and over. Parsed maps are
+** kept pristine, keyed on the filename, modification time and size, and each
+** caller gets its own copy. Changes to INCLUDEd, symbolset or fontset files
+** are not detected. The cache is enabled by setting the MS_MAPFILE_CACHE_SIZE
+** environment variable to the number of mapfiles to keep.
+*/
+typedef struct {
+  char *filename;
+  time_t mtime;
+  off_t size;
+  mapObj *map;
+  unsigned long last_use;
+} mapFileCacheEntry;
+
+static mapFileCacheEntry *mapfile_cache = NULL;
+static int mapfile_cache_size = -1;
+static unsigned long mapfile_cache_clock = 0;
+
+static mapObj *msCloneCachedMap(mapObj *src)
+{
+  mapObj *map = msNewMapObj();
+
+  if(!map) return NULL;
+  if(msCopyMap(map, src) != MS_SUCCESS) {
+    msFreeMap(map);
+    return NULL;
+  }
+
+  /* what msLoadMap() does besides parsing */
+  msApplyMapConfigOptions(map);
+
+  return map;
+}
+
+mapObj *msLoadMapCached(const char *filename)
+{
+  struct stat sb;
+  mapObj *map = NULL;
+  int i, slot = 0;
+
+  msAcquireLock(TLOCK_MAPFILE);
+  if(mapfile_cache_size < 0) {
+    const char *size = getenv("MS_MAPFILE_CACHE_SIZE");
+    mapfile_cache_size = size ? MS_MAX(atoi(size), 0) : 0;
+    if(mapfile_cache_size > 0)
+      mapfile_cache = (mapFileCacheEntry*)msSmallCalloc(mapfile_cache_size, sizeof(mapFileCacheEntry));
+  }
+  if(mapfile_cache_size == 0 || !filename || stat(filename, &sb) != 0) {
+    msReleaseLock(TLOCK_MAPFILE);
+    return msLoadMap(filename, NULL);
+  }
+
+  for(i=0; i<mapfile_cache_size; i++) {
+    mapFileCacheEntry *entry = &(mapfile_cache[i]);
+    if(entry->filename && strcmp(entry->filename, filename) == 0) {
+      if(entry->mtime == sb.st_mtime && entry->size == sb.st_size) {
+        entry->last_use = ++mapfile_cache_clock;
+        map = msCloneCachedMap(entry->map);
+        msReleaseLock(TLOCK_MAPFILE);
+        if(map && map->debug >= MS_DEBUGLEVEL_TUNING)
+          msDebug("msLoadMapCached(): using cached copy of %s\n", filename);
+        return map;
+      }
+      /* the file changed, reuse its slot */
+      slot = i;
+      break;
+    }
+    if(!entry->filename || entry->last_use < mapfile_cache[slot].last_use)
+      slot = i;
+  }
+  msReleaseLock(TLOCK_MAPFILE);
+
+  /* the parser has its own lock, don't hold ours while parsing */
+  map = msLoadMap(filename, NULL);
+  if(!map) return NULL;
+
+  msAcquireLock(TLOCK_MAPFILE);
+  if(mapfile_cache[slot].filename) {
+    msFree(mapfile_cache[slot].filename);
+    msFreeMap(mapfile_cache[slot].map);
+  }
+  mapfile_cache[slot].filename = msStrdup(filename);
+  mapfile_cache[slot].mtime = sb.st_mtime;
+  mapfile_cache[slot].size = sb.st_size;
+  mapfile_cache[slot].map = map;
+  mapfile_cache[slot].last_use = ++mapfile_cache_clock;
+  map = msCloneCachedMap(map);
+  msReleaseLock(TLOCK_MAPFILE);
+
+  return map;
+}
+
+void msMapFileCacheCleanup(void)
+{
+  int i;
+
+  msAcquireLock(TLOCK_MAPFILE);
+  for(i=0; i<mapfile_cache_size; i++) {
+    msFree(mapfile_cache[i].filename);
+    msFreeMap(mapfile_cache[i].map);
+  }
+  msFree(mapfile_cache);
+  mapfile_cache = NULL;
+  mapfile_cache_size = -1;
+  msReleaseLock(TLOCK_MAPFILE);
+}
+
 /*
 ** Loads mapfile snippets via a URL (only via the CGI so don't worry about thread locks)
 */
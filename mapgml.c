@@ -40,67 +40,103 @@
 
 static int msGMLGeometryLookup(gmlGeometryListObj *geometryList, const char *type);
 
+/*
+** Coordinates are written with 6 decimals, as "%f" would (see msFormatDouble()).
+*/
+#define GML_COORDINATE_PRECISION 6
+
+/* Writes x<separator>y, plus <separator>z for 3D output, then terminator if not 0. */
+static void gmlWriteCoordinates(msIOWriter *writer, pointObj *point,
+                                int nSRSDimension, char separator, char terminator)
+{
+  msIO_writerPutDouble(writer, point->x, GML_COORDINATE_PRECISION);
+  msIO_writerWrite(writer, &separator, 1);
+  msIO_writerPutDouble(writer, point->y, GML_COORDINATE_PRECISION);
+#ifdef USE_POINT_Z_M
+  if( nSRSDimension == 3 ) {
+    msIO_writerWrite(writer, &separator, 1);
+    msIO_writerPutDouble(writer, point->z, GML_COORDINATE_PRECISION);
+  }
+#endif
+  if( terminator )
+    msIO_writerWrite(writer, &terminator, 1);
+}
+
 /*
 ** Functions that write the feature boundary geometry (i.e. a rectObj).
 */
 
 /* GML 2.1.2 */
-static int gmlWriteBounds_GML2(FILE *stream, rectObj *rect,
+static int gmlWriteBounds_GML2(msIOWriter *writer, rectObj *rect,
                                const char *srsname, const char *tab,
                                const char *pszTopPrefix)
 {
   char *srsname_encoded;
 
-  if(!stream) return(MS_FAILURE);
+  if(!writer) return(MS_FAILURE);
   if(!rect) return(MS_FAILURE);
   if(!tab) return(MS_FAILURE);
 
-  msIO_fprintf(stream, "%s<%s:boundedBy>\n", tab, pszTopPrefix);
+  msIO_writerPrintf(writer, "%s<%s:boundedBy>\n", tab, pszTopPrefix);
   if(srsname) {
     srsname_encoded = msEncodeHTMLEntities(srsname);
-    msIO_fprintf(stream, "%s\t<gml:Box srsName=\"%s\">\n", tab, srsname_encoded);
+    msIO_writerPrintf(writer, "%s\t<gml:Box srsName=\"%s\">\n", tab, srsname_encoded);
     msFree(srsname_encoded);
   } else
-    msIO_fprintf(stream, "%s\t<gml:Box>\n", tab);
-
-  msIO_fprintf(stream, "%s\t\t<gml:coordinates>", tab);
-  msIO_fprintf(stream, "%.6f,%.6f %.6f,%.6f", rect->minx, rect->miny, rect->maxx, rect->maxy );
-  msIO_fprintf(stream, "</gml:coordinates>\n");
-  msIO_fprintf(stream, "%s\t</gml:Box>\n", tab);
-  msIO_fprintf(stream, "%s</%s:boundedBy>\n", tab, pszTopPrefix);
+    msIO_writerPrintf(writer, "%s\t<gml:Box>\n", tab);
+
+  msIO_writerPrintf(writer, "%s\t\t<gml:coordinates>", tab);
+  msIO_writerPutDouble(writer, rect->minx, GML_COORDINATE_PRECISION);
+  msIO_writerPuts(writer, ",");
+  msIO_writerPutDouble(writer, rect->miny, GML_COORDINATE_PRECISION);
+  msIO_writerPuts(writer, " ");
+  msIO_writerPutDouble(writer, rect->maxx, GML_COORDINATE_PRECISION);
+  msIO_writerPuts(writer, ",");
+  msIO_writerPutDouble(writer, rect->maxy, GML_COORDINATE_PRECISION);
+  msIO_writerPrintf(writer, "</gml:coordinates>\n");
+  msIO_writerPrintf(writer, "%s\t</gml:Box>\n", tab);
+  msIO_writerPrintf(writer, "%s</%s:boundedBy>\n", tab, pszTopPrefix);
 
   return MS_SUCCESS;
 }
 
 /* GML 3.1 or GML 3.2 (MapServer limits GML encoding to the level 0 profile) */
-static int gmlWriteBounds_GML3(FILE *stream, rectObj *rect,
+static int gmlWriteBounds_GML3(msIOWriter *writer, rectObj *rect,
                                const char *srsname, const char *tab,
                                const char *pszTopPrefix)
 {
   char *srsname_encoded;
 
-  if(!stream) return(MS_FAILURE);
+  if(!writer) return(MS_FAILURE);
   if(!rect) return(MS_FAILURE);
   if(!tab) return(MS_FAILURE);
 
-  msIO_fprintf(stream, "%s<%s:boundedBy>\n", tab, pszTopPrefix);
+  msIO_writerPrintf(writer, "%s<%s:boundedBy>\n", tab, pszTopPrefix);
   if(srsname) {
     srsname_encoded = msEncodeHTMLEntities(srsname);
-    msIO_fprintf(stream, "%s\t<gml:Envelope srsName=\"%s\">\n", tab, srsname_encoded);
+    msIO_writerPrintf(writer, "%s\t<gml:Envelope srsName=\"%s\">\n", tab, srsname_encoded);
     msFree(srsname_encoded);
   } else
-    msIO_fprintf(stream, "%s\t<gml:Envelope>\n", tab);
-
-  msIO_fprintf(stream, "%s\t\t<gml:lowerCorner>%.6f %.6f</gml:lowerCorner>\n", tab, rect->minx, rect->miny);
-  msIO_fprintf(stream, "%s\t\t<gml:upperCorner>%.6f %.6f</gml:upperCorner>\n", tab, rect->maxx, rect->maxy);
-
-  msIO_fprintf(stream, "%s\t</gml:Envelope>\n", tab);
-  msIO_fprintf(stream, "%s</%s:boundedBy>\n", tab, pszTopPrefix);
+    msIO_writerPrintf(writer, "%s\t<gml:Envelope>\n", tab);
+
+  msIO_writerPrintf(writer, "%s\t\t<gml:lowerCorner>", tab);
+  msIO_writerPutDouble(writer, rect->minx, GML_COORDINATE_PRECISION);
+  msIO_writerPuts(writer, " ");
+  msIO_writerPutDouble(writer, rect->miny, GML_COORDINATE_PRECISION);
+  msIO_writerPuts(writer, "</gml:lowerCorner>\n");
+  msIO_writerPrintf(writer, "%s\t\t<gml:upperCorner>", tab);
+  msIO_writerPutDouble(writer, rect->maxx, GML_COORDINATE_PRECISION);
+  msIO_writerPuts(writer, " ");
+  msIO_writerPutDouble(writer, rect->maxy, GML_COORDINATE_PRECISION);
+  msIO_writerPuts(writer, "</gml:upperCorner>\n");
+
+  msIO_writerPrintf(writer, "%s\t</gml:Envelope>\n", tab);
+  msIO_writerPrintf(writer, "%s</%s:boundedBy>\n", tab, pszTopPrefix);
 
   return MS_SUCCESS;
 }
 
-static void gmlStartGeometryContainer(FILE *stream, const char *name,
+static void gmlStartGeometryContainer(msIOWriter *writer, const char *name,
                                       const char *namespace, const char *tab)
 {
   const char *tag_name=OWS_GML_DEFAULT_GEOMETRY_NAME;
@@ -108,12 +144,12 @@ static void gmlStartGeometryContainer(FILE *stream, const char *name,
   if(name) tag_name = name;
 
   if(namespace)
-    msIO_fprintf(stream, "%s<%s:%s>\n", tab, namespace, tag_name);
+    msIO_writerPrintf(writer, "%s<%s:%s>\n", tab, namespace, tag_name);
   else
-    msIO_fprintf(stream, "%s<%s>\n", tab, tag_name);
+    msIO_writerPrintf(writer, "%s<%s>\n", tab, tag_name);
 }
 
-static void gmlEndGeometryContainer(FILE *stream, const char *name,
+static void gmlEndGeometryContainer(msIOWriter *writer, const char *name,
                                     const char *namespace, const char *tab)
 {
   const char *tag_name=OWS_GML_DEFAULT_GEOMETRY_NAME;
@@ -121,13 +157,13 @@ static void gmlEndGeometryContainer(FILE *stream, const char *name,
   if(name) tag_name = name;
 
   if(namespace)
-    msIO_fprintf(stream, "%s</%s:%s>\n", tab, namespace, tag_name);
+    msIO_writerPrintf(writer, "%s</%s:%s>\n", tab, namespace, tag_name);
   else
-    msIO_fprintf(stream, "%s</%s>\n", tab, tag_name);
+    msIO_writerPrintf(writer, "%s</%s>\n", tab, tag_name);
 }
 
 /* GML 2.1.2 */
-static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
+static int gmlWriteGeometry_GML2(msIOWriter *writer, gmlGeometryListObj *geometryList,
                                  shapeObj *shape, const char *srsname,
                                  const char *namespace, const char *tab,
                                  int nSRSDimension)
@@ -139,7 +175,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
   int geometry_aggregate_index, geometry_simple_index;
   char *geometry_aggregate_name = NULL, *geometry_simple_name = NULL;
 
-  if(!stream) return(MS_FAILURE);
+  if(!writer) return(MS_FAILURE);
   if(!shape) return(MS_FAILURE);
   if(!tab) return(MS_FAILURE);
   if(!geometryList) return(MS_FAILURE);
@@ -163,59 +199,48 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
 
         for(i=0; i<shape->numlines; i++) {
           for(j=0; j<shape->line[i].numpoints; j++) {
-            gmlStartGeometryContainer(stream, geometry_simple_name, namespace, tab);
+            gmlStartGeometryContainer(writer, geometry_simple_name, namespace, tab);
 
             /* Point */
             if(srsname_encoded)
-              msIO_fprintf(stream, "%s<gml:Point srsName=\"%s\">\n", tab, srsname_encoded);
-            else
-              msIO_fprintf(stream, "%s<gml:Point>\n", tab);
-#ifdef USE_POINT_Z_M
-            if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%s  <gml:coordinates>%f,%f,%f</gml:coordinates>\n",
-                           tab, shape->line[i].point[j].x, shape->line[i].point[j].y, shape->line[i].point[j].z);
+              msIO_writerPrintf(writer, "%s<gml:Point srsName=\"%s\">\n", tab, srsname_encoded);
             else
-                /* fall-through */
-#endif
-            msIO_fprintf(stream, "%s  <gml:coordinates>%f,%f</gml:coordinates>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y);
+              msIO_writerPrintf(writer, "%s<gml:Point>\n", tab);
+            msIO_writerPrintf(writer, "%s  <gml:coordinates>", tab);
+            gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ',', 0);
+            msIO_writerPuts(writer, "</gml:coordinates>\n");
 
-            msIO_fprintf(stream, "%s</gml:Point>\n", tab);
+            msIO_writerPrintf(writer, "%s</gml:Point>\n", tab);
 
-            gmlEndGeometryContainer(stream, geometry_simple_name, namespace, tab);
+            gmlEndGeometryContainer(writer, geometry_simple_name, namespace, tab);
           }
         }
       } else if((geometry_aggregate_index != -1) || (geometryList->numgeometries == 0)) { /* write a MultiPoint */
-        gmlStartGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlStartGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
 
         /* MultiPoint */
         if(srsname_encoded)
-          msIO_fprintf(stream, "%s<gml:MultiPoint srsName=\"%s\">\n", tab, srsname_encoded);
+          msIO_writerPrintf(writer, "%s<gml:MultiPoint srsName=\"%s\">\n", tab, srsname_encoded);
         else
-          msIO_fprintf(stream, "%s<gml:MultiPoint>\n", tab);
+          msIO_writerPrintf(writer, "%s<gml:MultiPoint>\n", tab);
 
         for(i=0; i<shape->numlines; i++) {
           for(j=0; j<shape->line[i].numpoints; j++) {
-            msIO_fprintf(stream, "%s  <gml:pointMember>\n", tab);
-            msIO_fprintf(stream, "%s    <gml:Point>\n", tab);
-#ifdef USE_POINT_Z_M
-            if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%s      <gml:coordinates>%f,%f,%f</gml:coordinates>\n",
-                           tab, shape->line[i].point[j].x, shape->line[i].point[j].y,
-                           shape->line[i].point[j].z);
-            else
-                /* fall-through */
-#endif
-            msIO_fprintf(stream, "%s      <gml:coordinates>%f,%f</gml:coordinates>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y);
-            msIO_fprintf(stream, "%s    </gml:Point>\n", tab);
-            msIO_fprintf(stream, "%s  </gml:pointMember>\n", tab);
+            msIO_writerPrintf(writer, "%s  <gml:pointMember>\n", tab);
+            msIO_writerPrintf(writer, "%s    <gml:Point>\n", tab);
+            msIO_writerPrintf(writer, "%s      <gml:coordinates>", tab);
+            gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ',', 0);
+            msIO_writerPuts(writer, "</gml:coordinates>\n");
+            msIO_writerPrintf(writer, "%s    </gml:Point>\n", tab);
+            msIO_writerPrintf(writer, "%s  </gml:pointMember>\n", tab);
           }
         }
 
-        msIO_fprintf(stream, "%s</gml:MultiPoint>\n", tab);
+        msIO_writerPrintf(writer, "%s</gml:MultiPoint>\n", tab);
 
-        gmlEndGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlEndGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
       } else {
-        msIO_fprintf(stream, "<!-- Warning: Cannot write geometry- no point/multipoint geometry defined. -->\n");
+        msIO_writerPrintf(writer, "<!-- Warning: Cannot write geometry- no point/multipoint geometry defined. -->\n");
       }
 
       break;
@@ -229,67 +254,53 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
           (geometry_simple_index != -1 && geometry_aggregate_index == -1) ||
           (geometryList->numgeometries == 0 && shape->numlines == 1)) { /* write a LineStrings(s) */
         for(i=0; i<shape->numlines; i++) {
-          gmlStartGeometryContainer(stream, geometry_simple_name, namespace, tab);
+          gmlStartGeometryContainer(writer, geometry_simple_name, namespace, tab);
 
           /* LineString */
           if(srsname_encoded)
-            msIO_fprintf(stream, "%s<gml:LineString srsName=\"%s\">\n", tab, srsname_encoded);
+            msIO_writerPrintf(writer, "%s<gml:LineString srsName=\"%s\">\n", tab, srsname_encoded);
           else
-            msIO_fprintf(stream, "%s<gml:LineString>\n", tab);
+            msIO_writerPrintf(writer, "%s<gml:LineString>\n", tab);
 
-          msIO_fprintf(stream, "%s  <gml:coordinates>", tab);
+          msIO_writerPrintf(writer, "%s  <gml:coordinates>", tab);
           for(j=0; j<shape->line[i].numpoints; j++)
           {
-#ifdef USE_POINT_Z_M
-            if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%f,%f,%f ", shape->line[i].point[j].x, shape->line[i].point[j].y,
-                           shape->line[i].point[j].z);
-            else
-                /* fall-through */
-#endif
-            msIO_fprintf(stream, "%f,%f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+            gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ',', ' ');
           }
-          msIO_fprintf(stream, "</gml:coordinates>\n");
+          msIO_writerPrintf(writer, "</gml:coordinates>\n");
 
-          msIO_fprintf(stream, "%s</gml:LineString>\n", tab);
+          msIO_writerPrintf(writer, "%s</gml:LineString>\n", tab);
 
-          gmlEndGeometryContainer(stream, geometry_simple_name, namespace, tab);
+          gmlEndGeometryContainer(writer, geometry_simple_name, namespace, tab);
         }
       } else if(geometry_aggregate_index != -1 || (geometryList->numgeometries == 0)) { /* write a MultiCurve */
-        gmlStartGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlStartGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
 
         /* MultiLineString */
         if(srsname_encoded)
-          msIO_fprintf(stream, "%s<gml:MultiLineString srsName=\"%s\">\n", tab, srsname_encoded);
+          msIO_writerPrintf(writer, "%s<gml:MultiLineString srsName=\"%s\">\n", tab, srsname_encoded);
         else
-          msIO_fprintf(stream, "%s<gml:MultiLineString>\n", tab);
+          msIO_writerPrintf(writer, "%s<gml:MultiLineString>\n", tab);
 
         for(j=0; j<shape->numlines; j++) {
-          msIO_fprintf(stream, "%s  <gml:lineStringMember>\n", tab); /* no srsname at this point */
-          msIO_fprintf(stream, "%s    <gml:LineString>\n", tab); /* no srsname at this point */
+          msIO_writerPrintf(writer, "%s  <gml:lineStringMember>\n", tab); /* no srsname at this point */
+          msIO_writerPrintf(writer, "%s    <gml:LineString>\n", tab); /* no srsname at this point */
 
-          msIO_fprintf(stream, "%s      <gml:coordinates>", tab);
+          msIO_writerPrintf(writer, "%s      <gml:coordinates>", tab);
           for(i=0; i<shape->line[j].numpoints; i++)
           {
-#ifdef USE_POINT_Z_M
-            if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%f,%f,%f ", shape->line[j].point[i].x, shape->line[j].point[i].y,
-                           shape->line[j].point[i].z);
-            else
-                /* fall-through */
-#endif
-            msIO_fprintf(stream, "%f,%f ", shape->line[j].point[i].x, shape->line[j].point[i].y);
+            gmlWriteCoordinates(writer, &(shape->line[j].point[i]), nSRSDimension, ',', ' ');
           }
-          msIO_fprintf(stream, "</gml:coordinates>\n");
-          msIO_fprintf(stream, "%s    </gml:LineString>\n", tab);
-          msIO_fprintf(stream, "%s  </gml:lineStringMember>\n", tab);
+          msIO_writerPrintf(writer, "</gml:coordinates>\n");
+          msIO_writerPrintf(writer, "%s    </gml:LineString>\n", tab);
+          msIO_writerPrintf(writer, "%s  </gml:lineStringMember>\n", tab);
         }
 
-        msIO_fprintf(stream, "%s</gml:MultiLineString>\n", tab);
+        msIO_writerPrintf(writer, "%s</gml:MultiLineString>\n", tab);
 
-        gmlEndGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlEndGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
       } else {
-        msIO_fprintf(stream, "<!-- Warning: Cannot write geometry- no line/multiline geometry defined. -->\n");
+        msIO_writerPrintf(writer, "<!-- Warning: Cannot write geometry- no line/multiline geometry defined. -->\n");
       }
 
       break;
@@ -315,139 +326,111 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
           /* get a list of inner rings for this polygon */
           innerlist = msGetInnerList(shape, i, outerlist);
 
-          gmlStartGeometryContainer(stream, geometry_simple_name, namespace, tab);
+          gmlStartGeometryContainer(writer, geometry_simple_name, namespace, tab);
 
           /* Polygon */
           if(srsname_encoded)
-            msIO_fprintf(stream, "%s<gml:Polygon srsName=\"%s\">\n", tab, srsname_encoded);
+            msIO_writerPrintf(writer, "%s<gml:Polygon srsName=\"%s\">\n", tab, srsname_encoded);
           else
-            msIO_fprintf(stream, "%s<gml:Polygon>\n", tab);
+            msIO_writerPrintf(writer, "%s<gml:Polygon>\n", tab);
 
-          msIO_fprintf(stream, "%s  <gml:outerBoundaryIs>\n", tab);
-          msIO_fprintf(stream, "%s    <gml:LinearRing>\n", tab);
+          msIO_writerPrintf(writer, "%s  <gml:outerBoundaryIs>\n", tab);
+          msIO_writerPrintf(writer, "%s    <gml:LinearRing>\n", tab);
 
-          msIO_fprintf(stream, "%s      <gml:coordinates>", tab);
+          msIO_writerPrintf(writer, "%s      <gml:coordinates>", tab);
           for(j=0; j<shape->line[i].numpoints; j++)
           {
-#ifdef USE_POINT_Z_M
-            if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%f,%f,%f ", shape->line[i].point[j].x, shape->line[i].point[j].y,
-                           shape->line[i].point[j].z);
-            else
-                /* fall-through */
-#endif
-            msIO_fprintf(stream, "%f,%f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+            gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ',', ' ');
           }
-          msIO_fprintf(stream, "</gml:coordinates>\n");
+          msIO_writerPrintf(writer, "</gml:coordinates>\n");
 
-          msIO_fprintf(stream, "%s    </gml:LinearRing>\n", tab);
-          msIO_fprintf(stream, "%s  </gml:outerBoundaryIs>\n", tab);
+          msIO_writerPrintf(writer, "%s    </gml:LinearRing>\n", tab);
+          msIO_writerPrintf(writer, "%s  </gml:outerBoundaryIs>\n", tab);
 
           for(k=0; k<shape->numlines; k++) { /* now step through all the inner rings */
             if(innerlist[k] == MS_TRUE) {
-              msIO_fprintf(stream, "%s  <gml:innerBoundaryIs>\n", tab);
-              msIO_fprintf(stream, "%s    <gml:LinearRing>\n", tab);
+              msIO_writerPrintf(writer, "%s  <gml:innerBoundaryIs>\n", tab);
+              msIO_writerPrintf(writer, "%s    <gml:LinearRing>\n", tab);
 
-              msIO_fprintf(stream, "%s      <gml:coordinates>", tab);
+              msIO_writerPrintf(writer, "%s      <gml:coordinates>", tab);
               for(j=0; j<shape->line[k].numpoints; j++)
               {
-#ifdef USE_POINT_Z_M
-                if( nSRSDimension == 3 )
-                  msIO_fprintf(stream, "%f,%f,%f ", shape->line[k].point[j].x, shape->line[k].point[j].y,
-                           shape->line[k].point[j].z);
-                else
-                  /* fall-through */
-#endif
-                msIO_fprintf(stream, "%f,%f ", shape->line[k].point[j].x, shape->line[k].point[j].y);
+                gmlWriteCoordinates(writer, &(shape->line[k].point[j]), nSRSDimension, ',', ' ');
               }
-              msIO_fprintf(stream, "</gml:coordinates>\n");
+              msIO_writerPrintf(writer, "</gml:coordinates>\n");
 
-              msIO_fprintf(stream, "%s    </gml:LinearRing>\n", tab);
-              msIO_fprintf(stream, "%s  </gml:innerBoundaryIs>\n", tab);
+              msIO_writerPrintf(writer, "%s    </gml:LinearRing>\n", tab);
+              msIO_writerPrintf(writer, "%s  </gml:innerBoundaryIs>\n", tab);
             }
           }
 
-          msIO_fprintf(stream, "%s</gml:Polygon>\n", tab);
+          msIO_writerPrintf(writer, "%s</gml:Polygon>\n", tab);
           free(innerlist);
 
-          gmlEndGeometryContainer(stream, geometry_simple_name, namespace, tab);
+          gmlEndGeometryContainer(writer, geometry_simple_name, namespace, tab);
         }
         free(outerlist);
         outerlist = NULL;
       } else if(geometry_aggregate_index != -1 || (geometryList->numgeometries == 0)) { /* write a MultiPolygon */
-        gmlStartGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlStartGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
 
         /* MultiPolygon */
         if(srsname_encoded)
-          msIO_fprintf(stream, "%s<gml:MultiPolygon srsName=\"%s\">\n", tab, srsname_encoded);
+          msIO_writerPrintf(writer, "%s<gml:MultiPolygon srsName=\"%s\">\n", tab, srsname_encoded);
         else
-          msIO_fprintf(stream, "%s<gml:MultiPolygon>\n", tab);
+          msIO_writerPrintf(writer, "%s<gml:MultiPolygon>\n", tab);
 
         for(i=0; i<shape->numlines; i++) { /* step through the outer rings */
           if(outerlist[i] == MS_TRUE) {
             innerlist = msGetInnerList(shape, i, outerlist);
 
-            msIO_fprintf(stream, "%s<gml:polygonMember>\n", tab);
-            msIO_fprintf(stream, "%s  <gml:Polygon>\n", tab);
+            msIO_writerPrintf(writer, "%s<gml:polygonMember>\n", tab);
+            msIO_writerPrintf(writer, "%s  <gml:Polygon>\n", tab);
 
-            msIO_fprintf(stream, "%s    <gml:outerBoundaryIs>\n", tab);
-            msIO_fprintf(stream, "%s      <gml:LinearRing>\n", tab);
+            msIO_writerPrintf(writer, "%s    <gml:outerBoundaryIs>\n", tab);
+            msIO_writerPrintf(writer, "%s      <gml:LinearRing>\n", tab);
 
-            msIO_fprintf(stream, "%s        <gml:coordinates>", tab);
+            msIO_writerPrintf(writer, "%s        <gml:coordinates>", tab);
             for(j=0; j<shape->line[i].numpoints; j++)
             {
-#ifdef USE_POINT_Z_M
-              if( nSRSDimension == 3 )
-                msIO_fprintf(stream, "%f,%f,%f ", shape->line[i].point[j].x, shape->line[i].point[j].y,
-                             shape->line[i].point[j].z);
-              else
-                /* fall-through */
-#endif
-              msIO_fprintf(stream, "%f,%f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+              gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ',', ' ');
             }
-            msIO_fprintf(stream, "</gml:coordinates>\n");
+            msIO_writerPrintf(writer, "</gml:coordinates>\n");
 
-            msIO_fprintf(stream, "%s      </gml:LinearRing>\n", tab);
-            msIO_fprintf(stream, "%s    </gml:outerBoundaryIs>\n", tab);
+            msIO_writerPrintf(writer, "%s      </gml:LinearRing>\n", tab);
+            msIO_writerPrintf(writer, "%s    </gml:outerBoundaryIs>\n", tab);
 
             for(k=0; k<shape->numlines; k++) { /* now step through all the inner rings */
               if(innerlist[k] == MS_TRUE) {
-                msIO_fprintf(stream, "%s    <gml:innerBoundaryIs>\n", tab);
-                msIO_fprintf(stream, "%s      <gml:LinearRing>\n", tab);
+                msIO_writerPrintf(writer, "%s    <gml:innerBoundaryIs>\n", tab);
+                msIO_writerPrintf(writer, "%s      <gml:LinearRing>\n", tab);
 
-                msIO_fprintf(stream, "%s        <gml:coordinates>", tab);
+                msIO_writerPrintf(writer, "%s        <gml:coordinates>", tab);
                 for(j=0; j<shape->line[k].numpoints; j++)
                 {
-#ifdef USE_POINT_Z_M
-                  if( nSRSDimension == 3 )
-                    msIO_fprintf(stream, "%f,%f,%f ", shape->line[k].point[j].x, shape->line[k].point[j].y,
-                                shape->line[k].point[j].z);
-                  else
-                    /* fall-through */
-#endif
-                  msIO_fprintf(stream, "%f,%f ", shape->line[k].point[j].x, shape->line[k].point[j].y);
+                  gmlWriteCoordinates(writer, &(shape->line[k].point[j]), nSRSDimension, ',', ' ');
                 }
-                msIO_fprintf(stream, "</gml:coordinates>\n");
+                msIO_writerPrintf(writer, "</gml:coordinates>\n");
 
-                msIO_fprintf(stream, "%s      </gml:LinearRing>\n", tab);
-                msIO_fprintf(stream, "%s    </gml:innerBoundaryIs>\n", tab);
+                msIO_writerPrintf(writer, "%s      </gml:LinearRing>\n", tab);
+                msIO_writerPrintf(writer, "%s    </gml:innerBoundaryIs>\n", tab);
               }
             }
 
-            msIO_fprintf(stream, "%s  </gml:Polygon>\n", tab);
-            msIO_fprintf(stream, "%s</gml:polygonMember>\n", tab);
+            msIO_writerPrintf(writer, "%s  </gml:Polygon>\n", tab);
+            msIO_writerPrintf(writer, "%s</gml:polygonMember>\n", tab);
 
             free(innerlist);
           }
         }
-        msIO_fprintf(stream, "%s</gml:MultiPolygon>\n", tab);
+        msIO_writerPrintf(writer, "%s</gml:MultiPolygon>\n", tab);
 
         free(outerlist);
         outerlist = NULL;
 
-        gmlEndGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlEndGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
       } else {
-        msIO_fprintf(stream, "<!-- Warning: Cannot write geometry- no polygon/multipolygon geometry defined. -->\n");
+        msIO_writerPrintf(writer, "<!-- Warning: Cannot write geometry- no polygon/multipolygon geometry defined. -->\n");
       }
 
       break;
@@ -477,7 +460,7 @@ static char* gmlCreateGeomId(OWSGMLVersion nGMLVersion, const char* pszFID, int*
 }
 
 /* GML 3.1 or GML 3.2 (MapServer limits GML encoding to the level 0 profile) */
-static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList, shapeObj *shape,
+static int gmlWriteGeometry_GML3(msIOWriter *writer, gmlGeometryListObj *geometryList, shapeObj *shape,
                                  const char *srsname, const char *namespace, const char *tab,
                                  const char *pszFID, OWSGMLVersion nGMLVersion,
                                  int nSRSDimension)
@@ -490,7 +473,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
   int geometry_aggregate_index, geometry_simple_index;
   char *geometry_aggregate_name = NULL, *geometry_simple_name = NULL;
 
-  if(!stream) return(MS_FAILURE);
+  if(!writer) return(MS_FAILURE);
   if(!shape) return(MS_FAILURE);
   if(!tab) return(MS_FAILURE);
   if(!geometryList) return(MS_FAILURE);
@@ -514,64 +497,68 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
 
         for(i=0; i<shape->numlines; i++) {
           for(j=0; j<shape->line[i].numpoints; j++) {
-            gmlStartGeometryContainer(stream, geometry_simple_name, namespace, tab);
+            gmlStartGeometryContainer(writer, geometry_simple_name, namespace, tab);
 
             /* Point */
             pszGMLId = gmlCreateGeomId(nGMLVersion, pszFID, &id);
             if(srsname_encoded)
-              msIO_fprintf(stream, "%s  <gml:Point%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
+              msIO_writerPrintf(writer, "%s  <gml:Point%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
             else
-              msIO_fprintf(stream, "%s  <gml:Point%s>\n", tab, pszGMLId);
+              msIO_writerPrintf(writer, "%s  <gml:Point%s>\n", tab, pszGMLId);
 
 #ifdef USE_POINT_Z_M
             if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%s    <gml:pos srsDimension=\"3\">%f %f %f</gml:pos>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y, shape->line[i].point[j].z);
+              msIO_writerPrintf(writer, "%s    <gml:pos srsDimension=\"3\">", tab);
             else
-                /* fall-through */
+              /* fall-through */
 #endif
-            msIO_fprintf(stream, "%s    <gml:pos>%f %f</gml:pos>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y);
+            msIO_writerPrintf(writer, "%s    <gml:pos>", tab);
+            gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ' ', 0);
+            msIO_writerPuts(writer, "</gml:pos>\n");
 
-            msIO_fprintf(stream, "%s  </gml:Point>\n", tab);
+            msIO_writerPrintf(writer, "%s  </gml:Point>\n", tab);
 
-            gmlEndGeometryContainer(stream, geometry_simple_name, namespace, tab);
+            gmlEndGeometryContainer(writer, geometry_simple_name, namespace, tab);
             msFree(pszGMLId);
           }
         }
       } else if((geometry_aggregate_index != -1) || (geometryList->numgeometries == 0)) { /* write a MultiPoint */
         pszGMLId = gmlCreateGeomId(nGMLVersion, pszFID, &id);
-        gmlStartGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlStartGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
 
         /* MultiPoint */
         if(srsname_encoded)
-          msIO_fprintf(stream, "%s  <gml:MultiPoint%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
+          msIO_writerPrintf(writer, "%s  <gml:MultiPoint%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
         else
-          msIO_fprintf(stream, "%s  <gml:MultiPoint%s>\n", tab, pszGMLId);
+          msIO_writerPrintf(writer, "%s  <gml:MultiPoint%s>\n", tab, pszGMLId);
 
         msFree(pszGMLId);
 
         for(i=0; i<shape->numlines; i++) {
           for(j=0; j<shape->line[i].numpoints; j++) {
-            msIO_fprintf(stream, "%s    <gml:pointMember>\n", tab);
+            msIO_writerPrintf(writer, "%s    <gml:pointMember>\n", tab);
             pszGMLId = gmlCreateGeomId(nGMLVersion, pszFID, &id);
-            msIO_fprintf(stream, "%s      <gml:Point%s>\n", tab, pszGMLId);
+            msIO_writerPrintf(writer, "%s      <gml:Point%s>\n", tab, pszGMLId);
 #ifdef USE_POINT_Z_M
             if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%s        <gml:pos srsDimension=\"3\">%f %f %f</gml:pos>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y, shape->line[i].point[j].z);
+              msIO_writerPrintf(writer, "%s        <gml:pos srsDimension=\"3\">", tab);
             else
-                /* fall-through */
+              /* fall-through */
 #endif
-            msIO_fprintf(stream, "%s        <gml:pos>%f %f</gml:pos>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y);
-            msIO_fprintf(stream, "%s      </gml:Point>\n", tab);
+            msIO_writerPrintf(writer, "%s        <gml:pos>", tab);
+            gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ' ', 0);
+            msIO_writerPuts(writer, "</gml:pos>\n");
+            msIO_writerPrintf(writer, "%s      </gml:Point>\n", tab);
             msFree(pszGMLId);
-            msIO_fprintf(stream, "%s    </gml:pointMember>\n", tab);
+            msIO_writerPrintf(writer, "%s    </gml:pointMember>\n", tab);
           }
         }
 
-        msIO_fprintf(stream, "%s  </gml:MultiPoint>\n", tab);
+        msIO_writerPrintf(writer, "%s  </gml:MultiPoint>\n", tab);
 
-        gmlEndGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlEndGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
       } else {
-        msIO_fprintf(stream, "<!-- Warning: Cannot write geometry- no point/multipoint geometry defined. -->\n");
+        msIO_writerPrintf(writer, "<!-- Warning: Cannot write geometry- no point/multipoint geometry defined. -->\n");
       }
 
       break;
@@ -585,72 +572,60 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
           (geometry_simple_index != -1 && geometry_aggregate_index == -1) ||
           (geometryList->numgeometries == 0 && shape->numlines == 1)) { /* write a LineStrings(s) */
         for(i=0; i<shape->numlines; i++) {
-          gmlStartGeometryContainer(stream, geometry_simple_name, namespace, tab);
+          gmlStartGeometryContainer(writer, geometry_simple_name, namespace, tab);
 
           /* LineString (should be Curve?) */
           pszGMLId = gmlCreateGeomId(nGMLVersion, pszFID, &id);
           if(srsname_encoded)
-            msIO_fprintf(stream, "%s  <gml:LineString%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
+            msIO_writerPrintf(writer, "%s  <gml:LineString%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
           else
-            msIO_fprintf(stream, "%s  <gml:LineString%s>\n", tab, pszGMLId);
+            msIO_writerPrintf(writer, "%s  <gml:LineString%s>\n", tab, pszGMLId);
           msFree(pszGMLId);
 
-          msIO_fprintf(stream, "%s    <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
+          msIO_writerPrintf(writer, "%s    <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
           for(j=0; j<shape->line[i].numpoints; j++)
           {
-#ifdef USE_POINT_Z_M
-            if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%f %f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y, shape->line[i].point[j].z);
-            else
-                /* fall-through */
-#endif
-              msIO_fprintf(stream, "%f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+            gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ' ', ' ');
           }
-          msIO_fprintf(stream, "</gml:posList>\n");
+          msIO_writerPrintf(writer, "</gml:posList>\n");
 
-          msIO_fprintf(stream, "%s  </gml:LineString>\n", tab);
+          msIO_writerPrintf(writer, "%s  </gml:LineString>\n", tab);
 
-          gmlEndGeometryContainer(stream, geometry_simple_name, namespace, tab);
+          gmlEndGeometryContainer(writer, geometry_simple_name, namespace, tab);
         }
       } else if(geometry_aggregate_index != -1 || (geometryList->numgeometries == 0)) { /* write a MultiCurve */
-        gmlStartGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlStartGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
 
         /* MultiCurve */
         pszGMLId = gmlCreateGeomId(nGMLVersion, pszFID, &id);
         if(srsname_encoded)
-          msIO_fprintf(stream, "%s  <gml:MultiCurve%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
+          msIO_writerPrintf(writer, "%s  <gml:MultiCurve%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
         else
-          msIO_fprintf(stream, "%s  <gml:MultiCurve%s>\n", tab, pszGMLId);
+          msIO_writerPrintf(writer, "%s  <gml:MultiCurve%s>\n", tab, pszGMLId);
         msFree(pszGMLId);
 
         for(i=0; i<shape->numlines; i++) {
-          msIO_fprintf(stream, "%s    <gml:curveMember>\n", tab);
+          msIO_writerPrintf(writer, "%s    <gml:curveMember>\n", tab);
           pszGMLId = gmlCreateGeomId(nGMLVersion, pszFID, &id);
-          msIO_fprintf(stream, "%s      <gml:LineString%s>\n", tab, pszGMLId); /* no srsname at this point */
+          msIO_writerPrintf(writer, "%s      <gml:LineString%s>\n", tab, pszGMLId); /* no srsname at this point */
           msFree(pszGMLId);
 
-          msIO_fprintf(stream, "%s        <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
+          msIO_writerPrintf(writer, "%s        <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
           for(j=0; j<shape->line[i].numpoints; j++)
           {
-#ifdef USE_POINT_Z_M
-            if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%f %f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y, shape->line[i].point[j].z);
-            else
-                /* fall-through */
-#endif
-              msIO_fprintf(stream, "%f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+            gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ' ', ' ');
           }
 
-          msIO_fprintf(stream, "</gml:posList>\n");
-          msIO_fprintf(stream, "%s      </gml:LineString>\n", tab);
-          msIO_fprintf(stream, "%s    </gml:curveMember>\n", tab);
+          msIO_writerPrintf(writer, "</gml:posList>\n");
+          msIO_writerPrintf(writer, "%s      </gml:LineString>\n", tab);
+          msIO_writerPrintf(writer, "%s    </gml:curveMember>\n", tab);
         }
 
-        msIO_fprintf(stream, "%s  </gml:MultiCurve>\n", tab);
+        msIO_writerPrintf(writer, "%s  </gml:MultiCurve>\n", tab);
 
-        gmlEndGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlEndGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
       } else {
-        msIO_fprintf(stream, "<!-- Warning: Cannot write geometry- no line/multiline geometry defined. -->\n");
+        msIO_writerPrintf(writer, "<!-- Warning: Cannot write geometry- no line/multiline geometry defined. -->\n");
       }
 
       break;
@@ -676,149 +651,125 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
           /* get a list of inner rings for this polygon */
           innerlist = msGetInnerList(shape, i, outerlist);
 
-          gmlStartGeometryContainer(stream, geometry_simple_name, namespace, tab);
+          gmlStartGeometryContainer(writer, geometry_simple_name, namespace, tab);
 
           pszGMLId = gmlCreateGeomId(nGMLVersion, pszFID, &id);
 
           /* Polygon (should be Surface?) */
           if(srsname_encoded)
-            msIO_fprintf(stream, "%s  <gml:Polygon%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
+            msIO_writerPrintf(writer, "%s  <gml:Polygon%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
           else
-            msIO_fprintf(stream, "%s  <gml:Polygon%s>\n", tab, pszGMLId);
+            msIO_writerPrintf(writer, "%s  <gml:Polygon%s>\n", tab, pszGMLId);
           msFree(pszGMLId);
 
-          msIO_fprintf(stream, "%s    <gml:exterior>\n", tab);
-          msIO_fprintf(stream, "%s      <gml:LinearRing>\n", tab);
+          msIO_writerPrintf(writer, "%s    <gml:exterior>\n", tab);
+          msIO_writerPrintf(writer, "%s      <gml:LinearRing>\n", tab);
 
-          msIO_fprintf(stream, "%s        <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
+          msIO_writerPrintf(writer, "%s        <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
           for(j=0; j<shape->line[i].numpoints; j++)
           {
-#ifdef USE_POINT_Z_M
-            if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%f %f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y, shape->line[i].point[j].z);
-            else
-                /* fall-through */
-#endif
-              msIO_fprintf(stream, "%f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+            gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ' ', ' ');
           }
 
-          msIO_fprintf(stream, "</gml:posList>\n");
+          msIO_writerPrintf(writer, "</gml:posList>\n");
 
-          msIO_fprintf(stream, "%s      </gml:LinearRing>\n", tab);
-          msIO_fprintf(stream, "%s    </gml:exterior>\n", tab);
+          msIO_writerPrintf(writer, "%s      </gml:LinearRing>\n", tab);
+          msIO_writerPrintf(writer, "%s    </gml:exterior>\n", tab);
 
           for(k=0; k<shape->numlines; k++) { /* now step through all the inner rings */
             if(innerlist[k] == MS_TRUE) {
-              msIO_fprintf(stream, "%s    <gml:interior>\n", tab);
-              msIO_fprintf(stream, "%s      <gml:LinearRing>\n", tab);
+              msIO_writerPrintf(writer, "%s    <gml:interior>\n", tab);
+              msIO_writerPrintf(writer, "%s      <gml:LinearRing>\n", tab);
 
-              msIO_fprintf(stream, "%s        <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
+              msIO_writerPrintf(writer, "%s        <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
               for(j=0; j<shape->line[k].numpoints; j++)
               {
-#ifdef USE_POINT_Z_M
-                if( nSRSDimension == 3 )
-                    msIO_fprintf(stream, "%f %f %f ", shape->line[k].point[j].x, shape->line[k].point[j].y, shape->line[k].point[j].z);
-                else
-                        /* fall-through */
-#endif
-                msIO_fprintf(stream, "%f %f ", shape->line[k].point[j].x, shape->line[k].point[j].y);
+                gmlWriteCoordinates(writer, &(shape->line[k].point[j]), nSRSDimension, ' ', ' ');
               }
 
-              msIO_fprintf(stream, "</gml:posList>\n");
+              msIO_writerPrintf(writer, "</gml:posList>\n");
 
-              msIO_fprintf(stream, "%s      </gml:LinearRing>\n", tab);
-              msIO_fprintf(stream, "%s    </gml:interior>\n", tab);
+              msIO_writerPrintf(writer, "%s      </gml:LinearRing>\n", tab);
+              msIO_writerPrintf(writer, "%s    </gml:interior>\n", tab);
             }
           }
 
-          msIO_fprintf(stream, "%s  </gml:Polygon>\n", tab);
+          msIO_writerPrintf(writer, "%s  </gml:Polygon>\n", tab);
           free(innerlist);
 
-          gmlEndGeometryContainer(stream, geometry_simple_name, namespace, tab);
+          gmlEndGeometryContainer(writer, geometry_simple_name, namespace, tab);
         }
         free(outerlist);
         outerlist = NULL;
       } else if(geometry_aggregate_index != -1 || (geometryList->numgeometries == 0)) { /* write a MultiSurface */
-        gmlStartGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlStartGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
 
         pszGMLId = gmlCreateGeomId(nGMLVersion, pszFID, &id);
 
         /* MultiSurface */
         if(srsname_encoded)
-          msIO_fprintf(stream, "%s  <gml:MultiSurface%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
+          msIO_writerPrintf(writer, "%s  <gml:MultiSurface%s srsName=\"%s\">\n", tab, pszGMLId, srsname_encoded);
         else
-          msIO_fprintf(stream, "%s  <gml:MultiSurface%s>\n", tab, pszGMLId);
+          msIO_writerPrintf(writer, "%s  <gml:MultiSurface%s>\n", tab, pszGMLId);
         msFree(pszGMLId);
 
         for(i=0; i<shape->numlines; i++) { /* step through the outer rings */
           if(outerlist[i] == MS_TRUE) {
-            msIO_fprintf(stream, "%s    <gml:surfaceMember>\n", tab);
+            msIO_writerPrintf(writer, "%s    <gml:surfaceMember>\n", tab);
 
             /* get a list of inner rings for this polygon */
             innerlist = msGetInnerList(shape, i, outerlist);
 
             pszGMLId = gmlCreateGeomId(nGMLVersion, pszFID, &id);
 
-            msIO_fprintf(stream, "%s      <gml:Polygon%s>\n", tab, pszGMLId);
+            msIO_writerPrintf(writer, "%s      <gml:Polygon%s>\n", tab, pszGMLId);
             msFree(pszGMLId);
 
-            msIO_fprintf(stream, "%s        <gml:exterior>\n", tab);
-            msIO_fprintf(stream, "%s          <gml:LinearRing>\n", tab);
+            msIO_writerPrintf(writer, "%s        <gml:exterior>\n", tab);
+            msIO_writerPrintf(writer, "%s          <gml:LinearRing>\n", tab);
 
-            msIO_fprintf(stream, "%s            <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
+            msIO_writerPrintf(writer, "%s            <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
             for(j=0; j<shape->line[i].numpoints; j++)
             {
-#ifdef USE_POINT_Z_M
-            if( nSRSDimension == 3 )
-              msIO_fprintf(stream, "%f %f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y, shape->line[i].point[j].z);
-            else
-                /* fall-through */
-#endif
-              msIO_fprintf(stream, "%f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+              gmlWriteCoordinates(writer, &(shape->line[i].point[j]), nSRSDimension, ' ', ' ');
             }
 
-            msIO_fprintf(stream, "</gml:posList>\n");
+            msIO_writerPrintf(writer, "</gml:posList>\n");
 
-            msIO_fprintf(stream, "%s          </gml:LinearRing>\n", tab);
-            msIO_fprintf(stream, "%s        </gml:exterior>\n", tab);
+            msIO_writerPrintf(writer, "%s          </gml:LinearRing>\n", tab);
+            msIO_writerPrintf(writer, "%s        </gml:exterior>\n", tab);
 
             for(k=0; k<shape->numlines; k++) { /* now step through all the inner rings */
               if(innerlist[k] == MS_TRUE) {
-                msIO_fprintf(stream, "%s        <gml:interior>\n", tab);
-                msIO_fprintf(stream, "%s          <gml:LinearRing>\n", tab);
+                msIO_writerPrintf(writer, "%s        <gml:interior>\n", tab);
+                msIO_writerPrintf(writer, "%s          <gml:LinearRing>\n", tab);
 
-                msIO_fprintf(stream, "%s            <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
+                msIO_writerPrintf(writer, "%s            <gml:posList srsDimension=\"%d\">", tab, nSRSDimension);
                 for(j=0; j<shape->line[k].numpoints; j++)
                 {
-#ifdef USE_POINT_Z_M
-                  if( nSRSDimension == 3 )
-                    msIO_fprintf(stream, "%f %f %f ", shape->line[k].point[j].x, shape->line[k].point[j].y, shape->line[k].point[j].z);
-                  else
-                        /* fall-through */
-#endif
-                  msIO_fprintf(stream, "%f %f ", shape->line[k].point[j].x, shape->line[k].point[j].y);
+                  gmlWriteCoordinates(writer, &(shape->line[k].point[j]), nSRSDimension, ' ', ' ');
                 }
-                msIO_fprintf(stream, "</gml:posList>\n");
+                msIO_writerPrintf(writer, "</gml:posList>\n");
 
-                msIO_fprintf(stream, "%s          </gml:LinearRing>\n", tab);
-                msIO_fprintf(stream, "%s        </gml:interior>\n", tab);
+                msIO_writerPrintf(writer, "%s          </gml:LinearRing>\n", tab);
+                msIO_writerPrintf(writer, "%s        </gml:interior>\n", tab);
               }
             }
 
-            msIO_fprintf(stream, "%s      </gml:Polygon>\n", tab);
+            msIO_writerPrintf(writer, "%s      </gml:Polygon>\n", tab);
 
             free(innerlist);
-            msIO_fprintf(stream, "%s    </gml:surfaceMember>\n", tab);
+            msIO_writerPrintf(writer, "%s    </gml:surfaceMember>\n", tab);
           }
         }
-        msIO_fprintf(stream, "%s  </gml:MultiSurface>\n", tab);
+        msIO_writerPrintf(writer, "%s  </gml:MultiSurface>\n", tab);
 
         free(outerlist);
         outerlist = NULL;
 
-        gmlEndGeometryContainer(stream, geometry_aggregate_name, namespace, tab);
+        gmlEndGeometryContainer(writer, geometry_aggregate_name, namespace, tab);
       } else {
-        msIO_fprintf(stream, "<!-- Warning: Cannot write geometry- no polygon/multipolygon geometry defined. -->\n");
+        msIO_writerPrintf(writer, "<!-- Warning: Cannot write geometry- no polygon/multipolygon geometry defined. -->\n");
       }
 
       break;
@@ -836,17 +787,17 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
 /*
 ** Wrappers for the format specific encoding functions.
 */
-static int gmlWriteBounds(FILE *stream, OWSGMLVersion format, rectObj *rect,
+static int gmlWriteBounds(msIOWriter *writer, OWSGMLVersion format, rectObj *rect,
                           const char *srsname, const char *tab,
                           const char *pszTopPrefix)
 {
   switch(format) {
     case(OWS_GML2):
-      return gmlWriteBounds_GML2(stream, rect, srsname, tab, pszTopPrefix);
+      return gmlWriteBounds_GML2(writer, rect, srsname, tab, pszTopPrefix);
       break;
     case(OWS_GML3):
     case(OWS_GML32):
-      return gmlWriteBounds_GML3(stream, rect, srsname, tab, pszTopPrefix);
+      return gmlWriteBounds_GML3(writer, rect, srsname, tab, pszTopPrefix);
       break;
     default:
       msSetError(MS_IOERR, "Unsupported GML format.", "gmlWriteBounds()");
@@ -855,18 +806,18 @@ static int gmlWriteBounds(FILE *stream, OWSGMLVersion format, rectObj *rect,
   return(MS_FAILURE);
 }
 
-static int gmlWriteGeometry(FILE *stream, gmlGeometryListObj *geometryList,
+static int gmlWriteGeometry(msIOWriter *writer, gmlGeometryListObj *geometryList,
                             OWSGMLVersion format, shapeObj *shape,
                             const char *srsname, const char *namespace,
                             const char *tab, const char* pszFID, int nSRSDimension)
 {
   switch(format) {
     case(OWS_GML2):
-      return gmlWriteGeometry_GML2(stream, geometryList, shape, srsname, namespace, tab, nSRSDimension);
+      return gmlWriteGeometry_GML2(writer, geometryList, shape, srsname, namespace, tab, nSRSDimension);
       break;
     case(OWS_GML3):
     case(OWS_GML32):
-      return gmlWriteGeometry_GML3(stream, geometryList, shape, srsname, namespace, tab, pszFID, format, nSRSDimension);
+      return gmlWriteGeometry_GML3(writer, geometryList, shape, srsname, namespace, tab, pszFID, format, nSRSDimension);
       break;
     default:
       msSetError(MS_IOERR, "Unsupported GML format.", "gmlWriteGeometry()");
@@ -1002,7 +953,7 @@ void msGMLFreeGeometries(gmlGeometryListObj *geometryList)
   free(geometryList);
 }
 
-static void msGMLWriteItem(FILE *stream, gmlItemObj *item,
+static void msGMLWriteItem(msIOWriter *writer, gmlItemObj *item,
                            const char *value, const char *namespace,
                            const char *tab,
                            OWSGMLVersion outputformat,
@@ -1013,7 +964,7 @@ static void msGMLWriteItem(FILE *stream, gmlItemObj *item,
   char gmlid[256];
   gmlid[0] = 0;
 
-  if(!stream || !item) return;
+  if(!writer || !item) return;
   if(!item->visible) return;
 
   if(!namespace) add_namespace = MS_FALSE;
@@ -1058,30 +1009,43 @@ static void msGMLWriteItem(FILE *stream, gmlItemObj *item,
       }
   }
 
-  if( encoded_value == NULL )
-  {
-    if(item->encode == MS_TRUE)
-      encoded_value = msEncodeHTMLEntities(value);
-    else
-      encoded_value = msStrdup(value);
-  }
-
   if(!item->template) { /* build the tag from pieces */
 
     if(add_namespace == MS_TRUE && msIsXMLTagValid(tag_name) == MS_FALSE)
-      msIO_fprintf(stream, "<!-- WARNING: The value '%s' is not valid in a XML tag context. -->\n", tag_name);
+      msIO_writerPrintf(writer, "<!-- WARNING: The value '%s' is not valid in a XML tag context. -->\n", tag_name);
 
     if(add_namespace == MS_TRUE)
-      msIO_fprintf(stream, "%s<%s:%s%s>%s</%s:%s>\n", tab, namespace, tag_name, gmlid, encoded_value, namespace, tag_name);
+      msIO_writerPrintf(writer, "%s<%s:%s%s>", tab, namespace, tag_name, gmlid);
     else
-      msIO_fprintf(stream, "%s<%s%s>%s</%s>\n", tab, tag_name, gmlid, encoded_value, tag_name);
+      msIO_writerPrintf(writer, "%s<%s%s>", tab, tag_name, gmlid);
+
+    /* the value is encoded straight into the output */
+    if(encoded_value)
+      msIO_writerPuts(writer, encoded_value);
+    else if(value && item->encode == MS_TRUE)
+      msIO_writerPutsEncoded(writer, value);
+    else if(value)
+      msIO_writerPuts(writer, value);
+
+    if(add_namespace == MS_TRUE)
+      msIO_writerPrintf(writer, "</%s:%s>\n", namespace, tag_name);
+    else
+      msIO_writerPrintf(writer, "</%s>\n", tag_name);
   } else {
     char *tag = NULL;
 
+    if( encoded_value == NULL )
+    {
+      if(item->encode == MS_TRUE)
+        encoded_value = msEncodeHTMLEntities(value);
+      else
+        encoded_value = msStrdup(value);
+    }
+
     tag = msStrdup(item->template);
     tag = msReplaceSubstring(tag, "$value", encoded_value);
     if(namespace) tag = msReplaceSubstring(tag, "$namespace", namespace);
-    msIO_fprintf(stream, "%s%s\n", tab, tag);
+    msIO_writerPrintf(writer, "%s%s\n", tab, tag);
     free(tag);
   }
 
@@ -1229,23 +1193,23 @@ void msGMLFreeConstants(gmlConstantListObj *constantList)
   free(constantList);
 }
 
-static void msGMLWriteConstant(FILE *stream, gmlConstantObj *constant, const char *namespace, const char *tab)
+static void msGMLWriteConstant(msIOWriter *writer, gmlConstantObj *constant, const char *namespace, const char *tab)
 {
   int add_namespace = MS_TRUE;
 
-  if(!stream || !constant) return;
+  if(!writer || !constant) return;
   if(!constant->value) return;
 
   if(!namespace) add_namespace = MS_FALSE;
   if(strchr(constant->name, ':') != NULL) add_namespace = MS_FALSE;
 
   if(add_namespace == MS_TRUE && msIsXMLTagValid(constant->name) == MS_FALSE)
-    msIO_fprintf(stream, "<!-- WARNING: The value '%s' is not valid in a XML tag context. -->\n", constant->name);
+    msIO_writerPrintf(writer, "<!-- WARNING: The value '%s' is not valid in a XML tag context. -->\n", constant->name);
 
   if(add_namespace == MS_TRUE)
-    msIO_fprintf(stream, "%s<%s:%s>%s</%s:%s>\n", tab, namespace, constant->name, constant->value, namespace, constant->name);
+    msIO_writerPrintf(writer, "%s<%s:%s>%s</%s:%s>\n", tab, namespace, constant->name, constant->value, namespace, constant->name);
   else
-    msIO_fprintf(stream, "%s<%s>%s</%s>\n", tab, constant->name, constant->value, constant->name);
+    msIO_writerPrintf(writer, "%s<%s>%s</%s>\n", tab, constant->name, constant->value, constant->name);
 
   return;
 }
@@ -1322,7 +1286,7 @@ void msGMLFreeGroups(gmlGroupListObj *groupList)
   free(groupList);
 }
 
-static void msGMLWriteGroup(FILE *stream,
+static void msGMLWriteGroup(msIOWriter *writer,
                             gmlGroupObj *group, shapeObj *shape,
                             gmlItemListObj *itemList,
                             gmlConstantListObj *constantList,
@@ -1337,7 +1301,7 @@ static void msGMLWriteGroup(FILE *stream,
   gmlItemObj *item=NULL;
   gmlConstantObj *constant=NULL;
 
-  if(!stream || !group) return;
+  if(!writer || !group) return;
 
   /* setup the item/constant tab */
   itemtab = (char *) msSmallMalloc(sizeof(char)*strlen(tab)+3);
@@ -1348,16 +1312,16 @@ static void msGMLWriteGroup(FILE *stream,
 
   /* start the group */
   if(add_namespace == MS_TRUE)
-    msIO_fprintf(stream, "%s<%s:%s>\n", tab, namespace, group->name);
+    msIO_writerPrintf(writer, "%s<%s:%s>\n", tab, namespace, group->name);
   else
-    msIO_fprintf(stream, "%s<%s>\n", tab, group->name);
+    msIO_writerPrintf(writer, "%s<%s>\n", tab, group->name);
 
   /* now the items/constants in the group */
   for(i=0; i<group->numitems; i++) {
     for(j=0; j<constantList->numconstants; j++) {
       constant = &(constantList->constants[j]);
       if(strcasecmp(constant->name, group->items[i]) == 0) {
-        msGMLWriteConstant(stream, constant, namespace, itemtab);
+        msGMLWriteConstant(writer, constant, namespace, itemtab);
         break;
       }
     }
@@ -1366,7 +1330,7 @@ static void msGMLWriteGroup(FILE *stream,
       item = &(itemList->items[j]);
       if(strcasecmp(item->name, group->items[i]) == 0) {
         /* the number of items matches the number of values exactly */
-        msGMLWriteItem(stream, item, shape->values[j], namespace, itemtab, outputformat, pszFID);
+        msGMLWriteItem(writer, item, shape->values[j], namespace, itemtab, outputformat, pszFID);
         break;
       }
     }
@@ -1374,9 +1338,9 @@ static void msGMLWriteGroup(FILE *stream,
 
   /* end the group */
   if(add_namespace == MS_TRUE)
-    msIO_fprintf(stream, "%s</%s:%s>\n", tab, namespace, group->name);
+    msIO_writerPrintf(writer, "%s</%s:%s>\n", tab, namespace, group->name);
   else
-    msIO_fprintf(stream, "%s</%s>\n", tab, group->name);
+    msIO_writerPrintf(writer, "%s</%s>\n", tab, group->name);
 
   msFree(itemtab);
 
@@ -1393,6 +1357,7 @@ int msGMLWriteQuery(mapObj *map, char *filename, const char *namespaces)
   layerObj *lp=NULL;
   shapeObj shape;
   FILE *stream=stdout; /* defaults to stdout */
+  msIOWriter writer;
   char szPath[MS_MAXPATHLEN];
   char *value;
   char *pszMapSRS = NULL;
@@ -1413,6 +1378,7 @@ int msGMLWriteQuery(mapObj *map, char *filename, const char *namespaces)
       return(MS_FAILURE);
     }
   }
+  msIO_writerInit(&writer, stream);
 
   msIO_fprintf(stream, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\n");
   msOWSPrintValidateMetadata(stream, &(map->web.metadata), namespaces, "rootname", OWS_NOERR, "<%s ", "msGMLOutput");
@@ -1524,28 +1490,29 @@ int msGMLWriteQuery(mapObj *map, char *filename, const char *namespaces)
         /* Write the feature geometry and bounding box unless 'none' was requested. */
         /* Default to bbox only if nothing specified and output full geometry only if explicitly requested */
         if(!(geometryList && geometryList->numgeometries == 1 && strcasecmp(geometryList->geometries[0].name, "none") == 0)) {
-          gmlWriteBounds(stream, OWS_GML2, &(shape.bounds), pszOutputSRS, "\t\t\t", "gml");
+          gmlWriteBounds(&writer, OWS_GML2, &(shape.bounds), pszOutputSRS, "\t\t\t", "gml");
           if (geometryList && geometryList->numgeometries > 0 )
-            gmlWriteGeometry(stream, geometryList, OWS_GML2, &(shape), pszOutputSRS, NULL, "\t\t\t", "", nSRSDimension);
+            gmlWriteGeometry(&writer, geometryList, OWS_GML2, &(shape), pszOutputSRS, NULL, "\t\t\t", "", nSRSDimension);
         }
 
         /* write any item/values */
         for(k=0; k<itemList->numitems; k++) {
           item = &(itemList->items[k]);
           if(msItemInGroups(item->name, groupList) == MS_FALSE)
-            msGMLWriteItem(stream, item, shape.values[k], NULL, "\t\t\t", OWS_GML2, NULL);
+            msGMLWriteItem(&writer, item, shape.values[k], NULL, "\t\t\t", OWS_GML2, NULL);
         }
 
         /* write any constants */
         for(k=0; k<constantList->numconstants; k++) {
           constant = &(constantList->constants[k]);
           if(msItemInGroups(constant->name, groupList) == MS_FALSE)
-            msGMLWriteConstant(stream, constant, NULL, "\t\t\t");
+            msGMLWriteConstant(&writer, constant, NULL, "\t\t\t");
         }
 
         /* write any groups */
         for(k=0; k<groupList->numgroups; k++)
-          msGMLWriteGroup(stream, &(groupList->groups[k]), &shape, itemList, constantList, NULL, "\t\t\t", OWS_GML2, NULL);
+          msGMLWriteGroup(&writer, &(groupList->groups[k]), &shape, itemList, constantList, NULL, "\t\t\t", OWS_GML2, NULL);
+        msIO_writerFlush(&writer);
 
         /* end this feature */
         /* specify a feature name if nothing provided */
@@ -1605,6 +1572,7 @@ void msGMLWriteWFSBounds(mapObj *map, FILE *stream, const char *tab,
   /* Need to start with BBOX of the whole resultset */
   if (msGetQueryResultBounds(map, &resultBounds) > 0) {
     char* srs = NULL;
+    msIOWriter writer;
     if (bSwapAxis) {
       double tmp;
 
@@ -1630,14 +1598,234 @@ void msGMLWriteWFSBounds(mapObj *map, FILE *stream, const char *tab,
             msOWSGetEPSGProj(&(map->projection), &(map->web.metadata), "FGO", MS_TRUE, &srs);
     }
 
-    gmlWriteBounds(stream, outputformat, &resultBounds, srs, tab,
+    msIO_writerInit(&writer, stream);
+    gmlWriteBounds(&writer, outputformat, &resultBounds, srs, tab,
                    (nWFSVersion == OWS_2_0_0) ? "wfs" : "gml");
+    msIO_writerFlush(&writer);
     msFree(srs);
   }
 }
 
 #endif
 
+#ifdef USE_WFS_SVR
+
+/*
+** What msGMLWriteWFSQuery() needs to know about a layer to write its features.
+*/
+typedef struct {
+  layerObj *lp;
+  char *layerName;
+  const char *namespace_prefix;
+  int featureIdIndex; /* -1 when there is no feature id */
+  char *srs;
+  int bOutputGMLIdOnly;
+  int nSRSDimension;
+
+  gmlGroupListObj *groupList;
+  gmlItemListObj *itemList;
+  gmlConstantListObj *constantList;
+  gmlGeometryListObj *geometryList;
+} gmlWFSLayerObj;
+
+static void gmlFreeWFSLayer(gmlWFSLayerObj *layer)
+{
+  msFree(layer->srs);
+  msFree(layer->layerName);
+
+  if(layer->groupList) msGMLFreeGroups(layer->groupList);
+  if(layer->constantList) msGMLFreeConstants(layer->constantList);
+  if(layer->itemList) msGMLFreeItems(layer->itemList);
+  if(layer->geometryList) msGMLFreeGeometries(layer->geometryList);
+
+  memset(layer, 0, sizeof(gmlWFSLayerObj));
+}
+
+/*
+** Sets up the namespace, feature id, srs and item/group metadata of a layer,
+** writing any configuration warning along the way.
+*/
+static int gmlInitWFSLayer(gmlWFSLayerObj *layer, msIOWriter *writer, mapObj *map, layerObj *lp,
+                           const char *default_namespace_prefix, OWSGMLVersion outputformat,
+                           int bUseURN, int bGetPropertyValueRequest)
+{
+  const char *value;
+  const char *geomtype;
+  int j;
+
+  memset(layer, 0, sizeof(gmlWFSLayerObj));
+  layer->lp = lp;
+  layer->featureIdIndex = -1;
+  layer->nSRSDimension = 2;
+
+  /* setup namespace, a layer can override the default */
+  layer->namespace_prefix = msOWSLookupMetadata(&(lp->metadata), "OFG", "namespace_prefix");
+  if(!layer->namespace_prefix) layer->namespace_prefix = default_namespace_prefix;
+
+  geomtype = msOWSLookupMetadata(&(lp->metadata), "OFG", "geomtype");
+  if( geomtype != NULL && (strstr(geomtype, "25d") != NULL || strstr(geomtype, "25D") != NULL) )
+  {
+#ifdef USE_POINT_Z_M
+      layer->nSRSDimension = 3;
+#else
+      msIO_writerPrintf(writer, "<!-- WARNING: 25d requested forn typename '%s' but MapServer compiled without USE_POINT_Z_M support. -->\n", lp->name);
+#endif
+  }
+
+  value = msOWSLookupMetadata(&(lp->metadata), "OFG", "featureid");
+  if(value) { /* find the featureid amongst the items for this layer */
+    for(j=0; j<lp->numitems; j++) {
+      if(strcasecmp(lp->items[j], value) == 0) { /* found it */
+        layer->featureIdIndex = j;
+        break;
+      }
+    }
+
+    /* Produce a warning if a featureid was set but the corresponding item is not found. */
+    if (layer->featureIdIndex == -1)
+      msIO_writerPrintf(writer, "<!-- WARNING: FeatureId item '%s' not found in typename '%s'. -->\n", value, lp->name);
+  }
+  else if( outputformat == OWS_GML32 )
+      msIO_writerPrintf(writer, "<!-- WARNING: No featureid defined for typename '%s'. Output will not validate. -->\n", lp->name);
+
+  /* populate item and group metadata structures */
+  layer->itemList = msGMLGetItems(lp, "G");
+  layer->constantList = msGMLGetConstants(lp, "G");
+  layer->groupList = msGMLGetGroups(lp, "G");
+  layer->geometryList = msGMLGetGeometries(lp, "GFO", MS_FALSE);
+  if (layer->itemList == NULL || layer->constantList == NULL || layer->groupList == NULL || layer->geometryList == NULL) {
+    msSetError(MS_MISCERR, "Unable to populate item and group metadata structures", "msGMLWriteWFSQuery()");
+    gmlFreeWFSLayer(layer);
+    return MS_FAILURE;
+  }
+
+  if( bGetPropertyValueRequest )
+  {
+    value = msOWSLookupMetadata(&(lp->metadata), "G", "include_items");
+    if( value != NULL && strcmp(value, "@gml:id") == 0 )
+        layer->bOutputGMLIdOnly = MS_TRUE;
+  }
+
+  if (layer->namespace_prefix) {
+    layer->layerName = (char *) msSmallMalloc(strlen(layer->namespace_prefix)+strlen(lp->name)+2);
+    sprintf(layer->layerName, "%s:%s", layer->namespace_prefix, lp->name);
+  } else {
+    layer->layerName = msStrdup(lp->name);
+  }
+
+  if( bUseURN )
+  {
+      layer->srs = msOWSGetProjURN(&(map->projection), NULL, "FGO", MS_TRUE);
+      if (!layer->srs)
+        layer->srs = msOWSGetProjURN(&(map->projection), &(map->web.metadata), "FGO", MS_TRUE);
+      if (!layer->srs)
+        layer->srs = msOWSGetProjURN(&(lp->projection), &(lp->metadata), "FGO", MS_TRUE);
+  }
+  else
+  {
+      msOWSGetEPSGProj(&(map->projection), NULL, "FGO", MS_TRUE, &layer->srs);
+      if (!layer->srs)
+        msOWSGetEPSGProj(&(map->projection), &(map->web.metadata), "FGO", MS_TRUE, &layer->srs);
+      if (!layer->srs)
+        msOWSGetEPSGProj(&(lp->projection), &(lp->metadata), "FGO", MS_TRUE, &layer->srs);
+  }
+
+  return MS_SUCCESS;
+}
+
+/*
+** Writes one feature, the shape must already be in the map projection.
+** Axis are swapped in place when bSwapAxis is set.
+*/
+static void gmlWriteWFSFeature(msIOWriter *writer, gmlWFSLayerObj *layer, shapeObj *shape,
+                               OWSGMLVersion outputformat, int nWFSVersion, int bSwapAxis,
+                               int bGetPropertyValueRequest)
+{
+  char *pszFID;
+  int k;
+
+  if(layer->featureIdIndex != -1) {
+      pszFID = (char*) msSmallMalloc( strlen(layer->lp->name) + 1 + strlen(shape->values[layer->featureIdIndex]) + 1 );
+      sprintf(pszFID, "%s.%s", layer->lp->name, shape->values[layer->featureIdIndex]);
+  }
+  else
+      pszFID = msStrdup("");
+
+  if( layer->bOutputGMLIdOnly )
+  {
+      msIO_writerPrintf(writer, "    <wfs:member>%s</wfs:member>\n", pszFID);
+      msFree(pszFID);
+      return;
+  }
+
+  /*
+  ** start this feature
+  */
+  if( nWFSVersion == OWS_2_0_0 )
+      msIO_writerPrintf(writer, "    <wfs:member>\n");
+  else
+      msIO_writerPrintf(writer, "    <gml:featureMember>\n");
+  if(msIsXMLTagValid(layer->layerName) == MS_FALSE)
+      msIO_writerPrintf(writer, "<!-- WARNING: The value '%s' is not valid in a XML tag context. -->\n", layer->layerName);
+  if(layer->featureIdIndex != -1) {
+      if( !bGetPropertyValueRequest )
+      {
+          if(outputformat == OWS_GML2)
+              msIO_writerPrintf(writer, "      <%s fid=\"%s\">\n", layer->layerName, pszFID);
+          else  /* OWS_GML3 or OWS_GML32 */
+              msIO_writerPrintf(writer, "      <%s gml:id=\"%s\">\n", layer->layerName, pszFID);
+      }
+  } else {
+      if( !bGetPropertyValueRequest )
+          msIO_writerPrintf(writer, "      <%s>\n", layer->layerName);
+  }
+
+  if (bSwapAxis)
+    msAxisSwapShape(shape);
+
+  /* write the feature geometry and bounding box */
+  if(!(layer->geometryList && layer->geometryList->numgeometries == 1 &&
+      strcasecmp(layer->geometryList->geometries[0].name, "none") == 0)) {
+    if( !bGetPropertyValueRequest )
+      gmlWriteBounds(writer, outputformat, &(shape->bounds), layer->srs, "        ", "gml");
+    gmlWriteGeometry(writer, layer->geometryList, outputformat, shape, layer->srs,
+                     layer->namespace_prefix, "        ", pszFID, layer->nSRSDimension);
+  }
+
+  /* write any item/values */
+  for(k=0; k<layer->itemList->numitems; k++) {
+    gmlItemObj *item = &(layer->itemList->items[k]);
+    if(msItemInGroups(item->name, layer->groupList) == MS_FALSE)
+      msGMLWriteItem(writer, item, shape->values[k], layer->namespace_prefix,
+                     "        ", outputformat, pszFID);
+  }
+
+  /* write any constants */
+  for(k=0; k<layer->constantList->numconstants; k++) {
+    gmlConstantObj *constant = &(layer->constantList->constants[k]);
+    if(msItemInGroups(constant->name, layer->groupList) == MS_FALSE)
+      msGMLWriteConstant(writer, constant, layer->namespace_prefix, "        ");
+  }
+
+  /* write any groups */
+  for(k=0; k<layer->groupList->numgroups; k++)
+    msGMLWriteGroup(writer, &(layer->groupList->groups[k]), shape, layer->itemList,
+                    layer->constantList, layer->namespace_prefix, "        ", outputformat, pszFID);
+
+  if( !bGetPropertyValueRequest )
+      /* end this feature */
+      msIO_writerPrintf(writer, "      </%s>\n", layer->layerName);
+
+  if( nWFSVersion == OWS_2_0_0 )
+    msIO_writerPrintf(writer, "    </wfs:member>\n");
+  else
+    msIO_writerPrintf(writer, "    </gml:featureMember>\n");
+
+  msFree(pszFID);
+}
+
+#endif /* USE_WFS_SVR */
+
 /*
 ** msGMLWriteWFSQuery()
 **
@@ -1649,19 +1837,13 @@ int msGMLWriteWFSQuery(mapObj *map, FILE *stream, const char *default_namespace_
 {
 #ifdef USE_WFS_SVR
   int status;
-  int i,j,k;
+  int i,j;
   layerObj *lp=NULL;
   shapeObj shape;
+  gmlWFSLayerObj layer;
 
-  gmlGroupListObj *groupList=NULL;
-  gmlItemListObj *itemList=NULL;
-  gmlConstantListObj *constantList=NULL;
-  gmlGeometryListObj *geometryList=NULL;
-  gmlItemObj *item=NULL;
-  gmlConstantObj *constant=NULL;
-
-  const char *namespace_prefix=NULL;
   int bSwapAxis;
+  msIOWriter writer;
 
   msInitShape(&shape);
 
@@ -1672,107 +1854,32 @@ int msGMLWriteWFSQuery(mapObj *map, FILE *stream, const char *default_namespace_
   if (!bGetPropertyValueRequest) {
     msGMLWriteWFSBounds(map, stream, "      ", outputformat, nWFSVersion, bUseURN);
   }
+  msIO_writerInit(&writer, stream);
+
   /* step through the layers looking for query results */
   for(i=0; i<map->numlayers; i++) {
 
     lp = GET_LAYER(map, map->layerorder[i]);
 
     if(lp->resultcache && lp->resultcache->numresults > 0)  { /* found results */
-      char *layerName;
-      const char *value;
-      int featureIdIndex=-1; /* no feature id */
-      char* srs = NULL;
-      int bOutputGMLIdOnly = MS_FALSE;
-      int nSRSDimension = 2;
-      const char* geomtype;
       reprojectionObj* reprojector = NULL;
 
-      /* setup namespace, a layer can override the default */
-      namespace_prefix = msOWSLookupMetadata(&(lp->metadata), "OFG", "namespace_prefix");
-      if(!namespace_prefix) namespace_prefix = default_namespace_prefix;
-      
-      geomtype = msOWSLookupMetadata(&(lp->metadata), "OFG", "geomtype");
-      if( geomtype != NULL && (strstr(geomtype, "25d") != NULL || strstr(geomtype, "25D") != NULL) )
-      {
-#ifdef USE_POINT_Z_M
-          nSRSDimension = 3;
-#else
-          msIO_fprintf(stream, "<!-- WARNING: 25d requested forn typename '%s' but MapServer compiled without USE_POINT_Z_M support. -->\n", lp->name);
-#endif
-      }
-
-      value = msOWSLookupMetadata(&(lp->metadata), "OFG", "featureid");
-      if(value) { /* find the featureid amongst the items for this layer */
-        for(j=0; j<lp->numitems; j++) {
-          if(strcasecmp(lp->items[j], value) == 0) { /* found it */
-            featureIdIndex = j;
-            break;
-          }
-        }
-
-        /* Produce a warning if a featureid was set but the corresponding item is not found. */
-        if (featureIdIndex == -1)
-          msIO_fprintf(stream, "<!-- WARNING: FeatureId item '%s' not found in typename '%s'. -->\n", value, lp->name);
-      }
-      else if( outputformat == OWS_GML32 )
-          msIO_fprintf(stream, "<!-- WARNING: No featureid defined for typename '%s'. Output will not validate. -->\n", lp->name);
-
-      /* populate item and group metadata structures */
-      itemList = msGMLGetItems(lp, "G");
-      constantList = msGMLGetConstants(lp, "G");
-      groupList = msGMLGetGroups(lp, "G");
-      geometryList = msGMLGetGeometries(lp, "GFO", MS_FALSE);
-      if (itemList == NULL || constantList == NULL || groupList == NULL || geometryList == NULL) {
-        msSetError(MS_MISCERR, "Unable to populate item and group metadata structures", "msGMLWriteWFSQuery()");
+      if(gmlInitWFSLayer(&layer, &writer, map, lp, default_namespace_prefix, outputformat,
+                         bUseURN, bGetPropertyValueRequest) != MS_SUCCESS) {
+        msIO_writerFlush(&writer);
         return MS_FAILURE;
       }
-      
-      if( bGetPropertyValueRequest )
-      {
-        const char* value = msOWSLookupMetadata(&(lp->metadata), "G", "include_items");
-        if( value != NULL && strcmp(value, "@gml:id") == 0 )
-            bOutputGMLIdOnly = MS_TRUE;
-      }
-
-      if (namespace_prefix) {
-        layerName = (char *) msSmallMalloc(strlen(namespace_prefix)+strlen(lp->name)+2);
-        sprintf(layerName, "%s:%s", namespace_prefix, lp->name);
-      } else {
-        layerName = msStrdup(lp->name);
-      }
-
-      if( bUseURN )
-      {
-          srs = msOWSGetProjURN(&(map->projection), NULL, "FGO", MS_TRUE);
-          if (!srs)
-            srs = msOWSGetProjURN(&(map->projection), &(map->web.metadata), "FGO", MS_TRUE);
-          if (!srs)
-            srs = msOWSGetProjURN(&(lp->projection), &(lp->metadata), "FGO", MS_TRUE);
-      }
-      else
-      {
-          msOWSGetEPSGProj(&(map->projection), NULL, "FGO", MS_TRUE, &srs);
-          if (!srs)
-            msOWSGetEPSGProj(&(map->projection), &(map->web.metadata), "FGO", MS_TRUE, &srs);
-          if (!srs)
-            msOWSGetEPSGProj(&(lp->projection), &(lp->metadata), "FGO", MS_TRUE, &srs);
-      }
 
       if(msProjectionsDiffer(&(lp->projection), &(map->projection))) {
         reprojector = msProjectCreateReprojector(&(lp->projection), &(map->projection));
         if( reprojector == NULL ) {
-           msGMLFreeGroups(groupList);
-           msGMLFreeConstants(constantList);
-           msGMLFreeItems(itemList);
-           msGMLFreeGeometries(geometryList);
-           msFree(layerName);
+           gmlFreeWFSLayer(&layer);
+           msIO_writerFlush(&writer);
            return MS_FAILURE;
         }
       }
 
       for(j=0; j<lp->resultcache->numresults; j++) {
-        char* pszFID;
-
         if( lp->resultcache->results[j].shape )
         {
             /* msDebug("Using cached shape %ld\n", lp->resultcache->results[j].shapeindex); */
@@ -1782,12 +1889,9 @@ int msGMLWriteWFSQuery(mapObj *map, FILE *stream, const char *default_namespace_
         {
             status = msLayerGetShape(lp, &shape, &(lp->resultcache->results[j]));
             if(status != MS_SUCCESS) {
-                msGMLFreeGroups(groupList);
-                msGMLFreeConstants(constantList);
-                msGMLFreeItems(itemList);
-                msGMLFreeGeometries(geometryList);
-                msFree(layerName);
+                gmlFreeWFSLayer(&layer);
                 msProjectDestroyReprojector(reprojector);
+                msIO_writerFlush(&writer);
                 return(status);
             }
         }
@@ -1796,108 +1900,23 @@ int msGMLWriteWFSQuery(mapObj *map, FILE *stream, const char *default_namespace_
         if(reprojector)
           msProjectShapeEx(reprojector, &shape);
 
-        if(featureIdIndex != -1) {
-            pszFID = (char*) msSmallMalloc( strlen(lp->name) + 1 + strlen(shape.values[featureIdIndex]) + 1 );
-            sprintf(pszFID, "%s.%s", lp->name, shape.values[featureIdIndex]);
-        }
-        else
-            pszFID = msStrdup("");
-
-
-        if( bOutputGMLIdOnly )
-        {
-            msIO_fprintf(stream, "    <wfs:member>%s</wfs:member>\n", pszFID);
-            msFree(pszFID);
-            msFreeShape(&shape); /* init too */
-            continue;
-        }
-
-        /*
-        ** start this feature
-        */
-        if( nWFSVersion == OWS_2_0_0 )
-            msIO_fprintf(stream, "    <wfs:member>\n");
-        else
-            msIO_fprintf(stream, "    <gml:featureMember>\n");
-        if(msIsXMLTagValid(layerName) == MS_FALSE)
-            msIO_fprintf(stream, "<!-- WARNING: The value '%s' is not valid in a XML tag context. -->\n", layerName);
-        if(featureIdIndex != -1) {
-            if( !bGetPropertyValueRequest )
-            {
-                if(outputformat == OWS_GML2)
-                    msIO_fprintf(stream, "      <%s fid=\"%s\">\n", layerName, pszFID);
-                else  /* OWS_GML3 or OWS_GML32 */
-                    msIO_fprintf(stream, "      <%s gml:id=\"%s\">\n", layerName, pszFID);
-            }
-        } else {
-            if( !bGetPropertyValueRequest )
-                msIO_fprintf(stream, "      <%s>\n", layerName);
-        }
-
-        if (bSwapAxis)
-          msAxisSwapShape(&shape);
-
-        /* write the feature geometry and bounding box */
-        if(!(geometryList && geometryList->numgeometries == 1 &&
-            strcasecmp(geometryList->geometries[0].name, "none") == 0)) {
-          if( !bGetPropertyValueRequest )
-            gmlWriteBounds(stream, outputformat, &(shape.bounds), srs, "        ", "gml");
-          gmlWriteGeometry(stream, geometryList, outputformat, &(shape), srs,
-                           namespace_prefix, "        ", pszFID, nSRSDimension);
-        }
-
-        /* write any item/values */
-        for(k=0; k<itemList->numitems; k++) {
-          item = &(itemList->items[k]);
-          if(msItemInGroups(item->name, groupList) == MS_FALSE)
-            msGMLWriteItem(stream, item, shape.values[k], namespace_prefix,
-                           "        ", outputformat, pszFID);
-        }
-
-        /* write any constants */
-        for(k=0; k<constantList->numconstants; k++) {
-          constant = &(constantList->constants[k]);
-          if(msItemInGroups(constant->name, groupList) == MS_FALSE)
-            msGMLWriteConstant(stream, constant, namespace_prefix, "        ");
-        }
-
-        /* write any groups */
-        for(k=0; k<groupList->numgroups; k++)
-          msGMLWriteGroup(stream, &(groupList->groups[k]), &shape, itemList,
-                          constantList, namespace_prefix, "        ", outputformat, pszFID);
-
-        if( !bGetPropertyValueRequest )
-            /* end this feature */
-            msIO_fprintf(stream, "      </%s>\n", layerName);
-
-        if( nWFSVersion == OWS_2_0_0 )
-          msIO_fprintf(stream, "    </wfs:member>\n");
-        else
-          msIO_fprintf(stream, "    </gml:featureMember>\n");
-
+        gmlWriteWFSFeature(&writer, &layer, &shape, outputformat, nWFSVersion, bSwapAxis,
+                           bGetPropertyValueRequest);
 
-        msFree(pszFID);
-        pszFID = NULL;
         msFreeShape(&shape); /* init too */
       }
 
       msProjectDestroyReprojector(reprojector);
 
-      msFree(srs);
-
       /* done with this layer, do a little clean-up */
-      msFree(layerName);
-
-      msGMLFreeGroups(groupList);
-      msGMLFreeConstants(constantList);
-      msGMLFreeItems(itemList);
-      msGMLFreeGeometries(geometryList);
+      gmlFreeWFSLayer(&layer);
 
       /* msLayerClose(lp); */
     }
 
   } /* next layer */
 
+  msIO_writerFlush(&writer);
   return(MS_SUCCESS);
 
 #else /* Stub for mapscript */
@@ -1906,6 +1925,76 @@ int msGMLWriteWFSQuery(mapObj *map, FILE *stream, const char *default_namespace_
 #endif /* USE_WFS_SVR */
 }
 
+#ifdef USE_WFS_SVR
+
+/*
+** WFS output streamed from the query itself, see msWFSGetFeature(). Features
+** are written as msQueryBy*() hands them over, nothing is kept besides the
+** metadata of the current layer.
+*/
+struct gmlWFSStreamObj {
+  msIOWriter writer;
+  mapObj *map;
+  const char *default_namespace_prefix;
+  OWSGMLVersion outputformat;
+  int nWFSVersion;
+  int bUseURN;
+  int bSwapAxis;
+  gmlWFSLayerObj layer; /* layer.lp is NULL until the first feature */
+};
+
+gmlWFSStreamObj *msGMLCreateWFSStream(mapObj *map, FILE *stream, const char *default_namespace_prefix,
+                                      OWSGMLVersion outputformat, int nWFSVersion, int bUseURN)
+{
+  gmlWFSStreamObj *gmlstream = (gmlWFSStreamObj *) msSmallCalloc(1, sizeof(gmlWFSStreamObj));
+
+  msIO_writerInit(&gmlstream->writer, stream);
+  gmlstream->map = map;
+  gmlstream->default_namespace_prefix = default_namespace_prefix;
+  gmlstream->outputformat = outputformat;
+  gmlstream->nWFSVersion = nWFSVersion;
+  gmlstream->bUseURN = bUseURN;
+  gmlstream->bSwapAxis = msIsAxisInvertedProj(&(map->projection));
+
+  return gmlstream;
+}
+
+/*
+** Writes a feature of lp, in the map projection as msQueryByRect() and
+** msQueryByFilter() hand it over. The shape is left as it was given.
+*/
+int msGMLWriteWFSStreamFeature(gmlWFSStreamObj *gmlstream, layerObj *lp, shapeObj *shape)
+{
+  if(gmlstream->layer.lp != lp) {
+    if(gmlstream->layer.lp) gmlFreeWFSLayer(&gmlstream->layer);
+    if(gmlInitWFSLayer(&gmlstream->layer, &gmlstream->writer, gmlstream->map, lp,
+                       gmlstream->default_namespace_prefix, gmlstream->outputformat,
+                       gmlstream->bUseURN, MS_FALSE) != MS_SUCCESS)
+      return MS_FAILURE;
+  }
+
+  gmlWriteWFSFeature(&gmlstream->writer, &gmlstream->layer, shape, gmlstream->outputformat,
+                     gmlstream->nWFSVersion, gmlstream->bSwapAxis, MS_FALSE);
+  if(gmlstream->bSwapAxis)
+    msAxisSwapShape(shape); /* back to what the query expects */
+
+  return MS_SUCCESS;
+}
+
+/*
+** Flushes whatever is left and frees the stream.
+*/
+void msGMLFreeWFSStream(gmlWFSStreamObj *gmlstream)
+{
+  if(!gmlstream) return;
+
+  msIO_writerFlush(&gmlstream->writer);
+  if(gmlstream->layer.lp) gmlFreeWFSLayer(&gmlstream->layer);
+  free(gmlstream);
+}
+
+#endif /* USE_WFS_SVR */
+
 
 #ifdef USE_LIBXML2
 
@@ -52,13 +52,9 @@ typedef struct msIOContextGroup_t {
   msIOContext stdin_context;
   msIOContext stdout_context;
   msIOContext stderr_context;
-
-  void*    thread_id;
-  struct msIOContextGroup_t *next;
 } msIOContextGroup;
 
 static msIOContextGroup default_contexts;
-static msIOContextGroup *io_context_list = NULL;
 static void msIO_Initialize( void );
 
 #ifdef msIO_printf
@@ -76,14 +72,18 @@ static void msIO_Initialize( void );
 void msIO_Cleanup()
 
 {
+  msIOContextGroup *group;
+
   if( is_msIO_initialized )
 
   {
     is_msIO_initialized = MS_FALSE;
-    while( io_context_list != NULL ) {
-      msIOContextGroup *last = io_context_list;
-      io_context_list = io_context_list->next;
-      free( last );
+
+    /* the groups of other threads go away with their threads */
+    group = (msIOContextGroup *) msGetThreadSlot( TSLOT_IOCONTEXT );
+    if( group != NULL ) {
+      msSetThreadSlot( TSLOT_IOCONTEXT, NULL, NULL );
+      free( group );
     }
   }
 }
@@ -95,66 +95,37 @@ void msIO_Cleanup()
 static msIOContextGroup *msIO_GetContextGroup()
 
 {
-  void* nThreadId = msGetThreadId();
-  msIOContextGroup *prev = NULL, *group = io_context_list;
+  msIOContextGroup *group;
 
-  if( group != NULL && group->thread_id == nThreadId )
+  group = (msIOContextGroup *) msGetThreadSlot( TSLOT_IOCONTEXT );
+  if( group != NULL )
     return group;
 
   /* -------------------------------------------------------------------- */
-  /*      Search for group for this thread                                */
+  /*      Create a new context group for this thread.                     */
   /* -------------------------------------------------------------------- */
   msAcquireLock( TLOCK_IOCONTEXT );
   msIO_Initialize();
+  msReleaseLock( TLOCK_IOCONTEXT );
 
-  group = io_context_list;
-  while( group != NULL && group->thread_id != nThreadId ) {
-    prev = group;
-    group = group->next;
-  }
-
-  /* -------------------------------------------------------------------- */
-  /*      If we found it, make sure it is pushed to the front of the      */
-  /*      link for faster finding next time, and return it.               */
-  /* -------------------------------------------------------------------- */
-  if( group != NULL ) {
-    if( prev != NULL ) {
-      prev->next = group->next;
-      group->next = io_context_list;
-      io_context_list = group;
-    }
-
-    msReleaseLock( TLOCK_IOCONTEXT );
-    return group;
-  }
-
-  /* -------------------------------------------------------------------- */
-  /*      Create a new context group for this thread.                     */
-  /* -------------------------------------------------------------------- */
   group = (msIOContextGroup *) calloc(sizeof(msIOContextGroup),1);
+  if( group == NULL )
+    return NULL;
 
   group->stdin_context = default_contexts.stdin_context;
   group->stdout_context = default_contexts.stdout_context;
   group->stderr_context = default_contexts.stderr_context;
-  group->thread_id = nThreadId;
 
-  group->next = io_context_list;
-  io_context_list = group;
-
-  msReleaseLock( TLOCK_IOCONTEXT );
+  msSetThreadSlot( TSLOT_IOCONTEXT, group, free );
 
   return group;
 }
 
 /* returns MS_TRUE if the msIO standard output hasn't been redirected */
 int msIO_isStdContext() {
-  msIOContextGroup *group = io_context_list;
-  void* nThreadId = msGetThreadId();
-  if(!group || group->thread_id != nThreadId) {
-    group = msIO_GetContextGroup();
-    if(!group) {
-      return MS_FALSE; /* probably a bug */
-    }
+  msIOContextGroup *group = msIO_GetContextGroup();
+  if(!group) {
+    return MS_FALSE; /* probably a bug */
   }
   if(group->stderr_context.cbData == (void*)stderr &&
       group->stdin_context.cbData == (void*)stdin &&
@@ -170,16 +141,10 @@ int msIO_isStdContext() {
 msIOContext *msIO_getHandler( FILE * fp )
 
 {
-  void* nThreadId = msGetThreadId();
-  msIOContextGroup *group = io_context_list;
-
-  msIO_Initialize();
+  msIOContextGroup *group = msIO_GetContextGroup();
 
-  if( group == NULL || group->thread_id != nThreadId ) {
-    group = msIO_GetContextGroup();
-    if( group == NULL )
-      return NULL;
-  }
+  if( group == NULL )
+    return NULL;
 
   if( fp == stdin || fp == NULL || strcmp((const char *)fp,"stdin") == 0 )
     return &(group->stdin_context);
@@ -498,6 +463,200 @@ int msIO_fread( void *data, size_t size, size_t nmemb, FILE *fp )
     return msIO_contextRead( context, data, size * nmemb ) / size;
 }
 
+/* ==================================================================== */
+/* ==================================================================== */
+/*      Buffered writer.                                                */
+/* ==================================================================== */
+/* ==================================================================== */
+
+/************************************************************************/
+/*                          msIO_writerInit()                           */
+/************************************************************************/
+
+void msIO_writerInit( msIOWriter *writer, FILE *fp )
+
+{
+  writer->fp = fp;
+  writer->used = 0;
+}
+
+/************************************************************************/
+/*                          msIO_writerFlush()                          */
+/*                                                                      */
+/*      Passes the buffered data on to the channel, returns the         */
+/*      number of bytes written or -1.                                  */
+/************************************************************************/
+
+int msIO_writerFlush( msIOWriter *writer )
+
+{
+  int used = writer->used;
+
+  if( used == 0 )
+    return 0;
+
+  writer->used = 0;
+  if( msIO_fwrite( writer->data, 1, used, writer->fp ) != used )
+    return -1;
+
+  return used;
+}
+
+/************************************************************************/
+/*                          msIO_writerWrite()                          */
+/************************************************************************/
+
+int msIO_writerWrite( msIOWriter *writer, const void *data, int byteCount )
+
+{
+  if( byteCount <= 0 )
+    return 0;
+
+  if( writer->used + byteCount > MS_IO_WRITER_SIZE ) {
+    if( msIO_writerFlush( writer ) < 0 )
+      return -1;
+
+    /* too big to be worth buffering */
+    if( byteCount > MS_IO_WRITER_SIZE / 2 )
+      return msIO_fwrite( data, 1, byteCount, writer->fp );
+  }
+
+  memcpy( writer->data + writer->used, data, byteCount );
+  writer->used += byteCount;
+
+  return byteCount;
+}
+
+/************************************************************************/
+/*                          msIO_writerPuts()                           */
+/************************************************************************/
+
+int msIO_writerPuts( msIOWriter *writer, const char *string )
+
+{
+  return msIO_writerWrite( writer, string, strlen(string) );
+}
+
+/************************************************************************/
+/*                       msIO_writerPutsEncoded()                       */
+/*                                                                      */
+/*      Writes string with the entities encoded like                    */
+/*      msEncodeHTMLEntities() does, without allocating.                */
+/************************************************************************/
+
+int msIO_writerPutsEncoded( msIOWriter *writer, const char *string )
+
+{
+  const char *c, *start;
+  const char *entity;
+  int written = 0;
+
+  for( c = start = string; *c != '\0'; c++ ) {
+    switch( *c ) {
+      case '&':
+        entity = "&amp;";
+        break;
+      case '<':
+        entity = "&lt;";
+        break;
+      case '>':
+        entity = "&gt;";
+        break;
+      case '"':
+        entity = "&quot;";
+        break;
+      case '\'':
+        entity = "&#39;";
+        break;
+      default:
+        continue;
+    }
+
+    /* copy the plain characters seen so far, then the entity */
+    if( msIO_writerWrite( writer, start, c - start ) < 0 ||
+        msIO_writerPuts( writer, entity ) < 0 )
+      return -1;
+    written += (c - start) + strlen(entity);
+    start = c + 1;
+  }
+
+  if( msIO_writerWrite( writer, start, c - start ) < 0 )
+    return -1;
+
+  return written + (c - start);
+}
+
+/************************************************************************/
+/*                        msIO_writerPutDouble()                        */
+/*                                                                      */
+/*      Formats value with msFormatDouble() directly into the buffer.   */
+/************************************************************************/
+
+int msIO_writerPutDouble( msIOWriter *writer, double value, int precision )
+
+{
+  int available, length;
+
+  if( MS_IO_WRITER_SIZE - writer->used < 64 &&
+      msIO_writerFlush( writer ) < 0 )
+    return -1;
+
+  available = MS_IO_WRITER_SIZE - writer->used;
+  length = msFormatDouble( writer->data + writer->used, available, value, precision );
+  if( length < 0 )
+    return -1;
+
+  /* only %f of huge values gets this long */
+  if( length >= available )
+    return msIO_writerPrintf( writer, "%.*f", precision, value );
+
+  writer->used += length;
+  return length;
+}
+
+/************************************************************************/
+/*                         msIO_writerPrintf()                          */
+/*                                                                      */
+/*      Formats directly into the buffer, only results larger than      */
+/*      the buffer go through msIO_vfprintf().                          */
+/************************************************************************/
+
+int msIO_writerPrintf( msIOWriter *writer, const char *format, ... )
+
+{
+  va_list args;
+  int     available, return_val;
+
+  available = MS_IO_WRITER_SIZE - writer->used;
+
+  va_start( args, format );
+  return_val = vsnprintf( writer->data + writer->used, available, format, args );
+  va_end( args );
+
+  if( return_val < 0 )
+    return -1;
+
+  if( return_val < available ) {
+    writer->used += return_val;
+    return return_val;
+  }
+
+  /* didn't fit, flush and try again */
+  if( msIO_writerFlush( writer ) < 0 )
+    return -1;
+
+  va_start( args, format );
+  if( return_val < MS_IO_WRITER_SIZE ) {
+    return_val = vsnprintf( writer->data, MS_IO_WRITER_SIZE, format, args );
+    if( return_val > 0 )
+      writer->used = return_val;
+  } else
+    return_val = msIO_vfprintf( writer->fp, format, args );
+  va_end( args );
+
+  return return_val;
+}
+
 /* ==================================================================== */
 /* ==================================================================== */
 /*      Internal default callbacks implementing stdio reading and       */
@@ -554,9 +713,6 @@ static void msIO_Initialize( void )
   default_contexts.stderr_context.readWriteFunc = msIO_stdioWrite;
   default_contexts.stderr_context.cbData = (void *) stderr;
 
-  default_contexts.next = NULL;
-  default_contexts.thread_id = 0;
-
   is_msIO_initialized = MS_TRUE;
 }
 
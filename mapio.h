@@ -100,6 +100,29 @@ extern "C" {
   int MS_DLL_EXPORT msIO_bufferRead( void *, void *, int );
   int MS_DLL_EXPORT msIO_bufferWrite( void *, void *, int );
 
+  /*
+  ** Buffered writer, for output made of many small writes (GML features,
+  ** templates): writes are collected in the writer and passed on to the
+  ** channel in large chunks.  Nothing else may write to the channel until
+  ** msIO_writerFlush() has been called.
+  */
+
+#define MS_IO_WRITER_SIZE 16384
+
+  typedef struct {
+    FILE          *fp;
+    int            used;
+    char           data[MS_IO_WRITER_SIZE];
+  } msIOWriter;
+
+  void MS_DLL_EXPORT msIO_writerInit( msIOWriter *writer, FILE *fp );
+  int MS_DLL_EXPORT msIO_writerFlush( msIOWriter *writer );
+  int MS_DLL_EXPORT msIO_writerWrite( msIOWriter *writer, const void *data, int byteCount );
+  int MS_DLL_EXPORT msIO_writerPuts( msIOWriter *writer, const char *string );
+  int MS_DLL_EXPORT msIO_writerPutsEncoded( msIOWriter *writer, const char *string );
+  int MS_DLL_EXPORT msIO_writerPutDouble( msIOWriter *writer, double value, int precision );
+  int MS_DLL_EXPORT msIO_writerPrintf( msIOWriter *writer, const char *format, ... ) MS_PRINT_FUNC_FORMAT(2,3);
+
   void MS_DLL_EXPORT msIO_resetHandlers(void);
   void MS_DLL_EXPORT msIO_installStdoutToBuffer(void);
   void MS_DLL_EXPORT msIO_installStdinFromBuffer(void);
@@ -28,6 +28,9 @@
  ****************************************************************************/
 
 #include "mapserver.h"
+#include "uthash.h"
+
+#include <sys/stat.h>
 
 
 
@@ -154,6 +157,246 @@ int msJoinClose(joinObj *join)
   return MS_FAILURE;
 }
 
+/*  */
+/* In memory tables shared by the XBase and CSV joins */
+/*  */
+
+/*
+** Joins used to scan the whole table for every shape. The table is now
+** indexed on the "to" column when the join is connected: the index maps each
+** value to the records holding it, in record order, so one-to-many joins
+** return the same records in the same order. CSV tables are kept in memory
+** along with their index. Tables are shared by all the joins on the same file
+** and column and kept between requests (up to MS_JOIN_CACHE_MAX unused ones),
+** keyed on the identity (device, inode, mtime and size) of the file so a
+** modified file is read again.
+*/
+#define MS_JOIN_CACHE_MAX 16
+
+typedef struct {
+  char *value;
+  int *records;
+  int numrecords;
+  UT_hash_handle hh;
+} joinIndexEntry;
+
+typedef struct joinTableObj {
+  char *filename;
+  long long key[4]; /* device, inode, mtime and size */
+  int connectiontype; /* MS_DB_XBASE or MS_DB_CSV */
+  int toindex;
+
+  joinIndexEntry *index;
+
+  /* CSV only */
+  char ***rows;
+  int numrows;
+  int numitems;
+
+  int refcount;
+  int stale; /* not in the cache, freed once released */
+  struct joinTableObj *next;
+} joinTableObj;
+
+static joinTableObj *joinCache = NULL; /* most recently used first */
+
+static int msJoinTableKey(FILE *fp, long long *key)
+{
+  struct stat sb;
+
+  if(!fp || fstat(fileno(fp), &sb) != 0)
+    return MS_FAILURE;
+  key[0] = (long long) sb.st_dev;
+  key[1] = (long long) sb.st_ino;
+  key[2] = (long long) sb.st_mtime;
+  key[3] = (long long) sb.st_size;
+  return MS_SUCCESS;
+}
+
+static joinTableObj *msJoinTableCreate(const char *filename, int connectiontype, int toindex)
+{
+  joinTableObj *table = (joinTableObj *) msSmallCalloc(1, sizeof(joinTableObj));
+
+  table->filename = msStrdup(filename);
+  table->connectiontype = connectiontype;
+  table->toindex = toindex;
+  table->refcount = 1;
+  table->stale = MS_TRUE; /* until added to the cache */
+  return table;
+}
+
+static void msJoinTableFree(joinTableObj *table)
+{
+  joinIndexEntry *entry, *tmp;
+  int i;
+
+  UT_HASH_ITER(hh, table->index, entry, tmp) {
+    UT_HASH_DEL(table->index, entry);
+    msFree(entry->value);
+    msFree(entry->records);
+    msFree(entry);
+  }
+  for(i=0; i<table->numrows; i++)
+    msFreeCharArray(table->rows[i], table->numitems);
+  msFree(table->rows);
+  msFree(table->filename);
+  msFree(table);
+}
+
+static void msJoinTableIndexAdd(joinTableObj *table, const char *value, int record)
+{
+  joinIndexEntry *entry;
+
+  UT_HASH_FIND_STR(table->index, value, entry);
+  if(!entry) {
+    entry = (joinIndexEntry *) msSmallCalloc(1, sizeof(joinIndexEntry));
+    entry->value = msStrdup(value);
+    UT_HASH_ADD_KEYPTR(hh, table->index, entry->value, strlen(entry->value), entry);
+  }
+  entry->records = (int *) msSmallRealloc(entry->records, sizeof(int)*(entry->numrecords+1));
+  entry->records[entry->numrecords++] = record;
+}
+
+static joinIndexEntry *msJoinTableLookup(joinTableObj *table, const char *value)
+{
+  joinIndexEntry *entry;
+
+  UT_HASH_FIND_STR(table->index, value, entry);
+  return entry;
+}
+
+/* returns a reference on the cached table matching key, or NULL */
+static joinTableObj *msJoinTableAcquire(const char *filename, int connectiontype, int toindex, const long long *key)
+{
+  joinTableObj *table, *prev = NULL;
+
+  msAcquireLock(TLOCK_JOIN);
+  for(table = joinCache; table; prev = table, table = table->next) {
+    if(table->connectiontype != connectiontype || table->toindex != toindex ||
+        strcmp(table->filename, filename) != 0)
+      continue;
+
+    /* unlink it, it moves to the front or goes away */
+    if(prev) prev->next = table->next;
+    else joinCache = table->next;
+
+    if(memcmp(table->key, key, sizeof(table->key)) == 0) {
+      table->next = joinCache;
+      joinCache = table;
+      table->refcount++;
+      break;
+    }
+
+    if(table->refcount == 0)
+      msJoinTableFree(table);
+    else
+      table->stale = MS_TRUE;
+    table = NULL;
+    break;
+  }
+  msReleaseLock(TLOCK_JOIN);
+
+  return table;
+}
+
+/*
+** Makes a newly built table available to other joins. Another thread may have
+** built and cached the same table since msJoinTableAcquire() missed, so the
+** cache is checked again under the lock; in that case the new table is freed
+** and a reference on the cached one is returned instead.
+*/
+static joinTableObj *msJoinTableCache(joinTableObj *table, const long long *key)
+{
+  joinTableObj *cached, *prev = NULL;
+
+  memcpy(table->key, key, sizeof(table->key));
+
+  msAcquireLock(TLOCK_JOIN);
+  for(cached = joinCache; cached; prev = cached, cached = cached->next) {
+    if(cached->connectiontype != table->connectiontype || cached->toindex != table->toindex ||
+        strcmp(cached->filename, table->filename) != 0)
+      continue;
+
+    /* unlink it, it moves to the front or goes away */
+    if(prev) prev->next = cached->next;
+    else joinCache = cached->next;
+
+    if(memcmp(cached->key, key, sizeof(cached->key)) == 0) {
+      cached->next = joinCache;
+      joinCache = cached;
+      cached->refcount++;
+      break;
+    }
+
+    if(cached->refcount == 0)
+      msJoinTableFree(cached);
+    else
+      cached->stale = MS_TRUE;
+    cached = NULL;
+    break;
+  }
+
+  if(!cached) {
+    table->stale = MS_FALSE;
+    table->next = joinCache;
+    joinCache = table;
+  }
+  msReleaseLock(TLOCK_JOIN);
+
+  if(cached) {
+    msJoinTableFree(table); /* never shared, no lock needed */
+    return cached;
+  }
+  return table;
+}
+
+static void msJoinTableRelease(joinTableObj *table)
+{
+  joinTableObj *prev = NULL, *next;
+  int unused = 0;
+
+  if(!table) return;
+
+  msAcquireLock(TLOCK_JOIN);
+  table->refcount--;
+  if(table->stale) {
+    if(table->refcount == 0)
+      msJoinTableFree(table);
+  } else {
+    /* only keep the most recently used tables */
+    for(table = joinCache; table; table = next) {
+      next = table->next;
+      if(table->refcount == 0 && ++unused > MS_JOIN_CACHE_MAX) {
+        if(prev) prev->next = next;
+        else joinCache = next;
+        msJoinTableFree(table);
+      } else {
+        prev = table;
+      }
+    }
+  }
+  msReleaseLock(TLOCK_JOIN);
+}
+
+/* frees the cached tables no longer in use, see msCleanup() */
+void msJoinCacheCleanup(void)
+{
+  joinTableObj *table, *prev = NULL, *next;
+
+  msAcquireLock(TLOCK_JOIN);
+  for(table = joinCache; table; table = next) {
+    next = table->next;
+    if(table->refcount == 0) {
+      if(prev) prev->next = next;
+      else joinCache = next;
+      msJoinTableFree(table);
+    } else {
+      prev = table;
+    }
+  }
+  msReleaseLock(TLOCK_JOIN);
+}
+
 /*  */
 /* XBASE join functions */
 /*  */
@@ -161,13 +404,16 @@ typedef struct {
   DBFHandle hDBF;
   int fromindex, toindex;
   char *target;
-  int nextrecord;
+  joinTableObj *table;
+  joinIndexEntry *match; /* records matching target */
+  int nextmatch;
 } msDBFJoinInfo;
 
 int msDBFJoinConnect(layerObj *layer, joinObj *join)
 {
-  int i;
+  int i, n;
   char szPath[MS_MAXPATHLEN];
+  long long key[4];
   msDBFJoinInfo *joininfo;
 
   if(join->joininfo) return(MS_SUCCESS); /* already open */
@@ -185,7 +431,9 @@ int msDBFJoinConnect(layerObj *layer, joinObj *join)
 
   /* initialize any members that won't get set later on in this function */
   joininfo->target = NULL;
-  joininfo->nextrecord = 0;
+  joininfo->table = NULL;
+  joininfo->match = NULL;
+  joininfo->nextmatch = 0;
 
   join->joininfo = joininfo;
 
@@ -216,6 +464,30 @@ int msDBFJoinConnect(layerObj *layer, joinObj *join)
     return(MS_FAILURE);
   }
 
+  /* index the "to" column, or reuse the index built by a previous join */
+  if(joininfo->hDBF->map) {
+    key[0] = joininfo->hDBF->map->dev;
+    key[1] = joininfo->hDBF->map->ino;
+    key[2] = joininfo->hDBF->map->mtime;
+    key[3] = joininfo->hDBF->map->size;
+    joininfo->table = msJoinTableAcquire(szPath, MS_DB_XBASE, joininfo->toindex, key);
+  } else if(msJoinTableKey(joininfo->hDBF->fp, key) == MS_SUCCESS) {
+    joininfo->table = msJoinTableAcquire(szPath, MS_DB_XBASE, joininfo->toindex, key);
+  } else {
+    key[0] = -1;
+  }
+
+  if(!joininfo->table) {
+    joininfo->table = msJoinTableCreate(szPath, MS_DB_XBASE, joininfo->toindex);
+    n = msDBFGetRecordCount(joininfo->hDBF);
+    for(i=0; i<n; i++) {
+      const char *value = msDBFReadStringAttribute(joininfo->hDBF, i, joininfo->toindex);
+      if(value) msJoinTableIndexAdd(joininfo->table, value, i);
+    }
+    if(key[0] != -1)
+      joininfo->table = msJoinTableCache(joininfo->table, key);
+  }
+
   /* finally store away the item names in the XBase table */
   join->numitems =  msDBFGetFieldCount(joininfo->hDBF);
   join->items = msDBFGetItems(joininfo->hDBF);
@@ -243,17 +515,18 @@ int msDBFJoinPrepare(joinObj *join, shapeObj *shape)
     return(MS_FAILURE);
   }
 
-  joininfo->nextrecord = 0; /* starting with the first record */
-
   if(joininfo->target) free(joininfo->target); /* clear last target */
   joininfo->target = msStrdup(shape->values[joininfo->fromindex]);
 
+  joininfo->match = msJoinTableLookup(joininfo->table, joininfo->target);
+  joininfo->nextmatch = 0; /* starting with the first record */
+
   return(MS_SUCCESS);
 }
 
 int msDBFJoinNext(joinObj *join)
 {
-  int i, n;
+  int i;
   msDBFJoinInfo *joininfo = join->joininfo;
 
   if(!joininfo) {
@@ -272,13 +545,7 @@ int msDBFJoinNext(joinObj *join)
     join->values = NULL;
   }
 
-  n = msDBFGetRecordCount(joininfo->hDBF);
-
-  for(i=joininfo->nextrecord; i<n; i++) { /* find a match */
-    if(strcmp(joininfo->target, msDBFReadStringAttribute(joininfo->hDBF, i, joininfo->toindex)) == 0) break;
-  }
-
-  if(i == n) { /* unable to do the join */
+  if(!joininfo->match || joininfo->nextmatch >= joininfo->match->numrecords) { /* unable to do the join */
     if((join->values = (char **)malloc(sizeof(char *)*join->numitems)) == NULL) {
       msSetError(MS_MEMERR, NULL, "msDBFJoinNext()");
       return(MS_FAILURE);
@@ -286,14 +553,15 @@ int msDBFJoinNext(joinObj *join)
     for(i=0; i<join->numitems; i++)
       join->values[i] = msStrdup("\0"); /* intialize to zero length strings */
 
-    joininfo->nextrecord = n;
+    joininfo->match = NULL;
     return(MS_DONE);
   }
 
+  i = joininfo->match->records[joininfo->nextmatch];
   if((join->values = msDBFGetValues(joininfo->hDBF,i)) == NULL)
     return(MS_FAILURE);
 
-  joininfo->nextrecord = i+1; /* so we know where to start looking next time through */
+  joininfo->nextmatch++; /* so we know where to start looking next time through */
 
   return(MS_SUCCESS);
 }
@@ -305,6 +573,7 @@ int msDBFJoinClose(joinObj *join)
   if(!joininfo) return(MS_SUCCESS); /* already closed */
 
   if(joininfo->hDBF) msDBFClose(joininfo->hDBF);
+  msJoinTableRelease(joininfo->table);
   if(joininfo->target) free(joininfo->target);
   free(joininfo);
   joininfo = NULL;
@@ -318,9 +587,9 @@ int msDBFJoinClose(joinObj *join)
 typedef struct {
   int fromindex, toindex;
   char *target;
-  char ***rows;
-  int numrows;
-  int nextrow;
+  joinTableObj *table; /* rows and index */
+  joinIndexEntry *match; /* rows matching target */
+  int nextmatch;
 } msCSVJoinInfo;
 
 int msCSVJoinConnect(layerObj *layer, joinObj *join)
@@ -328,7 +597,9 @@ int msCSVJoinConnect(layerObj *layer, joinObj *join)
   int i;
   FILE *stream;
   char szPath[MS_MAXPATHLEN];
+  long long key[4];
   msCSVJoinInfo *joininfo;
+  joinTableObj *table;
   char buffer[MS_BUFFER_LENGTH];
 
   if(join->joininfo) return(MS_SUCCESS); /* already open */
@@ -344,7 +615,9 @@ int msCSVJoinConnect(layerObj *layer, joinObj *join)
 
   /* initialize any members that won't get set later on in this function */
   joininfo->target = NULL;
-  joininfo->nextrow = 0;
+  joininfo->table = NULL;
+  joininfo->match = NULL;
+  joininfo->nextmatch = 0;
 
   join->joininfo = joininfo;
 
@@ -356,26 +629,50 @@ int msCSVJoinConnect(layerObj *layer, joinObj *join)
     }
   }
 
-  /* once through to get the number of rows */
-  joininfo->numrows = 0;
-  while(fgets(buffer, MS_BUFFER_LENGTH, stream) != NULL) joininfo->numrows++;
-  rewind(stream);
+  /* get "to" index (for now the user tells us which column, 1..n) */
+  joininfo->toindex = atoi(join->to) - 1;
 
-  if((joininfo->rows = (char ***) malloc(joininfo->numrows*sizeof(char **))) == NULL) {
-    fclose(stream);
-    msSetError(MS_MEMERR, "Error allocating rows.", "msCSVJoinConnect()");
-    return(MS_FAILURE);
-  }
+  /* reuse the rows and index loaded by a previous join */
+  if(msJoinTableKey(stream, key) == MS_SUCCESS)
+    joininfo->table = msJoinTableAcquire(szPath, MS_DB_CSV, joininfo->toindex, key);
+  else
+    key[0] = -1;
+
+  if(!joininfo->table) {
+    table = joininfo->table = msJoinTableCreate(szPath, MS_DB_CSV, joininfo->toindex);
 
-  /* load the rows */
-  i = 0;
-  while(fgets(buffer, MS_BUFFER_LENGTH, stream) != NULL) {
-    msStringTrimEOL(buffer);
-    joininfo->rows[i] = msStringSplitComplex(buffer, ",", &(join->numitems), MS_ALLOWEMPTYTOKENS);
-    i++;
+    /* once through to get the number of rows */
+    while(fgets(buffer, MS_BUFFER_LENGTH, stream) != NULL) table->numrows++;
+    rewind(stream);
+
+    table->rows = (char ***) malloc(table->numrows*sizeof(char **));
+    if(table->numrows > 0 && table->rows == NULL) {
+      table->numrows = 0;
+      fclose(stream);
+      msSetError(MS_MEMERR, "Error allocating rows.", "msCSVJoinConnect()");
+      return(MS_FAILURE);
+    }
+
+    /* load the rows */
+    i = 0;
+    while(i < table->numrows && fgets(buffer, MS_BUFFER_LENGTH, stream) != NULL) {
+      int numitems;
+      msStringTrimEOL(buffer);
+      table->rows[i] = msStringSplitComplex(buffer, ",", &numitems, MS_ALLOWEMPTYTOKENS);
+      table->numitems = numitems;
+      if(joininfo->toindex >= 0 && joininfo->toindex < numitems)
+        msJoinTableIndexAdd(table, table->rows[i][joininfo->toindex], i);
+      i++;
+    }
+    table->numrows = i;
+
+    if(key[0] != -1)
+      joininfo->table = msJoinTableCache(table, key);
   }
   fclose(stream);
 
+  join->numitems = joininfo->table->numitems;
+
   /* get "from" item index   */
   for(i=0; i<layer->numitems; i++) {
     if(strcasecmp(layer->items[i],join->from) == 0) { /* found it */
@@ -389,8 +686,6 @@ int msCSVJoinConnect(layerObj *layer, joinObj *join)
     return(MS_FAILURE);
   }
 
-  /* get "to" index (for now the user tells us which column, 1..n) */
-  joininfo->toindex = atoi(join->to) - 1;
   if(joininfo->toindex < 0 || joininfo->toindex > join->numitems) {
     msSetError(MS_JOINERR, "Invalid column index %s.", "msCSVJoinConnect()", join->to);
     return(MS_FAILURE);
@@ -428,11 +723,12 @@ int msCSVJoinPrepare(joinObj *join, shapeObj *shape)
     return(MS_FAILURE);
   }
 
-  joininfo->nextrow = 0; /* starting with the first record */
-
   if(joininfo->target) free(joininfo->target); /* clear last target */
   joininfo->target = msStrdup(shape->values[joininfo->fromindex]);
 
+  joininfo->match = msJoinTableLookup(joininfo->table, joininfo->target);
+  joininfo->nextmatch = 0; /* starting with the first record */
+
   return(MS_SUCCESS);
 }
 
@@ -452,41 +748,35 @@ int msCSVJoinNext(joinObj *join)
     join->values = NULL;
   }
 
-  for(i=joininfo->nextrow; i<joininfo->numrows; i++) { /* find a match     */
-    if(strcmp(joininfo->target, joininfo->rows[i][joininfo->toindex]) == 0) break;
-  }
-
   if((join->values = (char ** )malloc(sizeof(char *)*join->numitems)) == NULL) {
     msSetError(MS_MEMERR, NULL, "msCSVJoinNext()");
     return(MS_FAILURE);
   }
 
-  if(i == joininfo->numrows) { /* unable to do the join     */
+  if(!joininfo->match || joininfo->nextmatch >= joininfo->match->numrecords) { /* unable to do the join     */
     for(j=0; j<join->numitems; j++)
       join->values[j] = msStrdup("\0"); /* intialize to zero length strings */
 
-    joininfo->nextrow = joininfo->numrows;
+    joininfo->match = NULL;
     return(MS_DONE);
   }
 
+  i = joininfo->match->records[joininfo->nextmatch];
   for(j=0; j<join->numitems; j++)
-    join->values[j] = msStrdup(joininfo->rows[i][j]);
+    join->values[j] = msStrdup(joininfo->table->rows[i][j]);
 
-  joininfo->nextrow = i+1; /* so we know where to start looking next time through */
+  joininfo->nextmatch++; /* so we know where to start looking next time through */
 
   return(MS_SUCCESS);
 }
 
 int msCSVJoinClose(joinObj *join)
 {
-  int i;
   msCSVJoinInfo *joininfo = join->joininfo;
 
   if(!joininfo) return(MS_SUCCESS); /* already closed */
 
-  for(i=0; i<joininfo->numrows; i++)
-    msFreeCharArray(joininfo->rows[i], join->numitems);
-  free(joininfo->rows);
+  msJoinTableRelease(joininfo->table);
   if(joininfo->target) free(joininfo->target);
   free(joininfo);
   joininfo = NULL;
@@ -649,21 +649,27 @@ void KmlRenderer::renderPolygon(imageObj*, shapeObj *p, colorObj *color)
 void KmlRenderer::addCoordsNode(xmlNodePtr parentNode, pointObj *pts, int numPts)
 {
   char lineBuf[128];
+  char xBuf[64], yBuf[64], zBuf[64];
 
   xmlNodePtr coordsNode = xmlNewChild(parentNode, NULL, BAD_CAST "coordinates", NULL);
   xmlNodeAddContent(coordsNode, BAD_CAST "\n");
 
+  /* msFormatDouble() with 8 decimals is "%.8f" without the printf() cost */
   for (int i=0; i<numPts; i++) {
+    msFormatDouble(xBuf, sizeof(xBuf), pts[i].x, 8);
+    msFormatDouble(yBuf, sizeof(yBuf), pts[i].y, 8);
     if( mElevationFromAttribute ) {
-      sprintf(lineBuf, "\t%.8f,%.8f,%.8f\n", pts[i].x, pts[i].y, mCurrentElevationValue);
+      msFormatDouble(zBuf, sizeof(zBuf), mCurrentElevationValue, 8);
+      snprintf(lineBuf, sizeof(lineBuf), "\t%s,%s,%s\n", xBuf, yBuf, zBuf);
     } else if (AltitudeMode == relativeToGround || AltitudeMode == absolute) {
 #ifdef USE_POINT_Z_M
-      sprintf(lineBuf, "\t%.8f,%.8f,%.8f\n", pts[i].x, pts[i].y, pts[i].z);
+      msFormatDouble(zBuf, sizeof(zBuf), pts[i].z, 8);
+      snprintf(lineBuf, sizeof(lineBuf), "\t%s,%s,%s\n", xBuf, yBuf, zBuf);
 #else
       msSetError(MS_MISCERR, "Z coordinates support not available  (mapserver not compiled with USE_POINT_Z_M option)", "KmlRenderer::addCoordsNode()");
 #endif
     } else
-      sprintf(lineBuf, "\t%.8f,%.8f\n", pts[i].x, pts[i].y);
+      snprintf(lineBuf, sizeof(lineBuf), "\t%s,%s\n", xBuf, yBuf);
 
     xmlNodeAddContent(coordsNode, BAD_CAST lineBuf);
   }
@@ -852,16 +858,16 @@ xmlNodePtr KmlRenderer::createGroundOverlayNode(xmlNodePtr parentNode, char *ima
     mapextent = currentLayer->map->extent;
 
   xmlNodePtr latLonBoxNode = xmlNewChild(groundOverlayNode, NULL, BAD_CAST "LatLonBox", NULL);
-  sprintf(crdStr, "%.8f", mapextent.maxy);
+  msFormatDouble(crdStr, sizeof(crdStr), mapextent.maxy, 8);
   xmlNewChild(latLonBoxNode, NULL, BAD_CAST "north", BAD_CAST crdStr);
 
-  sprintf(crdStr, "%.8f", mapextent.miny);
+  msFormatDouble(crdStr, sizeof(crdStr), mapextent.miny, 8);
   xmlNewChild(latLonBoxNode, NULL, BAD_CAST "south", BAD_CAST crdStr);
 
-  sprintf(crdStr, "%.8f", mapextent.minx);
+  msFormatDouble(crdStr, sizeof(crdStr), mapextent.minx, 8);
   xmlNewChild(latLonBoxNode, NULL, BAD_CAST "west", BAD_CAST crdStr);
 
-  sprintf(crdStr, "%.8f", mapextent.maxx);
+  msFormatDouble(crdStr, sizeof(crdStr), mapextent.maxx, 8);
   xmlNewChild(latLonBoxNode, NULL, BAD_CAST "east", BAD_CAST crdStr);
 
   xmlNewChild(latLonBoxNode, NULL, BAD_CAST "rotation", BAD_CAST "0.0");
@@ -567,7 +567,206 @@ static int labelInImage(int width, int height, lineObj *lpoly, rectObj *bounds,
   return(MS_TRUE);
 }
 
+/*
+** Label cache index: a uniform grid over the image holding the rendered
+** labels and the markers of each priority slot, so that collision tests
+** only look at the label cache members whose bounds share a cell with the
+** tested bounds instead of all of them. Bounds outside of the image are
+** clamped to the border cells, bounds that can't be placed (inverted or
+** NaN) are kept in an overflow list that is always tested.
+*/
+#define MS_LABELCACHE_GRID_CELLSIZE 64
+#define MS_LABELCACHE_GRID_MAXCELLS 64 /* per dimension */
+
+typedef struct {
+  int *items;
+  int numitems;
+  int maxitems;
+} labelGridCell;
+
+typedef struct {
+  labelGridCell *cells; /* ncols*nrows, allocated on first insert */
+  labelGridCell overflow;
+  int numitems; /* items are numbered 0..numitems-1 */
+  unsigned int *stamps; /* per item, to report each candidate only once */
+  int numstamps;
+  unsigned int stamp;
+} labelGrid;
+
+struct labelCacheIndex {
+  int ncols, nrows;
+  double cellwidth, cellheight;
+  labelGrid rendered; /* items are indexes in rendered_text_symbols */
+  labelGrid markers[MS_MAX_LABEL_PRIORITY]; /* items are indexes in the slot markers */
+  int nummarkers[MS_MAX_LABEL_PRIORITY]; /* markers of each slot already in the grid */
+  int *candidates;
+  int maxcandidates;
+};
+
+static void labelGridCellAdd(labelGridCell *cell, int item)
+{
+  if(cell->numitems == cell->maxitems) {
+    cell->maxitems = cell->maxitems ? cell->maxitems * 2 : 8;
+    cell->items = msSmallRealloc(cell->items, cell->maxitems * sizeof(int));
+  }
+  cell->items[cell->numitems++] = item;
+}
+
+static void labelGridFree(struct labelCacheIndex *index, labelGrid *grid)
+{
+  int i;
+  if(grid->cells) {
+    for(i=0; i<index->ncols*index->nrows; i++)
+      msFree(grid->cells[i].items);
+    msFree(grid->cells);
+  }
+  msFree(grid->overflow.items);
+  msFree(grid->stamps);
+  memset(grid, 0, sizeof(labelGrid));
+}
+
+static int labelGridCellIndex(double v, double cellsize, int ncells)
+{
+  if(!(v > 0)) return 0;
+  v /= cellsize;
+  if(v >= ncells) return ncells - 1;
+  return (int)v;
+}
+
+/* returns MS_FALSE if rect can't be mapped to grid cells */
+static int labelGridRange(const struct labelCacheIndex *index, const rectObj *rect,
+                          int *mincol, int *maxcol, int *minrow, int *maxrow)
+{
+  if(!(rect->minx <= rect->maxx && rect->miny <= rect->maxy))
+    return MS_FALSE;
+  *mincol = labelGridCellIndex(rect->minx, index->cellwidth, index->ncols);
+  *maxcol = labelGridCellIndex(rect->maxx, index->cellwidth, index->ncols);
+  *minrow = labelGridCellIndex(rect->miny, index->cellheight, index->nrows);
+  *maxrow = labelGridCellIndex(rect->maxy, index->cellheight, index->nrows);
+  return MS_TRUE;
+}
+
+static void labelGridInsert(struct labelCacheIndex *index, labelGrid *grid, const rectObj *rect, int item)
+{
+  int mincol, maxcol, minrow, maxrow, col, row;
+
+  if(item >= grid->numitems)
+    grid->numitems = item + 1;
+  if(item >= grid->numstamps) {
+    int numstamps = MS_MAX(item + 1, grid->numstamps * 2);
+    grid->stamps = msSmallRealloc(grid->stamps, numstamps * sizeof(unsigned int));
+    memset(grid->stamps + grid->numstamps, 0, (numstamps - grid->numstamps) * sizeof(unsigned int));
+    grid->numstamps = numstamps;
+  }
+
+  if(!labelGridRange(index, rect, &mincol, &maxcol, &minrow, &maxrow)) {
+    labelGridCellAdd(&grid->overflow, item);
+    return;
+  }
+  if(!grid->cells)
+    grid->cells = msSmallCalloc(index->ncols * index->nrows, sizeof(labelGridCell));
+  for(row=minrow; row<=maxrow; row++)
+    for(col=mincol; col<=maxcol; col++)
+      labelGridCellAdd(&grid->cells[row * index->ncols + col], item);
+}
+
+static void labelGridAddCandidate(struct labelCacheIndex *index, labelGrid *grid, int item, int *numcandidates)
+{
+  if(grid->stamps[item] == grid->stamp)
+    return;
+  grid->stamps[item] = grid->stamp;
+  if(*numcandidates == index->maxcandidates) {
+    index->maxcandidates = index->maxcandidates ? index->maxcandidates * 2 : 64;
+    index->candidates = msSmallRealloc(index->candidates, index->maxcandidates * sizeof(int));
+  }
+  index->candidates[(*numcandidates)++] = item;
+}
+
+/*
+** Collects in index->candidates the items of the grid that may overlap rect
+** (every item whose bounds overlap rect is included) and returns their number.
+*/
+static int labelGridQuery(struct labelCacheIndex *index, labelGrid *grid, const rectObj *rect)
+{
+  int mincol, maxcol, minrow, maxrow, col, row, i, numcandidates = 0;
+
+  if(!labelGridRange(index, rect, &mincol, &maxcol, &minrow, &maxrow)) {
+    /* can't be looked up, test all items */
+    if(grid->numitems > index->maxcandidates) {
+      index->maxcandidates = grid->numitems;
+      index->candidates = msSmallRealloc(index->candidates, index->maxcandidates * sizeof(int));
+    }
+    for(i=0; i<grid->numitems; i++)
+      index->candidates[i] = i;
+    return grid->numitems;
+  }
+
+  if(++grid->stamp == 0) { /* wrapped around */
+    memset(grid->stamps, 0, grid->numstamps * sizeof(unsigned int));
+    grid->stamp = 1;
+  }
+
+  for(i=0; i<grid->overflow.numitems; i++)
+    labelGridAddCandidate(index, grid, grid->overflow.items[i], &numcandidates);
+  if(grid->cells) {
+    for(row=minrow; row<=maxrow; row++) {
+      for(col=mincol; col<=maxcol; col++) {
+        labelGridCell *cell = &grid->cells[row * index->ncols + col];
+        for(i=0; i<cell->numitems; i++)
+          labelGridAddCandidate(index, grid, cell->items[i], &numcandidates);
+      }
+    }
+  }
+  return numcandidates;
+}
+
+static struct labelCacheIndex *msGetLabelCacheIndex(mapObj *map)
+{
+  struct labelCacheIndex *index = map->labelcache.index;
+  if(!index) {
+    int width = MS_MAX(map->width, 1), height = MS_MAX(map->height, 1);
+    index = msSmallCalloc(1, sizeof(struct labelCacheIndex));
+    index->ncols = MS_MIN(MS_LABELCACHE_GRID_MAXCELLS, (width + MS_LABELCACHE_GRID_CELLSIZE - 1) / MS_LABELCACHE_GRID_CELLSIZE);
+    index->nrows = MS_MIN(MS_LABELCACHE_GRID_MAXCELLS, (height + MS_LABELCACHE_GRID_CELLSIZE - 1) / MS_LABELCACHE_GRID_CELLSIZE);
+    index->cellwidth = (double)width / index->ncols;
+    index->cellheight = (double)height / index->nrows;
+    map->labelcache.index = index;
+  }
+  return index;
+}
+
+/* brings the marker grid of a priority slot up to date with the slot */
+static labelGrid *msGetLabelCacheMarkerGrid(mapObj *map, int priority)
+{
+  struct labelCacheIndex *index = msGetLabelCacheIndex(map);
+  labelCacheSlotObj *markerslot = &(map->labelcache.slots[priority]);
+  labelGrid *grid = &(index->markers[priority]);
+
+  if(markerslot->nummarkers < index->nummarkers[priority]) { /* slot was reset */
+    labelGridFree(index, grid);
+    index->nummarkers[priority] = 0;
+  }
+  for(; index->nummarkers[priority] < markerslot->nummarkers; index->nummarkers[priority]++)
+    labelGridInsert(index, grid, &markerslot->markers[index->nummarkers[priority]].bounds, index->nummarkers[priority]);
+  return grid;
+}
+
+void msFreeLabelCacheIndex(labelCacheObj *cache)
+{
+  struct labelCacheIndex *index = cache->index;
+  int p;
+  if(!index) return;
+  labelGridFree(index, &index->rendered);
+  for(p=0; p<MS_MAX_LABEL_PRIORITY; p++)
+    labelGridFree(index, &index->markers[p]);
+  msFree(index->candidates);
+  msFree(index);
+  cache->index = NULL;
+}
+
 void insertRenderedLabelMember(mapObj *map, labelCacheMemberObj *cachePtr) {
+  rectObj bounds;
+
   if(map->labelcache.num_rendered_members == map->labelcache.num_allocated_rendered_members) {
     if(map->labelcache.num_rendered_members == 0) {
       map->labelcache.num_allocated_rendered_members = 50;
@@ -577,6 +776,17 @@ void insertRenderedLabelMember(mapObj *map, labelCacheMemberObj *cachePtr) {
     map->labelcache.rendered_text_symbols = msSmallRealloc(map->labelcache.rendered_text_symbols,
             map->labelcache.num_allocated_rendered_members * sizeof(labelCacheMemberObj*));
   }
+
+  /* the leader line is tested even when it lies outside of the label bbox */
+  bounds = cachePtr->bbox;
+  if(cachePtr->leaderbbox && bounds.minx <= bounds.maxx && bounds.miny <= bounds.maxy) {
+    bounds.minx = MS_MIN(bounds.minx, cachePtr->leaderbbox->minx);
+    bounds.miny = MS_MIN(bounds.miny, cachePtr->leaderbbox->miny);
+    bounds.maxx = MS_MAX(bounds.maxx, cachePtr->leaderbbox->maxx);
+    bounds.maxy = MS_MAX(bounds.maxy, cachePtr->leaderbbox->maxy);
+  }
+  labelGridInsert(msGetLabelCacheIndex(map), &(map->labelcache.index->rendered), &bounds, map->labelcache.num_rendered_members);
+
   map->labelcache.rendered_text_symbols[map->labelcache.num_rendered_members++] = cachePtr;
 }
 
@@ -621,14 +831,16 @@ static inline int testSegmentLabelBBoxIntersection(const rectObj *leaderbbox, co
 }
 
 int msTestLabelCacheLeaderCollision(mapObj *map, pointObj *lp1, pointObj *lp2) {
-  int p;
+  int c, numcandidates;
   rectObj leaderbbox;
+  struct labelCacheIndex *index = msGetLabelCacheIndex(map);
   leaderbbox.minx = MS_MIN(lp1->x,lp2->x);
   leaderbbox.maxx = MS_MAX(lp1->x,lp2->x);
   leaderbbox.miny = MS_MIN(lp1->y,lp2->y);
   leaderbbox.maxy = MS_MAX(lp1->y,lp2->y);
-  for(p=0; p<map->labelcache.num_rendered_members; p++) {
-    labelCacheMemberObj *curCachePtr= map->labelcache.rendered_text_symbols[p];
+  numcandidates = labelGridQuery(index, &index->rendered, &leaderbbox);
+  for(c=0; c<numcandidates; c++) {
+    labelCacheMemberObj *curCachePtr= map->labelcache.rendered_text_symbols[index->candidates[c]];
     if(msRectOverlap(&leaderbbox, &(curCachePtr->bbox))) {
     /* leaderbbox interesects with the curCachePtr's global bbox */
       int t;
@@ -674,7 +886,8 @@ int msTestLabelCacheCollisions(mapObj *map, labelCacheMemberObj *cachePtr, label
         int current_priority, int current_label)
 {
   labelCacheObj *labelcache = &(map->labelcache);
-  int i, p, ll;
+  struct labelCacheIndex *index = msGetLabelCacheIndex(map);
+  int i, p, c, numcandidates;
 
   /*
    * Check against image bounds first
@@ -692,7 +905,9 @@ int msTestLabelCacheCollisions(mapObj *map, labelCacheMemberObj *cachePtr, label
     labelCacheSlotObj *markerslot;
     markerslot = &(labelcache->slots[p]);
 
-    for ( ll = 0; ll < markerslot->nummarkers; ll++ ) {
+    numcandidates = labelGridQuery(index, msGetLabelCacheMarkerGrid(map, p), &lb->bbox);
+    for ( c = 0; c < numcandidates; c++ ) {
+      int ll = index->candidates[c];
       if ( !(p == current_priority && current_label == markerslot->markers[ll].id ) ) {  /* labels can overlap their own marker */
         if ( intersectLabelPolygons(NULL, &markerslot->markers[ll].bounds, lb->poly, &lb->bbox ) == MS_TRUE ) {
           return MS_FALSE;
@@ -701,8 +916,9 @@ int msTestLabelCacheCollisions(mapObj *map, labelCacheMemberObj *cachePtr, label
     }
   }
 
-  for(p=0; p<labelcache->num_rendered_members; p++) {
-    labelCacheMemberObj *curCachePtr= labelcache->rendered_text_symbols[p];
+  numcandidates = labelGridQuery(index, &index->rendered, &lb->bbox);
+  for(c=0; c<numcandidates; c++) {
+    labelCacheMemberObj *curCachePtr= labelcache->rendered_text_symbols[index->candidates[c]];
     if(msRectOverlap(&curCachePtr->bbox,&lb->bbox)) {
       for(i=0; i<curCachePtr->numtextsymbols; i++) {
         int j;
@@ -967,6 +967,9 @@ int msLayerWhichItems(layerObj *layer, int get_all, const char *metadata)
       msTokenizeExpression(&(layer->class[i]->text), layer->items, &(layer->numitems));
   }
 
+  /* classitem value lookup */
+  msLayerBuildClassIndex(layer);
+
   /* layer filter */
   if(layer->filter.type == MS_EXPRESSION) msTokenizeExpression(&(layer->filter), layer->items, &(layer->numitems));
 
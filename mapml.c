@@ -40,28 +40,197 @@
 #include "maplibxml2.h"
 #endif
 
+#include <sys/stat.h>
+
 /* 
- * Utility function to output MapML doc via msIO
+ * Utility function to serialize a MapML doc, to be freed by the caller
  */
 
-static int _msIO_MapMLDump(FILE *fp, xmlDocPtr psDoc)
+static char *_msMapMLDumpToString(xmlDocPtr psDoc)
 {
-  int status = MS_SUCCESS;
+  char *pszContent = NULL;
 
   /* Note: we want to avoid the <?xml declaration in the output, 
    * so we dump the root node instead of the document itself */
   xmlBufferPtr buf = xmlBufferCreate();
   if (xmlNodeDump(buf, psDoc, xmlDocGetRootElement(psDoc), 0, 1) > 0) {
-    msIO_printf("%s\n", buf->content);
+    pszContent = msStrdup((const char *) xmlBufferContent(buf));
   }
   else {
-    // TODO: Produce an exception
-    msSetError(MS_WMSERR, "Writing MapML XML output failed.", "_msIO_MapMLDump()");
-    status = MS_FAILURE;
+    msSetError(MS_WMSERR, "Writing MapML XML output failed.", "_msMapMLDumpToString()");
   }
   xmlBufferFree (buf);
 
-  return status;
+  return pszContent;
+}
+
+#ifdef USE_MAPML
+/*
+ * In-process cache of GetMapML layer documents, useful to FastCGI and other
+ * long running processes. It is enabled by the "mapml_cache" web metadata.
+ * Documents are keyed on the mapfile and its modification time, the online
+ * resource and the request parameters, and evicted in LRU order. Files the
+ * mapfile INCLUDEs, and its symbolset and fontset, are not part of the key:
+ * touch the mapfile (or restart) after editing them.
+ */
+#define MAPML_CACHE_SIZE 64
+
+typedef struct {
+  char *key;
+  char *content;
+  char etag[19]; /* quoted 64 bits hash of the content */
+  unsigned long last_use;
+} mapmlCacheEntry;
+
+static mapmlCacheEntry mapml_cache[MAPML_CACHE_SIZE];
+static unsigned long mapml_cache_clock = 0;
+
+static void msMapMLComputeETag(const char *content, char *etag)
+{
+  unsigned long long hash = 14695981039346656037ULL; /* FNV-1a */
+  const unsigned char *c;
+
+  for (c = (const unsigned char *) content; *c; c++)
+    hash = (hash ^ *c) * 1099511628211ULL;
+  snprintf(etag, 19, "\"%016llx\"", hash);
+}
+
+/*
+ * Return the cache key of this request, or NULL if the cache is disabled
+ * or the mapfile cannot be found.
+ */
+static char *msMapMLCacheKey(mapObj *map, cgiRequestObj *req, const char *script_url, const char *pszService)
+{
+  const char *value, *mapfile = NULL;
+  msStringBuffer *key;
+  struct stat sb;
+  char szMTime[64];
+  int i;
+
+  value = msLookupHashTable(&(map->web.metadata), "mapml_cache");
+  if (value == NULL || !(EQUAL(value, "true") || EQUAL(value, "on") || EQUAL(value, "1")))
+    return NULL;
+
+  /* same rules as msCGILoadMap() */
+  for (i = 0; i < req->NumParams; i++) {
+    if (strcasecmp(req->ParamNames[i], "MAP") == 0) {
+      mapfile = getenv(req->ParamValues[i]) ? getenv(req->ParamValues[i]) : req->ParamValues[i];
+      break;
+    }
+  }
+  if (mapfile == NULL)
+    mapfile = getenv("MS_MAPFILE");
+  if (mapfile == NULL || stat(mapfile, &sb) != 0)
+    return NULL;
+  snprintf(szMTime, sizeof(szMTime), "%ld", (long) sb.st_mtime);
+
+  /* all parameters are part of the key, as they may also modify the map */
+  key = msStringBufferAlloc();
+  msStringBufferAppend(key, mapfile);
+  msStringBufferAppend(key, "\n");
+  msStringBufferAppend(key, szMTime);
+  msStringBufferAppend(key, "\n");
+  msStringBufferAppend(key, pszService);
+  msStringBufferAppend(key, "\n");
+  msStringBufferAppend(key, script_url);
+  for (i = 0; i < req->NumParams; i++) {
+    msStringBufferAppend(key, "\n");
+    msStringBufferAppend(key, req->ParamNames[i]);
+    msStringBufferAppend(key, "=");
+    msStringBufferAppend(key, req->ParamValues[i]);
+  }
+
+  return msStringBufferReleaseStringAndFree(key);
+}
+
+/* Look up a document, returning a copy of it to be freed by the caller */
+static char *msMapMLCacheLookup(const char *key, char *etag)
+{
+  char *content = NULL;
+  int i;
+
+  msAcquireLock(TLOCK_MAPML);
+  for (i = 0; i < MAPML_CACHE_SIZE; i++) {
+    if (mapml_cache[i].key && strcmp(mapml_cache[i].key, key) == 0) {
+      mapml_cache[i].last_use = ++mapml_cache_clock;
+      content = msStrdup(mapml_cache[i].content);
+      strcpy(etag, mapml_cache[i].etag);
+      break;
+    }
+  }
+  msReleaseLock(TLOCK_MAPML);
+
+  return content;
+}
+
+static void msMapMLCacheInsert(const char *key, const char *content, const char *etag)
+{
+  int i, slot = 0;
+
+  msAcquireLock(TLOCK_MAPML);
+  for (i = 0; i < MAPML_CACHE_SIZE; i++) {
+    if (mapml_cache[i].key == NULL || strcmp(mapml_cache[i].key, key) == 0) {
+      slot = i;
+      break;
+    }
+    if (mapml_cache[i].last_use < mapml_cache[slot].last_use)
+      slot = i;
+  }
+  msFree(mapml_cache[slot].key);
+  msFree(mapml_cache[slot].content);
+  mapml_cache[slot].key = msStrdup(key);
+  mapml_cache[slot].content = msStrdup(content);
+  strcpy(mapml_cache[slot].etag, etag);
+  mapml_cache[slot].last_use = ++mapml_cache_clock;
+  msReleaseLock(TLOCK_MAPML);
+}
+
+/*
+ * Send a layer document, or just a 304 status if the client already has
+ * it according to the If-None-Match header.
+ */
+static void msMapMLWriteLayerDocument(FILE *fp, const char *content, const char *etag)
+{
+  const char *if_none_match = getenv("HTTP_IF_NONE_MATCH");
+
+  if (if_none_match && (strstr(if_none_match, etag) != NULL || strcmp(if_none_match, "*") == 0)) {
+    msIO_setHeader("Status", "304 Not Modified");
+    msIO_setHeader("ETag", "%s", etag);
+    msIO_setHeader("Access-Control-Allow-Origin","*");
+    msIO_sendHeaders();
+    return;
+  }
+
+  msIO_setHeader("Content-Type","text/mapml");
+  msIO_setHeader("Access-Control-Allow-Origin","*");
+  msIO_setHeader("ETag", "%s", etag);
+  msIO_sendHeaders();
+
+  msIO_fprintf(fp, "%s\n", content);
+}
+#endif /* USE_MAPML */
+
+/*
+** msMapMLCleanup()
+**
+** Free the GetMapML document cache, called by msCleanup().
+*/
+void msMapMLCleanup(void)
+{
+#ifdef USE_MAPML
+  int i;
+
+  msAcquireLock(TLOCK_MAPML);
+  for (i = 0; i < MAPML_CACHE_SIZE; i++) {
+    msFree(mapml_cache[i].key);
+    msFree(mapml_cache[i].content);
+    mapml_cache[i].key = NULL;
+    mapml_cache[i].content = NULL;
+    mapml_cache[i].last_use = 0;
+  }
+  mapml_cache_clock = 0;
+  msReleaseLock(TLOCK_MAPML);
+#endif
 }
 
 /* 
@@ -257,6 +426,9 @@ int msWriteMapMLLayer(FILE *fp, mapObj *map, cgiRequestObj *req, owsRequestObj *
 
   projectionObj proj;
   rectObj ext;
+
+  char *pszCacheKey = NULL, *pszContent = NULL;
+  char szETag[19];
   
   /* We need this server's onlineresource. It will come with the trailing "?" or "&" */
   /* the returned string should be freed once we're done with it. */
@@ -291,6 +463,18 @@ int msWriteMapMLLayer(FILE *fp, mapObj *map, cgiRequestObj *req, owsRequestObj *
     return MS_FAILURE;
   }
 
+  /* Serve the document from the cache if we can, the key is kept to store it otherwise */
+  if ((pszCacheKey = msMapMLCacheKey(map, req, script_url, pszService)) != NULL) {
+    pszContent = msMapMLCacheLookup(pszCacheKey, szETag);
+    if (pszContent) {
+      msMapMLWriteLayerDocument(fp, pszContent, szETag);
+      msFree(pszContent);
+      msFree(pszCacheKey);
+      msFree(script_url);
+      return MS_SUCCESS;
+    }
+  }
+
 
   /* Look for requested layer. we check for layer's and group's name */
   /* as well as wms_layer_group names */
@@ -327,12 +511,15 @@ int msWriteMapMLLayer(FILE *fp, mapObj *map, cgiRequestObj *req, owsRequestObj *
   if (nLayers != 1) {
     msSetError(MS_WMSERR, "Invalid layer given in the LAYER parameter. A layer might be disabled for \
 this request. Check wms/ows_enable_request settings.", "msWriteMapMLLayer()");
+    msFree(pszCacheKey);
     return MS_FAILURE;
   }
   
   /* Validate MapML PROJECTION and map it to WMS CRS (EPSG code) */
-  if ((pszCRS = msIsMapMLProjectionEnabled(map, lp, pszNamespaces, pszProjection, FALSE)) == NULL)
+  if ((pszCRS = msIsMapMLProjectionEnabled(map, lp, pszNamespaces, pszProjection, FALSE)) == NULL) {
+    msFree(pszCacheKey);
     return MS_FAILURE; // msSetError already called
+  }
 
   /* Fetch and reproject layer extent to requested CRS */
   // TODO: For now just using map extent... need to look up layer/group extent if applicable
@@ -340,6 +527,7 @@ this request. Check wms/ows_enable_request settings.", "msWriteMapMLLayer()");
   msInitProjection(&proj);
   if (msLoadProjectionStringEPSG(&proj, pszCRS) != 0) {
     /* Failed to load projection, msSetError shoudlshould already have been called */
+    msFree(pszCacheKey);
     return MS_FAILURE;
   }
   if (msProjectionsDiffer(&(map->projection), &proj) == MS_TRUE) {
@@ -417,6 +605,7 @@ this request. Check wms/ows_enable_request settings.", "msWriteMapMLLayer()");
    *  - image: (the default) produces full page WMS GetMap images
    *  - tile: produces link-rel = tile with tiled WMS GetMap requests
    *  - cgitile: produces mode=tile mapserv CGI requests
+   *  - featuretile: produces link-rel = tile with tiled WMS GetMap requests returning MapML features
    *  - features: produces link-ref=features pointing to WFS GetFeature 
    */
   if (pszMapMLMode == NULL)
@@ -432,8 +621,10 @@ this request. Check wms/ows_enable_request settings.", "msWriteMapMLLayer()");
   /* <extent> */
   xmlNodePtr psMapMLExtent = _xmlNewChild1Prop(psMapMLBody, "map-extent", NULL, "units", pszProjection);
 
-  if (EQUAL(pszMapMLMode, "tile")) {
+  if (EQUAL(pszMapMLMode, "tile") || EQUAL(pszMapMLMode, "featuretile")) {
     // MAPML TILE mode: Serve requested layer as tiled WMS GetMap requests
+    // MAPML FEATURETILE mode: the same, as MapML vector tiles (WMS GetMap
+    // requests using an output format with the MAPML driver, see msMapMLWriteTile())
     // TODO: Should we allow this mode with WGS84?
     
     psNode = _xmlNewChild5Prop(psMapMLExtent, "map-input", NULL, "name", "txmin", "type", "location", "units", "tilematrix", "position", "top-left", "axis", "easting");
@@ -458,8 +649,13 @@ this request. Check wms/ows_enable_request settings.", "msWriteMapMLLayer()");
       pszBBOX = "{tymin},{txmin},{tymax},{txmax}";
 
     /* GetMap URL */
-    pszVal1 = CPLSPrintf("%sSERVICE=WMS&REQUEST=GetMap&FORMAT=%s&TRANSPARENT=TRUE&VERSION=1.3.0&LAYERS=%s&STYLES=%s&WIDTH=256&HEIGHT=256&CRS=%s&BBOX=%s&m4h=t", script_url, pszImageFormat, pszLayer, pszStyle, pszCRS, pszBBOX);
-    psNode = _xmlNewChild2Prop(psMapMLExtent, "map-link", NULL, "rel", "tile", "tref", pszVal1);
+    if (EQUAL(pszMapMLMode, "featuretile")) {
+      pszVal1 = CPLSPrintf("%sSERVICE=WMS&REQUEST=GetMap&FORMAT=text/mapml&VERSION=1.3.0&LAYERS=%s&STYLES=%s&WIDTH=256&HEIGHT=256&CRS=%s&BBOX=%s&m4h=t", script_url, pszLayer, pszStyle, pszCRS, pszBBOX);
+      psNode = _xmlNewChild3Prop(psMapMLExtent, "map-link", NULL, "rel", "tile", "type", "text/mapml", "tref", pszVal1);
+    } else {
+      pszVal1 = CPLSPrintf("%sSERVICE=WMS&REQUEST=GetMap&FORMAT=%s&TRANSPARENT=TRUE&VERSION=1.3.0&LAYERS=%s&STYLES=%s&WIDTH=256&HEIGHT=256&CRS=%s&BBOX=%s&m4h=t", script_url, pszImageFormat, pszLayer, pszStyle, pszCRS, pszBBOX);
+      psNode = _xmlNewChild2Prop(psMapMLExtent, "map-link", NULL, "rel", "tile", "tref", pszVal1);
+    }
 
     // TODO: Add WMS GetFeatureInfo (share code with "image" case)
     
@@ -545,22 +741,29 @@ this request. Check wms/ows_enable_request settings.", "msWriteMapMLLayer()");
     
   }
    else {
-    msSetError(MS_WMSERR, "Requested MapML output mode not supported. Use one of image, tile, cgitile or features.", "msWriteMapMLLayer()");
+    msSetError(MS_WMSERR, "Requested MapML output mode not supported. Use one of image, tile, featuretile, cgitile or features.", "msWriteMapMLLayer()");
+    msFree(pszCacheKey);
     return msMapMLException(map, "InvalidRequest");
   }
   
 
   /* Generate output */
-  msIO_setHeader("Content-Type","text/mapml");
-  msIO_setHeader("Access-Control-Allow-Origin","*");
-  msIO_sendHeaders();
-
-  _msIO_MapMLDump(fp, psMapMLDoc);
+  pszContent = _msMapMLDumpToString(psMapMLDoc);
+  if (pszContent) {
+    msMapMLComputeETag(pszContent, szETag);
+    if (pszCacheKey)
+      msMapMLCacheInsert(pszCacheKey, pszContent, szETag);
+    msMapMLWriteLayerDocument(fp, pszContent, szETag);
+  }
  
   /* Cleanup */
   xmlFreeDoc(psMapMLDoc);
+  msFree(pszCacheKey);
   msFree(script_url);
   
+  if (!pszContent)
+    return MS_FAILURE;
+  msFree(pszContent);
   return MS_SUCCESS;
 #else
   msSetError(MS_WMSERR, "MapML support is not available.", "msWriteMapMLLayer()");
@@ -570,11 +773,257 @@ this request. Check wms/ows_enable_request settings.", "msWriteMapMLLayer()");
 
 
 
+#ifdef USE_MAPML
 /*
-** msWriteMapMLLayer()
+ * Buffered output for MapML query results: the document is assembled in a
+ * bufferObj that is written out through msIO in chunks of about
+ * MS_DEFAULT_BUFFER_ALLOC bytes, instead of one msIO call per line.
+ */
+
+static void _mapmlBufferFlush(FILE *fp, bufferObj *buffer)
+{
+  if (buffer->size > 0) {
+    msIO_fwrite(buffer->data, 1, buffer->size, fp);
+    buffer->size = 0;
+  }
+}
+
+static void _mapmlBufferFlushIfFull(FILE *fp, bufferObj *buffer)
+{
+  if (buffer->size >= MS_DEFAULT_BUFFER_ALLOC)
+    _mapmlBufferFlush(fp, buffer);
+}
+
+static void _mapmlBufferAppend(bufferObj *buffer, const char *str)
+{
+  msBufferAppend(buffer, (void*) str, strlen(str));
+}
+
+static void _mapmlBufferPrintf(bufferObj *buffer, const char *format, ...)
+{
+  va_list args;
+  int n;
+
+  va_start(args, format);
+  n = vsnprintf((char*) buffer->data + buffer->size, buffer->available - buffer->size, format, args);
+  va_end(args);
+  if (n < 0)
+    return;
+
+  if ((size_t) n >= buffer->available - buffer->size) {
+    /* not enough room, grow the buffer (keeping space for the '\0') and format again */
+    msBufferResize(buffer, buffer->size + n + 1);
+    va_start(args, format);
+    vsnprintf((char*) buffer->data + buffer->size, buffer->available - buffer->size, format, args);
+    va_end(args);
+  }
+  buffer->size += n;
+}
+
+/* Return the MapML PROJECTION name of the map CRS, or NULL */
+static const char *msMapMLGetProjectionName(projectionObj *proj)
+{
+  int i;
+
+  for (i = 0; i < proj->numargs; i++) {
+    const char *arg = proj->args[i];
+    if (strncasecmp(arg, "init=epsg:", 10) != 0)
+      continue;
+    arg += 10;
+    if (EQUAL(arg, "3857") || EQUAL(arg, "900913"))
+      return "OSMTILE";
+    if (EQUAL(arg, "3978"))
+      return "CBMTILE";
+    if (EQUAL(arg, "5936"))
+      return "APSTILE";
+    if (EQUAL(arg, "4326"))
+      return "WGS84";
+  }
+  return NULL;
+}
+
+/*
+ * Decimals written for coordinates in the CRS proj: 6 for geographic ones
+ * (about 10 cm at the equator), 2 (1 cm) for projected ones.
+ */
+static int _mapmlGetPrecision(projectionObj *proj)
+{
+  return msProjIsGeographicCRS(proj) ? 6 : 2;
+}
+
+/* Append the points of a line as a <map-coordinates> element, with precision decimals */
+static void _mapmlBufferAppendCoordinates(bufferObj *buffer, lineObj *line, int precision, const char *tab)
+{
+  int i;
+
+  _mapmlBufferPrintf(buffer, "%s<map-coordinates>", tab);
+  for (i = 0; i < line->numpoints; i++)
+    _mapmlBufferPrintf(buffer, i == 0 ? "%.*f %.*f" : " %.*f %.*f",
+                       precision, line->point[i].x, precision, line->point[i].y);
+  _mapmlBufferAppend(buffer, "</map-coordinates>\n");
+}
+
+/* Append a polygon made of the outer ring outer and its holes */
+static void _mapmlBufferAppendPolygon(bufferObj *buffer, shapeObj *shape, int outer, int *outerlist, int precision, const char *tab)
+{
+  int *innerlist;
+  int i;
+  char szTab[32];
+
+  snprintf(szTab, sizeof(szTab), "%s  ", tab);
+  _mapmlBufferPrintf(buffer, "%s<map-polygon>\n", tab);
+  _mapmlBufferAppendCoordinates(buffer, &(shape->line[outer]), precision, szTab);
+  innerlist = msGetInnerList(shape, outer, outerlist);
+  for (i = 0; i < shape->numlines; i++) {
+    if (innerlist[i] == MS_TRUE)
+      _mapmlBufferAppendCoordinates(buffer, &(shape->line[i]), precision, szTab);
+  }
+  free(innerlist);
+  _mapmlBufferPrintf(buffer, "%s</map-polygon>\n", tab);
+}
+
+static void _mapmlBufferAppendGeometryStart(bufferObj *buffer, const char *cs)
+{
+  if (cs)
+    _mapmlBufferPrintf(buffer, "        <map-geometry cs=\"%s\">\n", cs);
+  else
+    _mapmlBufferAppend(buffer, "        <map-geometry>\n");
+}
+
+/*
+ * Append the shape as a <map-geometry> element, using single geometries
+ * where possible and multi-geometries otherwise. cs is "gcrs" for
+ * geographic coordinates and "pcrs" for projected ones, or NULL if
+ * already declared in the document <map-head>.
+ */
+static void _mapmlBufferAppendGeometry(bufferObj *buffer, shapeObj *shape, const char *cs, int precision)
+{
+  int i, numpoints = 0, numouters = 0;
+  int *outerlist = NULL;
+
+  if (shape->numlines <= 0)
+    return;
+
+  switch (shape->type) {
+    case MS_SHAPE_POINT:
+      for (i = 0; i < shape->numlines; i++)
+        numpoints += shape->line[i].numpoints;
+      if (numpoints == 0)
+        return;
+      _mapmlBufferAppendGeometryStart(buffer, cs);
+      if (numpoints == 1) {
+        _mapmlBufferAppend(buffer, "          <map-point>\n");
+        _mapmlBufferAppendCoordinates(buffer, &(shape->line[0]), precision, "            ");
+        _mapmlBufferAppend(buffer, "          </map-point>\n");
+      } else {
+        _mapmlBufferAppend(buffer, "          <map-multipoint>\n");
+        _mapmlBufferAppend(buffer, "            <map-coordinates>");
+        numpoints = 0;
+        for (i = 0; i < shape->numlines; i++) {
+          int j;
+          for (j = 0; j < shape->line[i].numpoints; j++)
+            _mapmlBufferPrintf(buffer, numpoints++ == 0 ? "%.*f %.*f" : " %.*f %.*f",
+                               precision, shape->line[i].point[j].x, precision, shape->line[i].point[j].y);
+        }
+        _mapmlBufferAppend(buffer, "</map-coordinates>\n");
+        _mapmlBufferAppend(buffer, "          </map-multipoint>\n");
+      }
+      break;
+
+    case MS_SHAPE_LINE:
+      _mapmlBufferAppendGeometryStart(buffer, cs);
+      if (shape->numlines == 1) {
+        _mapmlBufferAppend(buffer, "          <map-linestring>\n");
+        _mapmlBufferAppendCoordinates(buffer, &(shape->line[0]), precision, "            ");
+        _mapmlBufferAppend(buffer, "          </map-linestring>\n");
+      } else {
+        _mapmlBufferAppend(buffer, "          <map-multilinestring>\n");
+        for (i = 0; i < shape->numlines; i++)
+          _mapmlBufferAppendCoordinates(buffer, &(shape->line[i]), precision, "            ");
+        _mapmlBufferAppend(buffer, "          </map-multilinestring>\n");
+      }
+      break;
+
+    case MS_SHAPE_POLYGON:
+      outerlist = msGetOuterList(shape);
+      for (i = 0; i < shape->numlines; i++) {
+        if (outerlist[i] == MS_TRUE)
+          numouters++;
+      }
+      if (numouters == 0) {
+        free(outerlist);
+        return;
+      }
+      _mapmlBufferAppendGeometryStart(buffer, cs);
+      if (numouters == 1) {
+        for (i = 0; i < shape->numlines; i++) {
+          if (outerlist[i] == MS_TRUE)
+            _mapmlBufferAppendPolygon(buffer, shape, i, outerlist, precision, "          ");
+        }
+      } else {
+        _mapmlBufferAppend(buffer, "          <map-multipolygon>\n");
+        for (i = 0; i < shape->numlines; i++) {
+          if (outerlist[i] == MS_TRUE)
+            _mapmlBufferAppendPolygon(buffer, shape, i, outerlist, precision, "            ");
+        }
+        _mapmlBufferAppend(buffer, "          </map-multipolygon>\n");
+      }
+      free(outerlist);
+      break;
+
+    default:
+      return;
+  }
+
+  _mapmlBufferAppend(buffer, "        </map-geometry>\n");
+}
+/* Append the visible items of the shape as a <map-properties> table */
+static void _mapmlBufferAppendProperties(bufferObj *buffer, shapeObj *shape, gmlItemListObj *itemList, gmlGroupListObj *groupList)
+{
+  int k;
+
+  _mapmlBufferAppend(buffer,
+                     "        <map-properties>\n"
+                     "          <table>\n"
+                     "            <thead>\n"
+                     "              <tr>\n"
+                     "                <th role=\"columnheader\" scope=\"col\">Property Name</th>\n"
+                     "                <th role=\"columnheader\" scope=\"col\">Property Value</th>\n"
+                     "              </tr>\n"
+                     "            </thead>\n");
+
+  for(k=0; k<itemList->numitems; k++) {
+    gmlItemObj *item = &(itemList->items[k]);
+    if(item->visible && msItemInGroups(item->name, groupList) == MS_FALSE) {
+      char *pszName = msEncodeHTMLEntities(item->name);
+      char *pszValue = msEncodeHTMLEntities(shape->values[k]);
+      _mapmlBufferPrintf(buffer,
+                         "            <tbody>\n"
+                         "              <tr>\n"
+                         "                <th scope=\"row\">%s</th>\n"
+                         "                <td itemprop=\"%s\">%s</td>\n"
+                         "              </tr>\n"
+                         "            </tbody>\n", pszName, pszName, pszValue);
+      msFree(pszName);
+      msFree(pszValue);
+    }
+  }
+
+  _mapmlBufferAppend(buffer,
+                     "          </table>\n"
+                     "        </map-properties>\n");
+}
+#endif /* USE_MAPML */
+
+/*
+** msWriteMapMLQuery()
 **
 ** Dump MapML query results for WMS GetFeatureInfo
 **
+** Features are written with their geometry, in the map projection (i.e.
+** the CRS of the GetFeatureInfo request), unless the layer *_geometries
+** metadata is set to "none". Coordinates get 6 decimals in a geographic
+** CRS and 2 in a projected one.
 **
 ** Returns MS_SUCCESS/MS_FAILURE
 */
@@ -585,39 +1034,44 @@ int msWriteMapMLQuery(mapObj *map, FILE *fp, const char *namespaces)
 {
 #if defined(USE_MAPML)
   int status;
-  int i,j,k;
+  int i,j;
   layerObj *lp=NULL;
   shapeObj shape;
-  char szPath[MS_MAXPATHLEN];
-  char *value;
   char *pszMapSRS = NULL;
+  const char *pszProjection;
+  bufferObj buffer;
 
   gmlGroupListObj *groupList=NULL;
   gmlItemListObj *itemList=NULL;
   gmlConstantListObj *constantList=NULL;
   gmlGeometryListObj *geometryList=NULL;
-  gmlItemObj *item=NULL;
-  gmlConstantObj *constant=NULL;
 
   msInitShape(&shape);
-
+  msBufferInit(&buffer);
+  msBufferResize(&buffer, MS_DEFAULT_BUFFER_ALLOC);
 
   msIO_setHeader("Content-Type","text/mapml");
   msIO_setHeader("Access-Control-Allow-Origin","*");
   msIO_sendHeaders();
 
-  msIO_fprintf(fp, "<mapml- xmlns=\"http://www.w3.org/1999/xhtml\">\n");
-  msIO_fprintf(fp, "  <map-head>\n");
-  msIO_fprintf(fp, "  <map-title>GetFeatureInfo Results</map-title>\n");
-  //msIO_fprintf(fp, "  <map-base href=\"TODO-href\" />\n");
-  msIO_fprintf(fp, "  <map-meta charset=\"utf-8\" ></map-meta>\n");
-  // TODO: Add PROJECTION param to Content-Type value
-  msIO_fprintf(fp, "  <map-meta http-equiv=\"Content-Type\" content=\"text/mapml\" ></map-meta>\n");
-
-  msIO_fprintf(fp, "  </map-head>\n");
-
-  msIO_fprintf(fp, "  <map-body>\n");
-  msIO_fprintf(fp, "    <map-extent />\n");  // Mandatory extent element (empty)
+  _mapmlBufferAppend(&buffer,
+                     "<mapml- xmlns=\"http://www.w3.org/1999/xhtml\">\n"
+                     "  <map-head>\n"
+                     "  <map-title>GetFeatureInfo Results</map-title>\n"
+                     "  <map-meta charset=\"utf-8\" ></map-meta>\n");
+  /* The PROJECTION is that of the request CRS, when it is a MapML one */
+  pszProjection = msMapMLGetProjectionName(&(map->projection));
+  if (pszProjection)
+    _mapmlBufferPrintf(&buffer,
+                       "  <map-meta http-equiv=\"Content-Type\" content=\"text/mapml;projection=%s\" ></map-meta>\n"
+                       "  <map-meta name=\"projection\" content=\"%s\" ></map-meta>\n", pszProjection, pszProjection);
+  else
+    _mapmlBufferAppend(&buffer,
+                       "  <map-meta http-equiv=\"Content-Type\" content=\"text/mapml\" ></map-meta>\n");
+  _mapmlBufferAppend(&buffer,
+                     "  </map-head>\n"
+                     "  <map-body>\n"
+                     "    <map-extent />\n");  // Mandatory extent element (empty)
 
   /* Look up map SRS. We need an EPSG code for GML, if not then we get null and we'll fall back on the layer's SRS */
   msOWSGetEPSGProj(&(map->projection), NULL, namespaces, MS_TRUE, &pszMapSRS);
@@ -625,10 +1079,11 @@ int msWriteMapMLQuery(mapObj *map, FILE *fp, const char *namespaces)
   /* step through the layers looking for query results */
   for(i=0; i<map->numlayers; i++) {
     char *pszOutputSRS = NULL;
-    int nSRSDimension = 2;
     const char* geomtype;
-    char *layername=NULL, *layertitle=NULL;
-    
+    const char *cs;
+    char *layername=NULL;
+    int bWriteGeometry, precision;
+
     lp = (GET_LAYER(map, map->layerorder[i]));
 
     if(lp->resultcache && lp->resultcache->numresults > 0) { /* found results */
@@ -644,23 +1099,24 @@ int msWriteMapMLQuery(mapObj *map, FILE *fp, const char *namespaces)
       }
 #endif
 
+      /* Coordinate system of the geometries: the layer's one if not reprojected */
+      if (pszOutputSRS == pszMapSRS) {
+        cs = msProjIsGeographicCRS(&(map->projection)) ? "gcrs" : "pcrs";
+        precision = _mapmlGetPrecision(&(map->projection));
+      } else {
+        cs = msProjIsGeographicCRS(&(lp->projection)) ? "gcrs" : "pcrs";
+        precision = _mapmlGetPrecision(&(lp->projection));
+      }
+
       /* start this collection (layer) */
       
       // TODO: Lookup layername metadata, and chack for NULL lp->name
-      /* if no layer name provided fall back on the layer name + "_layer" */
-      layername = (char*) msSmallMalloc(strlen(lp->name)+7);
-      sprintf(layername, "%s", lp->name);
-      //msOWSPrintValidateMetadata(fp, &(lp->metadata), namespaces, "layername", OWS_NOERR, "\t<%s>\n", layername);
-
-      layertitle = (char *) msOWSLookupMetadata(&(lp->metadata), "OM", "map-title");
-      if (layertitle) {
-        //msOWSPrintEncodeMetadata(fp, &(lp->metadata), namespaces, "title", OWS_NOERR, "\t<gml:name>%s</gml:name>\n", layertitle);
-      }
+      layername = msEncodeHTMLEntities(lp->name);
 
       geomtype = msOWSLookupMetadata(&(lp->metadata), "OFG", "geomtype");
       if( geomtype != NULL && (strstr(geomtype, "25d") != NULL || strstr(geomtype, "25D") != NULL) )
       {
-          msIO_fprintf(fp, "<!-- WARNING: 25d requested for layer '%s' but MapML only supports 2D. -->\n", lp->name);
+          _mapmlBufferPrintf(&buffer, "<!-- WARNING: 25d requested for layer '%s' but MapML only supports 2D. -->\n", layername);
       }
 
       /* populate item and group metadata structures */
@@ -670,9 +1126,14 @@ int msWriteMapMLQuery(mapObj *map, FILE *fp, const char *namespaces)
       geometryList = msGMLGetGeometries(lp, namespaces, MS_FALSE);
       if (itemList == NULL || constantList == NULL || groupList == NULL || geometryList == NULL) {
         msSetError(MS_MISCERR, "Unable to populate item and group metadata structures", "msGMLWriteQuery()");
+        msFree(layername);
+        msBufferFree(&buffer);
         return MS_FAILURE;
       }
 
+      /* Write the feature geometry unless 'none' was requested. */
+      bWriteGeometry = !(geometryList->numgeometries == 1 && strcasecmp(geometryList->geometries[0].name, "none") == 0);
+
       for(j=0; j<lp->resultcache->numresults; j++) {
         status = msLayerGetShape(lp, &shape, &(lp->resultcache->results[j]));
         if(status != MS_SUCCESS) {
@@ -680,6 +1141,9 @@ int msWriteMapMLQuery(mapObj *map, FILE *fp, const char *namespaces)
            msGMLFreeConstants(constantList);
            msGMLFreeItems(itemList);
            msGMLFreeGeometries(geometryList);
+           msFree(layername);
+           _mapmlBufferFlush(fp, &buffer);
+           msBufferFree(&buffer);
            return(status);
         }
 
@@ -688,62 +1152,33 @@ int msWriteMapMLQuery(mapObj *map, FILE *fp, const char *namespaces)
         if(pszOutputSRS == pszMapSRS && msProjectionsDiffer(&(lp->projection), &(map->projection))) {
           status = msProjectShape(&lp->projection, &map->projection, &shape);
           if(status != MS_SUCCESS) {
-            msIO_fprintf(fp, "<!-- Warning: Failed to reproject shape: %s -->\n",msGetErrorString(","));
+            char *pszErrors = msGetErrorString(",");
+            _mapmlBufferPrintf(&buffer, "<!-- Warning: Failed to reproject shape: %s -->\n", pszErrors);
+            msFree(pszErrors);
+            msFreeShape(&shape);
             continue;
           }
         }
 #endif
 
         /* start this feature */
-        msIO_fprintf(fp, "      <map-feature id=\"%s.%ld\" class=\"%s\">\n", layername, shape.index, layername);
-
-        // TODO: handle geomeotry output...
-        //
-        /* Write the feature geometry and bounding box unless 'none' was requested. */
-        /* Default to bbox only if nothing specified and output full geometry only if explicitly requested */
-        /*  
-        if(!(geometryList && geometryList->numgeometries == 1 && strcasecmp(geometryList->geometries[0].name, "none") == 0)) {
-          gmlWriteBounds(fp, OWS_GML2, &(shape.bounds), pszOutputSRS, "\t\t\t", "gml");
-          if (geometryList && geometryList->numgeometries > 0 )
-            gmlWriteGeometry(fp, geometryList, OWS_GML2, &(shape), pszOutputSRS, NULL, "\t\t\t", "", nSRSDimension);
-        }
-        */
-        
-        /* write properties */
-        msIO_fprintf(fp, "        <map-properties>\n");
-        msIO_fprintf(fp, "          <table>\n");
-        msIO_fprintf(fp, "            <thead>\n");
-        msIO_fprintf(fp, "              <tr>\n");
-        msIO_fprintf(fp, "                <th role=\"columnheader\" scope=\"col\">Property Name</th>\n");
-        msIO_fprintf(fp, "                <th role=\"columnheader\" scope=\"col\">Property Value</th>\n");
-        msIO_fprintf(fp, "              </tr>\n");
-        msIO_fprintf(fp, "            </thead>\n");
-        
-        for(k=0; k<itemList->numitems; k++) {
-          item = &(itemList->items[k]);
-          if(item->visible && msItemInGroups(item->name, groupList) == MS_FALSE) {
-            msIO_fprintf(fp, "            <tbody>\n");
-            msIO_fprintf(fp, "              <tr>\n");
-            msIO_fprintf(fp, "                <th scope=\"row\">%s</th>\n", item->name);
-            msIO_fprintf(fp, "                <td itemprop=\"%s\">%s</td>\n", item->name, shape.values[k]);
-            msIO_fprintf(fp, "              </tr>\n");
-            msIO_fprintf(fp, "            </tbody>\n");
-          }
-        }
+        _mapmlBufferPrintf(&buffer, "      <map-feature id=\"%s.%ld\" class=\"%s\">\n", layername, shape.index, layername);
 
-        msIO_fprintf(fp, "          </table>\n");
-        msIO_fprintf(fp, "        </map-properties>\n");
+        if (bWriteGeometry)
+          _mapmlBufferAppendGeometry(&buffer, &shape, cs, precision);
 
+        /* write properties */
+        _mapmlBufferAppendProperties(&buffer, &shape, itemList, groupList);
 
         /* end this feature */
-        msIO_fprintf(fp, "      </map-feature>\n");
+        _mapmlBufferAppend(&buffer, "      </map-feature>\n");
+        _mapmlBufferFlushIfFull(fp, &buffer);
 
         msFreeShape(&shape); /* init too */
       }
 
       /* end this collection (layer) */
       msFree(layername);
-      msFree(layertitle);
 
       msGMLFreeGroups(groupList);
       msGMLFreeConstants(constantList);
@@ -757,12 +1192,14 @@ int msWriteMapMLQuery(mapObj *map, FILE *fp, const char *namespaces)
     }
   } /* next layer */
 
+  msFree(pszMapSRS);
 
-  
   /* end this document */
-  msIO_fprintf(fp, "  </map-body>\n");
-  msIO_fprintf(fp, "</mapml->\n");
-
+  _mapmlBufferAppend(&buffer,
+                     "  </map-body>\n"
+                     "</mapml->\n");
+  _mapmlBufferFlush(fp, &buffer);
+  msBufferFree(&buffer);
 
   return(MS_SUCCESS);
 
@@ -772,4 +1209,235 @@ int msWriteMapMLQuery(mapObj *map, FILE *fp, const char *namespaces)
 #endif
 }
 
+#ifdef USE_MAPML
+/*
+ * MapML vector tiles: the pipeline mirrors the one of mapmvt.c. Shapes are
+ * reprojected to the map (tile) CRS, transformed to the tile pixel grid,
+ * clipped to the tile plus an edge buffer, simplified on that grid (so the
+ * tolerance follows the zoom level) and written back in map coordinates,
+ * with just enough decimals to represent the grid.
+ */
+
+/* Back from the tile grid to map coordinates */
+static void mapmlUntransformShape(shapeObj *shape, rectObj *extent, int tile_extent)
+{
+  double res_x = (extent->maxx - extent->minx)/tile_extent;
+  double res_y = (extent->maxy - extent->miny)/tile_extent;
+  int i, j;
+
+  for (i = 0; i < shape->numlines; i++) {
+    for (j = 0; j < shape->line[i].numpoints; j++) {
+      shape->line[i].point[j].x = extent->minx + shape->line[i].point[j].x*res_x;
+      shape->line[i].point[j].y = extent->miny + shape->line[i].point[j].y*res_y;
+    }
+  }
+}
+#endif /* USE_MAPML */
+
+/*
+** msMapMLWriteTile()
+**
+** Write the features of the visible layers in the map extent as a MapML
+** document, for WMS GetMap and mapserv tile mode requests with an output
+** format using the MAPML driver. Output format options:
+**  - EXTENT: size of the tile grid coordinates are snapped to (default
+**    the tile width in pixels)
+**  - EDGE_BUFFER: buffer around the tile, in grid units (default 10)
+**  - SIMPLIFY: simplification tolerance, in grid units (default 1)
+**
+** Returns MS_SUCCESS/MS_FAILURE
+*/
+int msMapMLWriteTile(mapObj *map, int sendheaders)
+{
+#ifdef USE_MAPML
+  int iLayer, retcode = MS_SUCCESS;
+  int tile_extent, buffer, precision;
+  double tolerance, res;
+  const char *value, *cs, *pszProjection;
+  char *pszTitle;
+  bufferObj output;
+
+  value = msGetOutputFormatOption(map->outputformat, "EXTENT", NULL);
+  tile_extent = value ? MS_ABS(atoi(value)) : map->width;
+  if (tile_extent <= 0)
+    tile_extent = 256;
+  buffer = MS_ABS(atoi(msGetOutputFormatOption(map->outputformat, "EDGE_BUFFER", "10")));
+  tolerance = atof(msGetOutputFormatOption(map->outputformat, "SIMPLIFY", "1"));
+
+  /* make sure we have a scale and cellsize computed */
+  map->cellsize = MS_CELLSIZE(map->extent.minx, map->extent.maxx, map->width);
+  msCalculateScale(map->extent, map->units, map->width, map->height, map->resolution, &map->scaledenom);
+
+  /* expand the map->extent so it goes from pixel center (MapServer) to pixel edge (OWS) */
+  map->extent.minx -= map->cellsize * 0.5;
+  map->extent.maxx += map->cellsize * 0.5;
+  map->extent.miny -= map->cellsize * 0.5;
+  map->extent.maxy += map->cellsize * 0.5;
+
+  /* decimals needed to write the coordinates of the tile grid */
+  res = (map->extent.maxx - map->extent.minx)/tile_extent;
+  precision = (res >= 1) ? 0 : (int) ceil(-log10(res)) + 1;
+  if (precision > 10)
+    precision = 10;
+
+  cs = msProjIsGeographicCRS(&(map->projection)) ? "gcrs" : "pcrs";
+  pszProjection = msMapMLGetProjectionName(&(map->projection));
+
+  if (sendheaders) {
+    msIO_setHeader("Content-Type","text/mapml");
+    msIO_setHeader("Access-Control-Allow-Origin","*");
+    msIO_sendHeaders();
+  }
+
+  msBufferInit(&output);
+  msBufferResize(&output, MS_DEFAULT_BUFFER_ALLOC);
+
+  pszTitle = msEncodeHTMLEntities(map->name ? map->name : "");
+  _mapmlBufferPrintf(&output,
+                     "<mapml- xmlns=\"http://www.w3.org/1999/xhtml\">\n"
+                     "  <map-head>\n"
+                     "  <map-title>%s</map-title>\n"
+                     "  <map-meta charset=\"utf-8\" ></map-meta>\n", pszTitle);
+  msFree(pszTitle);
+  if (pszProjection) {
+    _mapmlBufferPrintf(&output,
+                       "  <map-meta http-equiv=\"Content-Type\" content=\"text/mapml;projection=%s\" ></map-meta>\n"
+                       "  <map-meta name=\"projection\" content=\"%s\" ></map-meta>\n", pszProjection, pszProjection);
+  }
+  _mapmlBufferPrintf(&output,
+                     "  <map-meta name=\"cs\" content=\"%s\" ></map-meta>\n"
+                     "  </map-head>\n"
+                     "  <map-body>\n", cs);
+
+  for (iLayer = 0; iLayer < map->numlayers; iLayer++) {
+    int status = MS_SUCCESS;
+    layerObj *layer = GET_LAYER(map, map->layerorder[iLayer]);
+    shapeObj shape;
+    gmlItemListObj *itemList = NULL;
+    gmlGroupListObj *groupList = NULL;
+    char *layername = NULL;
+    rectObj rect;
+
+    if (!msLayerIsVisible(map, layer)) continue;
+
+    if (layer->type != MS_LAYER_POINT && layer->type != MS_LAYER_POLYGON && layer->type != MS_LAYER_LINE)
+      continue;
+
+    status = msLayerOpen(layer);
+    if (status != MS_SUCCESS) {
+      retcode = status;
+      goto layer_cleanup;
+    }
+
+    status = msLayerWhichItems(layer, MS_TRUE, NULL); /* we want all items - behaves like a query in that sense */
+    if (status != MS_SUCCESS) {
+      retcode = status;
+      goto layer_cleanup;
+    }
+
+    /* -------------------------------------------------------------------- */
+    /*      Will we need to reproject?                                      */
+    /* -------------------------------------------------------------------- */
+    layer->project = msProjectionsDiffer(&(layer->projection), &(map->projection));
+
+    /* include the features of the edge buffer */
+    rect = map->extent;
+    rect.minx -= buffer * res;
+    rect.miny -= buffer * res;
+    rect.maxx += buffer * res;
+    rect.maxy += buffer * res;
+    if (layer->project) msProjectRect(&(map->projection), &(layer->projection), &rect);
+
+    status = msLayerWhichShapes(layer, rect, MS_TRUE);
+    if (status == MS_DONE) { /* no overlap - that's ok */
+      retcode = MS_SUCCESS;
+      goto layer_cleanup;
+    } else if (status != MS_SUCCESS) {
+      retcode = status;
+      goto layer_cleanup;
+    }
+
+    itemList = msGMLGetItems(layer, "MGO");
+    groupList = msGMLGetGroups(layer, "MGO");
+    if (itemList == NULL || groupList == NULL) {
+      msSetError(MS_MISCERR, "Unable to populate item and group metadata structures", "msMapMLWriteTile()");
+      retcode = MS_FAILURE;
+      goto layer_cleanup;
+    }
+    layername = msEncodeHTMLEntities(layer->name ? layer->name : "");
+
+    msInitShape(&shape);
+    while ((status = msLayerNextShape(layer, &shape)) == MS_SUCCESS) {
+
+      if (layer->numclasses > 0) {
+        shape.classindex = msShapeGetClass(layer, map, &shape, NULL, -1);
+        if (shape.classindex < 0)
+          goto feature_cleanup; /* no matching CLASS found, skip this feature */
+      }
+
+      if (layer->project) {
+        if (layer->reprojectorLayerToMap == NULL)
+        {
+            layer->reprojectorLayerToMap = msProjectCreateReprojector(
+                &layer->projection, &map->projection);
+        }
+        if (layer->reprojectorLayerToMap)
+            status = msProjectShapeEx(layer->reprojectorLayerToMap, &shape);
+        else
+            status = MS_FAILURE;
+      }
+      if (status == MS_SUCCESS)
+        status = msTransformShapeToTileGrid(&shape, &map->extent, tile_extent, 0);
+      if (status == MS_SUCCESS)
+        status = msClipShapeToTileGrid(&shape, layer->type, buffer, tile_extent);
+      if (status == MS_SUCCESS)
+        status = msSimplifyShapeOnTileGrid(&shape, layer->type, tolerance);
+
+      if (status == MS_SUCCESS) {
+        mapmlUntransformShape(&shape, &map->extent, tile_extent);
+
+        _mapmlBufferPrintf(&output, "      <map-feature id=\"%s.%ld\" class=\"%s\">\n", layername, shape.index, layername);
+        _mapmlBufferAppendGeometry(&output, &shape, NULL, precision);
+        _mapmlBufferAppendProperties(&output, &shape, itemList, groupList);
+        _mapmlBufferAppend(&output, "      </map-feature>\n");
+        _mapmlBufferFlushIfFull(stdout, &output);
+      }
+
+      feature_cleanup:
+      msFreeShape(&shape);
+    } /* next shape */
+
+    if (status == MS_FAILURE)
+      retcode = MS_FAILURE;
+
+    layer_cleanup:
+    msLayerClose(layer);
+    msGMLFreeItems(itemList);
+    msGMLFreeGroups(groupList);
+    msFree(layername);
+    if (retcode != MS_SUCCESS) break;
+  } /* next layer */
+
+  _mapmlBufferAppend(&output,
+                     "  </map-body>\n"
+                     "</mapml->\n");
+  if (retcode == MS_SUCCESS)
+    _mapmlBufferFlush(stdout, &output);
+  msBufferFree(&output);
 
+  return retcode;
+#else
+  msSetError(MS_MISCERR, "MapML support is not available.", "msMapMLWriteTile()");
+  return MS_FAILURE;
+#endif
+}
+
+int msPopulateRendererVTableMapML(rendererVTableObj *renderer)
+{
+#ifdef USE_MAPML
+  return MS_SUCCESS;
+#else
+  msSetError(MS_MISCERR, "MapML Driver requested but support is not compiled in", "msPopulateRendererVTableMapML()");
+  return MS_FAILURE;
+#endif
+}
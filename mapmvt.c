@@ -121,32 +121,23 @@ static void mvtReorderRings(shapeObj *shape, int *outers) {
 }
 
 static int mvtTransformShape(shapeObj *shape, rectObj *extent, int layer_type, int mvt_layer_extent) {
-  double scale_x,scale_y;
-  int i,j,outj;
+  int i;
 
   int *outers=NULL, ring_direction;
 
-  scale_x = (double)mvt_layer_extent/(extent->maxx - extent->minx);
-  scale_y = (double)mvt_layer_extent/(extent->maxy - extent->miny);
-
   if(layer_type == MS_LAYER_POLYGON) {
     outers = msGetOuterList(shape); /* compute before we muck with the shape */
     if(outers[0] == 0) /* first ring must be an outer */
       mvtReorderRings(shape, outers);
   }
 
-  for(i=0;i<shape->numlines;i++) {
-    for(j=0,outj=0;j<shape->line[i].numpoints;j++) {
-
-      shape->line[i].point[outj].x = (int)((shape->line[i].point[j].x - extent->minx)*scale_x);
-      shape->line[i].point[outj].y = mvt_layer_extent - (int)((shape->line[i].point[j].y - extent->miny)*scale_y);
-
-      if(!outj || shape->line[i].point[outj].x != shape->line[i].point[outj-1].x || shape->line[i].point[outj].y != shape->line[i].point[outj-1].y)
-        outj++; /* add the point to the shape only if it's the first one or if it's different than the previous one */
-    }
-    shape->line[i].numpoints = outj;
+  if(msTransformShapeToTileGrid(shape, extent, mvt_layer_extent, MS_TILEGRID_YDOWN|MS_TILEGRID_TRUNCATE) != MS_SUCCESS) {
+    msFree(outers);
+    return MS_FAILURE;
+  }
 
-    if(layer_type == MS_LAYER_POLYGON) {
+  if(layer_type == MS_LAYER_POLYGON) {
+    for(i=0;i<shape->numlines;i++) {
       if(shape->line[i].numpoints == 4 && getTriangleHeight(&shape->line[i]) < 1) {        
         shape->line[i].numpoints = 0; /* so it's not considered anymore */
         continue; /* next ring */
@@ -163,25 +154,7 @@ static int mvtTransformShape(shapeObj *shape, rectObj *extent, int layer_type, i
   msComputeBounds(shape); /* TODO: might need to limit this to just valid parts... */
   msFree(outers);
 
-  return (shape->numlines == 0)?MS_FAILURE:MS_SUCCESS; /* sucess if at least one line */
-}
-
-static int mvtClipShape(shapeObj *shape, int layer_type, int buffer, int mvt_layer_extent) {
-  rectObj tile_rect;
-  tile_rect.minx = tile_rect.miny=-buffer*16;
-  tile_rect.maxx = tile_rect.maxy=mvt_layer_extent + buffer*16;
-
-  if(layer_type == MS_LAYER_POLYGON) {
-    msClipPolygonRect(shape, tile_rect);
-  } else if(layer_type == MS_LAYER_LINE) {
-    msClipPolylineRect(shape, tile_rect);
-  }
-
-  /* success if at least one line and not a degenerate bounding box */
-  if(shape->numlines > 0 && (layer_type == MS_LAYER_POINT || (shape->bounds.minx != shape->bounds.maxx || shape->bounds.miny != shape->bounds.maxy)))
-    return MS_SUCCESS;
-  else
-    return MS_FAILURE;
+  return MS_SUCCESS;
 }
 
 static void freeMvtFeature( VectorTile__Tile__Feature *mvt_feature ) {
@@ -233,7 +206,7 @@ int mvtWriteShape( layerObj *layer, shapeObj *shape, VectorTile__Tile__Layer *mv
   if(mvtTransformShape(shape, unbuffered_bbox, layer->type, mvt_layer->extent) != MS_SUCCESS) {
     return MS_SUCCESS; /* degenerate shape */
   }
-  if(mvtClipShape(shape, layer->type, buffer, mvt_layer->extent) != MS_SUCCESS) {
+  if(msClipShapeToTileGrid(shape, layer->type, buffer*16, mvt_layer->extent) != MS_SUCCESS) {
     return MS_SUCCESS; /* no features left after clipping */
   }
 
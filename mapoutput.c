@@ -220,6 +220,16 @@ outputFormatObj *msCreateDefaultOutputFormat( mapObj *map,
     format->renderer = MS_RENDER_WITH_MVT;
   }
 #endif
+#if defined(USE_MAPML)
+  else if( strcasecmp(driver,"MAPML") == 0 ) {
+    if(!name) name="mapml";
+    format = msAllocOutputFormat( map, name, driver );
+    format->mimetype = msStrdup("text/mapml");
+    format->imagemode = MS_IMAGEMODE_FEATURE;
+    format->extension = msStrdup("mapml");
+    format->renderer = MS_RENDER_WITH_MAPML;
+  }
+#endif
 
   else if( strcasecmp(driver,"AGG/MIXED") == 0 &&
            name != NULL && strcasecmp(name,"jpegpng") == 0 ) {
@@ -1103,6 +1113,8 @@ int msInitializeRendererVTable(outputFormatObj *format)
     case MS_RENDER_WITH_MVT:
       return msPopulateRendererVTableMVT(format->vtable);
 #endif
+    case MS_RENDER_WITH_MAPML:
+      return msPopulateRendererVTableMapML(format->vtable);
 #ifdef USE_CAIRO
     case MS_RENDER_WITH_CAIRO_RASTER:
       return msPopulateRendererVTableCairoRaster(format->vtable);
@@ -445,6 +445,13 @@ void msGMLWriteWFSBounds(mapObj *map, FILE *stream, const char *tab,
 MS_DLL_EXPORT int msGMLWriteWFSQuery(mapObj *map, FILE *stream, const char *wfs_namespace,
                                      OWSGMLVersion outputformat, int nWFSVersion, int bUseURN,
                                      int bGetPropertyValueRequest);
+
+typedef struct gmlWFSStreamObj gmlWFSStreamObj;
+
+MS_DLL_EXPORT gmlWFSStreamObj *msGMLCreateWFSStream(mapObj *map, FILE *stream, const char *wfs_namespace,
+                                                    OWSGMLVersion outputformat, int nWFSVersion, int bUseURN);
+MS_DLL_EXPORT int msGMLWriteWFSStreamFeature(gmlWFSStreamObj *gmlstream, layerObj *lp, shapeObj *shape);
+MS_DLL_EXPORT void msGMLFreeWFSStream(gmlWFSStreamObj *gmlstream);
 #endif
 
 
@@ -583,6 +590,7 @@ int msSOSDispatch(mapObj *map, cgiRequestObj *requestobj, owsRequestObj *ows_req
 int msWriteMapMLLayer(FILE *fp, mapObj *map, cgiRequestObj *req, owsRequestObj *ows_request, const char *pszService);
 int msWriteMapMLQuery(mapObj *map, FILE *fp, const char *namespaces);
 int msMapMLTileDispatch(mapObj *map, cgiRequestObj *req, owsRequestObj *ows_request);
+MS_DLL_EXPORT void msMapMLCleanup(void);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -51,6 +51,20 @@
 ** msPostGISNextShape reads a row, increments layerinfo->rownum, and returns
 ** MS_SUCCESS, until rownum reaches ntuples, and it returns MS_DONE instead.
 **
+** With PROCESSING "STREAMING=YES", drawing queries (not queries, whose
+** results are read back by index) are sent in libpq single row mode instead:
+** layerinfo->pgresult then holds the current row only and msPostGISNextShape
+** fetches the next one once it is read, so memory no longer grows with the
+** size of the result. The connection is busy until the last row is read,
+** the next WhichShapes call or the layer is closed: GetShape, GetItems,
+** GetExtent and the count functions fail in the meantime rather than
+** cancelling the draw.
+**
+** With PROCESSING "BINARY_WKB=YES" (the default when built with
+** TRANSFER_ENCODING=256) results are transferred in binary format, which
+** returns the WKB as is instead of hex encoded. Attributes are then cast to
+** text by the database.
+**
 */
 
 /* GNU needs this for strcasestr */
@@ -119,6 +133,9 @@ msPostGISLayerInfo *msPostGISCreateLayerInfo(void)
   layerinfo->rownum = 0;
   layerinfo->version = 0;
   layerinfo->paging = MS_TRUE;
+  layerinfo->binary = RESULTSET_TYPE;
+  layerinfo->streaming = MS_FALSE;
+  layerinfo->streamactive = MS_FALSE;
 #ifdef USE_POINT_Z_M
   layerinfo->force2d = MS_FALSE;
 #else
@@ -127,6 +144,55 @@ msPostGISLayerInfo *msPostGISCreateLayerInfo(void)
   return layerinfo;
 }
 
+/*
+** msPostGISEndStream()
+**
+** Reads what's left of a single row mode query so the connection can be
+** used again, asking the server to cancel it first if rows remain.
+*/
+static void msPostGISEndStream(layerObj *layer, int cancel)
+{
+  msPostGISLayerInfo *layerinfo = (msPostGISLayerInfo*)layer->layerinfo;
+  PGresult *pgresult;
+
+  if ( ! layerinfo->streamactive ) return;
+  layerinfo->streamactive = MS_FALSE;
+
+  if ( cancel ) {
+    PGcancel *pgcancel = PQgetCancel(layerinfo->pgconn);
+    if ( pgcancel ) {
+      char errbuf[256];
+      if ( ! PQcancel(pgcancel, errbuf, sizeof(errbuf)) && layer->debug )
+        msDebug("msPostGISEndStream(): Unable to cancel query: %s\n", errbuf);
+      PQfreeCancel(pgcancel);
+    }
+  }
+
+  while ( (pgresult = PQgetResult(layerinfo->pgconn)) != NULL )
+    PQclear(pgresult);
+}
+
+/*
+** msPostGISCheckNoStream()
+**
+** The connection can't run anything else while a drawing query is streamed,
+** and cancelling it would silently truncate that draw, so other requests on
+** the layer are refused until all its rows are read or a new WhichShapes()
+** replaces it.
+*/
+static int msPostGISCheckNoStream(layerObj *layer, const char *routine)
+{
+  msPostGISLayerInfo *layerinfo = (msPostGISLayerInfo*)layer->layerinfo;
+
+  if ( layerinfo && layerinfo->streamactive ) {
+    msSetError(MS_QUERYERR,
+               "Layer %s is still reading a STREAMING=YES query, read all its shapes first.",
+               routine, layer->name ? layer->name : "(null)");
+    return MS_FAILURE;
+  }
+  return MS_SUCCESS;
+}
+
 /*
 ** msPostGISFreeLayerInfo()
 */
@@ -134,6 +200,7 @@ void msPostGISFreeLayerInfo(layerObj *layer)
 {
   msPostGISLayerInfo *layerinfo = NULL;
   layerinfo = (msPostGISLayerInfo*)layer->layerinfo;
+  if ( layerinfo->pgconn ) msPostGISEndStream(layer, MS_TRUE);
   if ( layerinfo->sql ) free(layerinfo->sql);
   if ( layerinfo->uid ) free(layerinfo->uid);
   if ( layerinfo->srid ) free(layerinfo->srid);
@@ -1754,11 +1821,11 @@ char *msPostGISBuildSQLItems(layerObj *layer)
     char *force2d = "";
 #if TRANSFER_ENCODING == 64
     const char *strGeomTemplate = "encode(ST_AsBinary(%s(\"%s\"),'%s'),'base64') as geom,\"%s\"";
-#elif TRANSFER_ENCODING == 256
-    const char *strGeomTemplate = "ST_AsBinary(%s(\"%s\"),'%s') as geom,\"%s\"::text";
 #else
     const char *strGeomTemplate = "encode(ST_AsBinary(%s(\"%s\"),'%s'),'hex') as geom,\"%s\"";
 #endif
+    if( layerinfo->binary )
+      strGeomTemplate = "ST_AsBinary(%s(\"%s\"),'%s') as geom,\"%s\"::text";
     if( layerinfo->force2d ) {
       if( layerinfo->version >= 20100 )
         force2d = "ST_Force2D";
@@ -1770,11 +1837,11 @@ char *msPostGISBuildSQLItems(layerObj *layer)
         /* Use AsEWKB() to get 3D */
 #if TRANSFER_ENCODING == 64
         strGeomTemplate = "encode(AsEWKB(%s(\"%s\"),'%s'),'base64') as geom,\"%s\"";
-#elif TRANSFER_ENCODING == 256
-        strGeomTemplate = "AsEWKB(%s(\"%s\"),'%s') as geom,\"%s\"::text";
 #else
         strGeomTemplate = "encode(AsEWKB(%s(\"%s\"),'%s'),'hex') as geom,\"%s\"";
 #endif
+        if( layerinfo->binary )
+          strGeomTemplate = "AsEWKB(%s(\"%s\"),'%s') as geom,\"%s\"::text";
     }
     strGeom = (char*)msSmallMalloc(strlen(strGeomTemplate) + strlen(force2d) + strlen(strEndian) + strlen(layerinfo->geomcolumn) + strlen(layerinfo->uid) + 1);
     sprintf(strGeom, strGeomTemplate, force2d, layerinfo->geomcolumn, strEndian, layerinfo->uid);
@@ -1798,20 +1865,18 @@ char *msPostGISBuildSQLItems(layerObj *layer)
     int t;
     for ( t = 0; t < layer->numitems; t++ ) {
       length += strlen(layer->items[t]) + 3; /* itemname + "", */
-#if TRANSFER_ENCODING == 256
-      length +=6; /*add a ::text*/
-#endif
+      if( layerinfo->binary )
+        length +=6; /*add a ::text*/
     }
     strItems = (char*)msSmallMalloc(length);
     strItems[0] = '\0';
     for ( t = 0; t < layer->numitems; t++ ) {
       strlcat(strItems, "\"", length);
       strlcat(strItems, layer->items[t], length);
-#if TRANSFER_ENCODING == 256
-      strlcat(strItems, "\"::text,", length);
-#else
-      strlcat(strItems, "\",", length);
-#endif
+      if( layerinfo->binary )
+        strlcat(strItems, "\"::text,", length);
+      else
+        strlcat(strItems, "\",", length);
     }
     strlcat(strItems, strGeom, length);
   }
@@ -2346,17 +2411,19 @@ int msPostGISReadShape(layerObj *layer, shapeObj *shape)
   } else {
     wkb = wkbstatic;
   }
+  if( layerinfo->binary ) {
+    result = 1;
+    memcpy(wkb, wkbstr, wkbstrlen);
+    w.size = wkbstrlen;
+  } else {
 #if TRANSFER_ENCODING == 64
-  result = msPostGISBase64Decode(wkb, wkbstr, wkbstrlen - 1);
-  w.size = (wkbstrlen - 1)/2;
-#elif TRANSFER_ENCODING == 256
-  result = 1;
-  memcpy(wkb, wkbstr, wkbstrlen);
-  w.size = wkbstrlen;
+    result = msPostGISBase64Decode(wkb, wkbstr, wkbstrlen - 1);
+    w.size = (wkbstrlen - 1)/2;
 #else
-  result = msPostGISHexDecode(wkb, wkbstr, wkbstrlen);
-  w.size = (wkbstrlen - 1)/2;
+    result = msPostGISHexDecode(wkb, wkbstr, wkbstrlen);
+    w.size = (wkbstrlen - 1)/2;
 #endif
+  }
 
   if( ! result ) {
     if(wkb!=wkbstatic) free(wkb);
@@ -2502,6 +2569,7 @@ int msPostGISLayerOpen(layerObj *layer)
   msPostGISLayerInfo  *layerinfo;
   int order_test = 1;
   const char* force2d_processing;
+  const char* processing;
 
   assert(layer != NULL);
 
@@ -2632,6 +2700,21 @@ int msPostGISLayerOpen(layerObj *layer)
   if (layer->debug)
     msDebug("msPostGISLayerOpen: Forcing 2D geometries: %s.\n", (layerinfo->force2d)?"yes":"no");
 
+  processing = msLayerGetProcessingKey( layer, "BINARY_WKB" );
+  if(processing && !strcasecmp(processing,"no")) {
+    layerinfo->binary = MS_FALSE;
+  }
+  else if(processing && !strcasecmp(processing,"yes")) {
+    layerinfo->binary = MS_TRUE;
+  }
+
+  processing = msLayerGetProcessingKey( layer, "STREAMING" );
+  if(processing && !strcasecmp(processing,"yes")) {
+    layerinfo->streaming = MS_TRUE;
+  }
+  if (layer->debug)
+    msDebug("msPostGISLayerOpen: Binary results: %s, streaming: %s.\n", (layerinfo->binary)?"yes":"no", (layerinfo->streaming)?"yes":"no");
+
   /* Save the layerinfo in the layerObj. */
   layer->layerinfo = (void*)layerinfo;
 
@@ -2793,7 +2876,12 @@ static PGresult* runPQexecParamsWithBindSubstitution(layerObj *layer, const char
   msPostGISLayerInfo* layerinfo = (msPostGISLayerInfo*) layer->layerinfo;
 
   int num_bind_values = 0;
-  const char** layer_bind_values = buildBindValues(layer, &num_bind_values);
+  const char** layer_bind_values;
+
+  if ( msPostGISCheckNoStream(layer, "runPQexecParamsWithBindSubstitution()") != MS_SUCCESS )
+    return NULL;
+
+  layer_bind_values = buildBindValues(layer, &num_bind_values);
 
   if(num_bind_values > 0) {
     pgresult = PQexecParams(layerinfo->pgconn, strSQL, num_bind_values, NULL, layer_bind_values, NULL, NULL, binary);
@@ -2806,6 +2894,80 @@ static PGresult* runPQexecParamsWithBindSubstitution(layerObj *layer, const char
 
   return pgresult;
 }
+
+/*
+** Sends strSQL in single row mode, see msPostGISFetchStreamRow() for reading
+** the results.
+*/
+static int msPostGISStartStream(layerObj *layer, const char* strSQL)
+{
+  msPostGISLayerInfo* layerinfo = (msPostGISLayerInfo*) layer->layerinfo;
+  int num_bind_values = 0, status;
+  const char** layer_bind_values;
+
+  msPostGISEndStream(layer, MS_TRUE);
+
+  layer_bind_values = buildBindValues(layer, &num_bind_values);
+  status = PQsendQueryParams(layerinfo->pgconn, strSQL, num_bind_values, NULL,
+                             num_bind_values > 0 ? layer_bind_values : NULL, NULL, NULL, layerinfo->binary);
+  freeBindValues(layer_bind_values);
+
+  if ( ! status ) {
+    msDebug("msPostGISStartStream(): Error (%s) executing query: %s\n", PQerrorMessage(layerinfo->pgconn), strSQL);
+    msSetError(MS_QUERYERR, "Error executing query. Check server logs","msPostGISLayerWhichShapes()");
+    return MS_FAILURE;
+  }
+
+  /* if this fails the whole result comes at once, which is read the same way */
+  if ( ! PQsetSingleRowMode(layerinfo->pgconn) && layer->debug )
+    msDebug("msPostGISStartStream(): Unable to set single row mode.\n");
+
+  layerinfo->streamactive = MS_TRUE;
+  return MS_SUCCESS;
+}
+
+/*
+** Replaces layerinfo->pgresult by the next row(s) of the streamed query.
+** Returns MS_DONE once all of them have been read.
+*/
+static int msPostGISFetchStreamRow(layerObj *layer)
+{
+  msPostGISLayerInfo* layerinfo = (msPostGISLayerInfo*) layer->layerinfo;
+  PGresult *pgresult;
+  ExecStatusType status;
+
+  if ( layerinfo->pgresult ) {
+    PQclear(layerinfo->pgresult);
+    layerinfo->pgresult = NULL;
+  }
+  layerinfo->rownum = 0;
+
+  if ( ! layerinfo->streamactive )
+    return MS_DONE;
+
+  pgresult = PQgetResult(layerinfo->pgconn);
+  if ( ! pgresult ) {
+    layerinfo->streamactive = MS_FALSE;
+    return MS_DONE;
+  }
+
+  status = PQresultStatus(pgresult);
+  if ( status == PGRES_SINGLE_TUPLE || (status == PGRES_TUPLES_OK && PQntuples(pgresult) > 0) ) {
+    layerinfo->pgresult = pgresult;
+    return MS_SUCCESS;
+  }
+  PQclear(pgresult);
+
+  if ( status == PGRES_TUPLES_OK ) { /* the empty result ending the query */
+    msPostGISEndStream(layer, MS_FALSE);
+    return MS_DONE;
+  }
+
+  msDebug("msPostGISFetchStreamRow(): Error (%s) executing query: %s\n", PQerrorMessage(layerinfo->pgconn), layerinfo->sql);
+  msSetError(MS_QUERYERR, "Error executing query. Check server logs","msPostGISLayerNextShape()");
+  msPostGISEndStream(layer, MS_FALSE);
+  return MS_FAILURE;
+}
 #endif
 
 /*
@@ -2827,6 +2989,9 @@ int msPostGISLayerWhichShapes(layerObj *layer, rectObj rect, int isQuery)
     msDebug("msPostGISLayerWhichShapes called.\n");
   }
 
+  /* A new query replaces a streamed one that wasn't read to the end. */
+  msPostGISEndStream(layer, MS_TRUE);
+
   /* Fill out layerinfo with our current DATA state. */
   if ( msPostGISParseData(layer) != MS_SUCCESS) {
     return MS_FAILURE;
@@ -2849,7 +3014,24 @@ int msPostGISLayerWhichShapes(layerObj *layer, rectObj rect, int isQuery)
     msDebug("msPostGISLayerWhichShapes query: %s\n", strSQL);
   }
 
-  pgresult = runPQexecParamsWithBindSubstitution(layer, strSQL, RESULTSET_TYPE);
+  /* Drawing queries can be read one row at a time. */
+  if (layerinfo->streaming && !isQuery) {
+    if (msPostGISStartStream(layer, strSQL) != MS_SUCCESS) {
+      free(strSQL);
+      return MS_FAILURE;
+    }
+
+    if(layerinfo->pgresult) PQclear(layerinfo->pgresult);
+    layerinfo->pgresult = NULL;
+
+    if(layerinfo->sql) free(layerinfo->sql);
+    layerinfo->sql = strSQL;
+
+    layerinfo->rownum = 0;
+    return MS_SUCCESS;
+  }
+
+  pgresult = runPQexecParamsWithBindSubstitution(layer, strSQL, layerinfo->binary);
 
   if ( layer->debug > 1 ) {
     msDebug("msPostGISLayerWhichShapes query status: %s (%d)\n", PQresStatus(PQresultStatus(pgresult)), PQresultStatus(pgresult));
@@ -2914,15 +3096,22 @@ int msPostGISLayerNextShape(layerObj *layer, shapeObj *shape)
   ** Roll through pgresult until we hit non-null shape (usually right away).
   */
   while (shape->type == MS_SHAPE_NULL) {
-    if (layerinfo->rownum < PQntuples(layerinfo->pgresult)) {
+    if (layerinfo->pgresult && layerinfo->rownum < PQntuples(layerinfo->pgresult)) {
       /* Retrieve this shape, cursor access mode. */
       msPostGISReadShape(layer, shape);
+      if( layerinfo->streamactive ) {
+        shape->resultindex = -1; /* the row won't be kept */
+      }
       if( shape->type != MS_SHAPE_NULL ) {
         (layerinfo->rownum)++; /* move to next shape */
         return MS_SUCCESS;
       } else {
         (layerinfo->rownum)++; /* move to next shape */
       }
+    } else if (layerinfo->streamactive) {
+      int status = msPostGISFetchStreamRow(layer);
+      if (status != MS_SUCCESS)
+        return status;
     } else {
       return MS_DONE;
     }
@@ -2962,6 +3151,10 @@ int msPostGISLayerGetShapeCount(layerObj *layer, rectObj rect, projectionObj *re
     msDebug("msPostGISLayerGetShapeCount called.\n");
   }
 
+  /* don't fall back to client-side evaluation, it would end the stream */
+  if ( msPostGISCheckNoStream(layer, "msPostGISLayerGetShapeCount()") != MS_SUCCESS )
+    return -1;
+
 
   // Special processing if the specified projection for the rect is different from the layer projection
   // We want to issue a WHERE that includes
@@ -3078,6 +3271,9 @@ int msPostGISLayerGetShape(layerObj *layer, shapeObj *shape, resultObj *record)
     msDebug("msPostGISLayerGetShape called for record = %i\n", resultindex);
   }
 
+  if ( msPostGISCheckNoStream(layer, "msPostGISLayerGetShape()") != MS_SUCCESS )
+    return MS_FAILURE;
+
   /* If resultindex is set, fetch the shape from the resultcache, otherwise fetch it from the DB  */
   if (resultindex >= 0) {
     int status;
@@ -3147,7 +3343,7 @@ int msPostGISLayerGetShape(layerObj *layer, shapeObj *shape, resultObj *record)
       msDebug("msPostGISLayerGetShape query: %s\n", strSQL);
     }
 
-    pgresult = runPQexecParamsWithBindSubstitution(layer, strSQL, RESULTSET_TYPE);
+    pgresult = runPQexecParamsWithBindSubstitution(layer, strSQL, layerinfo->binary);
 
     /* Something went wrong. */
     if ( (!pgresult) || (PQresultStatus(pgresult) != PGRES_TUPLES_OK) ) {
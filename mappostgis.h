@@ -65,6 +65,9 @@ typedef struct {
   int         version;     /* PostGIS version of the database */
   int         paging;      /* Driver handling of pagination, enabled by default */
   int         force2d;     /* Pass geometry through ST_Force2D */
+  int         binary;      /* Results in binary format: raw WKB, attributes cast to text */
+  int         streaming;   /* Read drawing queries one row at a time */
+  int         streamactive; /* A single row mode query is being read from pgconn */
 }
 msPostGISLayerInfo;
 
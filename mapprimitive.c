@@ -1097,6 +1097,131 @@ void msTransformShapeToPixelDoublePrecision(shapeObj *shape, rectObj extent, dou
 
 
 
+/*
+** Vector tile helpers, shared by the MVT and MapML tile writers. The tile
+** grid goes from 0 to tile_extent on both axes over the extent.
+*/
+
+/* Drop the parts of the shape with less than minpoints points */
+static void msRemoveSmallParts(shapeObj *shape, int minpoints)
+{
+  int i, outi;
+
+  for(i=0, outi=0; i<shape->numlines; i++) {
+    if(shape->line[i].numpoints < minpoints) {
+      free(shape->line[i].point);
+      continue;
+    }
+    shape->line[outi++] = shape->line[i];
+  }
+  shape->numlines = outi;
+}
+
+/*
+** Snaps the shape to the tile grid, dropping the repeated points. With
+** MS_TILEGRID_YDOWN the y axis points down from the top of the tile, and
+** with MS_TILEGRID_TRUNCATE the coordinates are truncated instead of
+** rounded. Parts are left as they are, degenerate ones included, so that
+** they still match the list of msGetOuterList() computed beforehand.
+*/
+int msTransformShapeToTileGrid(shapeObj *shape, rectObj *extent, int tile_extent, int flags)
+{
+  double scale_x, scale_y, x, y;
+  int i, j, outj;
+
+  scale_x = (double)tile_extent/(extent->maxx - extent->minx);
+  scale_y = (double)tile_extent/(extent->maxy - extent->miny);
+
+  for(i=0; i<shape->numlines; i++) {
+    for(j=0, outj=0; j<shape->line[i].numpoints; j++) {
+      x = (shape->line[i].point[j].x - extent->minx)*scale_x;
+      y = (shape->line[i].point[j].y - extent->miny)*scale_y;
+      if(flags & MS_TILEGRID_TRUNCATE) {
+        x = (int)x;
+        y = (int)y;
+      } else {
+        x = MS_NINT(x);
+        y = MS_NINT(y);
+      }
+      shape->line[i].point[outj].x = x;
+      shape->line[i].point[outj].y = (flags & MS_TILEGRID_YDOWN) ? tile_extent - y : y;
+
+      if(!outj || shape->line[i].point[outj].x != shape->line[i].point[outj-1].x || shape->line[i].point[outj].y != shape->line[i].point[outj-1].y)
+        outj++; /* add the point to the shape only if it's the first one or if it's different than the previous one */
+    }
+    shape->line[i].numpoints = outj;
+  }
+
+  msComputeBounds(shape);
+
+  return (shape->numlines == 0)?MS_FAILURE:MS_SUCCESS; /* success if at least one line */
+}
+
+/*
+** Clips a shape in tile grid coordinates to the tile grown by buffer grid
+** units and drops the parts left with too few points for the layer type.
+*/
+int msClipShapeToTileGrid(shapeObj *shape, int layer_type, double buffer, int tile_extent)
+{
+  rectObj tile_rect;
+  int i, j, outj;
+
+  tile_rect.minx = tile_rect.miny = -buffer;
+  tile_rect.maxx = tile_rect.maxy = tile_extent + buffer;
+
+  if(layer_type == MS_LAYER_POLYGON) {
+    msClipPolygonRect(shape, tile_rect);
+  } else if(layer_type == MS_LAYER_LINE) {
+    msClipPolylineRect(shape, tile_rect);
+  } else {
+    for(i=0; i<shape->numlines; i++) {
+      for(j=0, outj=0; j<shape->line[i].numpoints; j++) {
+        if(msPointInRect(&(shape->line[i].point[j]), &tile_rect))
+          shape->line[i].point[outj++] = shape->line[i].point[j];
+      }
+      shape->line[i].numpoints = outj;
+    }
+  }
+  msRemoveSmallParts(shape, layer_type == MS_LAYER_POLYGON ? 4 : layer_type == MS_LAYER_LINE ? 2 : 1);
+
+  /* success if at least one line and not a degenerate bounding box */
+  if(shape->numlines > 0 && (layer_type == MS_LAYER_POINT || (shape->bounds.minx != shape->bounds.maxx || shape->bounds.miny != shape->bounds.maxy)))
+    return MS_SUCCESS;
+  else
+    return MS_FAILURE;
+}
+
+/*
+** Radial distance simplification of a shape in tile grid coordinates: drop
+** the vertices closer than tolerance to the last kept one, always keeping
+** the ends.
+*/
+int msSimplifyShapeOnTileGrid(shapeObj *shape, int layer_type, double tolerance)
+{
+  const double sqTolerance = tolerance*tolerance;
+  int i, j, outj;
+
+  if(layer_type == MS_LAYER_POINT || tolerance <= 0)
+    return MS_SUCCESS;
+
+  for(i=0; i<shape->numlines; i++) {
+    lineObj *line = &(shape->line[i]);
+    if(line->numpoints < 3)
+      continue;
+    for(j=1, outj=1; j<line->numpoints; j++) {
+      double dx = line->point[j].x - line->point[outj-1].x;
+      double dy = line->point[j].y - line->point[outj-1].y;
+      if(j == line->numpoints-1 || dx*dx + dy*dy >= sqTolerance)
+        line->point[outj++] = line->point[j];
+    }
+    line->numpoints = outj;
+  }
+
+  msRemoveSmallParts(shape, layer_type == MS_LAYER_POLYGON ? 4 : 2);
+
+  return (shape->numlines == 0)?MS_FAILURE:MS_SUCCESS;
+}
+
 /*
 ** Converts from map coordinates to image coordinates
 */
@@ -69,8 +69,18 @@ struct reprojectionObj
     int should_do_line_cutting;
     shapeObj splitShape;
     int bFreePJ;
+    int fastpath; /* one of the FASTPATH_ values, pj is NULL if set */
 };
 
+#define FASTPATH_NONE                0
+#define FASTPATH_LONLAT_TO_WEBMERC   1
+#define FASTPATH_WEBMERC_TO_LONLAT   2
+
+/* Sphere radius of EPSG:3857, and PROJ's latitude tolerances */
+#define WEBMERC_RADIUS 6378137.0
+#define WEBMERC_EPS_LAT 1e-12
+#define WEBMERC_EPS_POLE 1e-10
+
 /* Helps considerably for use cases like msautotest/wxs/wms_inspire.map */
 /* which involve a number of layers with same SRS, and a number of exposed */
 /* output SRS */
@@ -78,11 +88,41 @@ struct reprojectionObj
 
 typedef struct
 {
+    unsigned hash;
     char* inStr;
     char* outStr;
     PJ* pj;
 } pjCacheEntry;
 
+/* Process-wide cache of the PROJ strings of normalized pipelines. */
+/* PJ objects cannot be shared between contexts, but instantiating */
+/* a pipeline from its PROJ string avoids the costly operation */
+/* search of proj_create_crs_to_crs() for contexts that have not */
+/* seen a given in/out pair yet (new threads, pooled contexts...) */
+/* The capacity can be set with the MS_PROJ_PIPELINE_CACHE_SIZE */
+/* environment variable, 0 disabling it. Protected by TLOCK_PROJ. */
+#define PJ_PIPELINE_CACHE_DEFAULT_SIZE 256
+
+typedef struct
+{
+    unsigned hash;
+    char* inStr;
+    char* outStr;
+    char* pipeline;
+    unsigned ms_proj_lib_change_counter;
+    unsigned long last_use;
+    int next; /* next entry in the same bucket, or -1 */
+} pjPipelineCacheEntry;
+
+static pjPipelineCacheEntry* pj_pipeline_cache = NULL;
+static int* pj_pipeline_cache_buckets = NULL;
+static int pj_pipeline_cache_nbuckets = 0;
+static int pj_pipeline_cache_capacity = -1;
+static int pj_pipeline_cache_size = 0;
+static unsigned long pj_pipeline_cache_clock = 0;
+static unsigned long pj_pipeline_cache_hits = 0;
+static unsigned long pj_pipeline_cache_misses = 0;
+
 struct projectionContext
 {
     PJ_CONTEXT* proj_ctx;
@@ -110,6 +150,363 @@ static int msProjectHasLonWrapOrOver(projectionObj *in) {
     return MS_FALSE;
 }
 
+/************************************************************************/
+/*                      msProjectGetWebMercatorRole()                   */
+/*                                                                      */
+/*      Return wkp_lonlat if the projection is WGS84 geographic         */
+/*      coordinates, wkp_gmerc if it is WGS84 / Pseudo-Mercator         */
+/*      (EPSG:3857, or the equivalent +proj=merc sphere definition      */
+/*      used by the tile API), and wkp_none otherwise.                  */
+/************************************************************************/
+
+static int msProjectGetWebMercatorRole(projectionObj *p)
+{
+    int i;
+    int is_epsg3857 = MS_FALSE, is_merc = MS_FALSE, is_longlat = MS_FALSE;
+    int is_wgs84 = MS_FALSE, has_a = MS_FALSE, has_b = MS_FALSE;
+
+    if( p == NULL || p->numargs == 0 || p->gt.need_geotransform )
+        return wkp_none;
+
+    for( i = 0; i < p->numargs; i++ )
+    {
+        const char* arg = p->args[i];
+        const char* value;
+        if( arg[0] == '+' )
+            arg++;
+        value = strchr(arg, '=');
+        value = value ? value + 1 : "";
+
+        if( strcasecmp(arg, "init=epsg:4326") == 0 )
+            is_longlat = is_wgs84 = MS_TRUE;
+        else if( strcasecmp(arg, "init=epsg:3857") == 0 )
+            is_epsg3857 = MS_TRUE;
+        else if( strcasecmp(arg, "proj=longlat") == 0 ||
+                 strcasecmp(arg, "proj=latlong") == 0 )
+            is_longlat = MS_TRUE;
+        else if( strcasecmp(arg, "proj=merc") == 0 )
+            is_merc = MS_TRUE;
+        else if( strcasecmp(arg, "datum=WGS84") == 0 )
+            is_wgs84 = MS_TRUE;
+        else if( strncasecmp(arg, "a=", 2) == 0 && atof(value) == WEBMERC_RADIUS )
+            has_a = MS_TRUE;
+        else if( strncasecmp(arg, "b=", 2) == 0 && atof(value) == WEBMERC_RADIUS )
+            has_b = MS_TRUE;
+        else if( (strncasecmp(arg, "lat_ts=", 7) == 0 ||
+                  strncasecmp(arg, "lon_0=", 6) == 0 ||
+                  strncasecmp(arg, "x_0=", 4) == 0 ||
+                  strncasecmp(arg, "y_0=", 4) == 0) && atof(value) == 0.0 )
+            continue;
+        else if( strncasecmp(arg, "k=", 2) == 0 && atof(value) == 1.0 )
+            continue;
+        else if( strcasecmp(arg, "units=m") == 0 ||
+                 strcasecmp(arg, "nadgrids=@null") == 0 ||
+                 strcasecmp(arg, "wktext") == 0 ||
+                 strcasecmp(arg, "no_defs") == 0 ||
+                 strcasecmp(arg, "epsgaxis=ne") == 0 )
+            continue;
+        else
+            return wkp_none;
+    }
+
+    if( is_longlat && is_wgs84 && !is_merc && !is_epsg3857 && !has_a && !has_b )
+        return wkp_lonlat;
+    if( is_epsg3857 && !is_merc && !is_longlat && !is_wgs84 && !has_a && !has_b )
+        return wkp_gmerc;
+    /* +proj=merc on the 6378137 sphere, not the WGS84 ellipsoid */
+    if( is_merc && has_a && has_b && !is_epsg3857 && !is_longlat && !is_wgs84 )
+        return wkp_gmerc;
+    return wkp_none;
+}
+
+/************************************************************************/
+/*                       msProjectWebMercatorAdjLon()                   */
+/*                                                                      */
+/*      Same longitude wrapping as PROJ's adjlon().                     */
+/************************************************************************/
+
+static double msProjectWebMercatorAdjLon(double lon)
+{
+    if( fabs(lon) < MS_PI + 1e-12 )
+        return lon;
+    lon += MS_PI;
+    lon -= 2 * MS_PI * floor(lon / (2 * MS_PI));
+    lon -= MS_PI;
+    return lon;
+}
+
+/************************************************************************/
+/*                   msProjectLonLatToWebMercator()                     */
+/*                                                                      */
+/*      Closed-form forward kernel, matching what PROJ returns for      */
+/*      EPSG:4326 -> EPSG:3857. Points are accessed with a stride of    */
+/*      step doubles. Points that cannot be projected are set to        */
+/*      HUGE_VAL. Returns the number of failures.                       */
+/************************************************************************/
+
+static int msProjectLonLatToWebMercator(int npoints, double *x, double *y, int step)
+{
+    const double deg_to_rad = MS_PI / 180.0;
+    int i, failures = 0;
+
+    for( i = 0; i < npoints; i++, x += step, y += step )
+    {
+        double lam = *x * deg_to_rad;
+        double phi = *y * deg_to_rad;
+        if( *x == HUGE_VAL || *y == HUGE_VAL ||
+            fabs(phi) - MS_PI2 > WEBMERC_EPS_LAT ||
+            fabs(fabs(phi) - MS_PI2) <= WEBMERC_EPS_POLE )
+        {
+            *x = HUGE_VAL;
+            *y = HUGE_VAL;
+            failures++;
+            continue;
+        }
+        *x = WEBMERC_RADIUS * msProjectWebMercatorAdjLon(lam);
+        *y = WEBMERC_RADIUS * asinh(tan(phi));
+    }
+    return failures;
+}
+
+/************************************************************************/
+/*                   msProjectWebMercatorToLonLat()                     */
+/*                                                                      */
+/*      Closed-form inverse kernel, matching what PROJ returns for      */
+/*      EPSG:3857 -> EPSG:4326.                                         */
+/************************************************************************/
+
+static int msProjectWebMercatorToLonLat(int npoints, double *x, double *y, int step)
+{
+    const double rad_to_deg = 180.0 / MS_PI;
+    int i, failures = 0;
+
+    for( i = 0; i < npoints; i++, x += step, y += step )
+    {
+        if( *x == HUGE_VAL || *y == HUGE_VAL )
+        {
+            *x = HUGE_VAL;
+            *y = HUGE_VAL;
+            failures++;
+            continue;
+        }
+        *y = atan(sinh(*y / WEBMERC_RADIUS)) * rad_to_deg;
+        *x = msProjectWebMercatorAdjLon(*x / WEBMERC_RADIUS) * rad_to_deg;
+    }
+    return failures;
+}
+
+/************************************************************************/
+/*                       msProjectRunFastPath()                         */
+/************************************************************************/
+
+static int msProjectRunFastPath(reprojectionObj* reprojector,
+                                int npoints, double *x, double *y, int step)
+{
+    if( reprojector->fastpath == FASTPATH_LONLAT_TO_WEBMERC )
+        return msProjectLonLatToWebMercator(npoints, x, y, step);
+    return msProjectWebMercatorToLonLat(npoints, x, y, step);
+}
+
+/************************************************************************/
+/*                          msProjectHashPair()                         */
+/************************************************************************/
+
+static unsigned msProjectHashPair(const char* in_str, const char* out_str)
+{
+    unsigned hash = 2166136261U; /* FNV-1a */
+    const unsigned char* c;
+    for( c = (const unsigned char*)in_str; *c; c++ )
+        hash = (hash ^ *c) * 16777619U;
+    hash = (hash ^ '\n') * 16777619U;
+    for( c = (const unsigned char*)out_str; *c; c++ )
+        hash = (hash ^ *c) * 16777619U;
+    return hash;
+}
+
+/************************************************************************/
+/*                     msProjectPipelineCacheInit()                     */
+/*                                                                      */
+/*      TLOCK_PROJ must be held. Returns MS_FALSE if disabled.          */
+/************************************************************************/
+
+static int msProjectPipelineCacheInit(void)
+{
+    int i;
+    if( pj_pipeline_cache_capacity < 0 )
+    {
+        const char* size = getenv("MS_PROJ_PIPELINE_CACHE_SIZE");
+        pj_pipeline_cache_capacity = size ? atoi(size) : PJ_PIPELINE_CACHE_DEFAULT_SIZE;
+        if( pj_pipeline_cache_capacity < 0 )
+            pj_pipeline_cache_capacity = 0;
+    }
+    if( pj_pipeline_cache_capacity == 0 )
+        return MS_FALSE;
+    if( pj_pipeline_cache == NULL )
+    {
+        pj_pipeline_cache = (pjPipelineCacheEntry*)
+            msSmallCalloc(pj_pipeline_cache_capacity, sizeof(pjPipelineCacheEntry));
+        pj_pipeline_cache_nbuckets = 1;
+        while( pj_pipeline_cache_nbuckets < pj_pipeline_cache_capacity )
+            pj_pipeline_cache_nbuckets *= 2;
+        pj_pipeline_cache_buckets = (int*)
+            msSmallMalloc(pj_pipeline_cache_nbuckets * sizeof(int));
+        for( i = 0; i < pj_pipeline_cache_nbuckets; i++ )
+            pj_pipeline_cache_buckets[i] = -1;
+        pj_pipeline_cache_size = 0;
+    }
+    return MS_TRUE;
+}
+
+/************************************************************************/
+/*                    msProjectPipelineCacheLookup()                    */
+/*                                                                      */
+/*      Returns a copy of the cached pipeline, or NULL.                 */
+/************************************************************************/
+
+static char* msProjectPipelineCacheLookup(unsigned hash,
+                                          const char* in_str,
+                                          const char* out_str)
+{
+    char* pipeline = NULL;
+    int i;
+
+    msAcquireLock( TLOCK_PROJ );
+    if( msProjectPipelineCacheInit() )
+    {
+        i = pj_pipeline_cache_buckets[hash & (pj_pipeline_cache_nbuckets - 1)];
+        for( ; i >= 0; i = pj_pipeline_cache[i].next )
+        {
+            pjPipelineCacheEntry* entry = &pj_pipeline_cache[i];
+            if( entry->hash == hash &&
+                entry->ms_proj_lib_change_counter == ms_proj_lib_change_counter &&
+                strcmp(entry->inStr, in_str) == 0 &&
+                strcmp(entry->outStr, out_str) == 0 )
+            {
+                entry->last_use = ++pj_pipeline_cache_clock;
+                pipeline = msStrdup(entry->pipeline);
+                break;
+            }
+        }
+        if( pipeline )
+            pj_pipeline_cache_hits++;
+        else
+            pj_pipeline_cache_misses++;
+
+        if( msGetGlobalDebugLevel() >= MS_DEBUGLEVEL_TUNING )
+            msDebug("createNormalizedPJ(): PROJ pipeline cache %s "
+                    "(%lu hits, %lu misses, %d/%d entries)\n",
+                    pipeline ? "hit" : "miss",
+                    pj_pipeline_cache_hits, pj_pipeline_cache_misses,
+                    pj_pipeline_cache_size, pj_pipeline_cache_capacity);
+    }
+    msReleaseLock( TLOCK_PROJ );
+
+    return pipeline;
+}
+
+/************************************************************************/
+/*                    msProjectPipelineCacheUnlink()                    */
+/************************************************************************/
+
+static void msProjectPipelineCacheUnlink(int idx)
+{
+    int* link = &pj_pipeline_cache_buckets[
+        pj_pipeline_cache[idx].hash & (pj_pipeline_cache_nbuckets - 1)];
+    while( *link != idx )
+        link = &pj_pipeline_cache[*link].next;
+    *link = pj_pipeline_cache[idx].next;
+}
+
+/************************************************************************/
+/*                    msProjectPipelineCacheInsert()                    */
+/*                                                                      */
+/*      Evicts the least recently used entry when full.                 */
+/************************************************************************/
+
+static void msProjectPipelineCacheInsert(unsigned hash,
+                                         const char* in_str,
+                                         const char* out_str,
+                                         const char* pipeline)
+{
+    int i;
+    pjPipelineCacheEntry* entry;
+
+    msAcquireLock( TLOCK_PROJ );
+    if( !msProjectPipelineCacheInit() )
+    {
+        msReleaseLock( TLOCK_PROJ );
+        return;
+    }
+
+    /* Another thread may have inserted it meanwhile */
+    i = pj_pipeline_cache_buckets[hash & (pj_pipeline_cache_nbuckets - 1)];
+    for( ; i >= 0; i = pj_pipeline_cache[i].next )
+    {
+        if( pj_pipeline_cache[i].hash == hash &&
+            strcmp(pj_pipeline_cache[i].inStr, in_str) == 0 &&
+            strcmp(pj_pipeline_cache[i].outStr, out_str) == 0 )
+            break;
+    }
+
+    if( i < 0 && pj_pipeline_cache_size < pj_pipeline_cache_capacity )
+    {
+        i = pj_pipeline_cache_size++;
+    }
+    else
+    {
+        if( i < 0 )
+        {
+            int j;
+            i = 0;
+            for( j = 1; j < pj_pipeline_cache_size; j++ )
+            {
+                if( pj_pipeline_cache[j].last_use < pj_pipeline_cache[i].last_use )
+                    i = j;
+            }
+        }
+        msProjectPipelineCacheUnlink(i);
+        msFree(pj_pipeline_cache[i].inStr);
+        msFree(pj_pipeline_cache[i].outStr);
+        msFree(pj_pipeline_cache[i].pipeline);
+    }
+
+    entry = &pj_pipeline_cache[i];
+    entry->hash = hash;
+    entry->inStr = msStrdup(in_str);
+    entry->outStr = msStrdup(out_str);
+    entry->pipeline = msStrdup(pipeline);
+    entry->ms_proj_lib_change_counter = ms_proj_lib_change_counter;
+    entry->last_use = ++pj_pipeline_cache_clock;
+    entry->next = pj_pipeline_cache_buckets[hash & (pj_pipeline_cache_nbuckets - 1)];
+    pj_pipeline_cache_buckets[hash & (pj_pipeline_cache_nbuckets - 1)] = i;
+
+    msReleaseLock( TLOCK_PROJ );
+}
+
+/************************************************************************/
+/*                    msProjectPipelineCacheCleanup()                   */
+/*                                                                      */
+/*      TLOCK_PROJ must be held.                                        */
+/************************************************************************/
+
+static void msProjectPipelineCacheCleanup(void)
+{
+    int i;
+    for( i = 0; i < pj_pipeline_cache_size; i++ )
+    {
+        msFree(pj_pipeline_cache[i].inStr);
+        msFree(pj_pipeline_cache[i].outStr);
+        msFree(pj_pipeline_cache[i].pipeline);
+    }
+    msFree(pj_pipeline_cache);
+    msFree(pj_pipeline_cache_buckets);
+    pj_pipeline_cache = NULL;
+    pj_pipeline_cache_buckets = NULL;
+    pj_pipeline_cache_nbuckets = 0;
+    pj_pipeline_cache_size = 0;
+    pj_pipeline_cache_capacity = -1;
+}
+
 /************************************************************************/
 /*                         createNormalizedPJ()                         */
 /************************************************************************/
@@ -125,17 +522,22 @@ static PJ* createNormalizedPJ(projectionObj *in, projectionObj *out, int* pbFree
         proj_as_proj_string(out->proj_ctx->proj_ctx, out->proj, PJ_PROJ_4, NULL) :
         proj_as_wkt(out->proj_ctx->proj_ctx, out->proj, PJ_WKT2_2018, wkt_options);
     PJ* pj_raw;
-    PJ* pj_normalized;
+    PJ* pj_normalized = NULL;
+    unsigned hash;
+    char* pipeline;
     if( !in_str || !out_str )
         return NULL;
 
+    hash = msProjectHashPair(in_str, out_str);
+
     if( in->proj_ctx->proj_ctx == out->proj_ctx->proj_ctx )
     {
         int i;
         pjCacheEntry* pj_cache = in->proj_ctx->pj_cache;
         for( i = 0; i < in->proj_ctx->pj_cache_size; i++ )
         {
-            if (strcmp(pj_cache[i].inStr, in_str) == 0 &&
+            if (pj_cache[i].hash == hash &&
+                strcmp(pj_cache[i].inStr, in_str) == 0 &&
                 strcmp(pj_cache[i].outStr, out_str) == 0 )
             {
                 PJ* ret = pj_cache[i].pj;
@@ -162,6 +564,21 @@ static PJ* createNormalizedPJ(projectionObj *in, projectionObj *out, int* pbFree
     fprintf(stderr, "cache miss!\n");
 #endif
 
+    /* -------------------------------------------------------------------- */
+    /*      Instantiate from the process-wide pipeline cache if we can.     */
+    /* -------------------------------------------------------------------- */
+    pipeline = msProjectPipelineCacheLookup(hash, in_str, out_str);
+    if( pipeline )
+    {
+        pj_normalized = proj_create(in->proj_ctx->proj_ctx, pipeline);
+        msFree(pipeline);
+    }
+
+    if( pj_normalized )
+    {
+        /* done */
+    }
+    else
 #if PROJ_VERSION_MAJOR == 6 && PROJ_VERSION_MINOR < 2
     if( strstr(in_str, "+proj=") && strstr(in_str, "+over") &&
         strstr(out_str, "+proj=") && strstr(out_str, "+over") &&
@@ -216,6 +633,16 @@ static PJ* createNormalizedPJ(projectionObj *in, projectionObj *out, int* pbFree
             return NULL;
         pj_normalized = proj_normalize_for_visualization(in->proj_ctx->proj_ctx, pj_raw);
         proj_destroy(pj_raw);
+
+        /* Only single operations can be exported as a PROJ string. */
+        /* A set of alternative operations is not cached. */
+        if( pj_normalized )
+        {
+            const char* pipeline_str =
+                proj_as_proj_string(in->proj_ctx->proj_ctx, pj_normalized, PJ_PROJ_5, NULL);
+            if( pipeline_str )
+                msProjectPipelineCacheInsert(hash, in_str, out_str, pipeline_str);
+        }
     }
     if( !pj_normalized )
         return NULL;
@@ -241,6 +668,7 @@ static PJ* createNormalizedPJ(projectionObj *in, projectionObj *out, int* pbFree
             memmove(&pj_cache[1], &pj_cache[0],
                     (PJ_CACHE_ENTRY_SIZE - 1) * sizeof(pjCacheEntry));
         }
+        pj_cache[i].hash = hash;
         pj_cache[i].inStr = msStrdup(in_str);
         pj_cache[i].outStr = msStrdup(out_str);
         pj_cache[i].pj = pj_normalized;
@@ -379,6 +807,20 @@ reprojectionObj* msProjectCreateReprojector(projectionObj* in, projectionObj* ou
         /* do nothing, no transformation required */
     }
     /* -------------------------------------------------------------------- */
+    /*      WGS84 to/from Web Mercator goes through built-in closed form    */
+    /*      kernels instead of a PROJ pipeline.                             */
+    /* -------------------------------------------------------------------- */
+    else if( in && in->proj && out && out->proj &&
+             msProjectGetWebMercatorRole(in) == wkp_lonlat &&
+             msProjectGetWebMercatorRole(out) == wkp_gmerc ) {
+        obj->fastpath = FASTPATH_LONLAT_TO_WEBMERC;
+    }
+    else if( in && in->proj && out && out->proj &&
+             msProjectGetWebMercatorRole(in) == wkp_gmerc &&
+             msProjectGetWebMercatorRole(out) == wkp_lonlat ) {
+        obj->fastpath = FASTPATH_WEBMERC_TO_LONLAT;
+    }
+    /* -------------------------------------------------------------------- */
     /*      If we have a fully defined input coordinate system and          */
     /*      output coordinate system, then we will use createNormalizedPJ   */
     /* -------------------------------------------------------------------- */
@@ -462,6 +904,10 @@ void msProjectDestroyReprojector(reprojectionObj* reprojector)
 int msProjectTransformPoints( reprojectionObj* reprojector,
                               int npoints, double* x, double* y )
 {
+    if( reprojector->fastpath ) {
+        msProjectRunFastPath(reprojector, npoints, x, y, 1);
+        return MS_SUCCESS;
+    }
     proj_trans_generic (reprojector->pj, PJ_FWD,
                         x, sizeof(double), npoints,
                         y, sizeof(double), npoints,
@@ -957,7 +1403,11 @@ int msProjectPointEx(reprojectionObj* reprojector, pointObj *point)
   }
 
 #if PROJ_VERSION_MAJOR >= 6
-  if( reprojector->pj ) {
+  if( reprojector->fastpath ) {
+    if( msProjectRunFastPath(reprojector, 1, &(point->x), &(point->y), 1) > 0 )
+      return MS_FAILURE;
+  }
+  else if( reprojector->pj ) {
     PJ_COORD c;
     c.xyzt.x = point->x;
     c.xyzt.y = point->y;
@@ -1055,6 +1505,78 @@ int msProjectPointEx(reprojectionObj* reprojector, pointObj *point)
   return(MS_SUCCESS);
 }
 
+/************************************************************************/
+/*                          msProjectPointsEx()                         */
+/*                                                                      */
+/*      Reproject an array of points in place. With PROJ >= 6 the       */
+/*      whole array goes through a single proj_trans_generic() call,    */
+/*      and the input and output geotransforms are applied over the     */
+/*      array. Points that fail to reproject are set to HUGE_VAL.       */
+/*      Returns the number of points that failed.                       */
+/************************************************************************/
+static int msProjectPointsEx(reprojectionObj* reprojector,
+                             int npoints, pointObj *points)
+{
+  int i, failures = 0;
+  projectionObj* in = reprojector->in;
+  projectionObj* out = reprojector->out;
+
+#if PROJ_VERSION_MAJOR >= 6
+  if( in && in->gt.need_geotransform ) {
+    const double *gt = in->gt.geotransform;
+    for( i = 0; i < npoints; i++ ) {
+      double x_out = gt[0] + gt[1] * points[i].x + gt[2] * points[i].y;
+      double y_out = gt[3] + gt[4] * points[i].x + gt[5] * points[i].y;
+      points[i].x = x_out;
+      points[i].y = y_out;
+    }
+  }
+
+  if( reprojector->fastpath && npoints > 0 ) {
+    failures = msProjectRunFastPath(reprojector, npoints,
+                                    &(points[0].x), &(points[0].y),
+                                    sizeof(pointObj) / sizeof(double));
+  }
+  else if( reprojector->pj && npoints > 0 ) {
+    proj_trans_generic (reprojector->pj, PJ_FWD,
+                        &(points[0].x), sizeof(pointObj), npoints,
+                        &(points[0].y), sizeof(pointObj), npoints,
+                        NULL, 0, 0,
+                        NULL, 0, 0 );
+    for( i = 0; i < npoints; i++ ) {
+      if( points[i].x == HUGE_VAL || points[i].y == HUGE_VAL ) {
+        points[i].x = HUGE_VAL;
+        points[i].y = HUGE_VAL;
+        failures++;
+      }
+    }
+  }
+
+  if( out && out->gt.need_geotransform ) {
+    const double *invgt = out->gt.invgeotransform;
+    for( i = 0; i < npoints; i++ ) {
+      double x_out, y_out;
+      if( points[i].x == HUGE_VAL )
+        continue;
+      x_out = invgt[0] + invgt[1] * points[i].x + invgt[2] * points[i].y;
+      y_out = invgt[3] + invgt[4] * points[i].x + invgt[5] * points[i].y;
+      points[i].x = x_out;
+      points[i].y = y_out;
+    }
+  }
+#else
+  for( i = 0; i < npoints; i++ ) {
+    if( msProjectPointEx(reprojector, &(points[i])) == MS_FAILURE ) {
+      points[i].x = HUGE_VAL;
+      points[i].y = HUGE_VAL;
+      failures++;
+    }
+  }
+#endif
+
+  return failures;
+}
+
 /************************************************************************/
 /*                         msProjectGrowRect()                          */
 /************************************************************************/
@@ -1251,6 +1773,7 @@ msProjectShapeLine(reprojectionObj* reprojector,
 {
   int i;
   pointObj  lastPoint, thisPoint, wrkPoint;
+  pointObj *projPoints;
   lineObj *line = shape->line + line_index;
   lineObj *line_out = line;
   int valid_flag = 0; /* 1=true, -1=false, 0=unknown */
@@ -1342,6 +1865,14 @@ msProjectShapeLine(reprojectionObj* reprojector,
   wrap_test = out != NULL && out->proj != NULL && msProjIsGeographicCRS(out)
               && !msProjIsGeographicCRS(in);
 
+  /* -------------------------------------------------------------------- */
+  /*      Reproject all the input points in one batch before walking     */
+  /*      the linestring, since the output is written over the input.    */
+  /* -------------------------------------------------------------------- */
+  projPoints = (pointObj*) msSmallMalloc(sizeof(pointObj) * MS_MAX(numpoints_in, 1));
+  memcpy( projPoints, line->point, sizeof(pointObj) * numpoints_in );
+  msProjectPointsEx( reprojector, numpoints_in, projPoints );
+
   line->numpoints = 0;
 
   memset( &lastPoint, 0, sizeof(lastPoint) );
@@ -1351,9 +1882,10 @@ msProjectShapeLine(reprojectionObj* reprojector,
   /* -------------------------------------------------------------------- */
   for( i=0; i < numpoints_in; i++ ) {
     int ms_err;
-    wrkPoint = thisPoint = line->point[i];
+    thisPoint = line->point[i];
+    wrkPoint = projPoints[i];
 
-    ms_err = msProjectPointEx(reprojector, &wrkPoint );
+    ms_err = (wrkPoint.x == HUGE_VAL) ? MS_FAILURE : MS_SUCCESS;
 
     /* -------------------------------------------------------------------- */
     /*      Apply wrap logic.                                               */
@@ -1489,6 +2021,8 @@ msProjectShapeLine(reprojectionObj* reprojector,
     lastPoint = thisPoint;
   }
 
+  msFree( projPoints );
+
   /* -------------------------------------------------------------------- */
   /*      Make sure that polygons are closed, even if the trip over       */
   /*      the horizon left them unclosed.                                 */
@@ -1613,41 +2147,46 @@ int msProjectLineEx(reprojectionObj* reprojector, lineObj *line)
                  msProjIsGeographicCRS(reprojector->out)
                  && !msProjIsGeographicCRS(reprojector->in);
 
-  if( be_careful ) {
-    pointObj  startPoint, thisPoint; /* locations in projected space */
+  if( be_careful && line->numpoints > 0 ) {
+    pointObj *srcPoints; /* unprojected input locations */
 
-    startPoint = line->point[0];
+    srcPoints = (pointObj*) msSmallMalloc(sizeof(pointObj) * line->numpoints);
+    memcpy( srcPoints, line->point, sizeof(pointObj) * line->numpoints );
 
-    for(i=0; i<line->numpoints; i++) {
-      double  dist;
+    if( msProjectPointsEx(reprojector, line->numpoints, line->point) > 0 ) {
+      /* Failed points are left as msProjectPointEx() leaves them */
+      for(i=0; i<line->numpoints; i++) {
+        if( line->point[i].x == HUGE_VAL ) {
+          line->point[i] = srcPoints[i];
+          msProjectPointEx(reprojector, &(line->point[i]));
+        }
+      }
+    }
 
-      thisPoint = line->point[i];
+    for(i=1; i<line->numpoints; i++) {
+      double  dist;
 
       /*
       ** Read comments before msTestNeedWrap() to better understand
       ** this dateline wrapping logic.
       */
-      msProjectPointEx(reprojector, &(line->point[i]));
-      if( i > 0 ) {
-        dist = line->point[i].x - line->point[0].x;
-        if( fabs(dist) > 180.0 ) {
-          if( msTestNeedWrap( thisPoint, startPoint,
-                              line->point[0], reprojector ) ) {
-            if( dist > 0.0 ) {
-              line->point[i].x -= 360.0;
-            } else if( dist < 0.0 ) {
-              line->point[i].x += 360.0;
-            }
+      dist = line->point[i].x - line->point[0].x;
+      if( fabs(dist) > 180.0 ) {
+        if( msTestNeedWrap( srcPoints[i], srcPoints[0],
+                            line->point[0], reprojector ) ) {
+          if( dist > 0.0 ) {
+            line->point[i].x -= 360.0;
+          } else if( dist < 0.0 ) {
+            line->point[i].x += 360.0;
           }
         }
-
       }
     }
-  } else {
-    for(i=0; i<line->numpoints; i++) {
-      if( msProjectPointEx(reprojector, &(line->point[i])) == MS_FAILURE )
-        return MS_FAILURE;
-    }
+
+    msFree( srcPoints );
+  } else if( !be_careful ) {
+    if( msProjectPointsEx(reprojector, line->numpoints, line->point) > 0 )
+      return MS_FAILURE;
   }
 
   return(MS_SUCCESS);
@@ -2755,5 +3294,8 @@ void msProjectionContextPoolCleanup()
         link = next;
     }
     headOfLinkedListOfProjContext = NULL;
+#if PROJ_VERSION_MAJOR >= 6
+    msProjectPipelineCacheCleanup();
+#endif
     msReleaseLock( TLOCK_PROJ );
 }
@@ -195,19 +195,100 @@ int msQuantizeRasterBuffer(rasterBufferObj *rb,
 }
 
 
+/*
+ ** Coarse inverse colormap used to speed up the search of the closest palette
+ ** entry: the RGBA cube is split in (256>>ICM_SHIFT)^4 cells, and for each cell
+ ** we keep the list of palette entries that can be the closest match of one of
+ ** its colors, i.e. the entries whose minimal distance to the cell is not
+ ** greater than the smallest maximal distance of any entry to the cell.
+ ** Lists are built lazily, the first time a color of the cell is looked up,
+ ** and are kept in palette order so that ties resolve as a full scan would.
+ */
+#define ICM_SHIFT 5
+#define ICM_LEVELS (256 >> ICM_SHIFT)
+#define ICM_CELL(r,g,b,a) ((((((r) >> ICM_SHIFT) * ICM_LEVELS + ((g) >> ICM_SHIFT)) * ICM_LEVELS + \
+                            ((b) >> ICM_SHIFT)) * ICM_LEVELS) + ((a) >> ICM_SHIFT))
+
+typedef struct {
+  int *cell_start; /* offset of the cell's list in entries, -1 if not built yet */
+  short *cell_count;
+  unsigned char *entries;
+  int num_entries, max_entries;
+} inverseColormap;
+
+static void icm_init(inverseColormap *icm)
+{
+  int ncells = ICM_LEVELS * ICM_LEVELS * ICM_LEVELS * ICM_LEVELS;
+  icm->cell_start = (int*)msSmallMalloc(ncells * sizeof(int));
+  memset(icm->cell_start, 0xff, ncells * sizeof(int));
+  icm->cell_count = (short*)msSmallMalloc(ncells * sizeof(short));
+  icm->num_entries = 0;
+  icm->max_entries = 4096;
+  icm->entries = (unsigned char*)msSmallMalloc(icm->max_entries);
+}
+
+static void icm_free(inverseColormap *icm)
+{
+  free(icm->cell_start);
+  free(icm->cell_count);
+  free(icm->entries);
+}
+
+static void icm_build_cell(inverseColormap *icm, int cell, rgbaPixel *pP,
+                           rgbaPixel *palette, int num_palette_entries)
+{
+  int i, c, lo[4], v[4];
+  long mindist[256], maxdist, minmaxdist = 2000000000;
+
+  lo[0] = (PAM_GETR(*pP) >> ICM_SHIFT) << ICM_SHIFT;
+  lo[1] = (PAM_GETG(*pP) >> ICM_SHIFT) << ICM_SHIFT;
+  lo[2] = (PAM_GETB(*pP) >> ICM_SHIFT) << ICM_SHIFT;
+  lo[3] = (PAM_GETA(*pP) >> ICM_SHIFT) << ICM_SHIFT;
+
+  for ( i = 0; i < num_palette_entries; ++i ) {
+    v[0] = PAM_GETR( palette[i] );
+    v[1] = PAM_GETG( palette[i] );
+    v[2] = PAM_GETB( palette[i] );
+    v[3] = PAM_GETA( palette[i] );
+    mindist[i] = maxdist = 0;
+    for ( c = 0; c < 4; ++c ) {
+      int hi = lo[c] + (1 << ICM_SHIFT) - 1;
+      int dmin = v[c] < lo[c] ? lo[c] - v[c] : (v[c] > hi ? v[c] - hi : 0);
+      int dmax = MS_MAX(v[c] - lo[c], hi - v[c]);
+      mindist[i] += dmin * dmin;
+      maxdist += dmax * dmax;
+    }
+    if ( maxdist < minmaxdist )
+      minmaxdist = maxdist;
+  }
+
+  if ( icm->num_entries + num_palette_entries > icm->max_entries ) {
+    icm->max_entries = MS_MAX(icm->max_entries * 2, icm->num_entries + num_palette_entries);
+    icm->entries = (unsigned char*)msSmallRealloc(icm->entries, icm->max_entries);
+  }
+  icm->cell_start[cell] = icm->num_entries;
+  for ( i = 0; i < num_palette_entries; ++i ) {
+    if ( mindist[i] <= minmaxdist )
+      icm->entries[icm->num_entries++] = (unsigned char)i;
+  }
+  icm->cell_count[cell] = (short)(icm->num_entries - icm->cell_start[cell]);
+}
+
 int msClassifyRasterBuffer(rasterBufferObj *rb, rasterBufferObj *qrb)
 {
   register int ind;
   unsigned char *outrow,*pQ;
   register rgbaPixel *pP;
   acolorhash_table acht;
-  int usehash, row, col;
+  inverseColormap icm;
+  int usehash, hashedcolors = 0, row, col;
   /*
    ** Step 4: map the colors in the image to their closest match in the
    ** new colormap, and write 'em out.
    */
   acht = pam_allocacolorhash( );
   usehash = 1;
+  icm_init(&icm);
 
   for ( row = 0; row < qrb->height; ++row ) {
     outrow = &(qrb->data.palette.pixels[row*qrb->width]);
@@ -218,32 +299,42 @@ int msClassifyRasterBuffer(rasterBufferObj *rb, rasterBufferObj *qrb)
       /* Check hash table to see if we have already matched this color. */
       ind = pam_lookupacolor( acht, pP );
       if ( ind == -1 ) {
-        /* No; search acolormap for closest match. */
+        /* No; search the candidates of the color's cell for the closest match. */
         register int i, r1, g1, b1, a1, r2, g2, b2, a2;
         register long dist, newdist;
+        const unsigned char *candidates;
+        int cell, ncandidates;
 
         r1 = PAM_GETR( *pP );
         g1 = PAM_GETG( *pP );
         b1 = PAM_GETB( *pP );
         a1 = PAM_GETA( *pP );
+        cell = ICM_CELL( r1, g1, b1, a1 );
+        if ( icm.cell_start[cell] < 0 )
+          icm_build_cell( &icm, cell, pP, qrb->data.palette.palette, qrb->data.palette.num_entries );
+        candidates = &icm.entries[icm.cell_start[cell]];
+        ncandidates = icm.cell_count[cell];
+
         dist = 2000000000;
-        for ( i = 0; i < qrb->data.palette.num_entries; ++i ) {
-          r2 = PAM_GETR( qrb->data.palette.palette[i] );
-          g2 = PAM_GETG( qrb->data.palette.palette[i] );
-          b2 = PAM_GETB( qrb->data.palette.palette[i] );
-          a2 = PAM_GETA( qrb->data.palette.palette[i] );
-          /* GRR POSSIBLE BUG */
-          newdist = ( r1 - r2 ) * ( r1 - r2 ) +  /* may overflow? */
+        for ( i = 0; i < ncandidates; ++i ) {
+          const rgbaPixel *entry = &qrb->data.palette.palette[candidates[i]];
+          r2 = PAM_GETR( *entry );
+          g2 = PAM_GETG( *entry );
+          b2 = PAM_GETB( *entry );
+          a2 = PAM_GETA( *entry );
+          newdist = ( r1 - r2 ) * ( r1 - r2 ) +
                     ( g1 - g2 ) * ( g1 - g2 ) +
                     ( b1 - b2 ) * ( b1 - b2 ) +
                     ( a1 - a2 ) * ( a1 - a2 );
           if ( newdist < dist ) {
-            ind = i;
+            ind = candidates[i];
             dist = newdist;
           }
         }
+        /* Stop feeding the hash once its chains get longer than the cell
+         * search, which happens with images with lots of distinct colors */
         if ( usehash ) {
-          if ( pam_addtoacolorhash( acht, pP, ind ) < 0 ) {
+          if ( ++hashedcolors > MAXCOLORS || pam_addtoacolorhash( acht, pP, ind ) < 0 ) {
             usehash = 0;
           }
         }
@@ -259,6 +350,7 @@ int msClassifyRasterBuffer(rasterBufferObj *rb, rasterBufferObj *qrb)
     } while ( col != rb->width );
   }
   pam_freeacolorhash(acht);
+  icm_free(&icm);
 
   return MS_SUCCESS;
 }
@@ -76,6 +76,9 @@ int msInitQuery(queryObj *query) {
   query->max_cached_shape_count = 0;
   query->max_cached_shape_ram_amount = 0;
 
+  query->result_callback = NULL;
+  query->result_callback_data = NULL;
+
   return MS_SUCCESS;
 }
 
@@ -199,24 +202,38 @@ static int canCacheShape(mapObj* map, queryCacheObj *queryCache,
   return MS_TRUE;
 }
 
-static int addResult(mapObj* map, resultCacheObj *cache,
+static int addResult(mapObj* map, layerObj *lp,
                      queryCacheObj* queryCache, shapeObj *shape)
 {
+  resultCacheObj *cache = lp->resultcache;
   int i;
-  int shape_ram_size = (map->query.max_cached_shape_ram_amount > 0) ? 
-                                            msGetShapeRAMSize( shape ) : 0;
-  int store_shape = canCacheShape (map, queryCache, shape, shape_ram_size);
+  int shape_ram_size, store_shape;
 
-  if(cache->numresults == cache->cachesize) { /* just add it to the end */
-    if(cache->cachesize == 0)
-      cache->results = (resultObj *) malloc(sizeof(resultObj)*MS_RESULTCACHEINCREMENT);
+  if(map->query.result_callback) { /* streamed, only the count and bounds are kept */
+    if(map->query.result_callback(map, lp, shape, map->query.result_callback_data) != MS_SUCCESS)
+      return(MS_FAILURE);
+    cache->numresults++;
+    cache->previousBounds = cache->bounds;
+    if(cache->numresults == 1)
+      cache->bounds = shape->bounds;
     else
-      cache->results = (resultObj *) realloc(cache->results, sizeof(resultObj)*(cache->cachesize+MS_RESULTCACHEINCREMENT));
-    if(!cache->results) {
+      msMergeRect(&(cache->bounds), &(shape->bounds));
+    return(MS_SUCCESS);
+  }
+
+  shape_ram_size = (map->query.max_cached_shape_ram_amount > 0) ?
+                                            msGetShapeRAMSize( shape ) : 0;
+  store_shape = canCacheShape (map, queryCache, shape, shape_ram_size);
+
+  if(cache->numresults == cache->cachesize) { /* double the size, so filling the cache stays linear */
+    int cachesize = (cache->cachesize == 0) ? MS_RESULTCACHEINITSIZE : 2*cache->cachesize;
+    resultObj *results = (resultObj *) realloc(cache->results, sizeof(resultObj)*cachesize);
+    if(!results) {
       msSetError(MS_MEMERR, "Realloc() error.", "addResult()");
       return(MS_FAILURE);
     }
-    cache->cachesize += MS_RESULTCACHEINCREMENT;
+    cache->results = results;
+    cache->cachesize = cachesize;
   }
 
   i = cache->numresults;
@@ -651,7 +668,7 @@ int msQueryByIndex(mapObj *map)
     return(MS_FAILURE);
   }
   
-  addResult(map, lp->resultcache, &queryCache, &shape);
+  addResult(map, lp, &queryCache, &shape);
 
   msFreeShape(&shape);
   /* msLayerClose(lp); */
@@ -962,7 +979,7 @@ int msQueryByFilter(mapObj *map)
       if( map->query.only_cache_result_count )
         lp->resultcache->numresults ++;
       else
-        addResult(map, lp->resultcache, &queryCache, &shape);
+        addResult(map, lp, &queryCache, &shape);
       msFreeShape(&shape);
 
       if(map->query.mode == MS_QUERY_SINGLE) { /* no need to look any further */
@@ -1267,7 +1284,7 @@ int msQueryByRect(mapObj *map)
         if( map->query.only_cache_result_count )
             lp->resultcache->numresults ++;
         else
-            addResult(map, lp->resultcache, &queryCache, &shape);
+            addResult(map, lp, &queryCache, &shape);
         --map->query.maxfeatures;
       }
       msFreeShape(&shape);
@@ -1306,14 +1323,85 @@ int msQueryByRect(mapObj *map)
   return(MS_FAILURE);
 }
 
-static int is_duplicate(resultCacheObj *resultcache, int shapeindex, int tileindex)
+/*
+** Set of the (tileindex, shapeindex) pairs already in a result cache, so that
+** msQueryByFeatures() doesn't select a shape twice when several selection
+** features overlap it. Open addressing, kept at most half full.
+*/
+typedef struct {
+  long shapeindex;
+  int tileindex;
+  int used;
+} resultKeyObj;
+
+typedef struct {
+  resultKeyObj *keys;
+  unsigned int size; /* a power of 2 */
+  unsigned int count;
+} resultSetObj;
+
+static void initResultSet(resultSetObj *set)
 {
-  int i;
+  set->keys = NULL;
+  set->size = set->count = 0;
+}
+
+static void freeResultSet(resultSetObj *set)
+{
+  msFree(set->keys);
+  initResultSet(set);
+}
+
+static unsigned int hashResultKey(long shapeindex, int tileindex)
+{
+  unsigned long long h = (unsigned long long) shapeindex * 0x9E3779B97F4A7C15ULL;
+  h ^= (unsigned long long)(unsigned int) tileindex * 0xC2B2AE3D27D4EB4FULL;
+  return (unsigned int)(h >> 32);
+}
 
-  for(i=0; i<resultcache->numresults; i++)
-    if(resultcache->results[i].shapeindex == shapeindex && resultcache->results[i].tileindex == tileindex) return(MS_TRUE);
+/* returns the slot holding the pair, or the empty slot where it belongs */
+static resultKeyObj *findResultKey(resultSetObj *set, long shapeindex, int tileindex)
+{
+  unsigned int i = hashResultKey(shapeindex, tileindex) & (set->size-1);
 
-  return(MS_FALSE);
+  while(set->keys[i].used && (set->keys[i].shapeindex != shapeindex || set->keys[i].tileindex != tileindex))
+    i = (i+1) & (set->size-1);
+
+  return &(set->keys[i]);
+}
+
+static int is_duplicate(resultSetObj *set, long shapeindex, int tileindex)
+{
+  if(set->count == 0) return(MS_FALSE);
+  return findResultKey(set, shapeindex, tileindex)->used;
+}
+
+static void addResultKey(resultSetObj *set, long shapeindex, int tileindex)
+{
+  resultKeyObj *key;
+
+  if(2*(set->count+1) > set->size) { /* rehash into a table twice as large */
+    resultSetObj grown;
+    unsigned int i;
+
+    grown.size = (set->size == 0) ? 64 : 2*set->size;
+    grown.count = set->count;
+    grown.keys = (resultKeyObj *) msSmallCalloc(grown.size, sizeof(resultKeyObj));
+    for(i=0; i<set->size; i++) {
+      if(set->keys[i].used)
+        *findResultKey(&grown, set->keys[i].shapeindex, set->keys[i].tileindex) = set->keys[i];
+    }
+    msFree(set->keys);
+    *set = grown;
+  }
+
+  key = findResultKey(set, shapeindex, tileindex);
+  if(!key->used) {
+    key->shapeindex = shapeindex;
+    key->tileindex = tileindex;
+    key->used = MS_TRUE;
+    set->count++;
+  }
 }
 
 int msQueryByFeatures(mapObj *map)
@@ -1327,13 +1415,16 @@ int msQueryByFeatures(mapObj *map)
 
   rectObj searchrect;
   shapeObj shape, selectshape;
+  segmentIndexObj *selectindex = NULL;
   int nclasses = 0;
   int *classgroup = NULL;
   double minfeaturesize = -1;
 
   queryCacheObj queryCache;
+  resultSetObj selected; /* what the layer has already selected */
 
   initQueryCache(&queryCache);
+  initResultSet(&selected);
 
   if(map->debug) msDebug("in msQueryByFeatures()\n");
 
@@ -1430,12 +1521,14 @@ int msQueryByFeatures(mapObj *map)
 
       status = msLayerGetShape(slp, &selectshape, &(slp->resultcache->results[i]));
       if(status != MS_SUCCESS) {
+        freeResultSet(&selected);
         msLayerClose(lp);
         msLayerClose(slp);
         return(MS_FAILURE);
       }
 
       if(selectshape.type != MS_SHAPE_POLYGON && selectshape.type != MS_SHAPE_LINE) {
+        freeResultSet(&selected);
         msLayerClose(lp);
         msLayerClose(slp);
         msSetError(MS_QUERYERR, "Selection features MUST be polygons or lines.", "msQueryByFeatures()");
@@ -1461,6 +1554,7 @@ int msQueryByFeatures(mapObj *map)
         msLayerClose(lp);
         break; /* next layer */
       } else if(status != MS_SUCCESS) {
+        freeResultSet(&selected);
         msLayerClose(lp);
         msLayerClose(slp);
         return(MS_FAILURE);
@@ -1470,7 +1564,6 @@ int msQueryByFeatures(mapObj *map)
         lp->resultcache = (resultCacheObj *)malloc(sizeof(resultCacheObj)); /* allocate and initialize the result cache */
         MS_CHECK_ALLOC(lp->resultcache, sizeof(resultCacheObj), MS_FAILURE);
         initResultCache( lp->resultcache);
-
       }
 
       nclasses = 0;
@@ -1481,10 +1574,17 @@ int msQueryByFeatures(mapObj *map)
       if (lp->minfeaturesize > 0)
         minfeaturesize = Pix2LayerGeoref(map, lp, lp->minfeaturesize);
 
+      /* index the selection shape once for all the intersection tests below */
+      if(tolerance == 0)
+        selectindex = msCreateSegmentIndex(&selectshape);
+
       while((status = msLayerNextShape(lp, &shape)) == MS_SUCCESS) { /* step through the shapes */
 
         /* check for dups when there are multiple selection shapes */
-        if(i > 0 && is_duplicate(lp->resultcache, shape.index, shape.tileindex)) continue;
+        if(i > 0 && is_duplicate(&selected, shape.index, shape.tileindex)) {
+          msFreeShape(&shape);
+          continue;
+        }
 
 
         /* Check if the shape size is ok to be drawn */
@@ -1525,7 +1625,7 @@ int msQueryByFeatures(mapObj *map)
             switch(shape.type) { /* make sure shape actually intersects the selectshape */
               case MS_SHAPE_POINT:
                 if(tolerance == 0) /* just test for intersection */
-                  status = msIntersectMultipointPolygon(&shape, &selectshape);
+                  status = msIntersectMultipointPolygonIndexed(&shape, &selectshape, selectindex);
                 else { /* check distance, distance=0 means they intersect */
                   distance = msDistanceShapeToShape(&selectshape, &shape);
                   if(distance < tolerance) status = MS_TRUE;
@@ -1533,7 +1633,7 @@ int msQueryByFeatures(mapObj *map)
                 break;
               case MS_SHAPE_LINE:
                 if(tolerance == 0) { /* just test for intersection */
-                  status = msIntersectPolylinePolygon(&shape, &selectshape);
+                  status = msIntersectPolylinePolygonIndexed(&shape, NULL, &selectshape, selectindex);
                 } else { /* check distance, distance=0 means they intersect */
                   distance = msDistanceShapeToShape(&selectshape, &shape);
                   if(distance < tolerance) status = MS_TRUE;
@@ -1541,7 +1641,7 @@ int msQueryByFeatures(mapObj *map)
                 break;
               case MS_SHAPE_POLYGON:
                 if(tolerance == 0) /* just test for intersection */
-                  status = msIntersectPolygons(&shape, &selectshape);
+                  status = msIntersectPolygonsIndexed(&shape, NULL, &selectshape, selectindex);
                 else { /* check distance, distance=0 means they intersect */
                   distance = msDistanceShapeToShape(&selectshape, &shape);
                   if(distance < tolerance) status = MS_TRUE;
@@ -1565,7 +1665,7 @@ int msQueryByFeatures(mapObj *map)
                 break;
               case MS_SHAPE_LINE:
                 if(tolerance == 0) { /* just test for intersection */
-                  status = msIntersectPolylines(&shape, &selectshape);
+                  status = msIntersectPolylinesIndexed(&shape, NULL, &selectshape, selectindex);
                 } else { /* check distance, distance=0 means they intersect */
                   distance = msDistanceShapeToShape(&selectshape, &shape);
                   if(distance < tolerance) status = MS_TRUE;
@@ -1573,7 +1673,7 @@ int msQueryByFeatures(mapObj *map)
                 break;
               case MS_SHAPE_POLYGON:
                 if(tolerance == 0) /* just test for intersection */
-                  status = msIntersectPolylinePolygon(&selectshape, &shape);
+                  status = msIntersectPolylinePolygonIndexed(&selectshape, selectindex, &shape, NULL);
                 else { /* check distance, distance=0 means they intersect */
                   distance = msDistanceShapeToShape(&selectshape, &shape);
                   if(distance < tolerance) status = MS_TRUE;
@@ -1595,7 +1695,9 @@ int msQueryByFeatures(mapObj *map)
             msFreeShape(&shape);
             continue;
           }
-          addResult(map, lp->resultcache, &queryCache, &shape);
+          addResult(map, lp, &queryCache, &shape);
+          if(slp->resultcache->numresults > 1)
+            addResultKey(&selected, shape.index, shape.tileindex);
         }
         msFreeShape(&shape);
 
@@ -1611,12 +1713,19 @@ int msQueryByFeatures(mapObj *map)
 
       msProjectDestroyReprojector(reprojector);
 
+      msFreeSegmentIndex(selectindex);
+      selectindex = NULL;
       msFreeShape(&selectshape);
 
-      if(status != MS_DONE) return(MS_FAILURE);
+      if(status != MS_DONE) {
+        freeResultSet(&selected);
+        return(MS_FAILURE);
+      }
 
     } /* next selection shape */
 
+    freeResultSet(&selected);
+
     if(lp->resultcache->numresults == 0) msLayerClose(lp); /* no need to keep the layer open */
   } /* next layer */
 
@@ -1830,10 +1939,10 @@ int msQueryByPoint(mapObj *map)
         if(map->query.mode == MS_QUERY_SINGLE) {
           cleanupResultCache(lp->resultcache);
           initQueryCache(&queryCache);
-          addResult(map, lp->resultcache, &queryCache, &shape);
+          addResult(map, lp, &queryCache, &shape);
           t = d; /* next one must be closer */
         } else {
-          addResult(map, lp->resultcache, &queryCache, &shape);
+          addResult(map, lp, &queryCache, &shape);
         }
       }
 
@@ -1878,6 +1987,7 @@ int msQueryByShape(mapObj *map)
 {
   int start, stop=0, l;
   shapeObj shape, *qshape=NULL;
+  segmentIndexObj *qindex=NULL;
   layerObj *lp;
   char status;
   double distance, tolerance, layer_tolerance;
@@ -2013,6 +2123,10 @@ int msQueryByShape(mapObj *map)
     if (lp->minfeaturesize > 0)
       minfeaturesize = Pix2LayerGeoref(map, lp, lp->minfeaturesize);
 
+    /* index the query shape once for all the intersection tests below */
+    if(tolerance == 0 && qshape->type != MS_SHAPE_POINT)
+      qindex = msCreateSegmentIndex(qshape);
+
     while((status = msLayerNextShape(lp, &shape)) == MS_SUCCESS) { /* step through the shapes */
 
       /* Check if the shape size is ok to be drawn */
@@ -2053,7 +2167,7 @@ int msQueryByShape(mapObj *map)
           switch(shape.type) { /* make sure shape actually intersects the shape */
             case MS_SHAPE_POINT:
               if(tolerance == 0) /* just test for intersection */
-                status = msIntersectMultipointPolygon(&shape, qshape);
+                status = msIntersectMultipointPolygonIndexed(&shape, qshape, qindex);
               else { /* check distance, distance=0 means they intersect */
                 distance = msDistanceShapeToShape(qshape, &shape);
                 if(distance < tolerance) status = MS_TRUE;
@@ -2061,7 +2175,7 @@ int msQueryByShape(mapObj *map)
               break;
             case MS_SHAPE_LINE:
               if(tolerance == 0) { /* just test for intersection */
-                status = msIntersectPolylinePolygon(&shape, qshape);
+                status = msIntersectPolylinePolygonIndexed(&shape, NULL, qshape, qindex);
               } else { /* check distance, distance=0 means they intersect */
                 distance = msDistanceShapeToShape(qshape, &shape);
                 if(distance < tolerance) status = MS_TRUE;
@@ -2069,7 +2183,7 @@ int msQueryByShape(mapObj *map)
               break;
             case MS_SHAPE_POLYGON:
               if(tolerance == 0) /* just test for intersection */
-                status = msIntersectPolygons(&shape, qshape);
+                status = msIntersectPolygonsIndexed(&shape, NULL, qshape, qindex);
               else { /* check distance, distance=0 means they intersect */
                 distance = msDistanceShapeToShape(qshape, &shape);
                 if(distance < tolerance) status = MS_TRUE;
@@ -2092,7 +2206,7 @@ int msQueryByShape(mapObj *map)
               break;
             case MS_SHAPE_LINE:
               if(tolerance == 0) { /* just test for intersection */
-                status = msIntersectPolylines(&shape, qshape);
+                status = msIntersectPolylinesIndexed(&shape, NULL, qshape, qindex);
               } else { /* check distance, distance=0 means they intersect */
                 distance = msDistanceShapeToShape(qshape, &shape);
                 if(distance < tolerance) status = MS_TRUE;
@@ -2100,7 +2214,7 @@ int msQueryByShape(mapObj *map)
               break;
             case MS_SHAPE_POLYGON:
               if(tolerance == 0) /* just test for intersection */
-                status = msIntersectPolylinePolygon(qshape, &shape);
+                status = msIntersectPolylinePolygonIndexed(qshape, qindex, &shape, NULL);
               else { /* check distance, distance=0 means they intersect */
                 distance = msDistanceShapeToShape(qshape, &shape);
                 if(distance < tolerance) status = MS_TRUE;
@@ -2128,7 +2242,7 @@ int msQueryByShape(mapObj *map)
           msFreeShape(&shape);
           continue;
         }
-        addResult(map, lp->resultcache, &queryCache, &shape);
+        addResult(map, lp, &queryCache, &shape);
       }
       msFreeShape(&shape);
 
@@ -2142,6 +2256,9 @@ int msQueryByShape(mapObj *map)
     free(classgroup);
     classgroup = NULL;
 
+    msFreeSegmentIndex(qindex);
+    qindex = NULL;
+
     msProjectDestroyReprojector(reprojector);
 
     if(status != MS_DONE) {
@@ -38,7 +38,6 @@
 
 
 extern int msyylex_destroy(void);
-extern int yyparse(parseObj *);
 
 extern parseResultObj yypresult; /* result of parsing, true/false */
 
@@ -165,7 +164,7 @@ static int msGetClass_String( layerObj *layer, colorObj *color, const char *pixe
         p.expr->curtoken = p.expr->tokens; /* reset */
         p.type = MS_PARSE_TYPE_BOOLEAN;
 
-        status = yyparse(&p);
+        status = msEvalParse(&p);
 
         if (status != 0) {
           msSetError(MS_PARSEERR, "Failed to parse expression: %s", "msGetClass_FloatRGB", expression->string);
@@ -603,8 +602,26 @@ CheckDatasetReturnType msDrawRasterLayerLowCheckDataset(mapObj *map,
     return CDRT_OK;
 }
 
+/************************************************************************/
+/*                      msDrawRasterCloseDataset()                      */
+/*                                                                      */
+/*      Unconditionally close a dataset, under TLOCK_GDAL.              */
+/************************************************************************/
+
+static void msDrawRasterCloseDataset(GDALDatasetH hDS)
+{
+  msAcquireLock( TLOCK_GDAL );
+  GDALClose( hDS );
+  msReleaseLock( TLOCK_GDAL );
+}
+
 /************************************************************************/
 /*              msDrawRasterLayerLowOpenDataset()                       */
+/*                                                                      */
+/*      TLOCK_GDAL is only held while the dataset is opened. Shared     */
+/*      datasets are keyed by the calling thread in GDAL, so the        */
+/*      returned handle is private to this thread and can be read       */
+/*      and resampled without holding the lock.                         */
 /************************************************************************/
 
 void* msDrawRasterLayerLowOpenDataset(mapObj *map, layerObj *layer,
@@ -613,6 +630,7 @@ void* msDrawRasterLayerLowOpenDataset(mapObj *map, layerObj *layer,
                                       char** p_decrypted_path)
 {
   const char* pszPath;
+  GDALDatasetH hDS;
 
   msGDALInitialize();
 
@@ -646,22 +664,27 @@ void* msDrawRasterLayerLowOpenDataset(mapObj *map, layerObj *layer,
   if( !layer->tileindex )
   {
     char** connectionoptions = msGetStringListFromHashTable(&(layer->connectionoptions));
-    GDALDatasetH hDS = GDALOpenEx( *p_decrypted_path,
-                                   GDAL_OF_RASTER | GDAL_OF_SHARED,
-                                   NULL,
-                                   (const char* const*)connectionoptions,
-                                   NULL);
+    hDS = GDALOpenEx( *p_decrypted_path,
+                      GDAL_OF_RASTER | GDAL_OF_SHARED,
+                      NULL,
+                      (const char* const*)connectionoptions,
+                      NULL);
     CSLDestroy(connectionoptions);
-    return hDS;
   }
   else
   {
-    return GDALOpenShared( *p_decrypted_path, GA_ReadOnly );
+    hDS = GDALOpenShared( *p_decrypted_path, GA_ReadOnly );
   }
+  msReleaseLock( TLOCK_GDAL );
+
+  return hDS;
 }
 
 /************************************************************************/
 /*                msDrawRasterLayerLowCloseDataset()                    */
+/*                                                                      */
+/*      Dereference or close a dataset returned by                      */
+/*      msDrawRasterLayerLowOpenDataset(), under TLOCK_GDAL.            */
 /************************************************************************/
 
 void msDrawRasterLayerLowCloseDataset(layerObj *layer, void* hDS)
@@ -684,6 +707,7 @@ void msDrawRasterLayerLowCloseDataset(layerObj *layer, void* hDS)
         CSLDestroy(connectionoptions);
       }
 
+      msAcquireLock( TLOCK_GDAL );
       if( close_connection != NULL
           && strcasecmp(close_connection,"DEFER") == 0 ) {
         GDALDereferenceDataset( (GDALDatasetH)hDS );
@@ -835,8 +859,8 @@ int msDrawRasterLayerLowWithDataset(mapObj *map, layerObj *layer, imageObj *imag
     if(layer->connectiontype == MS_KERNELDENSITY) {
       msAcquireLock( TLOCK_GDAL );
       status = msComputeKernelDensityDataset(map, image, layer, &hDS, &kernel_density_cleanup_ptr);
+      msReleaseLock( TLOCK_GDAL );
       if(status != MS_SUCCESS) {
-        msReleaseLock( TLOCK_GDAL );
         final_status = status;
         goto cleanup;
       }
@@ -846,8 +870,7 @@ int msDrawRasterLayerLowWithDataset(mapObj *map, layerObj *layer, imageObj *imag
 
         /* Set the projection to the map file projection */
         if (msLoadProjectionString(&(layer->projection), mapProjStr) != 0) {
-          GDALClose( hDS );
-          msReleaseLock( TLOCK_GDAL );
+          msDrawRasterCloseDataset( hDS );
           msSetError(MS_CGIERR, "Unable to set projection on interpolation layer.", "msDrawRasterLayerLow()");
           return(MS_FAILURE);
         }
@@ -875,24 +898,15 @@ int msDrawRasterLayerLowWithDataset(mapObj *map, layerObj *layer, imageObj *imag
         decrypted_path = NULL;
 
         if( eRet == CDRT_CONTINUE_NEXT_TILE )
-        {
-            msReleaseLock( TLOCK_GDAL );
             continue;
-        }
         if( eRet == CDRT_RETURN_MS_FAILURE )
-        {
-            msReleaseLock( TLOCK_GDAL );
             return MS_FAILURE;
-        }
     }
 
     if( msDrawRasterLoadProjection(layer, hDS, filename, tilesrsindex, tilesrsname) != MS_SUCCESS )
     {
         if( hDatasetIn == NULL )
-        {
-          GDALClose( hDS );
-          msReleaseLock( TLOCK_GDAL );
-        }
+          msDrawRasterCloseDataset( hDS );
         final_status = MS_FAILURE;
         break;
     }
@@ -929,10 +943,7 @@ int msDrawRasterLayerLowWithDataset(mapObj *map, layerObj *layer, imageObj *imag
 
     if( status == -1 ) {
       if( hDatasetIn == NULL )
-      {
-        GDALClose( hDS );
-        msReleaseLock( TLOCK_GDAL );
-      }
+        msDrawRasterCloseDataset( hDS );
       final_status = MS_FAILURE;
       break;
     }
@@ -952,8 +963,7 @@ int msDrawRasterLayerLowWithDataset(mapObj *map, layerObj *layer, imageObj *imag
       ** Note that instead of this workaround, we could explicitely set 
       ** CLOSE_CONNECTION=ALWAYS on the kerneldensity layer.
       */
-      GDALClose( hDS );
-      msReleaseLock( TLOCK_GDAL );
+      msDrawRasterCloseDataset( hDS );
     }
     else {
       if( hDatasetIn == NULL)
@@ -101,16 +101,15 @@ static int addResult(resultCacheObj *cache, int classindex, int shapeindex, int
 {
   int i;
 
-  if(cache->numresults == cache->cachesize) { /* just add it to the end */
-    if(cache->cachesize == 0)
-      cache->results = (resultObj *) malloc(sizeof(resultObj)*MS_RESULTCACHEINCREMENT);
-    else
-      cache->results = (resultObj *) realloc(cache->results, sizeof(resultObj)*(cache->cachesize+MS_RESULTCACHEINCREMENT));
-    if(!cache->results) {
+  if(cache->numresults == cache->cachesize) { /* double the size, so filling the cache stays linear */
+    int cachesize = (cache->cachesize == 0) ? MS_RESULTCACHEINITSIZE : 2*cache->cachesize;
+    resultObj *results = (resultObj *) realloc(cache->results, sizeof(resultObj)*cachesize);
+    if(!results) {
       msSetError(MS_MEMERR, "Realloc() error.", "addResult()");
       return(MS_FAILURE);
     }
-    cache->cachesize += MS_RESULTCACHEINCREMENT;
+    cache->results = results;
+    cache->cachesize = cachesize;
   }
 
   i = cache->numresults;
@@ -97,5 +97,84 @@ class MapCloningTestCase(MapCloneTestCase):
         fh.close()
 
 
+class MapCloneParsedFieldsTestCase(unittest.TestCase):
+    """msCopyMap() must reproduce everything the mapfile parser sets, since
+    the mapfile cache (MS_MAPFILE_CACHE_SIZE) serves copies of parsed maps"""
+
+    mapfile = """
+MAP
+    NAME "clonefields"
+    EXTENT 0 0 100 100
+    SIZE 100 100
+    LATLON
+        "proj=longlat"
+        "datum=NAD83"
+    END
+    WEB
+        TEMPPATH "/tmp/clone/"
+    END
+    SCALEBAR
+        OFFSET 3 4
+    END
+    LAYER
+        NAME "pg"
+        TYPE POLYGON
+        CONNECTIONTYPE POSTGIS
+        CONNECTION "dbname=none"
+        DATA "the_geom from (select * from t where id = :id) as foo using unique id"
+        BINDVALS
+            "id" "42"
+        END
+        CONNECTIONOPTIONS
+            "FLATTEN_NESTED_ATTRIBUTES" "YES"
+        END
+        GEOMTRANSFORM (buffer([shape], 5))
+        MINFEATURESIZE 3
+        UTFITEM "id"
+        UTFDATA "{\\"id\\":\\"[id]\\"}"
+        CLASS
+            MINFEATURESIZE 2
+            STYLE
+                POLAROFFSET 5 45
+                POSITION UL
+            END
+            LABEL
+                MINLENGTH 4
+            END
+        END
+    END
+END
+"""
+
+    def setUp(self):
+        self.mapobj_orig = mapscript.fromstring(self.mapfile)
+        self.mapobj_orig.getLayer(0).bandsitem = "bands"
+        self.mapobj_clone = self.mapobj_orig.clone()
+
+    def tearDown(self):
+        self.mapobj_orig = None
+        self.mapobj_clone = None
+
+    def testClonedMapfileText(self):
+        """MapCloneParsedFieldsTestCase.testClonedMapfileText: a cloned map writes out the same mapfile as the original"""
+        assert self.mapobj_clone.convertToString() == self.mapobj_orig.convertToString()
+
+    def testClonedLayerFields(self):
+        """MapCloneParsedFieldsTestCase.testClonedLayerFields: layer members not written by msSaveMap() are cloned"""
+        orig = self.mapobj_orig.getLayer(0)
+        clone = self.mapobj_clone.getLayer(0)
+        assert clone.bindvals["id"] == "42"
+        assert clone.connectionoptions["FLATTEN_NESTED_ATTRIBUTES"] == "YES"
+        assert clone.getGeomTransform() == orig.getGeomTransform()
+        assert clone.utfitem == "id"
+        assert clone.utfdata.string == orig.utfdata.string
+        assert clone.bandsitem == "bands"
+
+    def testClonedLatLon(self):
+        """MapCloneParsedFieldsTestCase.testClonedLatLon: the LATLON projection is cloned"""
+        assert self.mapobj_clone.latlon.numargs == 2
+        assert self.mapobj_clone.latlon.getUnits() == self.mapobj_orig.latlon.getUnits()
+
+
 if __name__ == '__main__':
     unittest.main()
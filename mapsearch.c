@@ -167,12 +167,6 @@ int msPointInPolygon(pointObj *p, lineObj *c)
   return status;
 }
 
-/*
-** Note: the following functions are brute force implementations. Some fancy
-** computational geometry algorithms would speed things up nicely in many
-** cases. In due time... -SDL-
-*/
-
 int msIntersectSegments(const pointObj *a, const pointObj *b, const pointObj *c, const pointObj *d)   /* from comp.graphics.alogorithms FAQ */
 {
 
@@ -213,16 +207,240 @@ int msIntersectSegments(const pointObj *a, const pointObj *b, const pointObj *c,
   return(MS_TRUE);
 }
 
+/*
+** Segment index: the segments of a shape (ring closing edges included, they
+** are only used by point in polygon tests) are cut into runs of
+** MS_SEGMENT_INDEX_NODE consecutive segments, which are spatially coherent,
+** and their bounds are packed bottom up into a tree. A search only tests the
+** segments whose bounds overlap the search rectangle, with the same tests as
+** the brute force code so the results don't change. Searches are slightly
+** enlarged so rounding in those tests can't hide an intersection, and zero
+** length segments (repeated vertices) are always tested since
+** msIntersectSegments() takes them as coincident with any segment when they
+** come second.
+**
+** Indexes are built for a query shape once and reused for every candidate
+** feature (see msQueryByShape()), or on the fly by the functions below when
+** both shapes are big enough to make the brute force comparison slow.
+*/
+#define MS_SEGMENT_INDEX_NODE 8
+#define MS_SEGMENT_INDEX_MAX_LEVELS 16
+#define MS_SEGMENT_INDEX_MIN_PAIRS 16384 /* segment pairs for which an index is built on the fly */
+
+typedef struct {
+  const pointObj *a, *b;
+  int closing; /* ring closing edge */
+} indexedSegmentObj;
+
+struct segmentIndexObj {
+  indexedSegmentObj *segments;
+  int numsegments;
+  int *degenerate; /* zero length segments, ring closing edges excepted */
+  int numdegenerate;
+  rectObj *nodes; /* leaves (runs of segments) first, then each level up to the root */
+  int levelstart[MS_SEGMENT_INDEX_MAX_LEVELS+1];
+  int numlevels;
+  double tolerance;
+};
+
+static int msShapeSegmentCount(const shapeObj *shape)
+{
+  int i, n = 0;
+
+  for(i=0; i<shape->numlines; i++)
+    if(shape->line[i].numpoints > 1) n += shape->line[i].numpoints - 1;
+  return n;
+}
+
+static void msSegmentBounds(const indexedSegmentObj *segment, rectObj *rect)
+{
+  rect->minx = MS_MIN(segment->a->x, segment->b->x);
+  rect->maxx = MS_MAX(segment->a->x, segment->b->x);
+  rect->miny = MS_MIN(segment->a->y, segment->b->y);
+  rect->maxy = MS_MAX(segment->a->y, segment->b->y);
+}
+
+/*
+** Builds the segment index of shape, which must not change (nor be freed)
+** while the index is in use.
+*/
+segmentIndexObj *msCreateSegmentIndex(shapeObj *shape)
+{
+  segmentIndexObj *index;
+  int i, j, k, n, numnodes, level;
+  double maxcoord = 1;
+  rectObj rect;
+
+  index = (segmentIndexObj *) msSmallCalloc(1, sizeof(segmentIndexObj));
+
+  /* segments in ring order, the closing edge last (as in msPointInPolygon()) */
+  n = 0;
+  for(i=0; i<shape->numlines; i++)
+    n += shape->line[i].numpoints;
+  index->segments = (indexedSegmentObj *) msSmallMalloc(sizeof(indexedSegmentObj) * MS_MAX(n, 1));
+  for(i=0; i<shape->numlines; i++) {
+    lineObj *line = &(shape->line[i]);
+    for(j=0; j<line->numpoints; j++) {
+      indexedSegmentObj *segment = &(index->segments[index->numsegments++]);
+      segment->a = (j == 0) ? &(line->point[line->numpoints-1]) : &(line->point[j-1]);
+      segment->b = &(line->point[j]);
+      segment->closing = (j == 0);
+      if(!segment->closing && segment->a->x == segment->b->x && segment->a->y == segment->b->y) {
+        index->degenerate = (int *) msSmallRealloc(index->degenerate, sizeof(int) * (index->numdegenerate + 1));
+        index->degenerate[index->numdegenerate++] = index->numsegments - 1;
+      }
+      maxcoord = MS_MAX(maxcoord, MS_MAX(fabs(line->point[j].x), fabs(line->point[j].y)));
+    }
+  }
+  index->tolerance = maxcoord * 1e-9;
+
+  /* count the nodes of each level */
+  numnodes = 0;
+  n = index->numsegments;
+  for(level=0; level < MS_SEGMENT_INDEX_MAX_LEVELS; level++) {
+    index->levelstart[level] = numnodes;
+    n = (n + MS_SEGMENT_INDEX_NODE - 1) / MS_SEGMENT_INDEX_NODE;
+    numnodes += n;
+    if(n <= 1) {
+      level++;
+      break;
+    }
+  }
+  index->numlevels = (index->numsegments > 0) ? level : 0;
+  index->levelstart[index->numlevels] = numnodes;
+  index->nodes = (rectObj *) msSmallMalloc(sizeof(rectObj) * MS_MAX(numnodes, 1));
+
+  /* leaves, then each level from the one below */
+  for(i=0; index->numlevels > 0 && i < index->levelstart[1]; i++) {
+    msSegmentBounds(&(index->segments[i * MS_SEGMENT_INDEX_NODE]), &(index->nodes[i]));
+    for(k = i * MS_SEGMENT_INDEX_NODE + 1; k < MS_MIN((i + 1) * MS_SEGMENT_INDEX_NODE, index->numsegments); k++) {
+      msSegmentBounds(&(index->segments[k]), &rect);
+      msMergeRect(&(index->nodes[i]), &rect);
+    }
+  }
+  for(level=1; level < index->numlevels; level++) {
+    int first = index->levelstart[level-1], count = index->levelstart[level] - first;
+    for(i=0; i < index->levelstart[level+1] - index->levelstart[level]; i++) {
+      rectObj *node = &(index->nodes[index->levelstart[level] + i]);
+      *node = index->nodes[first + i * MS_SEGMENT_INDEX_NODE];
+      for(k = i * MS_SEGMENT_INDEX_NODE + 1; k < MS_MIN((i + 1) * MS_SEGMENT_INDEX_NODE, count); k++)
+        msMergeRect(node, &(index->nodes[first + k]));
+    }
+  }
+
+  return index;
+}
+
+void msFreeSegmentIndex(segmentIndexObj *index)
+{
+  if(!index) return;
+  msFree(index->segments);
+  msFree(index->degenerate);
+  msFree(index->nodes);
+  msFree(index);
+}
+
+/*
+** Calls visit() for the segments whose bounds overlap rect, until it returns
+** MS_TRUE, which is returned.
+*/
+static int msSegmentIndexSearch(const segmentIndexObj *index, rectObj rect,
+                                int (*visit)(const indexedSegmentObj *, void *), void *data)
+{
+  int stack[2 * MS_SEGMENT_INDEX_NODE * MS_SEGMENT_INDEX_MAX_LEVELS + 2];
+  int stacksize = 0, level, node, i;
+  rectObj bounds;
+
+  if(index->numlevels == 0)
+    return MS_FALSE;
+
+  rect.minx -= index->tolerance;
+  rect.miny -= index->tolerance;
+  rect.maxx += index->tolerance;
+  rect.maxy += index->tolerance;
+
+  stack[stacksize++] = index->numlevels - 1;
+  stack[stacksize++] = 0;
+  while(stacksize > 0) {
+    node = stack[--stacksize];
+    level = stack[--stacksize];
+    if(msRectOverlap(&(index->nodes[index->levelstart[level] + node]), &rect) != MS_TRUE)
+      continue;
+
+    if(level == 0) {
+      for(i = node * MS_SEGMENT_INDEX_NODE; i < MS_MIN((node + 1) * MS_SEGMENT_INDEX_NODE, index->numsegments); i++) {
+        msSegmentBounds(&(index->segments[i]), &bounds);
+        if(msRectOverlap(&bounds, &rect) == MS_TRUE && visit(&(index->segments[i]), data) == MS_TRUE)
+          return MS_TRUE;
+      }
+    } else {
+      int count = index->levelstart[level] - index->levelstart[level-1];
+      for(i = MS_MIN((node + 1) * MS_SEGMENT_INDEX_NODE, count) - 1; i >= node * MS_SEGMENT_INDEX_NODE; i--) {
+        stack[stacksize++] = level - 1;
+        stack[stacksize++] = i;
+      }
+    }
+  }
+
+  return MS_FALSE;
+}
+
+typedef struct {
+  const pointObj *point;
+  int crossings;
+} pointInPolygonSearch;
+
+static int msSegmentCrossesRay(const indexedSegmentObj *segment, void *data)
+{
+  pointInPolygonSearch *search = (pointInPolygonSearch *) data;
+  const pointObj *p = search->point, *i = segment->b, *j = segment->a;
+
+  /* same test as msPointInPolygon() */
+  if ((((i->y<=p->y) && (p->y<j->y)) || ((j->y<=p->y) && (p->y<i->y))) && (p->x < (j->x - i->x) * (p->y - i->y) / (j->y - i->y) + i->x))
+    search->crossings++;
+  return MS_FALSE;
+}
+
+typedef struct {
+  const pointObj *a, *b;
+  int first; /* the searched segment is the first argument of msIntersectSegments() */
+} segmentSearch;
+
+static int msSegmentIntersects(const indexedSegmentObj *segment, void *data)
+{
+  segmentSearch *search = (segmentSearch *) data;
+
+  if(segment->closing)
+    return MS_FALSE;
+  if(search->first)
+    return msIntersectSegments(search->a, search->b, segment->a, segment->b);
+  return msIntersectSegments(segment->a, segment->b, search->a, search->b);
+}
+
 /*
 ** Instead of using ring orientation we count the number of parts the
 ** point falls in. If odd the point is in the polygon, if 0 or even
 ** then the point is in a hole or completely outside.
 */
-int msIntersectPointPolygon(pointObj *point, shapeObj *poly)
+int msIntersectPointPolygonIndexed(pointObj *point, shapeObj *poly, segmentIndexObj *polyindex)
 {
   int i;
   int status=MS_FALSE;
 
+  if(polyindex) {
+    /* the parity of the crossings of all the parts is the same thing */
+    pointInPolygonSearch search;
+    rectObj ray;
+
+    search.point = point;
+    search.crossings = 0;
+    ray.minx = point->x;
+    ray.maxx = HUGE_VAL;
+    ray.miny = ray.maxy = point->y;
+    msSegmentIndexSearch(polyindex, ray, msSegmentCrossesRay, &search);
+    return (search.crossings % 2) ? MS_TRUE : MS_FALSE;
+  }
+
   for(i=0; i<poly->numlines; i++) {
     if(msPointInPolygon(point, &poly->line[i]) == MS_TRUE) /* ok, the point is in a line */
       status = !status;
@@ -231,74 +449,160 @@ int msIntersectPointPolygon(pointObj *point, shapeObj *poly)
   return(status);
 }
 
-int msIntersectMultipointPolygon(shapeObj *multipoint, shapeObj *poly)
+int msIntersectPointPolygon(pointObj *point, shapeObj *poly)
+{
+  return msIntersectPointPolygonIndexed(point, poly, NULL);
+}
+
+int msIntersectMultipointPolygonIndexed(shapeObj *multipoint, shapeObj *poly, segmentIndexObj *polyindex)
 {
-  int i,j;
+  int i,j,status=MS_FALSE,numpoints=0;
+  segmentIndexObj *tmpindex = NULL;
+
+  for(i=0; i<multipoint->numlines; i++)
+    numpoints += multipoint->line[i].numpoints;
+  if(!polyindex && numpoints > 1 && (double) numpoints * msShapeSegmentCount(poly) >= MS_SEGMENT_INDEX_MIN_PAIRS)
+    polyindex = tmpindex = msCreateSegmentIndex(poly);
 
   /* The change to loop through all the lines has been made for ticket
    * #2443 but is no more needed since ticket #2762. PostGIS now put all
    * points into a single line.  */
-  for(i=0; i<multipoint->numlines; i++ ) {
+  for(i=0; i<multipoint->numlines && status == MS_FALSE; i++ ) {
     lineObj points = multipoint->line[i];
     for(j=0; j<points.numpoints; j++) {
-      if(msIntersectPointPolygon(&(points.point[j]), poly) == MS_TRUE)
-        return(MS_TRUE);
+      if(msIntersectPointPolygonIndexed(&(points.point[j]), poly, polyindex) == MS_TRUE) {
+        status = MS_TRUE;
+        break;
+      }
     }
   }
 
-  return(MS_FALSE);
+  msFreeSegmentIndex(tmpindex);
+  return(status);
 }
 
-int msIntersectPolylines(shapeObj *line1, shapeObj *line2)
+int msIntersectMultipointPolygon(shapeObj *multipoint, shapeObj *poly)
 {
-  int c1,v1,c2,v2;
+  return msIntersectMultipointPolygonIndexed(multipoint, poly, NULL);
+}
+
+/*
+** Either index may be NULL, if both are and the shapes are big an index is
+** built for the larger one.
+*/
+int msIntersectPolylinesIndexed(shapeObj *line1, segmentIndexObj *index1, shapeObj *line2, segmentIndexObj *index2)
+{
+  int c1,v1,c2,v2,i,status;
+  segmentSearch search;
+  rectObj rect;
+
+  if(!index1 && !index2) {
+    int n1 = msShapeSegmentCount(line1), n2 = msShapeSegmentCount(line2);
+
+    if(MS_MIN(n1, n2) > 1 && (double) n1 * n2 >= MS_SEGMENT_INDEX_MIN_PAIRS) {
+      segmentIndexObj *tmpindex;
+      if(n1 > n2) {
+        tmpindex = msCreateSegmentIndex(line1);
+        status = msIntersectPolylinesIndexed(line1, tmpindex, line2, NULL);
+      } else {
+        tmpindex = msCreateSegmentIndex(line2);
+        status = msIntersectPolylinesIndexed(line1, NULL, line2, tmpindex);
+      }
+      msFreeSegmentIndex(tmpindex);
+      return status;
+    }
 
-  for(c1=0; c1<line1->numlines; c1++)
-    for(v1=1; v1<line1->line[c1].numpoints; v1++)
-      for(c2=0; c2<line2->numlines; c2++)
-        for(v2=1; v2<line2->line[c2].numpoints; v2++)
-          if(msIntersectSegments(&(line1->line[c1].point[v1-1]), &(line1->line[c1].point[v1]),
-                                 &(line2->line[c2].point[v2-1]), &(line2->line[c2].point[v2])) ==  MS_TRUE)
+    for(c1=0; c1<line1->numlines; c1++)
+      for(v1=1; v1<line1->line[c1].numpoints; v1++)
+        for(c2=0; c2<line2->numlines; c2++)
+          for(v2=1; v2<line2->line[c2].numpoints; v2++)
+            if(msIntersectSegments(&(line1->line[c1].point[v1-1]), &(line1->line[c1].point[v1]),
+                                   &(line2->line[c2].point[v2-1]), &(line2->line[c2].point[v2])) ==  MS_TRUE)
+              return(MS_TRUE);
+
+    return(MS_FALSE);
+  }
+
+  /* search the segments of the other shape in the index */
+  search.first = (index2 != NULL);
+  if(!index2) {
+    shapeObj *tmp = line1;
+    line1 = line2;
+    line2 = tmp;
+    index2 = index1;
+  }
+
+  for(c1=0; c1<line1->numlines; c1++) {
+    for(v1=1; v1<line1->line[c1].numpoints; v1++) {
+      search.a = &(line1->line[c1].point[v1-1]);
+      search.b = &(line1->line[c1].point[v1]);
+      rect.minx = MS_MIN(search.a->x, search.b->x);
+      rect.maxx = MS_MAX(search.a->x, search.b->x);
+      rect.miny = MS_MIN(search.a->y, search.b->y);
+      rect.maxy = MS_MAX(search.a->y, search.b->y);
+      if(msSegmentIndexSearch(index2, rect, msSegmentIntersects, &search) == MS_TRUE)
+        return(MS_TRUE);
+
+      if(search.first) {
+        for(i=0; i<index2->numdegenerate; i++)
+          if(msSegmentIntersects(&(index2->segments[index2->degenerate[i]]), &search) == MS_TRUE)
+            return(MS_TRUE);
+      } else if(search.a->x == search.b->x && search.a->y == search.b->y) {
+        for(i=0; i<index2->numsegments; i++)
+          if(msSegmentIntersects(&(index2->segments[i]), &search) == MS_TRUE)
             return(MS_TRUE);
+      }
+    }
+  }
 
   return(MS_FALSE);
 }
 
-int msIntersectPolylinePolygon(shapeObj *line, shapeObj *poly)
+int msIntersectPolylines(shapeObj *line1, shapeObj *line2)
+{
+  return msIntersectPolylinesIndexed(line1, NULL, line2, NULL);
+}
+
+int msIntersectPolylinePolygonIndexed(shapeObj *line, segmentIndexObj *lineindex, shapeObj *poly, segmentIndexObj *polyindex)
 {
   int i;
 
   /* STEP 1: polygon might competely contain the polyline or one of it's parts (only need to check one point from each part) */
   for(i=0; i<line->numlines; i++) {
-    if(msIntersectPointPolygon(&(line->line[i].point[0]), poly) == MS_TRUE) /* this considers holes and multiple parts */
+    if(msIntersectPointPolygonIndexed(&(line->line[i].point[0]), poly, polyindex) == MS_TRUE) /* this considers holes and multiple parts */
       return(MS_TRUE);
   }
 
   /* STEP 2: look for intersecting line segments */
-  if (msIntersectPolylines(line, poly) == MS_TRUE)
+  if (msIntersectPolylinesIndexed(line, lineindex, poly, polyindex) == MS_TRUE)
     return (MS_TRUE);
 
   return(MS_FALSE);
 }
 
-int msIntersectPolygons(shapeObj *p1, shapeObj *p2)
+int msIntersectPolylinePolygon(shapeObj *line, shapeObj *poly)
+{
+  return msIntersectPolylinePolygonIndexed(line, NULL, poly, NULL);
+}
+
+int msIntersectPolygonsIndexed(shapeObj *p1, segmentIndexObj *index1, shapeObj *p2, segmentIndexObj *index2)
 {
   int i;
 
   /* STEP 1: polygon 1 completely contains 2 (only need to check one point from each part) */
   for(i=0; i<p2->numlines; i++) {
-    if(msIntersectPointPolygon(&(p2->line[i].point[0]), p1) == MS_TRUE) /* this considers holes and multiple parts */
+    if(msIntersectPointPolygonIndexed(&(p2->line[i].point[0]), p1, index1) == MS_TRUE) /* this considers holes and multiple parts */
       return(MS_TRUE);
   }
 
   /* STEP 2: polygon 2 completely contains 1 (only need to check one point from each part) */
   for(i=0; i<p1->numlines; i++) {
-    if(msIntersectPointPolygon(&(p1->line[i].point[0]), p2) == MS_TRUE) /* this considers holes and multiple parts */
+    if(msIntersectPointPolygonIndexed(&(p1->line[i].point[0]), p2, index2) == MS_TRUE) /* this considers holes and multiple parts */
       return(MS_TRUE);
   }
 
   /* STEP 3: look for intersecting line segments */
-  if (msIntersectPolylines(p1, p2) == MS_TRUE)
+  if (msIntersectPolylinesIndexed(p1, index1, p2, index2) == MS_TRUE)
     return(MS_TRUE);
 
   /*
@@ -309,6 +613,11 @@ int msIntersectPolygons(shapeObj *p1, shapeObj *p2)
   return(MS_FALSE);
 }
 
+int msIntersectPolygons(shapeObj *p1, shapeObj *p2)
+{
+  return msIntersectPolygonsIndexed(p1, NULL, p2, NULL);
+}
+
 
 /*
 ** Distance computations
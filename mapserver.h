@@ -235,6 +235,7 @@ extern "C" {
 #define MS_TEMPLATE_EXPR "\\.(xml|wml|html|htm|svg|kml|gml|js|tmpl)$"
 
 #define MS_INDEX_EXTENSION ".qix"
+#define MS_HILBERT_INDEX_EXTENSION ".hix"
 
 #define MS_QUERY_RESULTS_MAGIC_STRING "MapServer Query Results"
 #define MS_QUERY_PARAMS_MAGIC_STRING "MapServer Query Params"
@@ -282,7 +283,6 @@ extern "C" {
 #define MS_LABELCACHEINCREMENT 10
 
 #define MS_RESULTCACHEINITSIZE 10
-#define MS_RESULTCACHEINCREMENT 10
 
 #define MS_FEATUREINITSIZE 10 /* how many points initially can a feature have */
 #define MS_FEATUREINCREMENT 10
@@ -396,6 +396,7 @@ extern "C" {
 #define MS_RENDER_WITH_KML 106
 #define MS_RENDER_WITH_UTFGRID 107
 #define MS_RENDER_WITH_MVT 108
+#define MS_RENDER_WITH_MAPML 109
 
 #ifndef SWIG
 
@@ -406,6 +407,7 @@ extern "C" {
 #define MS_RENDERER_KML(format) ((format)->renderer == MS_RENDER_WITH_KML)
 #define MS_RENDERER_OGR(format) ((format)->renderer == MS_RENDER_WITH_OGR)
 #define MS_RENDERER_MVT(format) ((format)->renderer == MS_RENDER_WITH_MVT)
+#define MS_RENDERER_MAPML(format) ((format)->renderer == MS_RENDER_WITH_MAPML)
 
 #define MS_RENDERER_PLUGIN(format) ((format)->renderer > MS_RENDER_WITH_PLUGIN)
 
@@ -762,6 +764,8 @@ extern "C" {
     int compiled;
 
     char *native_string; /* RFC 91 */
+
+    struct expressionProgram *program; /* compiled tokens, see mapexpression.c */
   } expressionObj;
 
   typedef struct {
@@ -889,6 +893,12 @@ extern "C" {
     int cache_shapes; /* whether to cache shapes in resultCacheObj */
     int max_cached_shape_count; /* maximum number of shapes cached in the total number of resultCacheObj */
     int max_cached_shape_ram_amount; /* maximum number of bytes taken by shapes cached in the total number of resultCacheObj */
+
+    /* when set, results are handed to this function as they are found instead of being */
+    /* stored in the resultCacheObj, which then only keeps their count and bounds (see WFS */
+    /* GetFeature). Not for single point queries, they need the results. */
+    int (*result_callback)(struct mapObj *map, struct layerObj *layer, shapeObj *shape, void *data);
+    void *result_callback_data;
   } queryObj;
 #endif
 
@@ -1313,6 +1323,9 @@ typedef struct labelObj labelObj;
     labelCacheMemberObj **rendered_text_symbols;
     int num_allocated_rendered_members;
     int num_rendered_members;
+#ifndef SWIG
+    struct labelCacheIndex *index; /* grid over rendered labels and markers, see maplabel.c */
+#endif
   } labelCacheObj;
 
   /************************************************************************/
@@ -1616,6 +1629,7 @@ typedef struct labelObj labelObj;
 
 #ifndef SWIG
     int classitemindex;
+    struct layerClassIndex *classindex; /* classitem value lookup, see msLayerBuildClassIndex() */
     resultCacheObj *resultcache; /* holds the results of a query against this layer */
     double scalefactor; /* computed, not set */
 #ifndef __cplusplus
@@ -2076,6 +2090,8 @@ void msPopulateTextSymbolForLabelAndString(textSymbolObj *ts, labelObj *l, char
   MS_DLL_EXPORT char *msGetExpressionString(expressionObj *exp);
   MS_DLL_EXPORT void msInitExpression(expressionObj *exp);
   MS_DLL_EXPORT void msFreeExpressionTokens(expressionObj *exp);
+  MS_DLL_EXPORT void msFreeExpressionProgram(expressionObj *exp);
+  MS_DLL_EXPORT int msEvalParse(parseObj *p);
   MS_DLL_EXPORT void msFreeExpression(expressionObj *exp);
 
   MS_DLL_EXPORT void msApplySubstitutions(mapObj *map, char **names, char **values, int npairs);
@@ -2129,6 +2145,8 @@ void msPopulateTextSymbolForLabelAndString(textSymbolObj *ts, labelObj *l, char
   MS_DLL_EXPORT int msGetLayerIndex(mapObj *map, const char *name);
   MS_DLL_EXPORT int msGetSymbolIndex(symbolSetObj *set, char *name, int try_addimage_if_notfound);
   MS_DLL_EXPORT mapObj  *msLoadMap(const char *filename, const char *new_mappath);
+  MS_DLL_EXPORT mapObj  *msLoadMapCached(const char *filename);
+  MS_DLL_EXPORT void msMapFileCacheCleanup(void);
   MS_DLL_EXPORT int msTransformXmlMapfile(const char *stylesheet, const char *xmlMapfile, FILE *tmpfile);
   MS_DLL_EXPORT int msSaveMap(mapObj *map, char *filename);
   MS_DLL_EXPORT void msFreeCharArray(char **array, int num_items);
@@ -2207,6 +2225,16 @@ void msPopulateTextSymbolForLabelAndString(textSymbolObj *ts, labelObj *l, char
   MS_DLL_EXPORT int msIntersectPolygons(shapeObj *p1, shapeObj *p2);
   MS_DLL_EXPORT int msIntersectPolylines(shapeObj *line1, shapeObj *line2);
 
+  /* segment indexes of a shape, reusable across intersection tests (in mapsearch.c) */
+  typedef struct segmentIndexObj segmentIndexObj;
+  MS_DLL_EXPORT segmentIndexObj *msCreateSegmentIndex(shapeObj *shape);
+  MS_DLL_EXPORT void msFreeSegmentIndex(segmentIndexObj *index);
+  MS_DLL_EXPORT int msIntersectPointPolygonIndexed(pointObj *p, shapeObj *polygon, segmentIndexObj *polyindex);
+  MS_DLL_EXPORT int msIntersectMultipointPolygonIndexed(shapeObj *multipoint, shapeObj *polygon, segmentIndexObj *polyindex);
+  MS_DLL_EXPORT int msIntersectPolylinePolygonIndexed(shapeObj *line, segmentIndexObj *lineindex, shapeObj *poly, segmentIndexObj *polyindex);
+  MS_DLL_EXPORT int msIntersectPolygonsIndexed(shapeObj *p1, segmentIndexObj *index1, shapeObj *p2, segmentIndexObj *index2);
+  MS_DLL_EXPORT int msIntersectPolylinesIndexed(shapeObj *line1, segmentIndexObj *index1, shapeObj *line2, segmentIndexObj *index2);
+
   MS_DLL_EXPORT int msInitQuery(queryObj *query); /* in mapquery.c */
   MS_DLL_EXPORT void msFreeQuery(queryObj *query);
   MS_DLL_EXPORT int msSaveQuery(mapObj *map, char *filename, int results);
@@ -2250,6 +2278,7 @@ void msPopulateTextSymbolForLabelAndString(textSymbolObj *ts, labelObj *l, char
   MS_DLL_EXPORT int msCountChars(char *str, char ch);
   MS_DLL_EXPORT char *msLongToString(long value);
   MS_DLL_EXPORT char *msDoubleToString(double value, int force_f);
+  MS_DLL_EXPORT int msFormatDouble(char *buffer, size_t bufferSize, double value, int precision);
   MS_DLL_EXPORT char *msIntToString(int value);
   MS_DLL_EXPORT void msStringToUpper(char *string);
   MS_DLL_EXPORT void msStringToLower(char *string);
@@ -2357,6 +2386,7 @@ void msPopulateTextSymbolForLabelAndString(textSymbolObj *ts, labelObj *l, char
   MS_DLL_EXPORT int WARN_UNUSED msAddLabel(mapObj *map, imageObj *image, labelObj *label, int layerindex, int classindex, shapeObj *shape, pointObj *point, double featuresize, textSymbolObj *ts);
   MS_DLL_EXPORT int WARN_UNUSED msAddLabelGroup(mapObj *map, imageObj *image, layerObj *layer, int classindex, shapeObj *shape, pointObj *point, double featuresize);
   MS_DLL_EXPORT void insertRenderedLabelMember(mapObj *map, labelCacheMemberObj *cachePtr);
+  MS_DLL_EXPORT void msFreeLabelCacheIndex(labelCacheObj *cache);
   MS_DLL_EXPORT int msTestLabelCacheCollisions(mapObj *map, labelCacheMemberObj *cachePtr, label_bounds *lb, int current_priority, int current_label);
   MS_DLL_EXPORT int msTestLabelCacheLeaderCollision(mapObj *map, pointObj *lp1, pointObj *lp2);
   MS_DLL_EXPORT labelCacheMemberObj *msGetLabelCacheMember(labelCacheObj *labelcache, int i);
@@ -2386,6 +2416,12 @@ void msPopulateTextSymbolForLabelAndString(textSymbolObj *ts, labelObj *l, char
   MS_DLL_EXPORT void msTransformShapeToPixelRound(shapeObj *shape, rectObj extent, double cellsize);
   MS_DLL_EXPORT void msTransformShapeToPixelDoublePrecision(shapeObj *shape, rectObj extent, double cellsize);
 
+#define MS_TILEGRID_YDOWN    1 /* y axis pointing down from the top of the tile */
+#define MS_TILEGRID_TRUNCATE 2 /* truncate the coordinates instead of rounding them */
+  MS_DLL_EXPORT int msTransformShapeToTileGrid(shapeObj *shape, rectObj *extent, int tile_extent, int flags);
+  MS_DLL_EXPORT int msClipShapeToTileGrid(shapeObj *shape, int layer_type, double buffer, int tile_extent);
+  MS_DLL_EXPORT int msSimplifyShapeOnTileGrid(shapeObj *shape, int layer_type, double tolerance);
+
 #ifndef SWIG
 
   struct line_lengths {
@@ -2632,6 +2668,7 @@ void msPopulateTextSymbolForLabelAndString(textSymbolObj *ts, labelObj *l, char
   MS_DLL_EXPORT int msJoinPrepare(joinObj *join, shapeObj *shape);
   MS_DLL_EXPORT int msJoinNext(joinObj *join);
   MS_DLL_EXPORT int msJoinClose(joinObj *join);
+  MS_DLL_EXPORT void msJoinCacheCleanup(void);
 
   /*in mapraster.c */
   int msDrawRasterLayerLowCheckIfMustDraw(mapObj *map, layerObj *layer);
@@ -2687,6 +2724,8 @@ void msPopulateTextSymbolForLabelAndString(textSymbolObj *ts, labelObj *l, char
   MS_DLL_EXPORT int msEvalExpression(layerObj *layer, shapeObj *shape, expressionObj *expression, int itemindex);
   MS_DLL_EXPORT int msShapeGetClass(layerObj *layer, mapObj *map, shapeObj *shape, int *classgroup, int numclasses);
   MS_DLL_EXPORT int msShapeGetNextClass(int currentclass, layerObj *layer, mapObj *map, shapeObj *shape, int *classgroup, int numclasses);
+  MS_DLL_EXPORT void msLayerBuildClassIndex(layerObj *layer);
+  MS_DLL_EXPORT void msLayerFreeClassIndex(layerObj *layer);
   MS_DLL_EXPORT int msShapeCheckSize(shapeObj *shape, double minfeaturesize);
   MS_DLL_EXPORT char* msShapeGetLabelAnnotation(layerObj *layer, shapeObj *shape, labelObj *lbl);
   MS_DLL_EXPORT int msGetLabelStatus(mapObj *map, layerObj *layer, shapeObj *shape, labelObj *lbl);
@@ -3086,8 +3125,10 @@ void msPopulateTextSymbolForLabelAndString(textSymbolObj *ts, labelObj *l, char
   MS_DLL_EXPORT int msPopulateRendererVTableKML( rendererVTableObj *renderer );
   MS_DLL_EXPORT int msPopulateRendererVTableOGR( rendererVTableObj *renderer );
   MS_DLL_EXPORT int msPopulateRendererVTableMVT( rendererVTableObj *renderer );
+  MS_DLL_EXPORT int msPopulateRendererVTableMapML( rendererVTableObj *renderer );
 
   MS_DLL_EXPORT int msMVTWriteTile( mapObj *map, int sendheaders );
+  MS_DLL_EXPORT int msMapMLWriteTile( mapObj *map, int sendheaders );
 
 #ifdef USE_CAIRO
   MS_DLL_EXPORT void msCairoCleanup(void);
@@ -203,14 +203,14 @@ mapObj *msCGILoadMap(mapservObj *mapserv)
   if(i == mapserv->request->NumParams) {
     char *ms_mapfile = getenv("MS_MAPFILE");
     if(ms_mapfile) {
-      map = msLoadMap(ms_mapfile,NULL);
+      map = msLoadMapCached(ms_mapfile);
     } else {
       msSetError(MS_WEBERR, "CGI variable \"map\" is not set.", "msCGILoadMap()"); /* no default, outta here */
       return NULL;
     }
   } else {
     if(getenv(mapserv->request->ParamValues[i])) /* an environment variable references the actual file to use */
-      map = msLoadMap(getenv(mapserv->request->ParamValues[i]), NULL);
+      map = msLoadMapCached(getenv(mapserv->request->ParamValues[i]));
     else {
       /* by here we know the request isn't for something in an environment variable */
       if(getenv("MS_MAP_NO_PATH")) {
@@ -224,7 +224,7 @@ mapObj *msCGILoadMap(mapservObj *mapserv)
       }
 
       /* ok to try to load now */
-      map = msLoadMap(mapserv->request->ParamValues[i], NULL);
+      map = msLoadMapCached(mapserv->request->ParamValues[i]);
     }
   }
   
@@ -1487,6 +1487,8 @@ int msCGIDispatchImageRequest(mapservObj *mapserv)
 {
   int status;
   imageObj *img = NULL;
+  unsigned char *tilebuffer = NULL;
+  int tilesize = 0;
   switch(mapserv->Mode) {
     case MAP:
       if(mapserv->QueryFile) {
@@ -1510,8 +1512,15 @@ int msCGIDispatchImageRequest(mapservObj *mapserv)
         if((status = msMVTWriteTile(mapserv->map, mapserv->sendheaders)) != MS_SUCCESS) return MS_FAILURE;
         return MS_SUCCESS;
       }
+      if(MS_RENDERER_MAPML(mapserv->map->outputformat)) {
+        if((status = msMapMLWriteTile(mapserv->map, mapserv->sendheaders)) != MS_SUCCESS) return MS_FAILURE;
+        return MS_SUCCESS;
+      }
 
-      img = msTileDraw(mapserv);
+      status = msTileDrawCached(mapserv, &tilebuffer, &tilesize);
+      if(status == MS_FAILURE) return MS_FAILURE;
+      if(status == MS_DONE)
+        img = msTileDraw(mapserv);
       break;
     case LEGEND:
     case MAPLEGEND:
@@ -1522,7 +1531,7 @@ int msCGIDispatchImageRequest(mapservObj *mapserv)
       break;
   }
 
-  if(!img) return MS_FAILURE;
+  if(!img && !tilebuffer) return MS_FAILURE;
 
   /*
    ** Set the Cache control headers if the option is set.
@@ -1544,6 +1553,16 @@ int msCGIDispatchImageRequest(mapservObj *mapserv)
     msIO_sendHeaders();
   }
 
+  if( tilebuffer ) {
+    if( msIO_needBinaryStdout() == MS_FAILURE ) {
+      free(tilebuffer);
+      return MS_FAILURE;
+    }
+    msIO_fwrite(tilebuffer, 1, tilesize, stdout);
+    free(tilebuffer);
+    return MS_SUCCESS;
+  }
+
   if( mapserv->Mode == MAP || mapserv->Mode == TILE )
     status = msSaveImage(mapserv->map, img, NULL);
   else
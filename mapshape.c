@@ -40,8 +40,15 @@
 #include "mapows.h"
 
 #include <cpl_conv.h>
+#include <cpl_string.h>
 #include <ogr_srs_api.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
 /* Only use this macro on 32-bit integers! */
 #define SWAP_FOUR_BYTES(data) \
   ( ((data >> 24) & 0x000000FF) | ((data >>  8) & 0x0000FF00) | \
@@ -183,6 +190,191 @@ static void writeHeader( SHPHandle psSHP )
   free( panSHX );
 }
 
+/************************************************************************/
+/*                          msMappedFileOpen()                          */
+/*                                                                      */
+/*      Memory mapped shapefiles, enabled with the MS_SHAPEFILE_MMAP    */
+/*      configuration option. Mappings are read only and shared by      */
+/*      all the handles (and threads) opening the same file, and are    */
+/*      kept around for later requests once released. A file changed    */
+/*      on disk (other inode, mtime or size) is mapped again, files     */
+/*      must however be replaced (e.g. renamed over) rather than        */
+/*      rewritten in place while mapped.                                */
+/************************************************************************/
+#define MS_MAPPED_FILE_CACHE_SIZE 64 /* unreferenced mappings kept */
+
+static msMappedFile *mappedFiles = NULL; /* most recently used first */
+
+static void msMappedFileFree(msMappedFile *psMap)
+{
+#ifndef _WIN32
+  munmap((void *) psMap->data, psMap->size);
+#endif
+  msFree(psMap->filename);
+  msFree(psMap);
+}
+
+/* unmaps the least recently used unreferenced files above the cache size, called with the lock held */
+static void msMappedFileTrim(void)
+{
+  msMappedFile *psMap, *psPrev = NULL;
+  int nUnreferenced = 0;
+
+  psMap = mappedFiles;
+  while(psMap) {
+    if(psMap->refcount == 0 && ++nUnreferenced > MS_MAPPED_FILE_CACHE_SIZE) {
+      msMappedFile *psNext = psMap->next;
+      if(psPrev) psPrev->next = psNext;
+      else mappedFiles = psNext;
+      msMappedFileFree(psMap);
+      psMap = psNext;
+    } else {
+      psPrev = psMap;
+      psMap = psMap->next;
+    }
+  }
+}
+
+/*
+** Returns a reference on a mapping of pszFilename, or NULL if mapping is
+** disabled or failed in which case the caller falls back to stdio.
+*/
+msMappedFile *msMappedFileOpen(const char *pszFilename)
+{
+#ifdef _WIN32
+  return NULL;
+#else
+  msMappedFile *psMap, *psPrev = NULL;
+  struct stat sStat;
+  void *pData;
+  int fd;
+
+  if(!CSLTestBoolean(CPLGetConfigOption("MS_SHAPEFILE_MMAP", "NO")))
+    return NULL;
+
+  if(stat(pszFilename, &sStat) != 0 || !S_ISREG(sStat.st_mode) || sStat.st_size == 0)
+    return NULL;
+
+  msAcquireLock(TLOCK_SHPMAP);
+  for(psMap = mappedFiles; psMap; psPrev = psMap, psMap = psMap->next) {
+    if(strcmp(psMap->filename, pszFilename) != 0)
+      continue;
+
+    /* unlink it, it moves to the front or goes away */
+    if(psPrev) psPrev->next = psMap->next;
+    else mappedFiles = psMap->next;
+
+    if(psMap->dev == (long long) sStat.st_dev && psMap->ino == (long long) sStat.st_ino &&
+        psMap->mtime == (long long) sStat.st_mtime && psMap->size == (size_t) sStat.st_size) {
+      psMap->next = mappedFiles;
+      mappedFiles = psMap;
+      psMap->refcount++;
+      msReleaseLock(TLOCK_SHPMAP);
+      return psMap;
+    }
+
+    if(psMap->refcount == 0)
+      msMappedFileFree(psMap);
+    else
+      psMap->stale = MS_TRUE;
+    break;
+  }
+
+  fd = open(pszFilename, O_RDONLY);
+  if(fd < 0 || fstat(fd, &sStat) != 0 || sStat.st_size == 0) {
+    if(fd >= 0) close(fd);
+    msReleaseLock(TLOCK_SHPMAP);
+    return NULL;
+  }
+  pData = mmap(NULL, sStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(pData == MAP_FAILED) {
+    msReleaseLock(TLOCK_SHPMAP);
+    return NULL;
+  }
+
+  psMap = (msMappedFile *) msSmallCalloc(1, sizeof(msMappedFile));
+  psMap->filename = msStrdup(pszFilename);
+  psMap->dev = sStat.st_dev;
+  psMap->ino = sStat.st_ino;
+  psMap->mtime = sStat.st_mtime;
+  psMap->data = (const uchar *) pData;
+  psMap->size = sStat.st_size;
+  psMap->refcount = 1;
+  psMap->next = mappedFiles;
+  mappedFiles = psMap;
+
+  msMappedFileTrim();
+  msReleaseLock(TLOCK_SHPMAP);
+
+  return psMap;
+#endif
+}
+
+void msMappedFileRelease(msMappedFile *psMap)
+{
+  if(!psMap) return;
+
+  msAcquireLock(TLOCK_SHPMAP);
+  psMap->refcount--;
+  if(psMap->stale) {
+    if(psMap->refcount == 0)
+      msMappedFileFree(psMap);
+  } else {
+    msMappedFileTrim();
+  }
+  msReleaseLock(TLOCK_SHPMAP);
+}
+
+/* unmaps the files no longer referenced, see msCleanup() */
+void msMappedFileCleanup(void)
+{
+  msMappedFile *psMap, *psPrev = NULL;
+
+  msAcquireLock(TLOCK_SHPMAP);
+  psMap = mappedFiles;
+  while(psMap) {
+    msMappedFile *psNext = psMap->next;
+    if(psMap->refcount == 0) {
+      if(psPrev) psPrev->next = psNext;
+      else mappedFiles = psNext;
+      msMappedFileFree(psMap);
+    } else {
+      psPrev = psMap;
+    }
+    psMap = psNext;
+  }
+  msReleaseLock(TLOCK_SHPMAP);
+}
+
+/*
+** Reads nBytes at nOffset from a .shp or .shx file, copied from the mapping
+** when the file is memory mapped.
+*/
+static int msSHPReadAt(FILE *fp, msMappedFile *psMap, int nOffset, void *pBuffer, int nBytes)
+{
+  if(psMap) {
+    if(nOffset < 0 || nBytes < 0 || (size_t) nOffset + nBytes > psMap->size)
+      return MS_FAILURE;
+    memcpy(pBuffer, psMap->data + nOffset, nBytes);
+    return MS_SUCCESS;
+  }
+  if(0 != fseek(fp, nOffset, 0) || 1 != fread(pBuffer, nBytes, 1, fp))
+    return MS_FAILURE;
+  return MS_SUCCESS;
+}
+
+static void msSHPCloseFiles( SHPHandle psSHP )
+{
+  if( psSHP->mapSHP ) {
+    msMappedFileRelease( psSHP->mapSHX );
+    msMappedFileRelease( psSHP->mapSHP );
+  } else {
+    fclose( psSHP->fpSHX );
+    fclose( psSHP->fpSHP );
+  }
+}
+
 /************************************************************************/
 /*                              msSHPOpen()                             */
 /*                                                                      */
@@ -228,6 +420,9 @@ SHPHandle msSHPOpen( const char * pszLayer, const char * pszAccess )
   psSHP->panParts = NULL;
   psSHP->nBufSize = psSHP->nPartMax = 0;
 
+  psSHP->fpSHP = psSHP->fpSHX = NULL;
+  psSHP->mapSHP = psSHP->mapSHX = NULL;
+
   /* -------------------------------------------------------------------- */
   /*  Compute the base (layer) name.  If there is any extension     */
   /*  on the passed in filename we will strip it off.         */
@@ -246,31 +441,54 @@ SHPHandle msSHPOpen( const char * pszLayer, const char * pszAccess )
   /*  a PC to Unix with upper case filenames won't work!        */
   /* -------------------------------------------------------------------- */
   pszFullname = (char *) msSmallMalloc(strlen(pszBasename) + 5);
-  sprintf( pszFullname, "%s.shp", pszBasename );
-  psSHP->fpSHP = fopen(pszFullname, pszAccess );
-  if( psSHP->fpSHP == NULL ) {
-    sprintf( pszFullname, "%s.SHP", pszBasename );
-    psSHP->fpSHP = fopen(pszFullname, pszAccess );
-  }
-  if( psSHP->fpSHP == NULL ) {
-    msFree(pszBasename);
-    msFree(pszFullname);
-    msFree(psSHP);
-    return( NULL );
+  if( strcmp(pszAccess,"rb") == 0 ) {
+    sprintf( pszFullname, "%s.shp", pszBasename );
+    psSHP->mapSHP = msMappedFileOpen(pszFullname);
+    if( psSHP->mapSHP == NULL ) {
+      sprintf( pszFullname, "%s.SHP", pszBasename );
+      psSHP->mapSHP = msMappedFileOpen(pszFullname);
+    }
+    if( psSHP->mapSHP != NULL ) {
+      sprintf( pszFullname, "%s.shx", pszBasename );
+      psSHP->mapSHX = msMappedFileOpen(pszFullname);
+      if( psSHP->mapSHX == NULL ) {
+        sprintf( pszFullname, "%s.SHX", pszBasename );
+        psSHP->mapSHX = msMappedFileOpen(pszFullname);
+      }
+      if( psSHP->mapSHX == NULL ) { /* use stdio for both */
+        msMappedFileRelease(psSHP->mapSHP);
+        psSHP->mapSHP = NULL;
+      }
+    }
   }
 
-  sprintf( pszFullname, "%s.shx", pszBasename );
-  psSHP->fpSHX = fopen(pszFullname, pszAccess );
-  if( psSHP->fpSHX == NULL ) {
-    sprintf( pszFullname, "%s.SHX", pszBasename );
+  if( psSHP->mapSHP == NULL ) {
+    sprintf( pszFullname, "%s.shp", pszBasename );
+    psSHP->fpSHP = fopen(pszFullname, pszAccess );
+    if( psSHP->fpSHP == NULL ) {
+      sprintf( pszFullname, "%s.SHP", pszBasename );
+      psSHP->fpSHP = fopen(pszFullname, pszAccess );
+    }
+    if( psSHP->fpSHP == NULL ) {
+      msFree(pszBasename);
+      msFree(pszFullname);
+      msFree(psSHP);
+      return( NULL );
+    }
+
+    sprintf( pszFullname, "%s.shx", pszBasename );
     psSHP->fpSHX = fopen(pszFullname, pszAccess );
-  }
-  if( psSHP->fpSHX == NULL ) {
-    fclose(psSHP->fpSHP);
-    msFree(pszBasename);
-    msFree(pszFullname);
-    msFree(psSHP);
-    return( NULL );
+    if( psSHP->fpSHX == NULL ) {
+      sprintf( pszFullname, "%s.SHX", pszBasename );
+      psSHP->fpSHX = fopen(pszFullname, pszAccess );
+    }
+    if( psSHP->fpSHX == NULL ) {
+      fclose(psSHP->fpSHP);
+      msFree(pszBasename);
+      msFree(pszFullname);
+      msFree(psSHP);
+      return( NULL );
+    }
   }
 
   free( pszFullname );
@@ -280,9 +498,8 @@ SHPHandle msSHPOpen( const char * pszLayer, const char * pszAccess )
   /*   Read the file size from the SHP file.            */
   /* -------------------------------------------------------------------- */
   pabyBuf = (uchar *) msSmallMalloc(100);
-  if(1 != fread( pabyBuf, 100, 1, psSHP->fpSHP )) {
-    fclose( psSHP->fpSHP );
-    fclose( psSHP->fpSHX );
+  if(msSHPReadAt( psSHP->fpSHP, psSHP->mapSHP, 0, pabyBuf, 100 ) != MS_SUCCESS) {
+    msSHPCloseFiles( psSHP );
     free( psSHP );
     free(pabyBuf);
     return( NULL );
@@ -296,10 +513,9 @@ SHPHandle msSHPOpen( const char * pszLayer, const char * pszAccess )
   /* -------------------------------------------------------------------- */
   /*  Read SHX file Header info                                           */
   /* -------------------------------------------------------------------- */
-  if(1 != fread( pabyBuf, 100, 1, psSHP->fpSHX )) {
+  if(msSHPReadAt( psSHP->fpSHX, psSHP->mapSHX, 0, pabyBuf, 100 ) != MS_SUCCESS) {
     msSetError(MS_SHPERR, "Corrupted .shx file", "msSHPOpen()");
-    fclose( psSHP->fpSHP );
-    fclose( psSHP->fpSHX );
+    msSHPCloseFiles( psSHP );
     free( psSHP );
     free(pabyBuf);
     return( NULL );
@@ -307,8 +523,7 @@ SHPHandle msSHPOpen( const char * pszLayer, const char * pszAccess )
 
   if( pabyBuf[0] != 0 || pabyBuf[1] != 0 || pabyBuf[2] != 0x27  || (pabyBuf[3] != 0x0a && pabyBuf[3] != 0x0d) ) {
     msSetError(MS_SHPERR, "Corrupted .shp file", "msSHPOpen()");
-    fclose( psSHP->fpSHP );
-    fclose( psSHP->fpSHX );
+    msSHPCloseFiles( psSHP );
     free( psSHP );
     free(pabyBuf);
 
@@ -322,8 +537,7 @@ SHPHandle msSHPOpen( const char * pszLayer, const char * pszAccess )
   if( psSHP->nRecords < 0 || psSHP->nRecords > 256000000 ) {
     msSetError(MS_SHPERR, "Corrupted .shp file : nRecords = %d.", "msSHPOpen()",
                psSHP->nRecords);
-    fclose( psSHP->fpSHP );
-    fclose( psSHP->fpSHX );
+    msSHPCloseFiles( psSHP );
     free( psSHP );
     free(pabyBuf);
     return( NULL );
@@ -370,6 +584,14 @@ SHPHandle msSHPOpen( const char * pszLayer, const char * pszAccess )
   /* -------------------------------------------------------------------- */
   psSHP->nMaxRecords = psSHP->nRecords;
 
+  /* Offsets are read straight from a memory mapped .shx */
+  if( psSHP->mapSHX ) {
+    psSHP->panRecOffset = psSHP->panRecSize = NULL;
+    psSHP->panRecLoaded = NULL;
+    psSHP->panRecAllLoaded = 1;
+    return( psSHP );
+  }
+
   /* Our in-memory cache of offset information */
   psSHP->panRecOffset = (int *) malloc(sizeof(int) * psSHP->nMaxRecords );
   /* Our in-memory cache of size information */
@@ -386,8 +608,7 @@ SHPHandle msSHPOpen( const char * pszLayer, const char * pszAccess )
     free(psSHP->panRecOffset);
     free(psSHP->panRecSize);
     free(psSHP->panRecLoaded);
-    fclose( psSHP->fpSHP );
-    fclose( psSHP->fpSHX );
+    msSHPCloseFiles( psSHP );
     free( psSHP );
     msSetError(MS_MEMERR, "Out of memory", "msSHPOpen()");
     return( NULL );
@@ -421,8 +642,7 @@ void msSHPClose(SHPHandle psSHP )
   free(psSHP->pabyRec);
   free(psSHP->panParts);
 
-  fclose( psSHP->fpSHX );
-  fclose( psSHP->fpSHP );
+  msSHPCloseFiles( psSHP );
 
   free( psSHP );
 }
@@ -1082,11 +1302,7 @@ int msSHPReadPoint( SHPHandle psSHP, int hEntity, pointObj *point )
   /* -------------------------------------------------------------------- */
   /*      Read the record.                                                */
   /* -------------------------------------------------------------------- */
-  if( 0 != fseek( psSHP->fpSHP, msSHXReadOffset( psSHP, hEntity), 0 )) {
-    msSetError(MS_IOERR, "failed to seek offset", "msSHPReadPoint()");
-    return(MS_FAILURE);
-  }
-  if( 1 != fread( psSHP->pabyRec, nEntitySize, 1, psSHP->fpSHP )) {
+  if( msSHPReadAt( psSHP->fpSHP, psSHP->mapSHP, msSHXReadOffset( psSHP, hEntity), psSHP->pabyRec, nEntitySize ) != MS_SUCCESS ) {
     msSetError(MS_IOERR, "failed to fread record", "msSHPReadPoint()");
     return(MS_FAILURE);
   }
@@ -1174,6 +1390,9 @@ int msSHXLoadAll( SHPHandle psSHP )
   int i;
   uchar *pabyBuf;
 
+  if( psSHP->mapSHX ) /* nothing to load */
+    return(MS_SUCCESS);
+
   pabyBuf = (uchar *) msSmallMalloc(8 * psSHP->nRecords );
   if(psSHP->nRecords != fread( pabyBuf, 8, psSHP->nRecords, psSHP->fpSHX )) {
     msSetError(MS_IOERR, "failed to read shx records", "msSHXLoadAll()");
@@ -1201,6 +1420,25 @@ int msSHXLoadAll( SHPHandle psSHP )
 
 }
 
+/*
+** Reads one of the two words of a .shx record from the mapping.
+*/
+static int msSHXReadMapped( SHPHandle psSHP, int hEntity, int iWord )
+{
+  ms_int32 nValue;
+  size_t nOffset = 100 + (size_t) hEntity * 8 + iWord * 4;
+
+  if( nOffset + 4 > psSHP->mapSHX->size )
+    return 0;
+
+  memcpy( &nValue, psSHP->mapSHX->data + nOffset, 4 );
+  if( !bBigEndian )
+    nValue = SWAP_FOUR_BYTES( nValue );
+
+  /* SHX stores the offsets in 2 byte units */
+  return nValue * 2;
+}
+
 int msSHXReadOffset( SHPHandle psSHP, int hEntity )
 {
 
@@ -1210,6 +1448,9 @@ int msSHXReadOffset( SHPHandle psSHP, int hEntity )
   if( hEntity < 0 || hEntity >= psSHP->nRecords )
     return(MS_FAILURE);
 
+  if( psSHP->mapSHX )
+    return msSHXReadMapped( psSHP, hEntity, 0 );
+
   if( ! (psSHP->panRecAllLoaded || msGetBit(psSHP->panRecLoaded, shxBufferPage)) ) {
     msSHXLoadPage( psSHP, shxBufferPage );
   }
@@ -1227,6 +1468,9 @@ int msSHXReadSize( SHPHandle psSHP, int hEntity )
   if( hEntity < 0 || hEntity >= psSHP->nRecords )
     return(MS_FAILURE);
 
+  if( psSHP->mapSHX )
+    return msSHXReadMapped( psSHP, hEntity, 1 );
+
   if( ! (psSHP->panRecAllLoaded || msGetBit(psSHP->panRecLoaded, shxBufferPage)) ) {
     msSHXLoadPage( psSHP, shxBufferPage );
   }
@@ -1268,13 +1512,8 @@ void msSHPReadShape( SHPHandle psSHP, int hEntity, shapeObj *shape )
   /* -------------------------------------------------------------------- */
   /*      Read the record.                                                */
   /* -------------------------------------------------------------------- */
-  if( 0 != fseek( psSHP->fpSHP, msSHXReadOffset( psSHP, hEntity), 0 )) {
-    msSetError(MS_IOERR, "failed to seek offset", "msSHPReadShape()");
-    shape->type = MS_SHAPE_NULL;
-    return;
-  }
-  if( 1 != fread( psSHP->pabyRec, nEntitySize, 1, psSHP->fpSHP )) {
-    msSetError(MS_IOERR, "failed to fread record", "msSHPReadPoint()");
+  if( msSHPReadAt( psSHP->fpSHP, psSHP->mapSHP, msSHXReadOffset( psSHP, hEntity), psSHP->pabyRec, nEntitySize ) != MS_SUCCESS ) {
+    msSetError(MS_IOERR, "failed to fread record", "msSHPReadShape()");
     shape->type = MS_SHAPE_NULL;
     return;
   }
@@ -1645,11 +1884,7 @@ int msSHPReadBounds( SHPHandle psSHP, int hEntity, rectObj *padBounds)
     }
 
     if( psSHP->nShapeType != SHP_POINT && psSHP->nShapeType != SHP_POINTZ && psSHP->nShapeType != SHP_POINTM) {
-      if( 0 != fseek( psSHP->fpSHP, msSHXReadOffset( psSHP, hEntity) + 12, 0 )) {
-        msSetError(MS_IOERR, "failed to seek offset", "msSHPReadBounds()");
-        return(MS_FAILURE);
-      }
-      if( 1 != fread( padBounds, sizeof(double)*4, 1, psSHP->fpSHP )) {
+      if( msSHPReadAt( psSHP->fpSHP, psSHP->mapSHP, msSHXReadOffset( psSHP, hEntity) + 12, padBounds, sizeof(double)*4 ) != MS_SUCCESS ) {
         msSetError(MS_IOERR, "failed to fread record", "msSHPReadBounds()");
         return(MS_FAILURE);
       }
@@ -1671,11 +1906,7 @@ int msSHPReadBounds( SHPHandle psSHP, int hEntity, rectObj *padBounds)
       /*      minimum and maximum bound.                                      */
       /* -------------------------------------------------------------------- */
 
-      if( 0 != fseek( psSHP->fpSHP, msSHXReadOffset( psSHP, hEntity) + 12, 0 )) {
-        msSetError(MS_IOERR, "failed to seek offset", "msSHPReadBounds()");
-        return(MS_FAILURE);
-      }
-      if( 1 != fread( padBounds, sizeof(double)*2, 1, psSHP->fpSHP )) {
+      if( msSHPReadAt( psSHP->fpSHP, psSHP->mapSHP, msSHXReadOffset( psSHP, hEntity) + 12, padBounds, sizeof(double)*2 ) != MS_SUCCESS ) {
         msSetError(MS_IOERR, "failed to fread record", "msSHPReadBounds()");
         return(MS_FAILURE);
       }
@@ -1709,6 +1940,11 @@ int msShapefileOpen(shapefileObj *shpfile, const char *mode, const char *filenam
   shpfile->status = NULL;
   shpfile->lastshape = -1;
   shpfile->isopen = MS_FALSE;
+  /* the .hix is only looked for when the MS_SHAPEFILE_HILBERT_INDEX configuration option asks for it */
+  if(CSLTestBoolean(CPLGetConfigOption("MS_SHAPEFILE_HILBERT_INDEX", "NO")))
+    shpfile->hilbertindex = MS_UNKNOWN;
+  else
+    shpfile->hilbertindex = MS_FALSE;
 
   /* open the shapefile file (appending ok) and get basic info */
   if(!mode)
@@ -1785,6 +2021,7 @@ int msShapefileCreate(shapefileObj *shpfile, char *filename, int type)
   shpfile->status = NULL;
   shpfile->lastshape = -1;
   shpfile->isopen = MS_TRUE;
+  shpfile->hilbertindex = MS_FALSE; /* new file, no index */
 
   shpfile->hDBF = NULL; /* XBase file is NOT created here... */
   return(0);
@@ -1841,13 +2078,22 @@ int msShapefileWhichShapes(shapefileObj *shpfile, rectObj rect, int debug)
 
     sprintf(filename, "%s%s", sourcename, MS_INDEX_EXTENSION);
 
-    shpfile->status = msSearchDiskTree(filename, rect, debug, shpfile->numshapes);
+    /* not enabled, or a shapefile without a usable .hix, which isn't probed again while it stays open */
+    if(shpfile->hilbertindex != MS_FALSE) {
+      shpfile->status = msSearchDiskHilbertTree(filename, rect, debug, shpfile->numshapes);
+      shpfile->hilbertindex = shpfile->status ? MS_TRUE : MS_FALSE;
+    }
+    if(!shpfile->status)
+      shpfile->status = msSearchDiskTreeCached(shpfile, filename, rect, debug);
+    if(!shpfile->status) {
+      shpfile->status = msSearchDiskTree(filename, rect, debug, shpfile->numshapes);
+      if(shpfile->status) /* index  */
+        msFilterTreeSearch(shpfile, shpfile->status, rect);
+    }
     free(filename);
     free(sourcename);
 
-    if(shpfile->status) { /* index  */
-      msFilterTreeSearch(shpfile, shpfile->status, rect);
-    } else { /* no index  */
+    if(!shpfile->status) { /* no index  */
       shpfile->status = msAllocBitArray(shpfile->numshapes);
       if(!shpfile->status) {
         msSetError(MS_MEMERR, NULL, "msShapefileWhichShapes()");
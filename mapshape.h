@@ -78,9 +78,22 @@ extern "C" {
 #ifndef SWIG
   typedef unsigned char uchar;
 
+  /* read only mapping of a whole file, shared by all the handles opened on it (see msMappedFileOpen()) */
+  typedef struct msMappedFile {
+    char *filename;
+    long long dev, ino, mtime; /* identify the version of the file that was mapped */
+    const uchar *data;
+    size_t size;
+    int refcount;
+    int stale; /* file changed on disk, unmapped once released */
+    struct msMappedFile *next;
+  } msMappedFile;
+
   typedef struct {
     FILE  *fpSHP;
     FILE  *fpSHX;
+    msMappedFile *mapSHP; /* when set, fpSHP and fpSHX are NULL */
+    msMappedFile *mapSHX;
 
     int   nShapeType;       /* SHPT_* */
     int   nFileSize;        /* SHP file */
@@ -114,6 +127,9 @@ extern "C" {
     %immutable;
 #endif
     FILE  *fp;
+#ifndef SWIG
+    msMappedFile *map; /* when set, fp is NULL and the file is read only */
+#endif
 
     int   nRecords;
 
@@ -168,6 +184,10 @@ extern "C" {
     ms_bitarray status;
 
     int isopen;
+
+#ifndef SWIG
+    int hilbertindex; /* whether a usable .hix exists, MS_UNKNOWN until the first search, MS_FALSE unless MS_SHAPEFILE_HILBERT_INDEX is set */
+#endif
 #ifdef SWIG
     %mutable;
 #endif
@@ -201,6 +221,10 @@ extern "C" {
   MS_DLL_EXPORT int msSHPWriteShape( SHPHandle psSHP, shapeObj *shape );
   MS_DLL_EXPORT int msSHPWritePoint(SHPHandle psSHP, pointObj *point );
   /* SHX reading */
+  MS_DLL_EXPORT msMappedFile *msMappedFileOpen( const char *pszFilename );
+  MS_DLL_EXPORT void msMappedFileRelease( msMappedFile *psMap );
+  MS_DLL_EXPORT void msMappedFileCleanup( void );
+
   MS_DLL_EXPORT int msSHXLoadAll( SHPHandle psSHP );
   MS_DLL_EXPORT int msSHXLoadPage( SHPHandle psSHP, int shxBufferPage );
   MS_DLL_EXPORT int msSHXReadOffset( SHPHandle psSHP, int hEntity );
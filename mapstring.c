@@ -365,6 +365,155 @@ char *msDoubleToString(double value, int force_f)
   return(buffer);
 }
 
+/*
+** Exact product of a and b as hi + lo, hi being the rounded product.
+** Dekker's algorithm, for products well inside the double range.
+*/
+static void msTwoProduct(double a, double b, double *hi, double *lo)
+{
+#ifdef FP_FAST_FMA
+  *hi = a * b;
+  *lo = fma(a, b, -*hi);
+#else
+  const double split = 134217729.0; /* 2^27 + 1 */
+  double t, ahi, alo, bhi, blo;
+
+  *hi = a * b;
+  t = split * a;
+  ahi = t - (t - a);
+  alo = a - ahi;
+  t = split * b;
+  bhi = t - (t - b);
+  blo = b - bhi;
+  *lo = ((ahi * bhi - *hi) + ahi * blo + alo * bhi) + alo * blo;
+#endif
+}
+
+#define MS_FORMAT_MAX_PRECISION 17
+
+static const double msFormatPowersOf10[MS_FORMAT_MAX_PRECISION+1] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+  1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+};
+
+/*
+** Rounds |value| * 10^precision to the nearest integer, ties to even, the
+** way printf() rounds the exact binary value. Returns MS_FALSE when the
+** result doesn't fit the 2^52 range this works in (or value is NaN/inf).
+*/
+static int msScaleAndRound(double value, int precision, unsigned long long *scaled)
+{
+  double hi, lo, r, frac;
+
+  if(!(fabs(value) < 4503599627370496.0)) /* 2^52, also catches NaN */
+    return MS_FALSE;
+
+  msTwoProduct(fabs(value), msFormatPowersOf10[precision], &hi, &lo);
+  if(!(hi < 4503599627370496.0))
+    return MS_FALSE;
+
+  /* below 2^52 hi - floor(hi) is exact and the .5 boundary is representable */
+  r = floor(hi);
+  frac = hi - r;
+  if(frac > 0.5 || (frac == 0.5 && (lo > 0 || (lo == 0 && ((unsigned long long) r & 1)))))
+    r += 1;
+
+  *scaled = (unsigned long long) r;
+  return MS_TRUE;
+}
+
+/* both operands are exact, so the division is correctly rounded */
+static int msReadsBackAs(unsigned long long scaled, int precision, double value)
+{
+  return (double)scaled / msFormatPowersOf10[precision] == fabs(value);
+}
+
+static int msWriteScaledDouble(char *buffer, int negative, unsigned long long scaled, int precision)
+{
+  char digits[32];
+  int numdigits = 0, length = 0;
+
+  do {
+    digits[numdigits++] = '0' + (char)(scaled % 10);
+    scaled /= 10;
+  } while(scaled != 0);
+  while(numdigits <= precision) /* at least one integer digit */
+    digits[numdigits++] = '0';
+
+  if(negative) buffer[length++] = '-';
+  while(numdigits > precision)
+    buffer[length++] = digits[--numdigits];
+  if(precision > 0) {
+    buffer[length++] = '.';
+    while(numdigits > 0)
+      buffer[length++] = digits[--numdigits];
+  }
+  buffer[length] = '\0';
+
+  return length;
+}
+
+/*
+** Formats a double without going through printf(). With precision >= 0
+** the result is the one of snprintf(buffer, bufferSize, "%.*f", precision,
+** value). With a negative precision the result is the shortest string
+** that reads back as value, in fixed notation unless the value needs all
+** 17 digits or is out of range. Returns the length of the formatted
+** string, like snprintf() does.
+*/
+int msFormatDouble(char *buffer, size_t bufferSize, double value, int precision)
+{
+  char formatted[48];
+  unsigned long long scaled;
+  int length, p, digits = 15;
+
+  if(precision >= 0) {
+    if(precision <= MS_FORMAT_MAX_PRECISION && msScaleAndRound(value, precision, &scaled)) {
+      length = msWriteScaledDouble(formatted, signbit(value), scaled, precision);
+      strlcpy(buffer, formatted, bufferSize);
+      return length;
+    }
+    return snprintf(buffer, bufferSize, "%.*f", precision, value);
+  }
+
+  /*
+  ** shortest: take the finest precision the exact path can handle and, if
+  ** its rounding reads back as value, drop the trailing zeros and then any
+  ** further digit that can go (finer precisions only get closer to value).
+  */
+  if(fabs(value) < 4503599627370496.0) {
+    unsigned long long candidate;
+
+    p = MS_FORMAT_MAX_PRECISION;
+    while(p > 0 && !(fabs(value) * msFormatPowersOf10[p] < 4503599627370496.0))
+      p--;
+    if(msScaleAndRound(value, p, &scaled) && msReadsBackAs(scaled, p, value)) {
+      while(p > 0 && scaled % 10 == 0) {
+        scaled /= 10;
+        p--;
+      }
+      while(p > 0 && msScaleAndRound(value, p-1, &candidate) && msReadsBackAs(candidate, p-1, value)) {
+        scaled = candidate;
+        p--;
+      }
+      length = msWriteScaledDouble(formatted, signbit(value), scaled, p);
+      strlcpy(buffer, formatted, bufferSize);
+      return length;
+    }
+    if(p < MS_FORMAT_MAX_PRECISION)
+      digits = 16; /* p decimals were 15 significant digits or more */
+  }
+
+  for(p=digits; p<17; p++) {
+    length = snprintf(formatted, sizeof(formatted), "%.*g", p, value);
+    if(strtod(formatted, NULL) == value) {
+      strlcpy(buffer, formatted, bufferSize);
+      return length;
+    }
+  }
+  return snprintf(buffer, bufferSize, "%.17g", value);
+}
+
 char *msIntToString(int value)
 {
   size_t bufferSize = 256;
@@ -1979,6 +1979,20 @@ static int processDateTag(char **line)
 
 }
 
+/*
+** Formats one [shpxy] point as <xh>x<xf><yh>y<yf><cs>, the numbers with precision
+** decimals (msFormatDouble(), so a negative precision gives the shortest exact form).
+*/
+static void formatShpxyPoint(char *point, size_t pointSize, double x, double y, int precision,
+                             const char *xh, const char *xf, const char *yh, const char *yf, const char *cs)
+{
+  char x_string[64], y_string[64];
+
+  msFormatDouble(x_string, sizeof(x_string), x, precision);
+  msFormatDouble(y_string, sizeof(y_string), y, precision);
+  snprintf(point, pointSize, "%s%s%s%s%s%s%s", xh, x_string, xf, yh, y_string, yf, cs);
+}
+
 /*
 ** Function to process a [shpxy ...] tag: line contains the tag, shape holds the coordinates.
 **
@@ -1997,8 +2011,6 @@ static int processShpxyTag(layerObj *layer, char **line, shapeObj *shape)
   int tagOffset, tagLength;
 
   const char *argValue=NULL;
-  char *pointFormat1=NULL, *pointFormat2=NULL;
-  int pointFormatLength;
 
   /*
   ** Pointers to static strings, naming convention is:
@@ -2127,13 +2139,6 @@ static int processShpxyTag(layerObj *layer, char **line, shapeObj *shape)
       if(argValue) projectionString = argValue;
     }
 
-    /* build the per point format strings (version 1 contains the coordinate seperator, version 2 doesn't) */
-    pointFormatLength = strlen(xh) + strlen(xf) + strlen(yh) + strlen(yf) + strlen(cs) + 12 + 1;
-    pointFormat1 = (char *) msSmallMalloc(pointFormatLength);
-    snprintf(pointFormat1, pointFormatLength, "%s%%.%dlf%s%s%%.%dlf%s%s", xh, precision, xf, yh, precision, yf, cs);
-    pointFormat2 = (char *) msSmallMalloc(pointFormatLength);
-    snprintf(pointFormat2, pointFormatLength, "%s%%.%dlf%s%s%%.%dlf%s", xh, precision, xf, yh, precision, yf);
-
     /* make a copy of the original shape or compute a centroid if necessary */
     msInitShape(&tShape);
     if(centroid == MS_TRUE) {
@@ -2157,8 +2162,6 @@ static int processShpxyTag(layerObj *layer, char **line, shapeObj *shape)
 
       bufferShape = msGEOSBuffer(shape, buffer);
       if(!bufferShape) {
-        free(pointFormat1);
-        free(pointFormat2);
         return(MS_FAILURE); /* buffer failed */
       }
       msCopyShape(bufferShape, &tShape);
@@ -2168,8 +2171,6 @@ static int processShpxyTag(layerObj *layer, char **line, shapeObj *shape)
     else {
       status = msCopyShape(shape, &tShape);
       if(status != 0) {
-        free(pointFormat1);
-        free(pointFormat2);
         return(MS_FAILURE); /* copy failed */
       }
     }
@@ -2261,10 +2262,10 @@ static int processShpxyTag(layerObj *layer, char **line, shapeObj *shape)
           if(strlen(ph) > 0) coords = msStringConcatenate(coords, ph);
           coords = msStringConcatenate(coords, orh);
           for(p=0; p<tShape.line[i].numpoints-1; p++) {
-            snprintf(point, sizeof(point), pointFormat1, scale_x*tShape.line[i].point[p].x, scale_y*tShape.line[i].point[p].y);
+            formatShpxyPoint(point, sizeof(point), scale_x*tShape.line[i].point[p].x, scale_y*tShape.line[i].point[p].y, precision, xh, xf, yh, yf, cs);
             coords = msStringConcatenate(coords, point);
           }
-          snprintf(point, sizeof(point), pointFormat2, scale_x*tShape.line[i].point[p].x, scale_y*tShape.line[i].point[p].y);
+          formatShpxyPoint(point, sizeof(point), scale_x*tShape.line[i].point[p].x, scale_y*tShape.line[i].point[p].y, precision, xh, xf, yh, yf, "");
           coords = msStringConcatenate(coords, point);
           coords = msStringConcatenate(coords, orf);
 
@@ -2275,10 +2276,10 @@ static int processShpxyTag(layerObj *layer, char **line, shapeObj *shape)
               /* j is an inner ring of i */
               coords = msStringConcatenate(coords, irh);
               for(p=0; p<tShape.line[j].numpoints-1; p++) {
-                snprintf(point, sizeof(point), pointFormat1, scale_x*tShape.line[j].point[p].x, scale_y*tShape.line[j].point[p].y);
+                formatShpxyPoint(point, sizeof(point), scale_x*tShape.line[j].point[p].x, scale_y*tShape.line[j].point[p].y, precision, xh, xf, yh, yf, cs);
                 coords = msStringConcatenate(coords, point);
               }
-              snprintf(point, sizeof(point), pointFormat2, scale_x*tShape.line[j].point[p].x, scale_y*tShape.line[j].point[p].y);
+              formatShpxyPoint(point, sizeof(point), scale_x*tShape.line[j].point[p].x, scale_y*tShape.line[j].point[p].y, precision, xh, xf, yh, yf, "");
               coords = msStringConcatenate(coords, irf);
             }
           }
@@ -2299,10 +2300,10 @@ static int processShpxyTag(layerObj *layer, char **line, shapeObj *shape)
         if(strlen(ph) > 0) coords = msStringConcatenate(coords, ph);
 
         for(p=0; p<tShape.line[i].numpoints-1; p++) {
-          snprintf(point, sizeof(point), pointFormat1, scale_x*tShape.line[i].point[p].x, scale_y*tShape.line[i].point[p].y);
+          formatShpxyPoint(point, sizeof(point), scale_x*tShape.line[i].point[p].x, scale_y*tShape.line[i].point[p].y, precision, xh, xf, yh, yf, cs);
           coords = msStringConcatenate(coords, point);
         }
-        snprintf(point, sizeof(point), pointFormat2, scale_x*tShape.line[i].point[p].x, scale_y*tShape.line[i].point[p].y);
+        formatShpxyPoint(point, sizeof(point), scale_x*tShape.line[i].point[p].x, scale_y*tShape.line[i].point[p].y, precision, xh, xf, yh, yf, "");
         coords = msStringConcatenate(coords, point);
 
         if(strlen(pf) > 0) coords = msStringConcatenate(coords, pf);
@@ -2331,10 +2332,6 @@ static int processShpxyTag(layerObj *layer, char **line, shapeObj *shape)
     tag = NULL;
     msFreeHashTable(tagArgs);
     tagArgs=NULL;
-    free(pointFormat1);
-    pointFormat1 = NULL;
-    free(pointFormat2);
-    pointFormat2 = NULL;
     free(coords);
     coords = NULL;
 
@@ -4168,6 +4165,7 @@ int msReturnPage(mapservObj *mapserv, char *html, int mode, char **papszBuffer)
   int   nBufferSize = 0;
   int   nCurrentSize = 0;
   int   nExpandBuffer = 0;
+  msIOWriter writer;
 
   ms_regex_t re; /* compiled regular expression to be matched */
   char szPath[MS_MAXPATHLEN];
@@ -4213,41 +4211,43 @@ int msReturnPage(mapservObj *mapserv, char *html, int mode, char **papszBuffer)
     }
   }
 
+  /* output is batched, not flushed line by line */
+  msIO_writerInit(&writer, stdout);
+
   while(fgets(line, MS_BUFFER_LENGTH, stream) != NULL) { /* now on to the end of the file */
+    char *out = line;
+    int nLength;
 
+    tmpline = NULL;
     if(strchr(line, '[') != NULL) {
       tmpline = processLine(mapserv, line, stream, mode);
-      if(!tmpline)
+      if(!tmpline) {
+        msIO_writerFlush(&writer);
+        fclose(stream);
         return MS_FAILURE;
+      }
+      out = tmpline;
+    }
 
-      if(papszBuffer) {
-        if(nBufferSize <= (int)(nCurrentSize + strlen(tmpline) + 1)) {
-          nExpandBuffer = (strlen(tmpline) /  MS_TEMPLATE_BUFFER) + 1;
-          nBufferSize = MS_TEMPLATE_BUFFER*nExpandBuffer + strlen((*papszBuffer));
-          (*papszBuffer) = (char *) msSmallRealloc((*papszBuffer),sizeof(char)*nBufferSize);
-        }
-        strcat((*papszBuffer), tmpline);
-        nCurrentSize += strlen(tmpline);
-      } else
-        msIO_fwrite(tmpline, strlen(tmpline), 1, stdout);
+    nLength = strlen(out);
+    if(papszBuffer) {
+      if(nBufferSize <= nCurrentSize + nLength + 1) {
+        nExpandBuffer = (nLength /  MS_TEMPLATE_BUFFER) + 1;
+        nBufferSize = MS_TEMPLATE_BUFFER*nExpandBuffer + nCurrentSize;
+        (*papszBuffer) = (char *) msSmallRealloc((*papszBuffer),sizeof(char)*nBufferSize);
+      }
+      memcpy((*papszBuffer) + nCurrentSize, out, nLength + 1);
+      nCurrentSize += nLength;
+    } else
+      msIO_writerWrite(&writer, out, nLength);
 
-      free(tmpline);
-    } else {
-      if(papszBuffer) {
-        if(nBufferSize <= (int)(nCurrentSize + strlen(line))) {
-          nExpandBuffer = (strlen(line) /  MS_TEMPLATE_BUFFER) + 1;
-          nBufferSize = MS_TEMPLATE_BUFFER*nExpandBuffer + strlen((*papszBuffer));
-          (*papszBuffer) = (char *)msSmallRealloc((*papszBuffer),sizeof(char)*nBufferSize);
-        }
-        strcat((*papszBuffer), line);
-        nCurrentSize += strlen(line);
-      } else
-        msIO_fwrite(line, strlen(line), 1, stdout);
-    }
-    if(!papszBuffer)
-      fflush(stdout);
+    free(tmpline);
   } /* next line */
 
+  msIO_writerFlush(&writer);
+  if(!papszBuffer)
+    fflush(stdout);
+
   fclose(stream);
 
   return MS_SUCCESS;
@@ -44,9 +44,15 @@ It should be available for Win32 and pthreads environments.  It should be
 possible to implement for other thread libraries if needed.
 
   int msGetThreadId():
-    Returns the current threads integer id.  This can be used for making
-        some information thread specific, as has been done for the global
-        error context in maperror.c.
+    Returns the current threads integer id.
+
+  void *msGetThreadSlot(int):
+  void msSetThreadSlot(int, void *, void (*)(void *)):
+        Get and set the current thread's value of a slot (TSLOT_* codes in
+        mapthread.h), built on native thread local storage so no lock is
+        taken.  The destructor set with a value is called on it when the
+        thread exits.  This is how the error, debug and io contexts and the
+        font cache are made thread specific.
 
   void msAcquireLock(int):
         Acquires the indicated Mutex.  If it is already held by another thread
@@ -144,7 +150,7 @@ static int thread_debug = 0;
 
 static char *lock_names[] = {
   NULL, "PARSER", "GDAL", "ERROROBJ", "PROJ", "TTF", "POOL", "SDE",
-  "ORACLE", "OWS", "LAYER_VTABLE", "IOCONTEXT", "TMPFILE", "DEBUGOBJ", "OGR", "TIME", "FRIBIDI", "WXS", "GEOS", NULL
+  "ORACLE", "OWS", "LAYER_VTABLE", "IOCONTEXT", "TMPFILE", "DEBUGOBJ", "OGR", "TIME", "FRIBIDI", "WXS", "GEOS", "MAPML", "MAPFILE", "SHPMAP", "QIX", "JOIN", NULL
 };
 #endif
 
@@ -242,6 +248,10 @@ void msReleaseLock( int nLockId )
 static int mutexes_initialized = 0;
 static HANDLE mutex_locks[TLOCK_MAX];
 
+/* fiber local storage is used for the thread slots, TLS has no destructor */
+static DWORD slots_index = FLS_OUT_OF_INDEXES;
+static VOID WINAPI msThreadSlotsDestructor( PVOID slots );
+
 /************************************************************************/
 /*                            msThreadInit()                            */
 /************************************************************************/
@@ -252,7 +262,8 @@ void msThreadInit()
   /* static pthread_mutex_t core_lock = PTHREAD_MUTEX_INITIALIZER; */
   static HANDLE core_lock = NULL;
 
-  if( mutexes_initialized >= TLOCK_STATIC_MAX )
+  if( mutexes_initialized >= TLOCK_STATIC_MAX &&
+      slots_index != FLS_OUT_OF_INDEXES )
     return;
 
   if( thread_debug )
@@ -266,6 +277,9 @@ void msThreadInit()
   for( ; mutexes_initialized < TLOCK_STATIC_MAX; mutexes_initialized++ )
     mutex_locks[mutexes_initialized] = CreateMutex( NULL, FALSE, NULL );
 
+  if( slots_index == FLS_OUT_OF_INDEXES )
+    slots_index = FlsAlloc( msThreadSlotsDestructor );
+
   ReleaseMutex( core_lock );
 }
 
@@ -316,3 +330,157 @@ void msReleaseLock( int nLockId )
 }
 
 #endif /* defined(USE_THREAD) && defined(_WIN32) */
+
+/************************************************************************/
+/* ==================================================================== */
+/*                          PER THREAD SLOTS                            */
+/* ==================================================================== */
+/************************************************************************/
+
+typedef struct {
+  void *values[TSLOT_MAX];
+  void (*destructors[TSLOT_MAX])(void *);
+} threadSlotsObj;
+
+#if defined(USE_THREAD)
+
+/************************************************************************/
+/*                        msDestroyThreadSlots()                        */
+/*                                                                      */
+/*      Called when a thread exits with its slots.                      */
+/************************************************************************/
+
+static void msDestroyThreadSlots( threadSlotsObj *slots )
+
+{
+  int i;
+
+  for( i = 0; i < TSLOT_MAX; i++ ) {
+    if( slots->values[i] != NULL && slots->destructors[i] != NULL )
+      slots->destructors[i]( slots->values[i] );
+  }
+  free( slots );
+}
+
+#endif
+
+#if defined(USE_THREAD) && !defined(_WIN32)
+
+static pthread_key_t slots_key;
+static pthread_once_t slots_key_once = PTHREAD_ONCE_INIT;
+
+static void msThreadSlotsDestructor( void *slots )
+
+{
+  msDestroyThreadSlots( (threadSlotsObj *) slots );
+}
+
+static void msCreateThreadSlotsKey( void )
+
+{
+  pthread_key_create( &slots_key, msThreadSlotsDestructor );
+}
+
+static threadSlotsObj *msGetThreadSlots( void )
+
+{
+  pthread_once( &slots_key_once, msCreateThreadSlotsKey );
+  return (threadSlotsObj *) pthread_getspecific( slots_key );
+}
+
+static void msSetThreadSlots( threadSlotsObj *slots )
+
+{
+  pthread_setspecific( slots_key, slots );
+}
+
+#elif defined(USE_THREAD) && defined(_WIN32)
+
+static VOID WINAPI msThreadSlotsDestructor( PVOID slots )
+
+{
+  if( slots != NULL )
+    msDestroyThreadSlots( (threadSlotsObj *) slots );
+}
+
+static threadSlotsObj *msGetThreadSlots( void )
+
+{
+  if( slots_index == FLS_OUT_OF_INDEXES )
+    msThreadInit();
+  return (threadSlotsObj *) FlsGetValue( slots_index );
+}
+
+static void msSetThreadSlots( threadSlotsObj *slots )
+
+{
+  FlsSetValue( slots_index, slots );
+}
+
+#else
+
+static threadSlotsObj *process_slots = NULL;
+
+static threadSlotsObj *msGetThreadSlots( void )
+
+{
+  return process_slots;
+}
+
+static void msSetThreadSlots( threadSlotsObj *slots )
+
+{
+  process_slots = slots;
+}
+
+#endif
+
+/************************************************************************/
+/*                          msGetThreadSlot()                           */
+/************************************************************************/
+
+void *msGetThreadSlot( int nSlotId )
+
+{
+  threadSlotsObj *slots;
+
+  assert( nSlotId >= 0 && nSlotId < TSLOT_MAX );
+
+  slots = msGetThreadSlots();
+  return slots ? slots->values[nSlotId] : NULL;
+}
+
+/************************************************************************/
+/*                          msSetThreadSlot()                           */
+/*                                                                      */
+/*      Setting the last value of the thread to NULL releases its       */
+/*      slots, so msCleanup() leaves nothing behind in the main thread. */
+/************************************************************************/
+
+void msSetThreadSlot( int nSlotId, void *pValue, void (*pfnDestructor)(void *) )
+
+{
+  threadSlotsObj *slots;
+  int i;
+
+  assert( nSlotId >= 0 && nSlotId < TSLOT_MAX );
+
+  slots = msGetThreadSlots();
+  if( slots == NULL ) {
+    if( pValue == NULL )
+      return;
+    slots = (threadSlotsObj *) msSmallCalloc( 1, sizeof(threadSlotsObj) );
+    msSetThreadSlots( slots );
+  }
+
+  slots->values[nSlotId] = pValue;
+  slots->destructors[nSlotId] = pfnDestructor;
+
+  if( pValue == NULL ) {
+    for( i = 0; i < TSLOT_MAX && slots->values[i] == NULL; i++ ) {}
+    if( i == TSLOT_MAX ) {
+      msSetThreadSlots( NULL );
+      free( slots );
+    }
+  }
+}
@@ -46,6 +46,21 @@ extern "C" {
 #define msReleaseLock(x)
 #endif
 
+  /*
+  ** Per thread state: each slot holds one pointer per thread, found without
+  ** locking.  The destructor given with a value is called on it when the
+  ** thread exits, it is not called when the value is replaced.
+  */
+  void *msGetThreadSlot(int nSlotId);
+  void msSetThreadSlot(int nSlotId, void *pValue, void (*pfnDestructor)(void *));
+
+#define TSLOT_IOCONTEXT 0
+#define TSLOT_ERROROBJ  1
+#define TSLOT_DEBUGOBJ  2
+#define TSLOT_TTF       3
+
+#define TSLOT_MAX       8
+
   /*
   ** lock ids - note there is a corresponding lock_names[] array in
   ** mapthread.c that needs to be extended when new ids are added.
@@ -69,8 +84,13 @@ extern "C" {
 #define TLOCK_FRIBIDI   16
 #define TLOCK_WxS       17
 #define TLOCK_GEOS       18
+#define TLOCK_MAPML      19
+#define TLOCK_MAPFILE    20
+#define TLOCK_SHPMAP     21
+#define TLOCK_QIX        22
+#define TLOCK_JOIN       23
 
-#define TLOCK_STATIC_MAX 20
+#define TLOCK_STATIC_MAX 24
 #define TLOCK_MAX       100
 
 #ifdef __cplusplus
@@ -30,6 +30,16 @@
 #include "maptile.h"
 #include "mapproject.h"
 
+#ifndef _WIN32
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <errno.h>
+#endif
+
 #ifdef USE_TILE_API
 static void msTileResetMetatileLevel(mapObj *map)
 {
@@ -117,53 +127,25 @@ static void msTileGetParams(mapObj *map, tileParams *params)
 }
 
 /************************************************************************
- *                            msTileExtractSubTile                      *
+ *                            msTileGetSubTilePosition                  *
  *                                                                      *
+ *  Column and row of the requested tile within its metatile.           *
  ************************************************************************/
-static imageObj* msTileExtractSubTile(const mapservObj *msObj, const imageObj *img)
+static int msTileGetSubTilePosition(const mapservObj *msObj, const tileParams *params, int *sx, int *sy)
 {
 
-  int width, mini, minj;
-  int zoom = 2;
-  imageObj* imgOut = NULL;
-  tileParams params;
-  rendererVTableObj *renderer;
-  rasterBufferObj imgBuffer;
+  *sx = 0;
+  *sy = 0;
 
-  if( !MS_RENDERER_PLUGIN(msObj->map->outputformat)
-      || msObj->map->outputformat->renderer != img->format->renderer ||
-      ! MS_MAP_RENDERER(msObj->map)->supports_pixel_buffer ) {
-    msSetError(MS_MISCERR,"unsupported or mixed renderers","msTileExtractSubTile()");
-    return NULL;
-  }
-  renderer = MS_MAP_RENDERER(msObj->map);
-
-  if (renderer->getRasterBufferHandle((imageObj*)img,&imgBuffer) != MS_SUCCESS) {
-    return NULL;
-  }
-
-
-  /*
-  ** Load the metatiling information from the map file.
-  */
-  msTileGetParams(msObj->map, &params);
-
-  /*
-  ** Initialize values for the metatile clip area.
-  */
-  width = img->width - 2*params.map_edge_buffer;
-  mini = params.map_edge_buffer;
-  minj = params.map_edge_buffer;
-  
   if( msObj->TileMode == TILE_GMAP ) {
     int x, y, zoom;
 
     if( msObj->TileCoords ) {
       if( msTileGetGMapCoords(msObj->TileCoords, &x, &y, &zoom) == MS_FAILURE )
-        return NULL;
+        return MS_FAILURE;
     } else {
       msSetError(MS_WEBERR, "Tile parameter not set.", "msTileSetup()");
-      return NULL;
+      return MS_FAILURE;
     }
 
     if(msObj->map->debug)
@@ -173,53 +155,83 @@ static imageObj* msTileExtractSubTile(const mapservObj *msObj, const imageObj *i
     ** The bottom N bits of the coordinates give us the subtile
     ** location relative to the metatile.
     */
-    x = (0xffff ^ (0xffff << params.metatile_level)) & x;
-    y = (0xffff ^ (0xffff << params.metatile_level)) & y;
+    *sx = (0xffff ^ (0xffff << params->metatile_level)) & x;
+    *sy = (0xffff ^ (0xffff << params->metatile_level)) & y;
 
     if(msObj->map->debug)
-      msDebug("msTileExtractSubTile(): gmaps image coords (x: %d, y: %d)\n",x,y);
-
-    mini = mini + x * params.tile_size;
-    minj = minj + y * params.tile_size;
+      msDebug("msTileExtractSubTile(): gmaps image coords (x: %d, y: %d)\n",*sx,*sy);
 
   } else if( msObj->TileMode == TILE_VE ) {
-    int tsize;
     int i = 0;
     char j = 0;
 
-    if( (int)strlen( msObj->TileCoords ) - params.metatile_level < 0 ) {
-      return(NULL);
+    if( (int)strlen( msObj->TileCoords ) - params->metatile_level < 0 ) {
+      return(MS_FAILURE);
     }
 
     /*
     ** Process the last elements of the VE coordinate string to place the
     ** requested tile in the context of the metatile
     */
-    for( i = strlen( msObj->TileCoords ) - params.metatile_level;
+    for( i = strlen( msObj->TileCoords ) - params->metatile_level;
          i < strlen( msObj->TileCoords );
          i++ ) {
       j = msObj->TileCoords[i];
-      tsize = width / zoom;
-      if( j == '1' || j == '3' ) mini += tsize;
-      if( j == '2' || j == '3' ) minj += tsize;
-      zoom *= 2;
+      *sx <<= 1;
+      *sy <<= 1;
+      if( j == '1' || j == '3' ) *sx += 1;
+      if( j == '2' || j == '3' ) *sy += 1;
     }
   } else {
-    return(NULL); /* Huh? Should have a mode. */
+    return(MS_FAILURE); /* Huh? Should have a mode. */
   }
 
-  imgOut = msImageCreate(params.tile_size, params.tile_size, msObj->map->outputformat, NULL, NULL, msObj->map->resolution, msObj->map->defresolution, NULL);
+  return MS_SUCCESS;
+}
+
+/************************************************************************
+ *                            msTileExtractSubTileAt                    *
+ *                                                                      *
+ *  Copy the subtile at column sx, row sy out of a metatile image.      *
+ ************************************************************************/
+static imageObj* msTileExtractSubTileAt(mapObj *map, const tileParams *params, const imageObj *img, int sx, int sy)
+{
+
+  int mini, minj;
+  imageObj* imgOut = NULL;
+  rendererVTableObj *renderer;
+  rasterBufferObj imgBuffer;
+
+  if( !MS_RENDERER_PLUGIN(map->outputformat)
+      || map->outputformat->renderer != img->format->renderer ||
+      ! MS_MAP_RENDERER(map)->supports_pixel_buffer ) {
+    msSetError(MS_MISCERR,"unsupported or mixed renderers","msTileExtractSubTile()");
+    return NULL;
+  }
+  renderer = MS_MAP_RENDERER(map);
+
+  if (renderer->getRasterBufferHandle((imageObj*)img,&imgBuffer) != MS_SUCCESS) {
+    return NULL;
+  }
+
+  /*
+  ** Top corner of the subtile, skipping the metatile clip area.
+  */
+  mini = params->map_edge_buffer + sx * params->tile_size;
+  minj = params->map_edge_buffer + sy * params->tile_size;
+
+  imgOut = msImageCreate(params->tile_size, params->tile_size, map->outputformat, NULL, NULL, map->resolution, map->defresolution, NULL);
 
   if( imgOut == NULL ) {
     return NULL;
   }
 
-  if(msObj->map->debug)
-    msDebug("msTileExtractSubTile(): extracting (%d x %d) tile, top corner (%d, %d)\n",params.tile_size,params.tile_size,mini,minj);
+  if(map->debug)
+    msDebug("msTileExtractSubTile(): extracting (%d x %d) tile, top corner (%d, %d)\n",params->tile_size,params->tile_size,mini,minj);
 
 
 
-  if(UNLIKELY(MS_FAILURE == renderer->mergeRasterBuffer(imgOut,&imgBuffer,1.0,mini, minj,0, 0,params.tile_size, params.tile_size))) {
+  if(UNLIKELY(MS_FAILURE == renderer->mergeRasterBuffer(imgOut,&imgBuffer,1.0,mini, minj,0, 0,params->tile_size, params->tile_size))) {
     msFreeImage(imgOut);
     return NULL;
   }
@@ -227,6 +239,27 @@ static imageObj* msTileExtractSubTile(const mapservObj *msObj, const imageObj *i
   return imgOut;
 }
 
+/************************************************************************
+ *                            msTileExtractSubTile                      *
+ *                                                                      *
+ ************************************************************************/
+static imageObj* msTileExtractSubTile(const mapservObj *msObj, const imageObj *img)
+{
+
+  int sx, sy;
+  tileParams params;
+
+  /*
+  ** Load the metatiling information from the map file.
+  */
+  msTileGetParams(msObj->map, &params);
+
+  if( msTileGetSubTilePosition(msObj, &params, &sx, &sy) != MS_SUCCESS )
+    return NULL;
+
+  return msTileExtractSubTileAt(msObj->map, &params, img, sx, sy);
+}
+
 
 /************************************************************************
  *                            msTileSetup                               *
@@ -531,3 +564,315 @@ imageObj* msTileDraw(mapservObj *msObj)
   return img;
 }
 
+
+#if defined(USE_TILE_API) && !defined(_WIN32)
+
+/************************************************************************
+ *                            msTileGetMetatileKey                      *
+ *                                                                      *
+ *  Hash of everything that selects the content of a metatile: the      *
+ *  mapfile and its modification time, the output format, the request   *
+ *  parameters (which carry the layer list and any runtime overrides)   *
+ *  and the metatile coordinates. The tile parameter itself is reduced  *
+ *  to its metatile. Like the MapML document cache, changes to INCLUDEd *
+ *  files, symbolsets and fontsets are not detected.                    *
+ ************************************************************************/
+static void msTileGetMetatileKey(const mapservObj *msObj, const tileParams *params, char *key, size_t keysize)
+{
+  unsigned long long h = 14695981039346656037ULL; /* FNV-1a */
+  char metatile[256], mtime[64] = "";
+  const char *parts[6], *mapfile = NULL;
+  struct stat st;
+  int i, p;
+
+  /* same rules as msCGILoadMap() */
+  for( i = 0; i < msObj->request->NumParams; i++ ) {
+    if( strcasecmp(msObj->request->ParamNames[i], "map") == 0 ) {
+      mapfile = getenv(msObj->request->ParamValues[i]) ? getenv(msObj->request->ParamValues[i]) : msObj->request->ParamValues[i];
+      break;
+    }
+  }
+  if( mapfile == NULL )
+    mapfile = getenv("MS_MAPFILE");
+  if( mapfile != NULL && stat(mapfile, &st) == 0 )
+    snprintf(mtime, sizeof(mtime), "%ld", (long) st.st_mtime);
+  else
+    mapfile = "";
+
+  if( msObj->TileMode == TILE_GMAP ) {
+    int x = 0, y = 0, zoom = 0;
+    msTileGetGMapCoords(msObj->TileCoords, &x, &y, &zoom);
+    snprintf(metatile, sizeof(metatile), "gmap %d %d %d %d %d",
+             zoom - params->metatile_level, x >> params->metatile_level,
+             y >> params->metatile_level, params->metatile_level, params->map_edge_buffer);
+  } else {
+    snprintf(metatile, sizeof(metatile), "ve %.*s %d %d",
+             (int)(strlen(msObj->TileCoords) - params->metatile_level), msObj->TileCoords,
+             params->metatile_level, params->map_edge_buffer);
+  }
+
+  parts[0] = mapfile;
+  parts[1] = mtime;
+  parts[2] = msObj->map->mappath ? msObj->map->mappath : "";
+  parts[3] = msObj->map->name ? msObj->map->name : "";
+  parts[4] = msObj->map->outputformat->name ? msObj->map->outputformat->name : "";
+  parts[5] = metatile;
+
+  for( p = 0; p < 6; p++ ) {
+    const unsigned char *c;
+    for( c = (const unsigned char *)parts[p]; *c; c++ ) {
+      h ^= *c;
+      h *= 1099511628211ULL;
+    }
+    h ^= 0xff;
+    h *= 1099511628211ULL;
+  }
+
+  for( i = 0; i < msObj->request->NumParams; i++ ) {
+    const unsigned char *c;
+    if( strcasecmp(msObj->request->ParamNames[i], "tile") == 0 )
+      continue;
+    for( c = (const unsigned char *)msObj->request->ParamNames[i]; *c; c++ ) {
+      h ^= *c;
+      h *= 1099511628211ULL;
+    }
+    h ^= '=';
+    h *= 1099511628211ULL;
+    for( c = (const unsigned char *)msObj->request->ParamValues[i]; *c; c++ ) {
+      h ^= *c;
+      h *= 1099511628211ULL;
+    }
+    h ^= '&';
+    h *= 1099511628211ULL;
+  }
+
+  snprintf(key, keysize, "%016llx", h);
+}
+
+/************************************************************************
+ *                            msTileReadCached                          *
+ *                                                                      *
+ *  Load a stored subtile unless it is missing or older than expire     *
+ *  seconds. Returns MS_DONE on a cache miss.                           *
+ ************************************************************************/
+static int msTileReadCached(const char *path, int expire, unsigned char **buffer, int *size)
+{
+  struct stat st;
+  FILE *fp;
+
+  if( stat(path, &st) != 0 || st.st_size <= 0 )
+    return MS_DONE;
+  if( expire > 0 && time(NULL) - st.st_mtime > expire )
+    return MS_DONE;
+
+  fp = fopen(path, "rb");
+  if( fp == NULL )
+    return MS_DONE;
+
+  *buffer = (unsigned char *) msSmallMalloc(st.st_size);
+  if( fread(*buffer, 1, st.st_size, fp) != (size_t)st.st_size ) {
+    fclose(fp);
+    msFree(*buffer);
+    *buffer = NULL;
+    return MS_DONE;
+  }
+  fclose(fp);
+
+  *size = (int)st.st_size;
+  return MS_SUCCESS;
+}
+
+/************************************************************************
+ *                            msTileSweepCache                          *
+ *                                                                      *
+ *  Remove the stored subtiles and lock files older than expire         *
+ *  seconds, which are left behind once the mapfile or the requests     *
+ *  change. The directory is scanned at most once per expire seconds,   *
+ *  the time of the last sweep being kept as the modification time of   *
+ *  a sweep.stamp file. The lock file of the metatile being drawn       *
+ *  (key) is kept.                                                      *
+ ************************************************************************/
+static void msTileSweepCache(const char *cachedir, const char *key, int expire, int debug)
+{
+  char path[MS_MAXPATHLEN];
+  struct stat st;
+  struct dirent *entry;
+  DIR *dir;
+  time_t now = time(NULL);
+  int fd, removed = 0;
+
+  snprintf(path, sizeof(path), "%s/sweep.stamp", cachedir);
+  if( stat(path, &st) == 0 && now - st.st_mtime < expire )
+    return;
+  if( (fd = open(path, O_CREAT | O_WRONLY, 0644)) < 0 )
+    return;
+  close(fd);
+  utime(path, NULL);
+
+  if( (dir = opendir(cachedir)) == NULL )
+    return;
+  while( (entry = readdir(dir)) != NULL ) {
+    const char *name = entry->d_name;
+
+    /* only our own <key>_<x>_<y>.<ext> and <key>.lock files */
+    if( strspn(name, "0123456789abcdef") != 16 || (name[16] != '_' && strcmp(name + 16, ".lock") != 0) )
+      continue;
+    if( strncmp(name, key, 16) == 0 && strcmp(name + 16, ".lock") == 0 )
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", cachedir, name);
+    if( stat(path, &st) == 0 && now - st.st_mtime > expire && unlink(path) == 0 )
+      removed++;
+  }
+  closedir(dir);
+
+  if( debug )
+    msDebug("msTileSweepCache(): removed %d expired files from %s\n", removed, cachedir);
+}
+
+#endif /* USE_TILE_API && !_WIN32 */
+
+/************************************************************************
+ *                            msTileDrawCached                          *
+ *                                                                      *
+ *   Metatile sibling cache, enabled by the tile_metatile_cache_dir     *
+ *   web metadata. Every subtile of a drawn metatile is encoded and     *
+ *   stored, so the requests for its siblings are served from disk      *
+ *   instead of drawing the whole metatile again. A lock file per       *
+ *   metatile makes concurrent processes draw a given metatile once.    *
+ *   Stored tiles older than tile_metatile_cache_expire seconds         *
+ *   (default 300) are drawn again, and removed by msTileSweepCache().  *
+ *   With tile_metatile_cache_expire 0 nothing expires and nothing is   *
+ *   removed: the directory then needs an external sweep (e.g. a cron   *
+ *   job deleting old files) as the mapfile and the requests change.    *
+ *   The directory is created if missing, its parent must exist.        *
+ *                                                                      *
+ *   Returns MS_SUCCESS with the encoded tile in buffer, MS_FAILURE on  *
+ *   error, or MS_DONE if the cache does not apply to this request and  *
+ *   msTileDraw() should be used.                                       *
+ *   WARNING: Call msTileSetExtent() first.                             *
+ ************************************************************************/
+
+int msTileDrawCached(mapservObj *msObj, unsigned char **buffer, int *size)
+{
+#if defined(USE_TILE_API) && !defined(_WIN32)
+  mapObj *map = msObj->map;
+  tileParams params;
+  const char *value;
+  char cachedir[MS_MAXPATHLEN], path[MS_MAXPATHLEN], tmppath[MS_MAXPATHLEN];
+  char key[32];
+  int expire = 300;
+  int sx, sy, i, j, fd, n;
+  int status = MS_SUCCESS;
+  imageObj *img;
+
+  *buffer = NULL;
+  *size = 0;
+
+  msTileGetParams(map, &params);
+  if( params.metatile_level == 0 )
+    return MS_DONE;
+  if( (value = msLookupHashTable(&(map->web.metadata), "tile_metatile_cache_dir")) == NULL )
+    return MS_DONE;
+  if( !MS_RENDERER_PLUGIN(map->outputformat) ||
+      !MS_MAP_RENDERER(map)->supports_pixel_buffer )
+    return MS_DONE;
+
+  if( msBuildPath(cachedir, map->mappath, value) == NULL )
+    return MS_FAILURE;
+  if( (value = msLookupHashTable(&(map->web.metadata), "tile_metatile_cache_expire")) != NULL )
+    expire = atoi(value);
+
+  if( msTileGetSubTilePosition(msObj, &params, &sx, &sy) != MS_SUCCESS )
+    return MS_FAILURE;
+  msTileGetMetatileKey(msObj, &params, key, sizeof(key));
+
+  if( mkdir(cachedir, 0755) != 0 && errno != EEXIST ) {
+    msSetError(MS_IOERR, "Unable to create metatile cache directory %s.", "msTileDrawCached()", cachedir);
+    return MS_FAILURE;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s_%d_%d.%s", cachedir, key, sx, sy,
+           map->outputformat->extension ? map->outputformat->extension : "img");
+  if( msTileReadCached(path, expire, buffer, size) == MS_SUCCESS ) {
+    if(map->debug)
+      msDebug("msTileDrawCached(): served %s from metatile cache\n", path);
+    return MS_SUCCESS;
+  }
+
+  /*
+  ** Serialize the drawing of this metatile, and check again once we
+  ** hold the lock in case another process has just drawn it.
+  */
+  snprintf(tmppath, sizeof(tmppath), "%s/%s.lock", cachedir, key);
+  fd = open(tmppath, O_CREAT | O_RDWR, 0644);
+  if( fd < 0 ) {
+    msSetError(MS_IOERR, "Unable to open metatile lock file %s.", "msTileDrawCached()", tmppath);
+    return MS_FAILURE;
+  }
+  if( flock(fd, LOCK_EX) != 0 ) {
+    close(fd);
+    msSetError(MS_IOERR, "Unable to lock metatile lock file %s.", "msTileDrawCached()", tmppath);
+    return MS_FAILURE;
+  }
+
+  if( msTileReadCached(path, expire, buffer, size) == MS_SUCCESS ) {
+    if(map->debug)
+      msDebug("msTileDrawCached(): served %s drawn by another process\n", path);
+    flock(fd, LOCK_UN);
+    close(fd);
+    return MS_SUCCESS;
+  }
+
+  img = msDrawMap(map, MS_FALSE);
+  if( img == NULL ) {
+    flock(fd, LOCK_UN);
+    close(fd);
+    return MS_FAILURE;
+  }
+
+  /*
+  ** Store every subtile, writing to a temporary name first so that
+  ** readers never see a partial file.
+  */
+  n = 1 << params.metatile_level;
+  for( j = 0; j < n && status == MS_SUCCESS; j++ ) {
+    for( i = 0; i < n && status == MS_SUCCESS; i++ ) {
+      char tilepath[MS_MAXPATHLEN];
+      imageObj *tile = msTileExtractSubTileAt(map, &params, img, i, j);
+      if( tile == NULL ) {
+        status = MS_FAILURE;
+        break;
+      }
+      snprintf(tilepath, sizeof(tilepath), "%s/%s_%d_%d.%s", cachedir, key, i, j,
+               map->outputformat->extension ? map->outputformat->extension : "img");
+      snprintf(tmppath, sizeof(tmppath), "%s.%d.tmp", tilepath, (int)getpid());
+      status = msSaveImage(map, tile, tmppath);
+      msFreeImage(tile);
+      if( status == MS_SUCCESS && rename(tmppath, tilepath) != 0 ) {
+        unlink(tmppath);
+        msSetError(MS_IOERR, "Unable to store metatile subtile %s.", "msTileDrawCached()", tilepath);
+        status = MS_FAILURE;
+      }
+    }
+  }
+  msFreeImage(img);
+
+  if( status == MS_SUCCESS && msTileReadCached(path, 0, buffer, size) != MS_SUCCESS ) {
+    msSetError(MS_IOERR, "Unable to read back metatile subtile %s.", "msTileDrawCached()", path);
+    status = MS_FAILURE;
+  }
+
+  if( status == MS_SUCCESS && expire > 0 )
+    msTileSweepCache(cachedir, key, expire, map->debug);
+
+  flock(fd, LOCK_UN);
+  close(fd);
+
+  return status;
+#else
+  (void)msObj;
+  *buffer = NULL;
+  *size = 0;
+  return MS_DONE;
+#endif
+}
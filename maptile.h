@@ -44,6 +44,7 @@ MS_DLL_EXPORT int msTileSetup(mapservObj *msObj);
 MS_DLL_EXPORT int msTileSetExtent(mapservObj *msObj);
 MS_DLL_EXPORT int msTileSetProjections(mapObj *map);
 MS_DLL_EXPORT imageObj* msTileDraw(mapservObj *msObj);
+MS_DLL_EXPORT int msTileDrawCached(mapservObj *msObj, unsigned char **buffer, int *size);
 
 typedef struct {
   int metatile_level; /* In zoom levels above tile request: best bet is 0, 1 or 2 */
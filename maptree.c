@@ -31,6 +31,9 @@
 #include "mapserver.h"
 #include "maptree.h"
 
+#include <sys/stat.h>
+#include <cpl_conv.h>
+
 
 
 /* -------------------------------------------------------------------- */
@@ -828,3 +831,820 @@ void msFilterTreeSearch(shapefileObj *shp, ms_bitarray status, rectObj search_re
   }
 
 }
+
+/*
+** Cached .qix search. With the MS_QIX_CACHE_SIZE configuration option set to
+** a size in megabytes, the index of a shapefile is read once into a flat array
+** of nodes (in file order, each node knowing where its subtree ends so it can
+** be searched without recursion) along with the bounds of all the shapes, and
+** kept for later requests. Entries are keyed on the identity (device, inode,
+** mtime and size) of both the .qix and the .shp file, and shared between
+** threads. Results are the same as msSearchDiskTree() + msFilterTreeSearch().
+*/
+typedef struct {
+  rectObj rect;
+  int firstid; /* index in ids */
+  int numshapes;
+  int next; /* first node after this subtree */
+} qixNodeObj;
+
+typedef struct qixCacheEntry {
+  char *filename;
+  long long key[8]; /* .qix then .shp device, inode, mtime and size */
+  int nShapes;
+  qixNodeObj *nodes;
+  int numnodes;
+  ms_int32 *ids;
+  rectObj *bounds; /* of every shape */
+  ms_bitarray boundsvalid; /* msSHPReadBounds() succeeded */
+  size_t bytes;
+  int refcount;
+  int stale; /* files changed on disk, freed once released */
+  struct qixCacheEntry *next;
+} qixCacheEntry;
+
+static qixCacheEntry *qixCache = NULL; /* most recently used first */
+static size_t qixCacheMaxBytes = 0;
+
+static size_t msTreeCacheMaxBytes(void)
+{
+  const char *size = CPLGetConfigOption("MS_QIX_CACHE_SIZE", NULL);
+  return size ? (size_t) MS_MAX(atoi(size), 0) * 1024 * 1024 : 0;
+}
+
+static void msTreeCacheFreeEntry(qixCacheEntry *entry)
+{
+  msFree(entry->filename);
+  msFree(entry->nodes);
+  msFree(entry->ids);
+  msFree(entry->bounds);
+  msFree(entry->boundsvalid);
+  msFree(entry);
+}
+
+/* drops least recently used unreferenced entries above the size limit, called with the lock held */
+static void msTreeCacheTrim(void)
+{
+  qixCacheEntry *entry, *prev = NULL;
+  size_t bytes = 0;
+
+  entry = qixCache;
+  while(entry) {
+    bytes += entry->bytes;
+    if(entry->refcount == 0 && bytes > qixCacheMaxBytes) {
+      qixCacheEntry *next = entry->next;
+      bytes -= entry->bytes;
+      if(prev) prev->next = next;
+      else qixCache = next;
+      msTreeCacheFreeEntry(entry);
+      entry = next;
+    } else {
+      prev = entry;
+      entry = entry->next;
+    }
+  }
+}
+
+static int msTreeStatKey(struct stat *sb, long long *key)
+{
+  key[0] = sb->st_dev;
+  key[1] = sb->st_ino;
+  key[2] = sb->st_mtime;
+  key[3] = sb->st_size;
+  return MS_SUCCESS;
+}
+
+/* identity of the .qix file msSHPDiskTreeOpen() opens, and of the .shp file of shp */
+static int msTreeCacheKey(shapefileObj *shp, const char *filename, long long *key)
+{
+  struct stat sb;
+
+  if(stat(filename, &sb) != 0) {
+    char *upper = msStrdup(filename);
+    int status;
+    if(strlen(upper) > 4)
+      strcpy(upper + strlen(upper) - 4, ".QIX");
+    status = stat(upper, &sb);
+    msFree(upper);
+    if(status != 0)
+      return MS_FAILURE;
+  }
+  msTreeStatKey(&sb, key);
+
+  if(shp->hSHP->mapSHP) {
+    key[4] = shp->hSHP->mapSHP->dev;
+    key[5] = shp->hSHP->mapSHP->ino;
+    key[6] = shp->hSHP->mapSHP->mtime;
+    key[7] = shp->hSHP->mapSHP->size;
+  } else {
+    if(!shp->hSHP->fpSHP || fstat(fileno(shp->hSHP->fpSHP), &sb) != 0)
+      return MS_FAILURE;
+    msTreeStatKey(&sb, key + 4);
+  }
+  return MS_SUCCESS;
+}
+
+static ms_int32 msTreeCacheReadInt(const uchar *data, int needswap)
+{
+  ms_int32 value;
+  memcpy(&value, data, 4);
+  if(needswap) SwapWord(4, &value);
+  return value;
+}
+
+/*
+** Reads the whole index and the shape bounds. Returns NULL if the index can't
+** be used as is (missing, corrupt or too large), in which case the regular
+** search handles and reports the problem.
+*/
+static qixCacheEntry *msTreeCacheLoad(shapefileObj *shp, const char *filename, int debug, size_t maxbytes)
+{
+  typedef struct {
+    int node, numsubnodes;
+    long end; /* where the subtree should end according to the node offset */
+  } qixStackItem;
+
+  SHPTreeHandle disktree;
+  qixCacheEntry *entry;
+  qixStackItem *stack = NULL;
+  uchar *data;
+  long start, size, pos = 0;
+  int i, numstack = 0, maxstack = 0, maxnodes = 0, numids = 0, maxids = 0;
+
+  disktree = msSHPDiskTreeOpen(filename, debug);
+  if(!disktree)
+    return NULL;
+
+  start = ftell(disktree->fp);
+  if(disktree->nShapes != shp->numshapes || start < 0 || fseek(disktree->fp, 0, SEEK_END) != 0 ||
+      (size = ftell(disktree->fp) - start) <= 0 || fseek(disktree->fp, start, SEEK_SET) != 0 ||
+      (size_t) size + (size_t) disktree->nShapes * sizeof(rectObj) > maxbytes) {
+    msSHPDiskTreeClose(disktree);
+    return NULL;
+  }
+  data = (uchar *) msSmallMalloc(size);
+  if(fread(data, size, 1, disktree->fp) != 1) {
+    msFree(data);
+    msSHPDiskTreeClose(disktree);
+    return NULL;
+  }
+
+  entry = (qixCacheEntry *) msSmallCalloc(1, sizeof(qixCacheEntry));
+  entry->nShapes = disktree->nShapes;
+
+  /* flatten the tree, nodes are stored depth first */
+  do {
+    if(numstack > 0 && stack[numstack-1].numsubnodes == 0) { /* end of a subtree */
+      numstack--;
+      if(pos != stack[numstack].end) goto corrupt;
+      entry->nodes[stack[numstack].node].next = entry->numnodes;
+      continue;
+    }
+    if(numstack > 0)
+      stack[numstack-1].numsubnodes--;
+
+    {
+      qixNodeObj *node;
+      ms_int32 offset, numshapes, numsubnodes;
+
+      if(pos + 40 > size) goto corrupt;
+      if(entry->numnodes == maxnodes) {
+        maxnodes = maxnodes ? maxnodes * 2 : 64;
+        entry->nodes = (qixNodeObj *) msSmallRealloc(entry->nodes, maxnodes * sizeof(qixNodeObj));
+      }
+      node = &entry->nodes[entry->numnodes++];
+
+      offset = msTreeCacheReadInt(data + pos, disktree->needswap);
+      memcpy(&node->rect, data + pos + 4, sizeof(rectObj));
+      if(disktree->needswap) {
+        SwapWord(8, &node->rect.minx);
+        SwapWord(8, &node->rect.miny);
+        SwapWord(8, &node->rect.maxx);
+        SwapWord(8, &node->rect.maxy);
+      }
+      numshapes = msTreeCacheReadInt(data + pos + 36, disktree->needswap);
+      pos += 40;
+      if(numshapes < 0 || offset < 0 || numshapes > (size - pos - 4) / 4) goto corrupt;
+
+      node->firstid = numids;
+      node->numshapes = numshapes;
+      if(numids + numshapes > maxids) {
+        maxids = MS_MAX(numids + numshapes, maxids * 2);
+        entry->ids = (ms_int32 *) msSmallRealloc(entry->ids, maxids * sizeof(ms_int32));
+      }
+      for(i=0; i<numshapes; i++) {
+        ms_int32 id = msTreeCacheReadInt(data + pos + i*4, disktree->needswap);
+        if(id < 0 || id >= entry->nShapes) goto corrupt;
+        entry->ids[numids++] = id;
+      }
+      pos += numshapes * 4;
+
+      numsubnodes = msTreeCacheReadInt(data + pos, disktree->needswap);
+      pos += 4;
+      if(numsubnodes < 0) goto corrupt;
+
+      if(numstack == maxstack) {
+        maxstack = maxstack ? maxstack * 2 : 16;
+        stack = (qixStackItem *) msSmallRealloc(stack, maxstack * sizeof(qixStackItem));
+      }
+      stack[numstack].node = entry->numnodes - 1;
+      stack[numstack].numsubnodes = numsubnodes;
+      stack[numstack].end = pos + offset;
+      numstack++;
+    }
+  } while(numstack > 0);
+
+  msFree(stack);
+  msFree(data);
+  msSHPDiskTreeClose(disktree);
+
+  entry->bounds = (rectObj *) msSmallMalloc(MS_MAX(entry->nShapes, 1) * sizeof(rectObj));
+  entry->boundsvalid = msAllocBitArray(MS_MAX(entry->nShapes, 1));
+  for(i=0; i<entry->nShapes; i++) {
+    if(msSHPReadBounds(shp->hSHP, i, &entry->bounds[i]) == MS_SUCCESS)
+      msSetBit(entry->boundsvalid, i, 1);
+  }
+
+  entry->filename = msStrdup(filename);
+  entry->bytes = entry->numnodes * sizeof(qixNodeObj) + numids * sizeof(ms_int32) +
+                 entry->nShapes * (sizeof(rectObj) + 1);
+  return entry;
+
+corrupt:
+  msFree(stack);
+  msFree(data);
+  msSHPDiskTreeClose(disktree);
+  msTreeCacheFreeEntry(entry);
+  return NULL;
+}
+
+static ms_bitarray msTreeCacheSearch(qixCacheEntry *entry, rectObj aoi)
+{
+  ms_bitarray status;
+  int i = 0, j;
+
+  status = msAllocBitArray(entry->nShapes);
+  if(!status)
+    return NULL;
+
+  while(i < entry->numnodes) {
+    const qixNodeObj *node = &entry->nodes[i];
+    if(!msRectOverlap(&node->rect, &aoi)) { /* skip this node and sub-nodes */
+      i = node->next;
+      continue;
+    }
+    for(j=0; j<node->numshapes; j++) {
+      int id = entry->ids[node->firstid + j];
+      /* same filtering as msFilterTreeSearch() */
+      if(msGetBit(entry->boundsvalid, id) && msRectOverlap(&entry->bounds[id], &aoi) != MS_TRUE)
+        continue;
+      msSetBit(status, id, 1);
+    }
+    i++;
+  }
+
+  return status;
+}
+
+/*
+** Looks up the current entry for filename, called with the lock held. An entry
+** for other versions of the files is dropped, a matching one moves to the front
+** and gets a reference.
+*/
+static qixCacheEntry *msTreeCacheFind(const char *filename, long long *key)
+{
+  qixCacheEntry *entry, *prev = NULL;
+
+  for(entry = qixCache; entry; prev = entry, entry = entry->next) {
+    if(strcmp(entry->filename, filename) != 0)
+      continue;
+
+    /* unlink it, it moves to the front or goes away */
+    if(prev) prev->next = entry->next;
+    else qixCache = entry->next;
+
+    if(memcmp(entry->key, key, sizeof(entry->key)) == 0) {
+      entry->next = qixCache;
+      qixCache = entry;
+      entry->refcount++;
+      return entry;
+    }
+
+    if(entry->refcount == 0)
+      msTreeCacheFreeEntry(entry);
+    else
+      entry->stale = MS_TRUE;
+    return NULL;
+  }
+
+  return NULL;
+}
+
+/*
+** Returns the shapes of shp whose bounds overlap aoi using the cached index,
+** or NULL if the cache is disabled or the index can't be cached.
+*/
+ms_bitarray msSearchDiskTreeCached(shapefileObj *shp, const char *filename, rectObj aoi, int debug)
+{
+  qixCacheEntry *entry, *loaded;
+  long long key[8];
+  size_t maxbytes = msTreeCacheMaxBytes();
+  ms_bitarray status;
+
+  if(maxbytes == 0 || !shp->hSHP || msTreeCacheKey(shp, filename, key) != MS_SUCCESS)
+    return NULL;
+
+  msAcquireLock(TLOCK_QIX);
+  entry = msTreeCacheFind(filename, key);
+  msReleaseLock(TLOCK_QIX);
+
+  if(!entry) {
+    loaded = msTreeCacheLoad(shp, filename, debug, maxbytes);
+    if(!loaded)
+      return NULL;
+    memcpy(loaded->key, key, sizeof(key));
+
+    /* another thread may have loaded the same index meanwhile, use the first one in */
+    msAcquireLock(TLOCK_QIX);
+    entry = msTreeCacheFind(filename, key);
+    if(entry) {
+      msTreeCacheFreeEntry(loaded);
+    } else {
+      entry = loaded;
+      entry->refcount = 1;
+      entry->next = qixCache;
+      qixCache = entry;
+    }
+    msReleaseLock(TLOCK_QIX);
+  }
+
+  status = msTreeCacheSearch(entry, aoi);
+
+  msAcquireLock(TLOCK_QIX);
+  entry->refcount--;
+  if(entry->stale) {
+    if(entry->refcount == 0)
+      msTreeCacheFreeEntry(entry);
+  } else {
+    qixCacheMaxBytes = maxbytes;
+    msTreeCacheTrim();
+  }
+  msReleaseLock(TLOCK_QIX);
+
+  return status;
+}
+
+/* frees the cached indexes no longer in use, see msCleanup() */
+void msTreeCacheCleanup(void)
+{
+  qixCacheEntry *entry, *prev = NULL;
+
+  msAcquireLock(TLOCK_QIX);
+  entry = qixCache;
+  while(entry) {
+    qixCacheEntry *next = entry->next;
+    if(entry->refcount == 0) {
+      if(prev) prev->next = next;
+      else qixCache = next;
+      msTreeCacheFreeEntry(entry);
+    } else {
+      prev = entry;
+    }
+    entry = next;
+  }
+  msReleaseLock(TLOCK_QIX);
+}
+
+/*
+** Packed Hilbert R-tree (.hix) index. The indexed shapes are sorted on the
+** Hilbert value of the center of their bounds and packed bottom up into
+** nodes of nodeSize entries, so every level is a contiguous array and the
+** children of node j are entries j*nodeSize to (j+1)*nodeSize-1 of the next
+** level. The file layout is:
+**
+**   8 bytes   "SHR", byte order (MS_NEW_LSB_ORDER or MS_NEW_MSB_ORDER),
+**             version, 3 reserved bytes
+**   16 bytes  number of shapes in the shapefile, number of indexed shapes,
+**             node size and number of levels
+**   4 bytes   per level, the number of entries in the level, root first
+**   32 bytes  per internal entry (minx, miny, maxx, maxy), root level first
+**   36 bytes  per leaf entry (bounds of the shape and shape id)
+**
+** Leaves hold the exact bounds of the shapes, so unlike a .qix search the
+** results don't need to be filtered against the .shp.
+*/
+#define HILBERT_MAX_LEVELS 32
+#define HILBERT_RECORD_SIZE 32
+#define HILBERT_LEAF_SIZE 36
+
+typedef struct {
+  unsigned int value;
+  ms_int32 id;
+  rectObj rect;
+} hilbertEntryObj;
+
+/* Hilbert curve distance of (x,y) on a 65536x65536 grid */
+static unsigned int hilbertValue(unsigned int x, unsigned int y)
+{
+  unsigned int rx, ry, s, t, d = 0;
+
+  for(s = 1 << 15; s > 0; s >>= 1) {
+    rx = (x & s) > 0;
+    ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+    if(ry == 0) {
+      if(rx == 1) {
+        x = s - 1 - x;
+        y = s - 1 - y;
+      }
+      t = x;
+      x = y;
+      y = t;
+    }
+  }
+  return d;
+}
+
+static int hilbertEntryCompare(const void *a, const void *b)
+{
+  const hilbertEntryObj *ea = (const hilbertEntryObj *) a, *eb = (const hilbertEntryObj *) b;
+
+  if(ea->value != eb->value) return (ea->value < eb->value) ? -1 : 1;
+  return (ea->id < eb->id) ? -1 : (ea->id > eb->id);
+}
+
+/* replaces the extension of filename (if any) by ext */
+static char *hilbertTreeFilename(const char *filename, const char *ext)
+{
+  char *pszFullname;
+  int i;
+
+  pszFullname = (char *) msSmallMalloc(strlen(filename) + strlen(ext) + 1);
+  strcpy(pszFullname, filename);
+  for(i = strlen(pszFullname)-1;
+      i > 0 && pszFullname[i] != '.' && pszFullname[i] != '/' && pszFullname[i] != '\\';
+      i--) {}
+  if(pszFullname[i] == '.')
+    pszFullname[i] = '\0';
+  strcat(pszFullname, ext);
+
+  return pszFullname;
+}
+
+static int hilbertWriteInt(FILE *fp, ms_int32 value)
+{
+  return fwrite(&value, 4, 1, fp) == 1;
+}
+
+static int hilbertWriteRect(FILE *fp, const rectObj *rect)
+{
+  double values[4];
+
+  values[0] = rect->minx;
+  values[1] = rect->miny;
+  values[2] = rect->maxx;
+  values[3] = rect->maxy;
+  return fwrite(values, 8, 4, fp) == 4;
+}
+
+/*
+** Builds and writes the .hix index of shapefile, nodesize is the number of
+** entries per node (0 for the default).
+*/
+int msWriteHilbertTree(shapefileObj *shapefile, const char *filename, int nodesize)
+{
+  hilbertEntryObj *entries;
+  rectObj *levels[HILBERT_MAX_LEVELS], bounds;
+  ms_int32 levelcount[HILBERT_MAX_LEVELS];
+  int numentries = 0, numlevels, i, j, k, status = MS_TRUE;
+  double width, height;
+  char *pszFullname;
+  uchar pabyBuf[8];
+  FILE *fp;
+
+  if(!shapefile) return MS_FALSE;
+  if(nodesize <= 0) nodesize = MS_HILBERT_NODE_SIZE;
+  if(nodesize < 2) nodesize = 2;
+
+  /* -------------------------------------------------------------------- */
+  /*      Sort the shapes with bounds on the Hilbert curve.               */
+  /* -------------------------------------------------------------------- */
+  entries = (hilbertEntryObj *) msSmallMalloc(sizeof(hilbertEntryObj) * MS_MAX(shapefile->numshapes, 1));
+  for(i=0; i<shapefile->numshapes; i++) {
+    if(msSHPReadBounds(shapefile->hSHP, i, &entries[numentries].rect) != MS_SUCCESS)
+      continue;
+    entries[numentries].id = i;
+    if(numentries == 0)
+      bounds = entries[0].rect;
+    else
+      msMergeRect(&bounds, &entries[numentries].rect);
+    numentries++;
+  }
+
+  if(numentries > 0) {
+    width = bounds.maxx - bounds.minx;
+    height = bounds.maxy - bounds.miny;
+    for(i=0; i<numentries; i++) {
+      const rectObj *rect = &entries[i].rect;
+      unsigned int x = 0, y = 0;
+      if(width > 0) x = (unsigned int) (65535 * ((rect->minx + rect->maxx) / 2 - bounds.minx) / width);
+      if(height > 0) y = (unsigned int) (65535 * ((rect->miny + rect->maxy) / 2 - bounds.miny) / height);
+      entries[i].value = hilbertValue(MS_MIN(x, 65535), MS_MIN(y, 65535));
+    }
+    qsort(entries, numentries, sizeof(hilbertEntryObj), hilbertEntryCompare);
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Pack the levels bottom up, levels[0] being the leaves.          */
+  /* -------------------------------------------------------------------- */
+  numlevels = 0;
+  if(numentries > 0) {
+    levels[0] = (rectObj *) msSmallMalloc(sizeof(rectObj) * numentries);
+    for(i=0; i<numentries; i++)
+      levels[0][i] = entries[i].rect;
+    levelcount[0] = numentries;
+    numlevels = 1;
+
+    while(levelcount[numlevels-1] > 1 && numlevels < HILBERT_MAX_LEVELS) {
+      const rectObj *children = levels[numlevels-1];
+      int numchildren = levelcount[numlevels-1];
+
+      levelcount[numlevels] = (numchildren + nodesize - 1) / nodesize;
+      levels[numlevels] = (rectObj *) msSmallMalloc(sizeof(rectObj) * levelcount[numlevels]);
+      for(j=0; j<levelcount[numlevels]; j++) {
+        levels[numlevels][j] = children[j * nodesize];
+        for(k = j * nodesize + 1; k < MS_MIN((j + 1) * nodesize, numchildren); k++)
+          msMergeRect(&levels[numlevels][j], (rectObj *) &children[k]);
+      }
+      numlevels++;
+    }
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Write the file in native byte order, root level first.          */
+  /* -------------------------------------------------------------------- */
+  pszFullname = hilbertTreeFilename(filename, MS_HILBERT_INDEX_EXTENSION);
+  fp = fopen(pszFullname, "wb");
+  if(!fp) {
+    msSetError(MS_IOERR, "Unable to create %s.", "msWriteHilbertTree()", pszFullname);
+    status = MS_FALSE;
+  } else {
+    i = 1;
+    memcpy(pabyBuf, "SHR", 3);
+    pabyBuf[3] = (*((uchar *) &i) == 1) ? MS_NEW_LSB_ORDER : MS_NEW_MSB_ORDER;
+    pabyBuf[4] = 1; /* version */
+    pabyBuf[5] = pabyBuf[6] = pabyBuf[7] = 0;
+
+    status = fwrite(pabyBuf, 8, 1, fp) == 1 &&
+             hilbertWriteInt(fp, shapefile->numshapes) &&
+             hilbertWriteInt(fp, numentries) &&
+             hilbertWriteInt(fp, nodesize) &&
+             hilbertWriteInt(fp, numlevels);
+    for(i=numlevels-1; status && i>=0; i--)
+      status = hilbertWriteInt(fp, levelcount[i]);
+    for(i=numlevels-1; status && i>0; i--)
+      for(j=0; status && j<levelcount[i]; j++)
+        status = hilbertWriteRect(fp, &levels[i][j]);
+    for(j=0; status && j<numentries; j++)
+      status = hilbertWriteRect(fp, &entries[j].rect) && hilbertWriteInt(fp, entries[j].id);
+
+    if(fclose(fp) != 0)
+      status = MS_FALSE;
+    if(!status)
+      msSetError(MS_IOERR, "Unable to write %s.", "msWriteHilbertTree()", pszFullname);
+  }
+
+  for(i=0; i<numlevels; i++)
+    free(levels[i]);
+  free(entries);
+  msFree(pszFullname);
+
+  return status ? MS_TRUE : MS_FALSE;
+}
+
+/* reads n bytes at offset from the mapping or the file */
+static int msHilbertTreeRead(SHPHilbertTreeHandle hTree, size_t offset, void *buf, size_t n)
+{
+  if(hTree->map) {
+    if(offset + n > hTree->map->size) return MS_FAILURE;
+    memcpy(buf, (const uchar *) hTree->map->data + offset, n);
+  } else {
+    if(fseek(hTree->fp, (long) offset, SEEK_SET) != 0 || fread(buf, n, 1, hTree->fp) != 1)
+      return MS_FAILURE;
+  }
+  hTree->bytesRead += n;
+  return MS_SUCCESS;
+}
+
+/*
+** Opens the .hix index matching filename (any extension is replaced), returns
+** NULL if there is none or if its header is not valid.
+*/
+SHPHilbertTreeHandle msSHPHilbertTreeOpen(const char *filename, int debug)
+{
+  SHPHilbertTreeHandle hTree;
+  char *pszFullname;
+  uchar pabyBuf[24];
+  ms_int32 header[4];
+  size_t size, expected;
+  int i, bBigEndian;
+
+  i = 1;
+  bBigEndian = (*((uchar *) &i) != 1);
+
+  hTree = (SHPHilbertTreeHandle) msSmallCalloc(1, sizeof(SHPHilbertTreeInfo));
+
+  pszFullname = hilbertTreeFilename(filename, MS_HILBERT_INDEX_EXTENSION);
+  hTree->map = msMappedFileOpen(pszFullname);
+  if(!hTree->map) {
+    hTree->fp = fopen(pszFullname, "rb");
+    if(!hTree->fp) {
+      msFree(pszFullname);
+      pszFullname = hilbertTreeFilename(filename, ".HIX");
+      hTree->map = msMappedFileOpen(pszFullname);
+      if(!hTree->map)
+        hTree->fp = fopen(pszFullname, "rb");
+    }
+  }
+
+  if(!hTree->map && !hTree->fp) {
+    msFree(pszFullname);
+    msFree(hTree);
+    return NULL;
+  }
+
+  if(hTree->map) {
+    size = hTree->map->size;
+  } else {
+    fseek(hTree->fp, 0, SEEK_END);
+    size = ftell(hTree->fp);
+  }
+
+  if(size < 24 || msHilbertTreeRead(hTree, 0, pabyBuf, 24) != MS_SUCCESS ||
+      memcmp(pabyBuf, "SHR", 3) != 0 || pabyBuf[4] != 1)
+    goto corrupt;
+
+  hTree->needswap = (pabyBuf[3] == MS_NEW_MSB_ORDER) ^ bBigEndian;
+  memcpy(header, pabyBuf + 8, 16);
+  for(i=0; i<4; i++)
+    if(hTree->needswap) SwapWord(4, &header[i]);
+  hTree->nShapes = header[0];
+  hTree->nEntries = header[1];
+  hTree->nodeSize = header[2];
+  hTree->numLevels = header[3];
+
+  if(hTree->nShapes < 0 || hTree->nEntries < 0 || hTree->nEntries > hTree->nShapes ||
+      hTree->nodeSize < 2 || hTree->numLevels < 0 || hTree->numLevels > HILBERT_MAX_LEVELS ||
+      (hTree->numLevels == 0) != (hTree->nEntries == 0))
+    goto corrupt;
+
+  /* -------------------------------------------------------------------- */
+  /*      Read the level sizes and check they describe a packed tree      */
+  /*      that fits in the file.                                          */
+  /* -------------------------------------------------------------------- */
+  hTree->levelCount = (ms_int32 *) msSmallMalloc(sizeof(ms_int32) * MS_MAX(hTree->numLevels, 1));
+  hTree->levelOffset = (size_t *) msSmallMalloc(sizeof(size_t) * MS_MAX(hTree->numLevels, 1));
+  if(hTree->numLevels > 0 &&
+      msHilbertTreeRead(hTree, 24, hTree->levelCount, 4 * hTree->numLevels) != MS_SUCCESS)
+    goto corrupt;
+
+  expected = 24 + 4 * (size_t) hTree->numLevels;
+  for(i=0; i<hTree->numLevels; i++) {
+    ms_int32 count;
+    if(hTree->needswap) SwapWord(4, &hTree->levelCount[i]);
+    count = hTree->levelCount[i];
+    if(i == 0) {
+      if(count != 1) goto corrupt;
+    } else if(count <= 0 || (count + (size_t) hTree->nodeSize - 1) / hTree->nodeSize != (size_t) hTree->levelCount[i-1]) {
+      goto corrupt;
+    }
+    hTree->levelOffset[i] = expected;
+    expected += (size_t) count * ((i == hTree->numLevels-1) ? HILBERT_LEAF_SIZE : HILBERT_RECORD_SIZE);
+  }
+  if(hTree->numLevels > 0 && hTree->levelCount[hTree->numLevels-1] != hTree->nEntries)
+    goto corrupt;
+  if(expected > size)
+    goto corrupt;
+
+  hTree->buffer = (uchar *) msSmallMalloc((size_t) hTree->nodeSize * HILBERT_LEAF_SIZE);
+  msFree(pszFullname);
+  return hTree;
+
+corrupt:
+  if(debug)
+    msDebug("msSHPHilbertTreeOpen(): %s is not a valid index, ignoring it.\n", pszFullname);
+  msFree(pszFullname);
+  msSHPHilbertTreeClose(hTree);
+  return NULL;
+}
+
+void msSHPHilbertTreeClose(SHPHilbertTreeHandle hTree)
+{
+  if(!hTree) return;
+  if(hTree->map) msMappedFileRelease(hTree->map);
+  if(hTree->fp) fclose(hTree->fp);
+  msFree(hTree->levelCount);
+  msFree(hTree->levelOffset);
+  msFree(hTree->buffer);
+  msFree(hTree);
+}
+
+/*
+** Returns the shapes whose bounds overlap aoi. The tree is walked depth first
+** in file order, each visit reading the entries of one node in one go.
+*/
+ms_bitarray msSHPHilbertTreeSearch(SHPHilbertTreeHandle hTree, rectObj aoi)
+{
+  ms_bitarray status;
+  int *stack, stacksize = 0, level, first, count, leaf, i;
+  double values[4];
+  rectObj rect;
+  ms_int32 id;
+
+  status = msAllocBitArray(MS_MAX(hTree->nShapes, 1));
+  if(!status) {
+    msSetError(MS_MEMERR, NULL, "msSHPHilbertTreeSearch()");
+    return NULL;
+  }
+  if(hTree->numLevels == 0)
+    return status;
+
+  /* (level, first entry) of the nodes left to visit */
+  stack = (int *) msSmallMalloc(sizeof(int) * 2 * (hTree->numLevels * hTree->nodeSize + 1));
+  stack[stacksize++] = 0;
+  stack[stacksize++] = 0;
+
+  while(stacksize > 0) {
+    first = stack[--stacksize];
+    level = stack[--stacksize];
+    leaf = (level == hTree->numLevels-1);
+    count = MS_MIN(hTree->nodeSize, hTree->levelCount[level] - first);
+
+    if(msHilbertTreeRead(hTree, hTree->levelOffset[level] + (size_t) first * (leaf ? HILBERT_LEAF_SIZE : HILBERT_RECORD_SIZE),
+                         hTree->buffer, (size_t) count * (leaf ? HILBERT_LEAF_SIZE : HILBERT_RECORD_SIZE)) != MS_SUCCESS)
+      goto error;
+
+    /* children are pushed last to first so they are read in file order */
+    for(i=count-1; i>=0; i--) {
+      const uchar *record = hTree->buffer + (size_t) i * (leaf ? HILBERT_LEAF_SIZE : HILBERT_RECORD_SIZE);
+      memcpy(values, record, 32);
+      if(hTree->needswap) {
+        SwapWord(8, &values[0]);
+        SwapWord(8, &values[1]);
+        SwapWord(8, &values[2]);
+        SwapWord(8, &values[3]);
+      }
+      rect.minx = values[0];
+      rect.miny = values[1];
+      rect.maxx = values[2];
+      rect.maxy = values[3];
+      if(msRectOverlap(&rect, &aoi) != MS_TRUE)
+        continue;
+
+      if(leaf) {
+        memcpy(&id, record + 32, 4);
+        if(hTree->needswap) SwapWord(4, &id);
+        if(id < 0 || id >= hTree->nShapes)
+          goto error;
+        msSetBit(status, id, 1);
+      } else {
+        stack[stacksize++] = level + 1;
+        stack[stacksize++] = (first + i) * hTree->nodeSize;
+      }
+    }
+  }
+
+  free(stack);
+  return status;
+
+error:
+  msSetError(MS_SHPERR, "The spatial index is corrupt.", "msSHPHilbertTreeSearch()");
+  free(stack);
+  free(status);
+  return NULL;
+}
+
+/*
+** Searches the .hix index matching filename, returns NULL if there is none
+** or it can't be used, in which case the caller falls back to the .qix.
+*/
+ms_bitarray msSearchDiskHilbertTree(const char *filename, rectObj aoi, int debug, int numshapes)
+{
+  SHPHilbertTreeHandle hTree;
+  ms_bitarray status;
+
+  hTree = msSHPHilbertTreeOpen(filename, debug);
+  if(!hTree)
+    return NULL;
+
+  if(hTree->nShapes != numshapes) {
+    if(debug)
+      msDebug("msSearchDiskHilbertTree(): index of %s is out of date, ignoring it.\n", filename);
+    msSHPHilbertTreeClose(hTree);
+    return NULL;
+  }
+
+  status = msSHPHilbertTreeSearch(hTree, aoi);
+  msSHPHilbertTreeClose(hTree);
+  return status;
+}
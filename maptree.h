@@ -69,6 +69,26 @@ extern "C" {
   } SHPTreeInfo;
   typedef SHPTreeInfo * SHPTreeHandle;
 
+  /* packed Hilbert R-tree (.hix) index, see msWriteHilbertTree() */
+#define MS_HILBERT_NODE_SIZE 16 /* default entries per node */
+
+  typedef struct {
+    FILE        *fp;
+    msMappedFile *map; /* when set, fp is NULL */
+    char        needswap;
+
+    ms_int32    nShapes; /* in the shapefile */
+    ms_int32    nEntries; /* shapes in the index */
+    ms_int32    nodeSize;
+    ms_int32    numLevels;
+    ms_int32    *levelCount; /* entries per level, root first */
+    size_t      *levelOffset;
+
+    uchar       *buffer; /* entries of one node */
+    size_t      bytesRead; /* by searches since the index was opened */
+  } SHPHilbertTreeInfo;
+  typedef SHPHilbertTreeInfo * SHPHilbertTreeHandle;
+
 #define MS_LSB_ORDER -1
 #define MS_MSB_ORDER -2
 #define MS_NATIVE_ORDER 0
@@ -92,6 +112,15 @@ extern "C" {
 
   MS_DLL_EXPORT void msFilterTreeSearch(shapefileObj *shp, ms_bitarray status, rectObj search_rect);
 
+  MS_DLL_EXPORT ms_bitarray msSearchDiskTreeCached(shapefileObj *shp, const char *filename, rectObj aoi, int debug);
+  MS_DLL_EXPORT void msTreeCacheCleanup(void);
+
+  MS_DLL_EXPORT int msWriteHilbertTree(shapefileObj *shapefile, const char *filename, int nodesize);
+  MS_DLL_EXPORT SHPHilbertTreeHandle msSHPHilbertTreeOpen(const char *filename, int debug);
+  MS_DLL_EXPORT void msSHPHilbertTreeClose(SHPHilbertTreeHandle hTree);
+  MS_DLL_EXPORT ms_bitarray msSHPHilbertTreeSearch(SHPHilbertTreeHandle hTree, rectObj aoi);
+  MS_DLL_EXPORT ms_bitarray msSearchDiskHilbertTree(const char *filename, rectObj aoi, int debug, int numshapes);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,7 @@
 #include "mapthread.h"
 #include "mapcopy.h"
 #include "mapows.h"
+#include "uthash.h"
 
 #include "gdal.h"
 
@@ -583,7 +584,7 @@ int msEvalExpression(layerObj *layer, shapeObj *shape, expressionObj *expression
       p.expr->curtoken = p.expr->tokens; /* reset */
       p.type = MS_PARSE_TYPE_BOOLEAN;
 
-      status = yyparse(&p);
+      status = msEvalParse(&p);
 
       if (status != 0) {
         msSetError(MS_PARSEERR, "Failed to parse expression: %s", "msEvalExpression", expression->string);
@@ -661,6 +662,182 @@ int msShapeGetClass(layerObj *layer, mapObj *map, shapeObj *shape, int *classgro
   return msShapeGetNextClass(-1, layer, map, shape, classgroup, numclasses);
 }
 
+/*
+** Classitem value lookup: for layers with many classes whose expressions are
+** plain strings or lists matched against the CLASSITEM, a hash from each value
+** to the (ascending) list of classes it can match, so that features don't have
+** to be tested against every class. Classes with any other kind of expression
+** are kept in a separate list and are candidates for every value.
+*/
+#define MS_CLASS_INDEX_MIN_CLASSES 8
+
+typedef struct {
+  char *value;
+  int *classes;
+  int numclasses;
+  UT_hash_handle hh;
+} classIndexEntry;
+
+struct layerClassIndex {
+  int numclasses; /* layer->numclasses when the index was built */
+  classIndexEntry *entries;
+  int *others; /* classes to evaluate whatever the value */
+  int numothers;
+};
+
+static void msClassIndexAdd(struct layerClassIndex *index, const char *value, size_t length, int iclass)
+{
+  classIndexEntry *entry;
+
+  UT_HASH_FIND(hh, index->entries, value, length, entry);
+  if(!entry) {
+    entry = (classIndexEntry *) msSmallCalloc(1, sizeof(classIndexEntry));
+    entry->value = (char *) msSmallMalloc(length + 1);
+    memcpy(entry->value, value, length);
+    entry->value[length] = '\0';
+    UT_HASH_ADD_KEYPTR(hh, index->entries, entry->value, length, entry);
+  } else if(entry->classes[entry->numclasses-1] == iclass) {
+    return; /* value repeated in a list */
+  }
+  entry->classes = (int *) msSmallRealloc(entry->classes, sizeof(int)*(entry->numclasses+1));
+  entry->classes[entry->numclasses++] = iclass;
+}
+
+void msLayerFreeClassIndex(layerObj *layer)
+{
+  classIndexEntry *entry, *tmp;
+
+  if(!layer->classindex) return;
+
+  UT_HASH_ITER(hh, layer->classindex->entries, entry, tmp) {
+    UT_HASH_DEL(layer->classindex->entries, entry);
+    msFree(entry->value);
+    msFree(entry->classes);
+    msFree(entry);
+  }
+  msFree(layer->classindex->others);
+  msFree(layer->classindex);
+  layer->classindex = NULL;
+}
+
+/* called once the layer items are known, see msLayerWhichItems() */
+void msLayerBuildClassIndex(layerObj *layer)
+{
+  struct layerClassIndex *index;
+  int i;
+
+  msLayerFreeClassIndex(layer);
+
+  if(layer->classitemindex < 0 || layer->numclasses < MS_CLASS_INDEX_MIN_CLASSES)
+    return;
+
+  index = (struct layerClassIndex *) msSmallCalloc(1, sizeof(struct layerClassIndex));
+  index->numclasses = layer->numclasses;
+  index->others = (int *) msSmallMalloc(sizeof(int)*layer->numclasses);
+
+  for(i=0; i<layer->numclasses; i++) {
+    expressionObj *expression = &(layer->class[i]->expression);
+
+    if(MS_STRING_IS_NULL_OR_EMPTY(expression->string) || expression->native_string != NULL) {
+      index->others[index->numothers++] = i; /* always true */
+    } else if(expression->type == MS_STRING && !(expression->flags & MS_EXP_INSENSITIVE)) {
+      msClassIndexAdd(index, expression->string, strlen(expression->string), i);
+    } else if(expression->type == MS_LIST) {
+      const char *start = expression->string, *end;
+      while((end = strchr(start, ',')) != NULL) {
+        msClassIndexAdd(index, start, end-start, i);
+        start = end+1;
+      }
+      msClassIndexAdd(index, start, strlen(start), i);
+    } else {
+      index->others[index->numothers++] = i;
+    }
+  }
+
+  if(index->numothers == layer->numclasses) { /* nothing to gain */
+    msFree(index->others);
+    msFree(index);
+    return;
+  }
+  layer->classindex = index;
+}
+
+/* does the shape belong to the class, fallback classes aside */
+static int msShapeMatchesClass(layerObj *layer, mapObj *map, shapeObj *shape, int iclass)
+{
+  if(map->scaledenom > 0) { /* verify scaledenom here  */
+    if((layer->class[iclass]->maxscaledenom > 0) && (map->scaledenom > layer->class[iclass]->maxscaledenom))
+      return MS_FALSE;
+    if((layer->class[iclass]->minscaledenom > 0) && (map->scaledenom <= layer->class[iclass]->minscaledenom))
+      return MS_FALSE;
+  }
+
+  /* verify the minfeaturesize */
+  if ((shape->type == MS_SHAPE_LINE || shape->type == MS_SHAPE_POLYGON) && (layer->class[iclass]->minfeaturesize > 0)) {
+    double minfeaturesize = Pix2LayerGeoref(map, layer,
+                                            layer->class[iclass]->minfeaturesize);
+    if (msShapeCheckSize(shape, minfeaturesize) == MS_FALSE)
+      return MS_FALSE;
+  }
+
+  return (layer->class[iclass]->status != MS_DELETE && msEvalExpression(layer, shape, &(layer->class[iclass]->expression), layer->classitemindex) == MS_TRUE);
+}
+
+/*
+** msShapeGetNextClass() using the classitem value lookup: only the classes
+** that can match are visited, in the same order as the linear scan.
+*/
+static int msShapeGetNextClassIndexed(int currentclass, layerObj *layer, mapObj *map,
+    shapeObj *shape, int *classgroup, int numclasses)
+{
+  struct layerClassIndex *index = layer->classindex;
+  classIndexEntry *entry;
+  int *matches = NULL, nmatches = 0, m = 0, o = 0;
+
+  UT_HASH_FIND_STR(index->entries, shape->values[layer->classitemindex], entry);
+  if(entry) {
+    matches = entry->classes;
+    nmatches = entry->numclasses;
+  }
+
+  while(m < nmatches || o < index->numothers) {
+    int i, iclass;
+
+    /* merge both ascending lists */
+    if(o == index->numothers || (m < nmatches && matches[m] < index->others[o]))
+      iclass = matches[m++];
+    else
+      iclass = index->others[o++];
+
+    /* position in the scan order, class groups are in class order (see msAllocateValidClassGroups()) */
+    if(classgroup) {
+      int lo = 0, hi = numclasses-1;
+      i = -1;
+      while(lo <= hi) {
+        int mid = (lo+hi)/2;
+        if(classgroup[mid] == iclass) {
+          i = mid;
+          break;
+        }
+        if(classgroup[mid] < iclass) lo = mid+1;
+        else hi = mid-1;
+      }
+      if(i < 0) continue;
+    } else {
+      i = iclass;
+    }
+    if(i <= currentclass || i >= numclasses) continue;
+
+    if(msShapeMatchesClass(layer, map, shape, iclass)) {
+      if (layer->class[iclass]->isfallback && currentclass != -1)
+        return -1;
+      return(iclass);
+    }
+  }
+
+  return(-1); /* no match */
+}
+
 int msShapeGetNextClass(int currentclass, layerObj *layer, mapObj *map,
     shapeObj *shape, int *classgroup, int numclasses)
 {
@@ -673,6 +850,11 @@ int msShapeGetNextClass(int currentclass, layerObj *layer, mapObj *map,
     if (classgroup == NULL || numclasses <=0)
       numclasses = layer->numclasses;
 
+    if (layer->classindex && layer->classindex->numclasses == layer->numclasses &&
+        layer->classitemindex < layer->numitems && layer->classitemindex < shape->numvalues &&
+        shape->values[layer->classitemindex] != NULL)
+      return msShapeGetNextClassIndexed(currentclass, layer, map, shape, classgroup, numclasses);
+
     for(i=currentclass+1; i<numclasses; i++) {
       if (classgroup)
         iclass = classgroup[i];
@@ -682,22 +864,7 @@ int msShapeGetNextClass(int currentclass, layerObj *layer, mapObj *map,
       if (iclass < 0 || iclass >= layer->numclasses)
         continue; /* this should never happen but just in case */
 
-      if(map->scaledenom > 0) { /* verify scaledenom here  */
-        if((layer->class[iclass]->maxscaledenom > 0) && (map->scaledenom > layer->class[iclass]->maxscaledenom))
-          continue; /* can skip this one, next class */
-        if((layer->class[iclass]->minscaledenom > 0) && (map->scaledenom <= layer->class[iclass]->minscaledenom))
-          continue; /* can skip this one, next class */
-      }
-
-      /* verify the minfeaturesize */
-      if ((shape->type == MS_SHAPE_LINE || shape->type == MS_SHAPE_POLYGON) && (layer->class[iclass]->minfeaturesize > 0)) {
-        double minfeaturesize = Pix2LayerGeoref(map, layer,
-                                                layer->class[iclass]->minfeaturesize);
-        if (msShapeCheckSize(shape, minfeaturesize) == MS_FALSE)
-          continue; /* skip this one, next class */
-      }
-
-      if(layer->class[iclass]->status != MS_DELETE && msEvalExpression(layer, shape, &(layer->class[iclass]->expression), layer->classitemindex) == MS_TRUE)
+      if(msShapeMatchesClass(layer, map, shape, iclass))
       {
         if (layer->class[iclass]->isfallback && currentclass != -1)
         {
@@ -765,7 +932,7 @@ char *msEvalTextExpressionInternal(expressionObj *expr, shapeObj *shape, int bJS
       p.expr->curtoken = p.expr->tokens; /* reset */
       p.type = MS_PARSE_TYPE_STRING;
 
-      status = yyparse(&p);
+      status = msEvalParse(&p);
 
       if (status != 0) {
         msSetError(MS_PARSEERR, "Failed to process text expression: %s", "msEvalTextExpression", expr->string);
@@ -804,7 +971,7 @@ double msEvalDoubleExpression(expressionObj *expression, shapeObj *shape)
   p.expr = expression;
   p.expr->curtoken = p.expr->tokens; /* reset */
   p.type = MS_PARSE_TYPE_STRING;
-  status = yyparse(&p);
+  status = msEvalParse(&p);
   if (status != 0) {
     msSetError(MS_PARSEERR, "Failed to parse expression: %s",
         "bindStyle", expression->string);
@@ -2060,6 +2227,10 @@ int msSetup()
 #endif
 void msCleanup()
 {
+  msMapFileCacheCleanup();
+  msMappedFileCleanup();
+  msTreeCacheCleanup();
+  msJoinCacheCleanup();
   msForceTmpFileBase( NULL );
   msConnPoolFinalCleanup();
   /* Lexer string parsing variable */
@@ -2092,6 +2263,8 @@ void msCleanup()
   msSetPROJ_LIB( NULL, NULL );
   msProjectionContextPoolCleanup();
 
+  msMapMLCleanup();
+
 #if defined(USE_CURL)
   msHTTPCleanup();
 #endif
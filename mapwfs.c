@@ -2981,6 +2981,72 @@ static int msWFSAnalyzeBBOX(mapObj *map, wfsParamsObj *paramsObj,
   return 0;
 }
 
+/*
+** msWFSCountMatchingFeatures()
+**
+** Re-runs the query on a copy of the map with no limit, keeping only the
+** count of features, and optionally the number of layers with features.
+*/
+static int msWFSCountMatchingFeatures(mapObj *map,
+                                      owsRequestObj *ows_request,
+                                      wfsParamsObj *paramsObj,
+                                      WFSGMLInfo* pgmlinfo,
+                                      rectObj bbox,
+                                      const char* sBBoxSrs,
+                                      char** layers,
+                                      int numlayers,
+                                      int nWFSVersion,
+                                      int* pnMatchingFeatures,
+                                      int* pnLayersWithFeatures)
+{
+  int j, status;
+  mapObj* mapTmp = (mapObj*)msSmallCalloc(1, sizeof(mapObj));
+  initMap(mapTmp);
+  msCopyMap(mapTmp, map);
+
+  /* Re-run the query but with no limit */
+  mapTmp->query.maxfeatures = -1;
+  mapTmp->query.startindex = -1;
+  mapTmp->query.only_cache_result_count = MS_TRUE;
+  for(j=0; j<mapTmp->numlayers; j++) {
+      layerObj* lp = GET_LAYER(mapTmp, j);
+      /* Reset layer paging */
+      lp->maxfeatures = -1;
+      lp->startindex = -1;
+  }
+
+  *pnMatchingFeatures = 0;
+  status = msWFSRetrieveFeatures(mapTmp,
+                                 ows_request,
+                                 paramsObj,
+                                 pgmlinfo,
+                                 paramsObj->pszFilter,
+                                 paramsObj->pszBbox != NULL,
+                                 sBBoxSrs,
+                                 bbox,
+                                 paramsObj->pszFeatureId,
+                                 layers,
+                                 numlayers,
+                                 -1,
+                                 nWFSVersion,
+                                 pnMatchingFeatures,
+                                 NULL);
+
+  if( pnLayersWithFeatures )
+  {
+      *pnLayersWithFeatures = 0;
+      for(j=0; j<mapTmp->numlayers; j++) {
+          layerObj* lp = GET_LAYER(mapTmp, j);
+          if( lp->resultcache && lp->resultcache->numresults > 0 )
+              (*pnLayersWithFeatures) ++;
+      }
+  }
+
+  msFreeMap(mapTmp);
+
+  return status;
+}
+
 static int msWFSComputeMatchingFeatures(mapObj *map,
                                         owsRequestObj *ows_request,
                                         wfsParamsObj *paramsObj,
@@ -3045,40 +3111,9 @@ static int msWFSComputeMatchingFeatures(mapObj *map,
         if( pszComputeNumberMatched != NULL &&
             strcasecmp(pszComputeNumberMatched, "true") == 0 )
         {
-            int j;
-            mapObj* mapTmp = (mapObj*)msSmallCalloc(1, sizeof(mapObj));
-            initMap(mapTmp);
-            msCopyMap(mapTmp, map);
-
-            /* Re-run the query but with no limit */
-            mapTmp->query.maxfeatures = -1;
-            mapTmp->query.startindex = -1;
-            mapTmp->query.only_cache_result_count = MS_TRUE;
-            for(j=0; j<mapTmp->numlayers; j++) {
-                layerObj* lp = GET_LAYER(mapTmp, j);
-                /* Reset layer paging */
-                lp->maxfeatures = -1;
-                lp->startindex = -1;
-            }
-
-            nMatchingFeatures = 0;
-            msWFSRetrieveFeatures(mapTmp,
-                                  ows_request,
-                                paramsObj,
-                                pgmlinfo,
-                                paramsObj->pszFilter,
-                                paramsObj->pszBbox != NULL,
-                                sBBoxSrs,
-                                bbox,
-                                paramsObj->pszFeatureId,
-                                layers,
-                                numlayers,
-                                -1,
-                                nWFSVersion,
-                                &nMatchingFeatures,
-                                NULL);
-
-            msFreeMap(mapTmp);
+            msWFSCountMatchingFeatures(map, ows_request, paramsObj, pgmlinfo,
+                                       bbox, sBBoxSrs, layers, numlayers,
+                                       nWFSVersion, &nMatchingFeatures, NULL);
         }
     }
   }
@@ -3301,6 +3336,131 @@ static void msWFSSetShapeCache(mapObj* map)
     }
 }
 
+/*
+** Streamed GetFeature output, enabled by wfs_stream_features: features are
+** written as the query reads them instead of being collected in the result
+** cache and read again with msLayerGetShape(), so memory doesn't grow with
+** the size of the response.
+*/
+typedef struct {
+  gmlWFSStreamObj *gmlstream;
+  int maxfeatures; /* -1 if unlimited */
+  int numfeatures; /* written so far */
+  int status;
+} WFSStreamInfo;
+
+static int msWFSStreamFeature(mapObj *map, layerObj *lp, shapeObj *shape, void *data)
+{
+  WFSStreamInfo *info = (WFSStreamInfo *) data;
+
+  /* The query asks for one more feature than needed to detect a next page */
+  if( info->status != MS_SUCCESS ||
+      (info->maxfeatures >= 0 && info->numfeatures >= info->maxfeatures) )
+    return info->status;
+
+  info->status = msGMLWriteWFSStreamFeature(info->gmlstream, lp, shape);
+  if( info->status == MS_SUCCESS )
+    info->numfeatures ++;
+
+  return info->status;
+}
+
+static int msWFSCanStreamFeatures(mapObj *map, wfsParamsObj *paramsObj,
+                                  outputFormatObj *psFormat,
+                                  int iResultTypeHits, int maxfeatures)
+{
+  const char* pszStreamFeatures =
+              msOWSLookupMetadata(&(map->web.metadata), "F", "stream_features");
+
+  if( pszStreamFeatures == NULL || strcasecmp(pszStreamFeatures, "true") != 0 )
+    return MS_FALSE;
+
+  /* Template output and hits need the result cache, and a single */
+  /* GetFeatureById response is rewritten from a buffer anyway */
+  return psFormat == NULL && iResultTypeHits == 0 && maxfeatures != 0 &&
+         paramsObj->countGetFeatureById != 1;
+}
+
+/*
+** msWFSStreamFeatures()
+**
+** Runs the query, writing the features to stdout as they are found. The
+** request must have been checked by a first msWFSCountMatchingFeatures() as an
+** exception can no longer be reported properly once the features are started.
+*/
+static int msWFSStreamFeatures(mapObj *map,
+                               owsRequestObj *ows_request,
+                               wfsParamsObj *paramsObj,
+                               WFSGMLInfo *pgmlinfo,
+                               rectObj bbox,
+                               const char *sBBoxSrs,
+                               char **layers,
+                               int numlayers,
+                               int maxfeatures,
+                               OWSGMLVersion outputformat,
+                               int nWFSVersion,
+                               int bUseURN,
+                               int iNumberOfFeatures)
+{
+  WFSStreamInfo info;
+  int status;
+  int nRetrievedFeatures = 0;
+
+  if( iNumberOfFeatures == 0 )
+    return MS_SUCCESS;
+
+  /* The bounds of the collection are only known after the last feature, */
+  /* but they are mandatory in GML 2 */
+  if( nWFSVersion < OWS_2_0_0 )
+  {
+    msIO_printf("   <gml:boundedBy>\n");
+    if(outputformat == OWS_GML3 || outputformat == OWS_GML32 )
+      msIO_printf("      <gml:Null>unknown</gml:Null>\n");
+    else
+      msIO_printf("      <gml:null>unknown</gml:null>\n");
+    msIO_printf("   </gml:boundedBy>\n");
+  }
+
+  info.gmlstream = msGMLCreateWFSStream(map, stdout, pgmlinfo->user_namespace_prefix,
+                                        outputformat, nWFSVersion, bUseURN);
+  info.maxfeatures = maxfeatures;
+  info.numfeatures = 0;
+  info.status = MS_SUCCESS;
+
+  map->query.result_callback = msWFSStreamFeature;
+  map->query.result_callback_data = &info;
+
+  status = msWFSRetrieveFeatures(map,
+                                 ows_request,
+                                 paramsObj,
+                                 pgmlinfo,
+                                 paramsObj->pszFilter,
+                                 paramsObj->pszBbox != NULL,
+                                 sBBoxSrs,
+                                 bbox,
+                                 paramsObj->pszFeatureId,
+                                 layers,
+                                 numlayers,
+                                 maxfeatures,
+                                 nWFSVersion,
+                                 &nRetrievedFeatures,
+                                 NULL);
+
+  map->query.result_callback = NULL;
+  map->query.result_callback_data = NULL;
+  msGMLFreeWFSStream(info.gmlstream);
+
+  if( info.numfeatures != iNumberOfFeatures )
+    msDebug("msWFSStreamFeatures(): %d features written, %d were counted before. "
+            "The data has likely changed in between.\n",
+            info.numfeatures, iNumberOfFeatures);
+
+  if( status == MS_SUCCESS )
+    status = info.status;
+
+  return status;
+}
+
 /*
 ** msWFSGetFeature()
 */
@@ -3326,6 +3486,7 @@ int msWFSGetFeature(mapObj *map, wfsParamsObj *paramsObj, cgiRequestObj *req,
   int iResultTypeHits = 0;
   int nMatchingFeatures = -1;
   int bHasNextFeatures = MS_FALSE;
+  int bStreamFeatures = MS_FALSE;
 
   char** papszGMLGroups = NULL;
   char** papszGMLIncludeItems = NULL;
@@ -3744,59 +3905,98 @@ int msWFSGetFeature(mapObj *map, wfsParamsObj *paramsObj, cgiRequestObj *req,
       return status;
   }
 
+  bStreamFeatures = msWFSCanStreamFeatures(map, paramsObj, psFormat,
+                                           iResultTypeHits, maxfeatures);
+  if( bStreamFeatures )
+  {
+      /* The header needs the counts before the features are read, they */
+      /* are taken without keeping any result. WFS 2.0 wants a collection per */
+      /* layer with features, which is left to the result cache path. */
+      int nLayersWithFeatures = 0;
+
+      status = msWFSCountMatchingFeatures(map, ows_request, paramsObj, &gmlinfo,
+                                          bbox, sBBoxSrs, layers, numlayers,
+                                          nWFSVersion, &nMatchingFeatures,
+                                          &nLayersWithFeatures);
+      if( status != MS_SUCCESS )
+      {
+          msFreeCharArray(layers, numlayers);
+          msFree(sBBoxSrs);
+          msFreeCharArray(papszGMLGroups, map->numlayers);
+          msFreeCharArray(papszGMLIncludeItems, map->numlayers);
+          msFreeCharArray(papszGMLGeometries, map->numlayers);
+          return status;
+      }
+
+      if( nWFSVersion >= OWS_2_0_0 && nLayersWithFeatures > 1 )
+      {
+          bStreamFeatures = MS_FALSE;
+          nMatchingFeatures = -1;
+      }
+      else
+      {
+          iNumberOfFeatures = nMatchingFeatures;
+          if( paramsObj->nStartIndex > 0 )
+              iNumberOfFeatures = MS_MAX(0, iNumberOfFeatures - paramsObj->nStartIndex);
+          if( maxfeatures >= 0 && iNumberOfFeatures > maxfeatures )
+          {
+              iNumberOfFeatures = maxfeatures;
+              bHasNextFeatures = MS_TRUE;
+          }
+      }
+  }
+
   if( iResultTypeHits == 1 )
   {
       map->query.only_cache_result_count = MS_TRUE;
   }
-  else
+  else if( !bStreamFeatures )
   {
       msWFSSetShapeCache(map);
   }
 
-  status = msWFSRetrieveFeatures(map,
-                                 ows_request,
-                           paramsObj,
-                           &gmlinfo,
-                           paramsObj->pszFilter,
-                           paramsObj->pszBbox != NULL,
-                           sBBoxSrs,
-                           bbox,
-                           paramsObj->pszFeatureId,
-                           layers,
-                           numlayers,
-                           maxfeatures,
-                           nWFSVersion,
-                           &iNumberOfFeatures,
-                           &bHasNextFeatures);
-  if( status != MS_SUCCESS )
+  if( !bStreamFeatures )
   {
-      msFreeCharArray(layers, numlayers);
-      msFree(sBBoxSrs);
-      msFreeCharArray(papszGMLGroups, map->numlayers);
-      msFreeCharArray(papszGMLIncludeItems, map->numlayers);
-      msFreeCharArray(papszGMLGeometries, map->numlayers);
-      return status;
+    status = msWFSRetrieveFeatures(map,
+                                   ows_request,
+                             paramsObj,
+                             &gmlinfo,
+                             paramsObj->pszFilter,
+                             paramsObj->pszBbox != NULL,
+                             sBBoxSrs,
+                             bbox,
+                             paramsObj->pszFeatureId,
+                             layers,
+                             numlayers,
+                             maxfeatures,
+                             nWFSVersion,
+                             &iNumberOfFeatures,
+                             &bHasNextFeatures);
+    if( status != MS_SUCCESS )
+    {
+        msFreeCharArray(layers, numlayers);
+        msFree(sBBoxSrs);
+        msFreeCharArray(papszGMLGroups, map->numlayers);
+        msFreeCharArray(papszGMLIncludeItems, map->numlayers);
+        msFreeCharArray(papszGMLGeometries, map->numlayers);
+        return status;
+    }
+
+    /* ----------------------------------------- */
+    /* Now compute nMatchingFeatures for WFS 2.0 */
+    /* ----------------------------------------- */
+
+    nMatchingFeatures = msWFSComputeMatchingFeatures(map,ows_request,paramsObj,
+                                                     iNumberOfFeatures,
+                                                     maxfeatures,
+                                                     &gmlinfo,
+                                                     bbox,
+                                                     sBBoxSrs,
+                                                     layers,
+                                                     numlayers,
+                                                     nWFSVersion);
   }
 
-  /* ----------------------------------------- */
-  /* Now compute nMatchingFeatures for WFS 2.0 */
-  /* ----------------------------------------- */
-  
-  nMatchingFeatures = msWFSComputeMatchingFeatures(map,ows_request,paramsObj,
-                                                   iNumberOfFeatures,
-                                                   maxfeatures,
-                                                   &gmlinfo,
-                                                   bbox,
-                                                   sBBoxSrs,
-                                                   layers,
-                                                   numlayers,
-                                                   nWFSVersion);
-
-  msFreeCharArray(layers, numlayers);
-
-  msFree(sBBoxSrs);
-  sBBoxSrs = NULL;
-
   /*
   ** GML Header generation.
   */
@@ -3830,6 +4030,8 @@ int msWFSGetFeature(mapObj *map, wfsParamsObj *paramsObj, cgiRequestObj *req,
       if( old_context != NULL )
           msIO_restoreOldStdoutContext(old_context);
       msWFSCleanupGMLInfo(&gmlinfo);
+      msFreeCharArray(layers, numlayers);
+      msFree(sBBoxSrs);
       msFreeCharArray(papszGMLGroups, map->numlayers);
       msFreeCharArray(papszGMLIncludeItems, map->numlayers);
       msFreeCharArray(papszGMLGeometries, map->numlayers);
@@ -3936,17 +4138,27 @@ int msWFSGetFeature(mapObj *map, wfsParamsObj *paramsObj, cgiRequestObj *req,
          }
       }
 
-      if( !bWFS2MultipleFeatureCollection )
+      if( bStreamFeatures )
       {
-        msGMLWriteWFSQuery(map, stdout,
-                                    gmlinfo.user_namespace_prefix,
-                                    outputformat,
-                                    nWFSVersion,
-                                    bUseURN,
-                                    MS_FALSE);
+        status = msWFSStreamFeatures(map, ows_request, paramsObj, &gmlinfo,
+                                     bbox, sBBoxSrs, layers, numlayers,
+                                     maxfeatures, outputformat, nWFSVersion,
+                                     bUseURN, iNumberOfFeatures);
       }
+      else
+      {
+        if( !bWFS2MultipleFeatureCollection )
+        {
+          msGMLWriteWFSQuery(map, stdout,
+                                      gmlinfo.user_namespace_prefix,
+                                      outputformat,
+                                      nWFSVersion,
+                                      bUseURN,
+                                      MS_FALSE);
+        }
 
-      status =  MS_SUCCESS;
+        status =  MS_SUCCESS;
+      }
     }
   } else {
     mapservObj *mapserv = msAllocMapServObj();
@@ -3977,6 +4189,8 @@ int msWFSGetFeature(mapObj *map, wfsParamsObj *paramsObj, cgiRequestObj *req,
     msFreeMapServObj( mapserv );
 
     if( status != MS_SUCCESS ) {
+      msFreeCharArray(layers, numlayers);
+      msFree(sBBoxSrs);
       msFreeCharArray(papszGMLGroups, map->numlayers);
       msFreeCharArray(papszGMLIncludeItems, map->numlayers);
       msFreeCharArray(papszGMLGeometries, map->numlayers);
@@ -3985,6 +4199,10 @@ int msWFSGetFeature(mapObj *map, wfsParamsObj *paramsObj, cgiRequestObj *req,
     }
   }
 
+  msFreeCharArray(layers, numlayers);
+  msFree(sBBoxSrs);
+  sBBoxSrs = NULL;
+
   msFreeCharArray(papszGMLGroups, map->numlayers);
   msFreeCharArray(papszGMLIncludeItems, map->numlayers);
   msFreeCharArray(papszGMLGeometries, map->numlayers);
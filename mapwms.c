@@ -1274,6 +1274,7 @@ int msWMSLoadGetMapParams(mapObj *map, int nVersion,
           format = msSelectOutputFormat( map, values[i] );
           if( format == NULL ||
               (strncasecmp(format->driver, "MVT", 3) != 0 &&
+               strncasecmp(format->driver, "MAPML", 5) != 0 &&
                strncasecmp(format->driver, "GDAL/", 5) != 0 &&
                strncasecmp(format->driver, "AGG/", 4) != 0 &&
                strncasecmp(format->driver, "UTFGRID", 7) != 0 &&
@@ -3981,6 +3982,13 @@ int msWMSGetMap(mapObj *map, int nVersion, char **names, char **values, int nume
       return MS_SUCCESS;
     }
 
+    /* and for MapML feature tiles */
+    if(MS_RENDERER_MAPML(map->outputformat)) {
+      int status=0;
+      if((status = msMapMLWriteTile(map, MS_TRUE)) != MS_SUCCESS) return MS_FAILURE;
+      return MS_SUCCESS;
+    }
+
     img = msDrawMap(map, drawquerymap);
   }
 
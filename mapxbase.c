@@ -134,6 +134,34 @@ static void flushRecord( DBFHandle psDBF )
   }
 }
 
+/************************************************************************/
+/*                            msDBFReadAt()                             */
+/*                                                                      */
+/*      Read nBytes at nOffset, copied from the mapping when the file   */
+/*      is memory mapped (see msMappedFileOpen()).                      */
+/************************************************************************/
+static int msDBFReadAt( DBFHandle psDBF, unsigned int nOffset, void *pBuffer, unsigned int nBytes )
+{
+  if( psDBF->map ) {
+    if( (size_t) nOffset + nBytes > psDBF->map->size )
+      return MS_FAILURE;
+    memcpy( pBuffer, psDBF->map->data + nOffset, nBytes );
+    return MS_SUCCESS;
+  }
+  safe_fseek( psDBF->fp, nOffset, 0 );
+  if( fread( pBuffer, nBytes, 1, psDBF->fp ) != 1 )
+    return MS_FAILURE;
+  return MS_SUCCESS;
+}
+
+static void msDBFCloseFile( DBFHandle psDBF )
+{
+  if( psDBF->map )
+    msMappedFileRelease( psDBF->map );
+  else
+    fclose( psDBF->fp );
+}
+
 /************************************************************************/
 /*                              msDBFOpen()                             */
 /*                                                                      */
@@ -174,15 +202,25 @@ DBFHandle msDBFOpen( const char * pszFilename, const char * pszAccess )
   /* -------------------------------------------------------------------- */
   psDBF = (DBFHandle) calloc( 1, sizeof(DBFInfo) );
   MS_CHECK_ALLOC(psDBF, sizeof(DBFInfo), NULL);
-  psDBF->fp = fopen( pszDBFFilename, pszAccess );
-  if( psDBF->fp == NULL )
-  {
-    if( strcmp(pszDBFFilename+strlen(pszDBFFilename)-4,".dbf") == 0 ) {
+  if( strcmp(pszAccess,"r") == 0 || strcmp(pszAccess,"rb") == 0 ) {
+    psDBF->map = msMappedFileOpen( pszDBFFilename );
+    if( psDBF->map == NULL && strcmp(pszDBFFilename+strlen(pszDBFFilename)-4,".dbf") == 0 ) {
       strcpy( pszDBFFilename+strlen(pszDBFFilename)-4, ".DBF");
-      psDBF->fp = fopen( pszDBFFilename, pszAccess );
+      psDBF->map = msMappedFileOpen( pszDBFFilename );
+      strcpy( pszDBFFilename+strlen(pszDBFFilename)-4, ".dbf");
+    }
+  }
+  if( psDBF->map == NULL ) {
+    psDBF->fp = fopen( pszDBFFilename, pszAccess );
+    if( psDBF->fp == NULL )
+    {
+      if( strcmp(pszDBFFilename+strlen(pszDBFFilename)-4,".dbf") == 0 ) {
+        strcpy( pszDBFFilename+strlen(pszDBFFilename)-4, ".DBF");
+        psDBF->fp = fopen( pszDBFFilename, pszAccess );
+      }
     }
   }
-  if( psDBF->fp == NULL ) {
+  if( psDBF->fp == NULL && psDBF->map == NULL ) {
     msFree(pszDBFFilename);
     msFree(psDBF);
     return( NULL );
@@ -201,8 +239,9 @@ DBFHandle msDBFOpen( const char * pszFilename, const char * pszAccess )
   /*  Read Table Header info                                              */
   /* -------------------------------------------------------------------- */
   pabyBuf = (uchar *) msSmallMalloc(500);
-  if( fread( pabyBuf, 32, 1, psDBF->fp ) != 1 )
+  if( msDBFReadAt( psDBF, 0, pabyBuf, 32 ) != MS_SUCCESS )
   {
+    msDBFCloseFile(psDBF);
     msFree(psDBF);
     msFree(pabyBuf);
     return( NULL );
@@ -224,9 +263,9 @@ DBFHandle msDBFOpen( const char * pszFilename, const char * pszAccess )
   pabyBuf = (uchar *) SfRealloc(pabyBuf,nHeadLen);
   psDBF->pszHeader = (char *) pabyBuf;
 
-  fseek( psDBF->fp, 32, 0 );
-  if( fread( pabyBuf, nHeadLen - 32, 1, psDBF->fp ) != 1 )
+  if( msDBFReadAt( psDBF, 32, pabyBuf, nHeadLen - 32 ) != MS_SUCCESS )
   {
+    msDBFCloseFile(psDBF);
     msFree(psDBF->pszCurrentRecord);
     msFree(psDBF);
     msFree(pabyBuf);
@@ -302,7 +341,7 @@ void  msDBFClose(DBFHandle psDBF)
   /* -------------------------------------------------------------------- */
   /*      Close, and free resources.                                      */
   /* -------------------------------------------------------------------- */
-  fclose( psDBF->fp );
+  msDBFCloseFile( psDBF );
 
   if( psDBF->panFieldOffset != NULL ) {
     free( psDBF->panFieldOffset );
@@ -533,8 +572,7 @@ static const char *msDBFReadAttribute(DBFHandle psDBF, int hEntity, int iField )
 
     nRecordOffset = psDBF->nRecordLength * hEntity + psDBF->nHeaderLength;
 
-    safe_fseek( psDBF->fp, nRecordOffset, 0 );
-    if( fread( psDBF->pszCurrentRecord, psDBF->nRecordLength, 1, psDBF->fp ) != 1 )
+    if( msDBFReadAt( psDBF, nRecordOffset, psDBF->pszCurrentRecord, psDBF->nRecordLength ) != MS_SUCCESS )
     {
       msSetError(MS_DBFERR, "Cannot read record %d.", "msDBFReadAttribute()",hEntity );
       return( NULL );
@@ -699,6 +737,9 @@ static int msDBFWriteAttribute(DBFHandle psDBF, int hEntity, int iField, void *
   if( hEntity < 0 || hEntity > psDBF->nRecords )
     return( MS_FALSE );
 
+  if( psDBF->map ) /* opened read only */
+    return( MS_FALSE );
+
   if( psDBF->bNoHeader )
     writeHeader(psDBF);
 
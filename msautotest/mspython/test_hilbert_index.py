@@ -0,0 +1,171 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+###############################################################################
+# $Id$
+#
+# Project:  MapServer
+# Purpose:  Test shapefile searches through a packed Hilbert R-tree (.hix).
+# Author:   MapServer team.
+#
+###############################################################################
+#  Copyright (c) 2026, MapServer contributors.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a
+#  copy of this software and associated documentation files (the "Software"),
+#  to deal in the Software without restriction, including without limitation
+#  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+#  and/or sell copies of the Software, and to permit persons to whom the
+#  Software is furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included
+#  in all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+#  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+#  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+#  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+#  DEALINGS IN THE SOFTWARE.
+###############################################################################
+
+
+import os
+import shutil
+import struct
+import pytest
+
+mapscript_available = False
+try:
+    import mapscript
+    mapscript_available = True
+except ImportError:
+    pass
+
+pytestmark = pytest.mark.skipif(not mapscript_available, reason="mapscript not available")
+
+
+def get_relpath_to_this(filename):
+    return os.path.join(os.path.dirname(__file__), filename)
+
+###############################################################################
+# Writes a .hix with the layout documented in maptree.c (native, here LSB,
+# byte order). entries are (minx, miny, maxx, maxy, shape id) tuples.
+
+def write_hix(filename, numshapes, entries, nodesize=4):
+
+    levels = [ [ e[0:4] for e in entries ] ]
+    while len(levels[0]) > 1:
+        children = levels[0]
+        parents = []
+        for j in range(0, len(children), nodesize):
+            node = children[j:j+nodesize]
+            parents.append( ( min(r[0] for r in node), min(r[1] for r in node),
+                              max(r[2] for r in node), max(r[3] for r in node) ) )
+        levels.insert(0, parents)
+
+    with open(filename, 'wb') as f:
+        f.write(b'SHR' + bytes([1, 1, 0, 0, 0]))
+        f.write(struct.pack('<4i', numshapes, len(entries), nodesize, len(levels)))
+        for level in levels:
+            f.write(struct.pack('<i', len(level)))
+        for level in levels[:-1]:
+            for r in level:
+                f.write(struct.pack('<4d', *r))
+        for e in entries:
+            f.write(struct.pack('<4di', *e))
+
+
+@pytest.fixture
+def shapefile(tmp_path):
+
+    for ext in ('shp', 'shx', 'dbf'):
+        shutil.copy(get_relpath_to_this('../query/data/bdry_counpy2.' + ext), str(tmp_path))
+    yield str(tmp_path / 'bdry_counpy2')
+
+    # don't leave the option set for the other tests
+    mapscript.fromstring('MAP CONFIG "MS_SHAPEFILE_HILBERT_INDEX" "NO" END')
+
+
+def shape_bounds(path):
+
+    sf = mapscript.shapefileObj(path + '.shp')
+    bounds = []
+    for i in range(sf.numshapes):
+        r = mapscript.rectObj()
+        sf.getExtent(i, r)
+        bounds.append( ( r.minx, r.miny, r.maxx, r.maxy, i ) )
+    return bounds
+
+
+def query(path, hilbert_index, rect):
+
+    map = mapscript.fromstring("""MAP
+        CONFIG "MS_SHAPEFILE_HILBERT_INDEX" "%s"
+        LAYER
+          NAME "bdry"
+          TYPE POLYGON
+          DATA "%s"
+          TEMPLATE "void"
+        END
+      END""" % ('YES' if hilbert_index else 'NO', path))
+    layer = map.getLayer(0)
+    layer.queryByRect(map, rect)
+    return sorted(layer.getResult(i).shapeindex for i in range(layer.getNumResults()))
+
+
+def query_rects(path):
+
+    sf = mapscript.shapefileObj(path + '.shp')
+    b = sf.bounds
+    width = b.maxx - b.minx
+    height = b.maxy - b.miny
+    return [ mapscript.rectObj(b.minx + width * fx, b.miny + height * fy,
+                               b.minx + width * (fx + size), b.miny + height * (fy + size))
+             for (fx, fy, size) in ( (0.1, 0.1, 0.2), (0.4, 0.3, 0.3), (0.7, 0.6, 0.05), (0.05, 0.05, 0.9) ) ]
+
+###############################################################################
+# Searches through a .hix return the same shapes as without it.
+
+def test_hilbert_index_search(shapefile):
+
+    rects = query_rects(shapefile)
+    expected = [ query(shapefile, False, r) for r in rects ]
+    assert len(expected[-1]) > 10
+
+    write_hix(shapefile + '.hix', len(shape_bounds(shapefile)), shape_bounds(shapefile))
+    for (r, shapes) in zip(rects, expected):
+        assert query(shapefile, True, r) == shapes
+
+###############################################################################
+# The .hix is only used when MS_SHAPEFILE_HILBERT_INDEX asks for it. This
+# index only lists even shapes, so it shows whether it was searched (a
+# search covering the whole shapefile wouldn't use any index).
+
+def test_hilbert_index_only_when_enabled(shapefile):
+
+    bounds = shape_bounds(shapefile)
+    rect = query_rects(shapefile)[-1]
+    expected = query(shapefile, False, rect)
+
+    write_hix(shapefile + '.hix', len(bounds), [ b for b in bounds if b[4] % 2 == 0 ])
+    assert query(shapefile, False, rect) == expected
+    assert query(shapefile, True, rect) == [ i for i in expected if i % 2 == 0 ]
+
+###############################################################################
+# A .hix that is truncated or doesn't match the shapefile is ignored.
+
+def test_hilbert_index_invalid(shapefile):
+
+    bounds = shape_bounds(shapefile)
+    rect = query_rects(shapefile)[1]
+    expected = query(shapefile, False, rect)
+
+    write_hix(shapefile + '.hix', len(bounds), bounds)
+    size = os.path.getsize(shapefile + '.hix')
+    with open(shapefile + '.hix', 'r+b') as f:
+        f.truncate(size - 10)
+    assert query(shapefile, True, rect) == expected
+
+    write_hix(shapefile + '.hix', len(bounds) + 1, [ b for b in bounds if b[4] % 2 == 0 ])
+    assert query(shapefile, True, rect) == expected
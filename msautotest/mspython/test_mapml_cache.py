@@ -0,0 +1,134 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+###############################################################################
+# $Id$
+#
+# Project:  MapServer
+# Purpose:  Test the GetMapML document cache and its If-None-Match support.
+# Author:   MapServer team.
+#
+###############################################################################
+#  Copyright (c) 2026, MapServer contributors.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a
+#  copy of this software and associated documentation files (the "Software"),
+#  to deal in the Software without restriction, including without limitation
+#  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+#  and/or sell copies of the Software, and to permit persons to whom the
+#  Software is furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included
+#  in all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+#  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+#  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+#  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+#  DEALINGS IN THE SOFTWARE.
+###############################################################################
+
+
+import os
+import shutil
+import pytest
+
+mapscript_available = False
+try:
+    import mapscript
+    mapscript_available = True
+except ImportError:
+    pass
+
+pytestmark = pytest.mark.skipif(not mapscript_available, reason="mapscript not available")
+
+
+def get_relpath_to_this(filename):
+    return os.path.join(os.path.dirname(__file__), filename)
+
+###############################################################################
+# The cache is keyed on the mapfile, so each test works on its own copy,
+# found through MS_MAPFILE like mapserv does.
+
+@pytest.fixture
+def mapfile(tmp_path, monkeypatch):
+
+    if 'SUPPORTS=WMS' not in mapscript.msGetVersion():
+        pytest.skip()
+
+    path = str(tmp_path / 'mapml_cache.map')
+    shutil.copy(get_relpath_to_this('mapml_cache.map'), path)
+    monkeypatch.setenv('MS_MAPFILE', path)
+    monkeypatch.delenv('HTTP_IF_NONE_MATCH', raising=False)
+    return path
+
+
+def get_mapml(map):
+
+    request = mapscript.OWSRequest()
+    mapscript.msIO_installStdoutToBuffer()
+    request.loadParamsFromURL('SERVICE=WMS&REQUEST=GetMapML&LAYER=road&PROJECTION=OSMTILE')
+    status = map.OWSDispatch(request)
+    headers = mapscript.msIO_getAndStripStdoutBufferMimeHeaders()
+    content = mapscript.msIO_getStdoutBufferString()
+    mapscript.msIO_resetHandlers()
+    assert status == 0
+    return headers, content
+
+###############################################################################
+# A second request is served from the cache, even though the map changed in
+# memory, until the mapfile itself is modified.
+
+def test_mapml_cache_hit(mapfile):
+
+    map = mapscript.mapObj(mapfile)
+    headers, content = get_mapml(map)
+    assert 'Original attribution' in content
+    assert 'ETag' in headers
+
+    map.web.metadata.set('wms_attribution_title', 'Changed attribution')
+    cached_headers, cached_content = get_mapml(map)
+    assert cached_content == content
+    assert cached_headers['ETag'] == headers['ETag']
+
+    mtime = os.stat(mapfile).st_mtime + 10
+    os.utime(mapfile, (mtime, mtime))
+    new_headers, new_content = get_mapml(map)
+    assert 'Changed attribution' in new_content
+    assert new_headers['ETag'] != headers['ETag']
+
+###############################################################################
+# Without mapml_cache every request builds the document again.
+
+def test_mapml_cache_disabled(mapfile):
+
+    map = mapscript.mapObj(mapfile)
+    map.web.metadata.remove('mapml_cache')
+    headers, content = get_mapml(map)
+    assert 'Original attribution' in content
+
+    map.web.metadata.set('wms_attribution_title', 'Changed attribution')
+    headers, content = get_mapml(map)
+    assert 'Changed attribution' in content
+
+###############################################################################
+# A client sending the ETag of the document it has gets a 304 and no content,
+# any other ETag gets the whole document.
+
+def test_mapml_cache_if_none_match(mapfile, monkeypatch):
+
+    map = mapscript.mapObj(mapfile)
+    headers, content = get_mapml(map)
+    assert 'Status' not in headers
+
+    monkeypatch.setenv('HTTP_IF_NONE_MATCH', headers['ETag'])
+    not_modified_headers, not_modified_content = get_mapml(map)
+    assert not_modified_headers['Status'] == '304 Not Modified'
+    assert not_modified_headers['ETag'] == headers['ETag']
+    assert not_modified_content == ''
+
+    monkeypatch.setenv('HTTP_IF_NONE_MATCH', '"0000000000000000"')
+    other_headers, other_content = get_mapml(map)
+    assert 'Status' not in other_headers
+    assert other_content == content
@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+###############################################################################
+# $Id$
+#
+# Project:  MapServer
+# Purpose:  Compare maps drawn with and without MS_PARALLEL_LAYERS.
+# Author:   MapServer team.
+#
+###############################################################################
+#  Copyright (c) 2026, MapServer contributors.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a
+#  copy of this software and associated documentation files (the "Software"),
+#  to deal in the Software without restriction, including without limitation
+#  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+#  and/or sell copies of the Software, and to permit persons to whom the
+#  Software is furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included
+#  in all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+#  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+#  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+#  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+#  DEALINGS IN THE SOFTWARE.
+###############################################################################
+
+import os
+import pytest
+
+mapscript_available = False
+try:
+    import mapscript
+    mapscript_available = True
+except ImportError:
+    pass
+
+gdal_available = False
+try:
+    from osgeo import gdal
+    gdal_available = True
+except ImportError:
+    pass
+
+pytestmark = [pytest.mark.skipif(not mapscript_available, reason="mapscript not available"),
+              pytest.mark.skipif(not gdal_available, reason="GDAL python bindings not available")]
+
+def get_relpath_to_this(filename):
+    return os.path.join(os.path.dirname(__file__), filename)
+
+###############################################################################
+# Draw the map sequentially and with 4 worker threads and return the bands
+# of both images.
+
+def draw_both_ways(map):
+
+    if 'SUPPORTS=THREADS' not in mapscript.msGetVersion():
+        pytest.skip('parallel layer drawing requires a thread-safe build')
+
+    pixels = []
+    for threads in (None, '4'):
+        if threads is not None:
+            map.setConfigOption('MS_PARALLEL_LAYERS', threads)
+        img = map.draw()
+        filename = '/vsimem/parallel_layers.png'
+        gdal.FileFromMemBuffer(filename, img.getBytes())
+        ds = gdal.Open(filename)
+        pixels.append([bytearray(ds.GetRasterBand(i + 1).ReadRaster())
+                       for i in range(ds.RasterCount)])
+        ds = None
+        gdal.Unlink(filename)
+
+    return pixels
+
+def max_channel_difference(bands_a, bands_b):
+
+    assert len(bands_a) == len(bands_b)
+    maxdiff = 0
+    for a, b in zip(bands_a, bands_b):
+        assert len(a) == len(b)
+        if a != b:
+            maxdiff = max(maxdiff, max(abs(x - y) for x, y in zip(a, b)))
+    return maxdiff
+
+###############################################################################
+# Opaque rectangles on pixel boundaries have no partially covered pixel, the
+# parallel output must then be identical to the sequential one.
+
+def test_parallel_layers_identical():
+
+    map = mapscript.mapObj(get_relpath_to_this('parallel_layers.map'))
+    for i in range(map.numlayers):
+        layer = map.getLayer(i)
+        layer.status = mapscript.MS_ON if layer.name.startswith('rect') else mapscript.MS_OFF
+
+    sequential, parallel = draw_both_ways(map)
+    assert max_channel_difference(sequential, parallel) == 0
+
+###############################################################################
+# Antialiased edges and translucent fills go through one more 8 bit
+# premultiplied rounding in parallel mode (see mapdraw.c), a few levels per
+# channel.
+
+def test_parallel_layers_antialiased():
+
+    map = mapscript.mapObj(get_relpath_to_this('parallel_layers.map'))
+
+    sequential, parallel = draw_both_ways(map)
+    assert max_channel_difference(sequential, parallel) <= 8
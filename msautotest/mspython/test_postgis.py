@@ -315,3 +315,83 @@ def test_postgis_box_bind_values_queryByRect():
             break
         count += 1
     assert count == 15
+
+###############################################################################
+# Maps drawn from STREAMING=YES and BINARY_WKB=YES layers must be identical
+# to the ones drawn from the default hex encoded, fully buffered result.
+
+def draw_road_map(processing):
+
+    map = mapscript.fromstring("""
+        MAP
+            SIZE 300 300
+            IMAGETYPE png
+            LAYER
+                CONNECTIONTYPE postgis
+                CONNECTION "dbname=msautotest user=postgres"
+                NAME road
+                DATA "the_geom from (select * from road order by gid) as foo using unique gid using srid=3978"
+                TYPE LINE
+                STATUS ON
+                %s
+                CLASS
+                    STYLE
+                        COLOR 0 0 255
+                        WIDTH 2
+                    END
+                END
+            END
+        END
+        """ % processing)
+    extent = map.getLayer(0).getExtent()
+    map.setExtent(extent.minx, extent.miny, extent.maxx, extent.maxy)
+    return map.draw().getBytes()
+
+
+@pytest.mark.parametrize("processing",
+                         ["PROCESSING 'STREAMING=YES'",
+                          "PROCESSING 'BINARY_WKB=YES'",
+                          "PROCESSING 'STREAMING=YES' PROCESSING 'BINARY_WKB=YES'",
+                          ])
+def test_postgis_streaming_draw(processing):
+
+    assert draw_road_map(processing) == draw_road_map("")
+
+###############################################################################
+# A STREAMING=YES layer refuses other requests, instead of cancelling the
+# streamed query, until all of its shapes have been read.
+
+def test_postgis_streaming_refuses_other_queries():
+
+    map = mapscript.mapObj()
+    layer = mapscript.layerObj(map)
+    layer.updateFromString("""
+        LAYER
+            CONNECTIONTYPE postgis
+            CONNECTION "dbname=msautotest user=postgres"
+            NAME road
+            DATA "the_geom from (select * from road order by gid) as foo using unique gid using srid=3978"
+            PROCESSING "STREAMING=YES"
+            TYPE LINE
+        END
+        """)
+    numfeatures = layer.getNumFeatures()
+    assert numfeatures > 1
+
+    layer.open()
+    layer.whichShapes(layer.getExtent())
+    shape = layer.nextShape()
+    assert shape is not None
+    with pytest.raises(mapscript.MapServerError):
+        layer.getShape(mapscript.resultObj(shape.index))
+    with pytest.raises(mapscript.MapServerError):
+        layer.getNumFeatures()
+
+    count = 1
+    while layer.nextShape() is not None:
+        count += 1
+    assert count == numfeatures
+
+    shape = layer.getShape(mapscript.resultObj(shape.index))
+    assert shape is not None
+    layer.close()
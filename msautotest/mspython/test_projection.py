@@ -0,0 +1,127 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+###############################################################################
+# $Id$
+#
+# Project:  MapServer
+# Purpose:  Compare the built-in WGS84 <-> Web Mercator reprojection with PROJ.
+# Author:   MapServer team.
+#
+###############################################################################
+#  Copyright (c) 2026, MapServer contributors.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a
+#  copy of this software and associated documentation files (the "Software"),
+#  to deal in the Software without restriction, including without limitation
+#  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+#  and/or sell copies of the Software, and to permit persons to whom the
+#  Software is furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included
+#  in all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+#  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+#  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+#  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+#  DEALINGS IN THE SOFTWARE.
+###############################################################################
+
+
+import pytest
+
+mapscript_available = False
+try:
+    import mapscript
+    mapscript_available = True
+except ImportError:
+    pass
+
+pytestmark = pytest.mark.skipif(not mapscript_available, reason="mapscript not available")
+
+# init=epsg:4326 <-> Web Mercator goes through the built-in formulas, the
+# +towgs84 definition of the same CRS is not recognized and goes through PROJ
+FASTPATH_LONLAT = "init=epsg:4326"
+PROJ_LONLAT = "+proj=longlat +ellps=WGS84 +towgs84=0,0,0"
+WEBMERC_DEFINITIONS = [ "init=epsg:3857",
+                        "+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0 +units=m +k=1.0 +nadgrids=@null" ]
+
+# a grid over the valid Web Mercator area, plus longitudes to wrap
+LONLAT_POINTS = [ ( lon, lat ) for lon in range(-175, 180, 25) for lat in range(-85, 90, 10) ] + \
+                [ ( 190, 45 ), ( -200, -30 ), ( 179.9, -85 ) ]
+
+###############################################################################
+# Test the closed form WGS84 <-> Web Mercator reprojection against PROJ output
+
+def test_reprojection_wgs84_webmercator_fastpath():
+
+    wgs84_proj = mapscript.projectionObj("init=epsg:4326")
+    webmerc_proj = mapscript.projectionObj("init=epsg:3857")
+    sphere_proj = mapscript.projectionObj(WEBMERC_DEFINITIONS[1])
+
+    # Reference values computed with PROJ
+    tests = [ ( -123.1, 49.25, -13703429.316651976, 6317388.117930812 ),
+              ( 179.9, -85, 20026376.393709917, -19971868.880408566 ),
+              ( 190, 45, -18924313.434856508, 5621521.486192066 ),
+              ( 2.35, 48.85, 261600.8033641929, 6249447.75279128 ) ]
+
+    for merc_proj in (webmerc_proj, sphere_proj):
+        for (lon, lat, x, y) in tests:
+            p = mapscript.pointObj( lon, lat )
+            assert p.project(wgs84_proj, merc_proj) == 0
+            assert p.x == pytest.approx(x, abs=1e-6)
+            assert p.y == pytest.approx(y, abs=1e-6)
+
+        p = mapscript.pointObj( -13703429.316651976, 6317388.117930812 )
+        assert p.project(merc_proj, wgs84_proj) == 0
+        assert p.x == pytest.approx(-123.1, abs=1e-9)
+        assert p.y == pytest.approx(49.25, abs=1e-9)
+
+        # Longitudes are wrapped like PROJ does
+        p = mapscript.pointObj( 25000000, 1000 )
+        assert p.project(merc_proj, wgs84_proj) == 0
+        assert p.x == pytest.approx(-135.42117897011966, abs=1e-9)
+        assert p.y == pytest.approx(0.008983152804391653, abs=1e-9)
+
+    # Poles cannot be projected
+    p = mapscript.pointObj( 0, 90 )
+    assert p.project(wgs84_proj, webmerc_proj) != 0
+
+###############################################################################
+# Compare the built-in formulas with a PROJ only transform, point by point
+# and a whole line at once, in both directions.
+
+@pytest.mark.parametrize("webmerc", WEBMERC_DEFINITIONS)
+def test_reprojection_wgs84_webmercator_fastpath_matches_proj(webmerc):
+
+    fastpath_proj = mapscript.projectionObj(FASTPATH_LONLAT)
+    proj_proj = mapscript.projectionObj(PROJ_LONLAT)
+    merc_proj = mapscript.projectionObj(webmerc)
+
+    def project_points(points, src, dst):
+        result = []
+        for (x, y) in points:
+            p = mapscript.pointObj( x, y )
+            assert p.project(src, dst) == 0
+            result.append( ( p.x, p.y ) )
+        return result
+
+    def project_line(points, src, dst):
+        line = mapscript.lineObj()
+        for (x, y) in points:
+            line.add( mapscript.pointObj( x, y ) )
+        assert line.project(src, dst) == 0
+        return [ ( line.get(i).x, line.get(i).y ) for i in range(line.numpoints) ]
+
+    for project in (project_points, project_line):
+        merc_points = project(LONLAT_POINTS, proj_proj, merc_proj)
+        for (fast, ref) in zip(project(LONLAT_POINTS, fastpath_proj, merc_proj), merc_points):
+            assert fast[0] == pytest.approx(ref[0], abs=1e-4)
+            assert fast[1] == pytest.approx(ref[1], abs=1e-4)
+
+        lonlat_points = project(merc_points, merc_proj, proj_proj)
+        for (fast, ref) in zip(project(merc_points, merc_proj, fastpath_proj), lonlat_points):
+            assert fast[0] == pytest.approx(ref[0], abs=1e-9)
+            assert fast[1] == pytest.approx(ref[1], abs=1e-9)
@@ -0,0 +1,226 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time msDrawMap() with and without MS_PARALLEL_LAYERS
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/*
+** A 1000x1000 map with numlayers inline layers, alternately polygons and
+** lines, of numfeatures random antialiased triangles or polylines each.
+*/
+static char *buildMapfile(int numlayers, int numfeatures)
+{
+  size_t size = 1024 + (size_t) numlayers * (512 + (size_t) numfeatures * 80), len;
+  char *buffer = (char *) msSmallMalloc(size);
+  int i, j;
+
+  len = snprintf(buffer, size,
+                 "MAP\n"
+                 "  EXTENT 0 0 1000 1000\n"
+                 "  SIZE 1000 1000\n"
+                 "  IMAGETYPE png\n"
+                 "  IMAGECOLOR 255 255 255\n");
+
+  srand(1);
+  for(i=0; i<numlayers; i++) {
+    len += snprintf(buffer + len, size - len,
+                    "  LAYER\n"
+                    "    NAME \"layer%d\"\n"
+                    "    STATUS DEFAULT\n"
+                    "    TYPE %s\n"
+                    "    CLASS\n"
+                    "      STYLE COLOR %d %d %d WIDTH 2 OPACITY %d END\n"
+                    "    END\n",
+                    i, (i % 2) ? "LINE" : "POLYGON",
+                    rand() % 256, rand() % 256, rand() % 256, (i % 3) ? 100 : 60);
+    for(j=0; j<numfeatures; j++) {
+      int x = rand() % 1000, y = rand() % 1000;
+      len += snprintf(buffer + len, size - len,
+                      "    FEATURE POINTS %d %d %d %d %d %d %d %d END END\n",
+                      x, y, x + rand() % 100, y + rand() % 100,
+                      x - rand() % 100, y + rand() % 100, x, y);
+    }
+    len += snprintf(buffer + len, size - len, "  END\n");
+  }
+  snprintf(buffer + len, size - len, "END\n");
+
+  return buffer;
+}
+
+static double timeRenders(mapObj *map, int numruns, imageObj **lastimage)
+{
+  struct mstimeval start;
+  imageObj *image;
+  int i;
+
+  /* the first render fills the symbol caches, don't time it */
+  image = msDrawMap(map, MS_FALSE);
+  if(!image)
+    return -1;
+  msFreeImage(image);
+
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numruns; i++) {
+    image = msDrawMap(map, MS_FALSE);
+    if(!image)
+      return -1;
+    if(i < numruns - 1)
+      msFreeImage(image);
+  }
+  *lastimage = image;
+  return elapsed(&start) / numruns;
+}
+
+/* largest difference of any channel of any pixel, -1 if not comparable */
+static int compareImages(imageObj *a, imageObj *b, int *numdiffering)
+{
+  rasterBufferObj ra, rb;
+  unsigned int x, y;
+  int maxdiff = 0;
+
+  memset(&ra, 0, sizeof(rasterBufferObj));
+  memset(&rb, 0, sizeof(rasterBufferObj));
+  if(MS_IMAGE_RENDERER(a)->getRasterBufferHandle(a, &ra) != MS_SUCCESS ||
+      MS_IMAGE_RENDERER(b)->getRasterBufferHandle(b, &rb) != MS_SUCCESS ||
+      ra.type != MS_BUFFER_BYTE_RGBA || rb.type != MS_BUFFER_BYTE_RGBA ||
+      ra.width != rb.width || ra.height != rb.height)
+    return -1;
+
+  *numdiffering = 0;
+  for(y=0; y<ra.height; y++) {
+    for(x=0; x<ra.width; x++) {
+      unsigned int offa = x * ra.data.rgba.pixel_step + y * ra.data.rgba.row_step;
+      unsigned int offb = x * rb.data.rgba.pixel_step + y * rb.data.rgba.row_step;
+      int diff = MS_MAX(abs(ra.data.rgba.r[offa] - rb.data.rgba.r[offb]),
+                        abs(ra.data.rgba.g[offa] - rb.data.rgba.g[offb]));
+      diff = MS_MAX(diff, abs(ra.data.rgba.b[offa] - rb.data.rgba.b[offb]));
+      if(ra.data.rgba.a && rb.data.rgba.a)
+        diff = MS_MAX(diff, abs(ra.data.rgba.a[offa] - rb.data.rgba.a[offb]));
+      if(diff) (*numdiffering)++;
+      maxdiff = MS_MAX(maxdiff, diff);
+    }
+  }
+  return maxdiff;
+}
+
+int main(int argc, char *argv[])
+{
+  mapObj *map, *copy;
+  imageObj *sequential = NULL, *parallel = NULL;
+  struct mstimeval start;
+  char *mapfile, threads[32];
+  double sequentialtime, paralleltime, copytime;
+  int numlayers = 8, numfeatures = 2000, numthreads = 4, numruns = 10;
+  int i, maxdiff, numdiffering = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc > 1 && strcmp(argv[1], "-h") == 0) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    parallelbench [<threads>] [<layers>] [<features>] [<runs>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <threads>  (optional) is the MS_PARALLEL_LAYERS value, default 4.\n");
+    fprintf(stdout," <layers>   (optional) is the number of layers, default 8.\n");
+    fprintf(stdout," <features> (optional) is the number of features per layer, default 2000.\n");
+    fprintf(stdout," <runs>     (optional) is the number of renders to time, default 10.\n");
+    exit(0);
+  }
+
+  if(argc >= 2) numthreads = MS_MAX(atoi(argv[1]), 2);
+  if(argc >= 3) numlayers = MS_MAX(atoi(argv[2]), 2);
+  if(argc >= 4) numfeatures = MS_MAX(atoi(argv[3]), 1);
+  if(argc >= 5) numruns = MS_MAX(atoi(argv[4]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  mapfile = buildMapfile(numlayers, numfeatures);
+  map = msLoadMapFromString(mapfile, NULL);
+  msFree(mapfile);
+  if(!map) {
+    msWriteError(stderr);
+    msCleanup();
+    exit(1);
+  }
+
+  sequentialtime = timeRenders(map, numruns, &sequential);
+  snprintf(threads, sizeof(threads), "%d", numthreads);
+  msSetConfigOption(map, "MS_PARALLEL_LAYERS", threads);
+  paralleltime = timeRenders(map, numruns, &parallel);
+  if(sequentialtime < 0 || paralleltime < 0) {
+    msWriteError(stderr);
+    msFreeImage(sequential);
+    msFreeImage(parallel);
+    msFreeMap(map);
+    msCleanup();
+    exit(1);
+  }
+
+  /* what msDrawMap() spends on the worker copies of each request */
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numruns * numthreads; i++) {
+    copy = msNewMapObj();
+    msCopyMap(copy, map);
+    msFreeMap(copy);
+  }
+  copytime = elapsed(&start) / numruns;
+
+  maxdiff = compareImages(sequential, parallel, &numdiffering);
+
+  printf("%d layers of %d features on a %dx%d map\n",
+         numlayers, numfeatures, map->width, map->height);
+  printf("sequential:   %8.1f ms/render\n", sequentialtime * 1.0e3);
+  printf("%2d threads:   %8.1f ms/render, %.2fx, of which %.1f ms copying the map\n",
+         numthreads, paralleltime * 1.0e3, sequentialtime / paralleltime, copytime * 1.0e3);
+  printf("largest channel difference %d, %d of %d pixels differ\n",
+         maxdiff, numdiffering, map->width * map->height);
+
+  msFreeImage(sequential);
+  msFreeImage(parallel);
+  msFreeMap(map);
+  msCleanup();
+
+  /* see the rounding note in mapdraw.c, antialiased edges differ slightly */
+  return (maxdiff >= 0 && maxdiff <= 8) ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time reading a PostGIS layer with and without
+ *           PROCESSING STREAMING=YES and BINARY_WKB=YES.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/* peak resident set size of the process so far, in kB, or -1 */
+static long peakMemory(void)
+{
+#ifndef _WIN32
+  struct rusage usage;
+
+  if(getrusage(RUSAGE_SELF, &usage) == 0)
+    return usage.ru_maxrss;
+#endif
+  return -1;
+}
+
+/* reads every shape of the layer the way a map draw does, returns the count or -1 */
+static int readLayer(layerObj *layer)
+{
+  shapeObj shape;
+  rectObj extent;
+  int status, numshapes = 0;
+
+  if(msLayerOpen(layer) != MS_SUCCESS || msLayerGetExtent(layer, &extent) != MS_SUCCESS ||
+      msLayerWhichItems(layer, MS_TRUE, NULL) != MS_SUCCESS ||
+      msLayerWhichShapes(layer, extent, MS_FALSE) != MS_SUCCESS) {
+    msLayerClose(layer);
+    return -1;
+  }
+
+  msInitShape(&shape);
+  while((status = msLayerNextShape(layer, &shape)) == MS_SUCCESS) {
+    numshapes++;
+    msFreeShape(&shape);
+  }
+
+  msLayerClose(layer);
+  return status == MS_DONE ? numshapes : -1;
+}
+
+int main(int argc, char *argv[])
+{
+  /* the modes that buffer the whole result come last as the peak memory only grows */
+  const char *modes[][2] = {
+    {"STREAMING=YES", "BINARY_WKB=YES"},
+    {"STREAMING=YES", "BINARY_WKB=NO"},
+    {"STREAMING=NO", "BINARY_WKB=YES"},
+    {"STREAMING=NO", "BINARY_WKB=NO"}
+  };
+  mapObj *map;
+  layerObj *layer;
+  struct mstimeval start;
+  double seconds;
+  int numruns = 3, i, j, numshapes = 0, status = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 3) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    postgisbench <connection> <data> [<runs>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <connection> is a PostgreSQL connection string, e.g. \"dbname=msautotest\".\n");
+    fprintf(stdout," <data>       is a PostGIS layer DATA statement, e.g.\n");
+    fprintf(stdout,"              \"the_geom from road using unique gid using srid=3978\".\n");
+    fprintf(stdout," <runs>       (optional) is the number of reads to time per mode, default 3.\n");
+    exit(0);
+  }
+
+  if(argc >= 4) numruns = MS_MAX(atoi(argv[3]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  map = msLoadMapFromString("MAP LAYER NAME \"bench\" CONNECTIONTYPE POSTGIS TYPE POLYGON STATUS ON END END", NULL);
+  if(!map) {
+    msWriteError(stderr);
+    msCleanup();
+    exit(1);
+  }
+  layer = GET_LAYER(map, 0);
+  layer->connection = msStrdup(argv[1]);
+  layer->data = msStrdup(argv[2]);
+
+  for(i=0; i<4 && status == 0; i++) {
+    msLayerSetProcessingKey(layer, "STREAMING", strchr(modes[i][0], '=') + 1);
+    msLayerSetProcessingKey(layer, "BINARY_WKB", strchr(modes[i][1], '=') + 1);
+
+    msGettimeofday(&start, NULL);
+    for(j=0; j<numruns; j++) {
+      if((numshapes = readLayer(layer)) < 0) {
+        msWriteError(stderr);
+        status = 1;
+        break;
+      }
+    }
+    seconds = elapsed(&start);
+
+    if(status == 0)
+      printf("%-14s %-15s %8.1f ms/read, %d shapes, peak memory %ld kB\n",
+             modes[i][0], modes[i][1], seconds * 1.0e3 / numruns, numshapes, peakMemory());
+  }
+
+  msFreeMap(map);
+  msCleanup();
+
+  return status;
+}
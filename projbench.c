@@ -0,0 +1,195 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time the reprojection of shapefile geometries,
+ *           point by point and a whole line at a time.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/* appends the lines of all the shapes of filename to lines */
+static int readLines(const char *filename, lineObj **lines, int *numlines)
+{
+  shapefileObj shapefile;
+  shapeObj shape;
+  int i, j;
+
+  if(msShapefileOpen(&shapefile, "rb", filename, MS_TRUE) == -1)
+    return MS_FAILURE;
+
+  for(i=0; i<shapefile.numshapes; i++) {
+    msInitShape(&shape);
+    msSHPReadShape(shapefile.hSHP, i, &shape);
+    for(j=0; j<shape.numlines; j++) {
+      lineObj *line;
+      *lines = (lineObj *) msSmallRealloc(*lines, sizeof(lineObj) * (*numlines + 1));
+      line = &((*lines)[(*numlines)++]);
+      line->numpoints = shape.line[j].numpoints;
+      line->point = (pointObj *) msSmallMalloc(sizeof(pointObj) * MS_MAX(line->numpoints, 1));
+      memcpy(line->point, shape.line[j].point, sizeof(pointObj) * line->numpoints);
+    }
+    msFreeShape(&shape);
+  }
+
+  msShapefileClose(&shapefile);
+  return MS_SUCCESS;
+}
+
+/*
+** Reprojects copies of the lines numruns times, with one msProjectPointEx()
+** call per vertex (batched == MS_FALSE) or one msProjectLineEx() call per
+** line, and returns the time taken. work holds the last results.
+*/
+static double runProjection(reprojectionObj *reprojector, lineObj *lines, lineObj *work,
+                            int numlines, int numruns, int batched)
+{
+  struct mstimeval start;
+  int i, j, k;
+
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numruns; i++) {
+    for(j=0; j<numlines; j++) {
+      memcpy(work[j].point, lines[j].point, sizeof(pointObj) * lines[j].numpoints);
+      work[j].numpoints = lines[j].numpoints;
+      if(batched)
+        msProjectLineEx(reprojector, &work[j]);
+      else
+        for(k=0; k<work[j].numpoints; k++)
+          msProjectPointEx(reprojector, &(work[j].point[k]));
+    }
+  }
+  return elapsed(&start);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *src = "init=epsg:4326", *dst = "init=epsg:3857";
+  projectionObj in, out;
+  reprojectionObj *reprojector;
+  lineObj *lines = NULL, *work, *perpoint;
+  double pointtime, linetime, maxdiff = 0;
+  int numruns = 10000, numlines = 0, numpoints = 0, i, j;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  for(i=1; i<argc-1 && argv[i][0] == '-'; i+=2) {
+    if(strcmp(argv[i], "-s") == 0)
+      src = argv[i+1];
+    else if(strcmp(argv[i], "-t") == 0)
+      dst = argv[i+1];
+    else if(strcmp(argv[i], "-r") == 0)
+      numruns = MS_MAX(atoi(argv[i+1]), 1);
+    else
+      break;
+  }
+
+  if(i >= argc) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    projbench [-s <projection>] [-t <projection>] [-r <runs>] <shpfile>...\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," -s <projection> is the projection of the shapefiles, default init=epsg:4326.\n");
+    fprintf(stdout," -t <projection> is the output projection, default init=epsg:3857.\n");
+    fprintf(stdout," -r <runs>       is the number of times all the shapes are reprojected,\n");
+    fprintf(stdout,"                 default 10000.\n");
+    fprintf(stdout," <shpfile>       are .shp files, e.g. tests/*.shp.\n");
+    fprintf(stdout,"EPSG:4326 to EPSG:3857 uses built-in formulas instead of PROJ, pass\n");
+    fprintf(stdout,"-s \"+proj=longlat +ellps=WGS84 +towgs84=0,0,0\" to time PROJ instead.\n");
+    exit(0);
+  }
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  for(; i<argc; i++) {
+    if(readLines(argv[i], &lines, &numlines) != MS_SUCCESS) {
+      fprintf(stdout, "Error opening shapefile %s.\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  msInitProjection(&in);
+  msInitProjection(&out);
+  if(msLoadProjectionString(&in, src) != 0 || msLoadProjectionString(&out, dst) != 0 ||
+      (reprojector = msProjectCreateReprojector(&in, &out)) == NULL) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  work = (lineObj *) msSmallMalloc(sizeof(lineObj) * MS_MAX(numlines, 1));
+  perpoint = (lineObj *) msSmallMalloc(sizeof(lineObj) * MS_MAX(numlines, 1));
+  for(j=0; j<numlines; j++) {
+    work[j].point = (pointObj *) msSmallMalloc(sizeof(pointObj) * MS_MAX(lines[j].numpoints, 1));
+    perpoint[j].point = (pointObj *) msSmallMalloc(sizeof(pointObj) * MS_MAX(lines[j].numpoints, 1));
+    numpoints += lines[j].numpoints;
+  }
+
+  pointtime = runProjection(reprojector, lines, perpoint, numlines, numruns, MS_FALSE);
+  linetime = runProjection(reprojector, lines, work, numlines, numruns, MS_TRUE);
+
+  for(j=0; j<numlines; j++) {
+    for(i=0; i<lines[j].numpoints; i++) {
+      maxdiff = MS_MAX(maxdiff, fabs(work[j].point[i].x - perpoint[j].point[i].x));
+      maxdiff = MS_MAX(maxdiff, fabs(work[j].point[i].y - perpoint[j].point[i].y));
+    }
+  }
+
+  printf("%d lines, %d points, from %s to %s, %d runs\n", numlines, numpoints, src, dst, numruns);
+  printf("per point: %12.0f points/s\n", (double) numpoints * numruns / pointtime);
+  printf("per line:  %12.0f points/s, %.2fx\n", (double) numpoints * numruns / linetime, pointtime / linetime);
+  printf("largest difference between the two: %g\n", maxdiff);
+
+  for(j=0; j<numlines; j++) {
+    msFree(lines[j].point);
+    msFree(work[j].point);
+    msFree(perpoint[j].point);
+  }
+  msFree(lines);
+  msFree(work);
+  msFree(perpoint);
+  msProjectDestroyReprojector(reprojector);
+  msFreeProjection(&in);
+  msFreeProjection(&out);
+  msCleanup();
+
+  return 0;
+}
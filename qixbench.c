@@ -0,0 +1,169 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time .qix searches with and without the index cache
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <cpl_conv.h>
+#include <string.h>
+#include <stdlib.h>
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+  double da = *(const double *) a, db = *(const double *) b;
+  return (da > db) - (da < db);
+}
+
+static void printLatencies(const char *name, double *times, int numqueries)
+{
+  double total = 0;
+  int i;
+
+  for(i=0; i<numqueries; i++)
+    total += times[i];
+  qsort(times, numqueries, sizeof(double), compareDoubles);
+  printf("%-7s %8.1f us/search, p50 %8.1f us, p99 %8.1f us, max %8.1f us\n", name,
+         total * 1.0e6 / numqueries, times[numqueries / 2] * 1.0e6,
+         times[(int)(numqueries * 0.99)] * 1.0e6, times[numqueries - 1] * 1.0e6);
+}
+
+int main(int argc, char *argv[])
+{
+  shapefileObj shapefile;
+  struct mstimeval start;
+  rectObj *aois, bounds;
+  ms_bitarray *results, status;
+  double size = 0.05, *disktimes, *cachedtimes, loadtime;
+  int numqueries = 1000, i, j, mismatches = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    qixbench <shpfile> [<queries>] [<size>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <shpfile> is the name of a .shp file with a %s index (see shptree).\n", MS_INDEX_EXTENSION);
+    fprintf(stdout," <queries> (optional) is the number of random searches, default 1000.\n");
+    fprintf(stdout," <size>    (optional) is the size of the searches relative to the\n");
+    fprintf(stdout,"           extent of the shapefile, default 0.05.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) numqueries = MS_MAX(atoi(argv[2]), 1);
+  if(argc >= 4) size = atof(argv[3]);
+
+  if(msShapefileOpen(&shapefile, "rb", argv[1], MS_TRUE) == -1) {
+    fprintf(stdout, "Error opening shapefile %s.\n", argv[1]);
+    exit(1);
+  }
+
+  bounds = shapefile.bounds;
+  aois = (rectObj *) msSmallMalloc(sizeof(rectObj) * numqueries);
+  results = (ms_bitarray *) msSmallMalloc(sizeof(ms_bitarray) * numqueries);
+  disktimes = (double *) msSmallMalloc(sizeof(double) * numqueries);
+  cachedtimes = (double *) msSmallMalloc(sizeof(double) * numqueries);
+  srand(1);
+  for(i=0; i<numqueries; i++) {
+    double width = (bounds.maxx - bounds.minx) * size, height = (bounds.maxy - bounds.miny) * size;
+    aois[i].minx = bounds.minx + (bounds.maxx - bounds.minx - width) * rand() / (double) RAND_MAX;
+    aois[i].miny = bounds.miny + (bounds.maxy - bounds.miny - height) * rand() / (double) RAND_MAX;
+    aois[i].maxx = aois[i].minx + width;
+    aois[i].maxy = aois[i].miny + height;
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Disk search, as done without MS_QIX_CACHE_SIZE.                 */
+  /* -------------------------------------------------------------------- */
+  for(i=0; i<numqueries; i++) {
+    msGettimeofday(&start, NULL);
+    results[i] = msSearchDiskTree(argv[1], aois[i], 0, shapefile.numshapes);
+    if(results[i])
+      msFilterTreeSearch(&shapefile, results[i], aois[i]);
+    disktimes[i] = elapsed(&start);
+    if(!results[i]) {
+      fprintf(stdout, "Unable to search the %s index of %s.\n", MS_INDEX_EXTENSION, argv[1]);
+      exit(1);
+    }
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Cached search, the first one loads the index.                   */
+  /* -------------------------------------------------------------------- */
+  CPLSetConfigOption("MS_QIX_CACHE_SIZE", "1024");
+  msGettimeofday(&start, NULL);
+  status = msSearchDiskTreeCached(&shapefile, argv[1], aois[0], 0);
+  loadtime = elapsed(&start);
+  if(!status) {
+    fprintf(stdout, "Unable to cache the %s index of %s.\n", MS_INDEX_EXTENSION, argv[1]);
+    exit(1);
+  }
+  msFree(status);
+
+  for(i=0; i<numqueries; i++) {
+    msGettimeofday(&start, NULL);
+    status = msSearchDiskTreeCached(&shapefile, argv[1], aois[i], 0);
+    cachedtimes[i] = elapsed(&start);
+
+    for(j=0; j<shapefile.numshapes; j++) {
+      if((status && msGetBit(status, j)) != (msGetBit(results[i], j) != 0)) {
+        mismatches++;
+        break;
+      }
+    }
+    msFree(status);
+    msFree(results[i]);
+  }
+
+  printf("%d searches of %g of the extent of %s (%d shapes)\n",
+         numqueries, size, argv[1], shapefile.numshapes);
+  printLatencies("disk:", disktimes, numqueries);
+  printLatencies("cached:", cachedtimes, numqueries);
+  printf("cache load: %.1f ms\n", loadtime * 1.0e3);
+  if(mismatches)
+    printf("WARNING: %d searches returned different shapes\n", mismatches);
+
+  msFree(aois);
+  msFree(results);
+  msFree(disktimes);
+  msFree(cachedtimes);
+  msShapefileClose(&shapefile);
+  msCleanup();
+
+  return(mismatches ? 1 : 0);
+}
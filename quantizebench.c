@@ -0,0 +1,204 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time the quantization of a rendered raster map
+ *           to a 256 color palette, as done for PNG8 output.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+static long colorDistance(const rgbaPixel *a, const rgbaPixel *b)
+{
+  return (long) (a->r - b->r) * (a->r - b->r) + (long) (a->g - b->g) * (a->g - b->g) +
+         (long) (a->b - b->b) * (a->b - b->b) + (long) (a->a - b->a) * (a->a - b->a);
+}
+
+/* number of pixels not classified to one of their closest palette entries */
+static int checkClassification(rasterBufferObj *rb, rasterBufferObj *qrb)
+{
+  int row, col, errors = 0;
+  unsigned int i;
+
+  for(row=0; row<(int)rb->height; row++) {
+    rgbaPixel *pixel = (rgbaPixel *) &(rb->data.rgba.pixels[row * rb->data.rgba.row_step]);
+    for(col=0; col<(int)rb->width; col++, pixel++) {
+      long best = colorDistance(pixel, &qrb->data.palette.palette[0]);
+      for(i=1; i<qrb->data.palette.num_entries; i++)
+        best = MS_MIN(best, colorDistance(pixel, &qrb->data.palette.palette[i]));
+      if(colorDistance(pixel, &qrb->data.palette.palette[qrb->data.palette.pixels[row * rb->width + col]]) != best)
+        errors++;
+    }
+  }
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  mapObj *map;
+  imageObj *image;
+  rasterBufferObj rb, qrb;
+  rgbaPixel palette[256];
+  struct mstimeval start;
+  double quantizetime = 0, classifytime = 0, savetime = 0;
+  char *mapfile;
+  unsigned char *original;
+  size_t len, buffersize;
+  rectObj extent;
+  int numruns = 20, size = 1024, i, size_out, errors, status = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    quantizebench <raster> [<runs>] [<size>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <raster> is a GDAL raster file, e.g. tests/raster.tif.\n");
+    fprintf(stdout," <runs>   (optional) is the number of quantizations to time, default 20.\n");
+    fprintf(stdout," <size>   (optional) is the map width and height, default 1024.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) numruns = MS_MAX(atoi(argv[2]), 1);
+  if(argc >= 4) size = MS_MAX(atoi(argv[3]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  /* bilinear resampling, so the map has many more colors than the raster */
+  len = 512 + strlen(argv[1]);
+  mapfile = (char *) msSmallMalloc(len);
+  snprintf(mapfile, len,
+           "MAP\n"
+           "  SIZE %d %d\n"
+           "  IMAGETYPE png8\n"
+           "  LAYER\n"
+           "    NAME \"raster\"\n"
+           "    TYPE RASTER\n"
+           "    STATUS DEFAULT\n"
+           "    PROCESSING \"RESAMPLE=BILINEAR\"\n"
+           "    DATA \"%s\"\n"
+           "  END\n"
+           "END\n", size, size, argv[1]);
+  map = msLoadMapFromString(mapfile, NULL);
+  msFree(mapfile);
+  if(!map || msLayerGetExtent(GET_LAYER(map, 0), &extent) != MS_SUCCESS ||
+      msMapSetExtent(map, extent.minx, extent.miny, extent.maxx, extent.maxy) != MS_SUCCESS ||
+      (image = msDrawMap(map, MS_FALSE)) == NULL) {
+    msWriteError(stderr);
+    if(map) msFreeMap(map);
+    msCleanup();
+    exit(1);
+  }
+
+  if(MS_IMAGE_RENDERER(image)->getRasterBufferHandle(image, &rb) != MS_SUCCESS) {
+    msWriteError(stderr);
+    msFreeImage(image);
+    msFreeMap(map);
+    msCleanup();
+    exit(1);
+  }
+
+  /*
+  ** msQuantizeRasterBuffer() reduces the depth of the image in place when it
+  ** has too many colors, so each run starts again from a copy of the drawing.
+  */
+  buffersize = (size_t) rb.height * rb.data.rgba.row_step;
+  original = (unsigned char *) msSmallMalloc(buffersize);
+  memcpy(original, rb.data.rgba.pixels, buffersize);
+
+  memset(&qrb, 0, sizeof(rasterBufferObj));
+  qrb.type = MS_BUFFER_BYTE_PALETTE;
+  qrb.width = rb.width;
+  qrb.height = rb.height;
+  qrb.data.palette.pixels = (unsigned char *) msSmallMalloc(qrb.width * qrb.height);
+  qrb.data.palette.palette = palette;
+
+  /* the two steps msSaveRasterBuffer() runs for QUANTIZE_FORCE=ON */
+  for(i=0; i<numruns && status == 0; i++) {
+    memcpy(rb.data.rgba.pixels, original, buffersize);
+    qrb.data.palette.num_entries = 256;
+    qrb.data.palette.scaling_maxval = 255;
+    msGettimeofday(&start, NULL);
+    if(msQuantizeRasterBuffer(&rb, &(qrb.data.palette.num_entries), palette, NULL, 0,
+                              &(qrb.data.palette.scaling_maxval)) != MS_SUCCESS)
+      status = 1;
+    quantizetime += elapsed(&start);
+
+    msGettimeofday(&start, NULL);
+    if(status == 0 && msClassifyRasterBuffer(&rb, &qrb) != MS_SUCCESS)
+      status = 1;
+    classifytime += elapsed(&start);
+  }
+
+  if(status != 0) {
+    msWriteError(stderr);
+  } else {
+    errors = checkClassification(&rb, &qrb);
+
+    /* and the whole PNG8 encoding, for comparison */
+    for(i=0; i<numruns; i++) {
+      memcpy(rb.data.rgba.pixels, original, buffersize);
+      msGettimeofday(&start, NULL);
+      msFree(msSaveImageBuffer(image, &size_out, map->outputformat));
+      savetime += elapsed(&start);
+    }
+
+    printf("%dx%d map of %s, %u palette entries\n", rb.width, rb.height, argv[1], qrb.data.palette.num_entries);
+    printf("quantize: %8.1f ms\n", quantizetime * 1.0e3 / numruns);
+    printf("classify: %8.1f ms, %.1f Mpixels/s\n", classifytime * 1.0e3 / numruns,
+           (double) rb.width * rb.height * numruns / classifytime / 1.0e6);
+    printf("png8:     %8.1f ms for the whole encoding\n", savetime * 1.0e3 / numruns);
+    if(errors) {
+      printf("WARNING: %d pixels don't use one of their closest palette entries\n", errors);
+      status = 1;
+    }
+  }
+
+  msFree(qrb.data.palette.pixels);
+  msFree(original);
+  msFreeImage(image);
+  msFreeMap(map);
+  msCleanup();
+
+  return status;
+}
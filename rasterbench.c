@@ -0,0 +1,197 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Multi-threaded raster rendering throughput, to check that drawing
+ *           raster layers scales with the number of threads.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(USE_THREAD) && !defined(_WIN32)
+
+#include <pthread.h>
+
+typedef struct {
+  const char *mapfile;
+  rectObj extent;
+  int draws;
+  int failures;
+} rasterBenchObj;
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/* maps aren't shared between threads, each one draws its own copy */
+static void *benchThread(void *data)
+{
+  rasterBenchObj *bench = (rasterBenchObj *) data;
+  mapObj *map;
+  int i;
+
+  map = msLoadMapFromString((char *) bench->mapfile, NULL);
+  if(!map) {
+    bench->failures += bench->draws;
+    return NULL;
+  }
+  msMapSetExtent(map, bench->extent.minx, bench->extent.miny,
+                 bench->extent.maxx, bench->extent.maxy);
+
+  for(i=0; i<bench->draws; i++) {
+    imageObj *image = msDrawMap(map, MS_FALSE);
+    if(!image)
+      bench->failures++;
+    else
+      msFreeImage(image);
+  }
+
+  msFreeMap(map);
+  return NULL;
+}
+
+static double runBench(const char *mapfile, rectObj extent, int numthreads, int draws, int *failures)
+{
+  pthread_t *threads;
+  rasterBenchObj *benches;
+  struct mstimeval start;
+  double seconds;
+  int i;
+
+  threads = (pthread_t *) msSmallMalloc(sizeof(pthread_t) * numthreads);
+  benches = (rasterBenchObj *) msSmallCalloc(numthreads, sizeof(rasterBenchObj));
+
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numthreads; i++) {
+    benches[i].mapfile = mapfile;
+    benches[i].extent = extent;
+    benches[i].draws = draws;
+    pthread_create(&threads[i], NULL, benchThread, &benches[i]);
+  }
+  for(i=0; i<numthreads; i++) {
+    pthread_join(threads[i], NULL);
+    *failures += benches[i].failures;
+  }
+  seconds = elapsed(&start);
+
+  free(threads);
+  free(benches);
+  return seconds;
+}
+
+int main(int argc, char *argv[])
+{
+  int maxthreads = 8, draws = 20, size = 1024, failures = 0, numthreads;
+  double seconds, single = 0;
+  char *mapfile;
+  size_t len;
+  mapObj *map;
+  rectObj extent;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    rasterbench <raster> [<threads>] [<draws>] [<size>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <raster>     is a GDAL raster file, e.g. tests/raster.tif.\n");
+    fprintf(stdout," <threads>    (optional) is the largest number of threads, default 8.\n");
+    fprintf(stdout,"              Runs double the thread count from 1 up to it.\n");
+    fprintf(stdout," <draws>      (optional) is the number of maps drawn per thread,\n");
+    fprintf(stdout,"              default 20.\n");
+    fprintf(stdout," <size>       (optional) is the map width and height, default 1024.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) maxthreads = MS_MAX(atoi(argv[2]), 1);
+  if(argc >= 4) draws = MS_MAX(atoi(argv[3]), 1);
+  if(argc >= 5) size = MS_MAX(atoi(argv[4]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  len = 512 + strlen(argv[1]);
+  mapfile = (char *) msSmallMalloc(len);
+  snprintf(mapfile, len,
+           "MAP\n"
+           "  SIZE %d %d\n"
+           "  IMAGETYPE png\n"
+           "  LAYER\n"
+           "    NAME \"raster\"\n"
+           "    TYPE RASTER\n"
+           "    STATUS DEFAULT\n"
+           "    DATA \"%s\"\n"
+           "  END\n"
+           "END\n", size, size, argv[1]);
+
+  /* the map covers the whole raster, which is resampled to size x size */
+  map = msLoadMapFromString(mapfile, NULL);
+  if(!map || msLayerGetExtent(GET_LAYER(map, 0), &extent) != MS_SUCCESS) {
+    msWriteError(stderr);
+    if(map) msFreeMap(map);
+    msFree(mapfile);
+    msCleanup();
+    exit(1);
+  }
+  msFreeMap(map);
+
+  for(numthreads = 1; ; numthreads = MS_MIN(numthreads * 2, maxthreads)) {
+    seconds = runBench(mapfile, extent, numthreads, draws, &failures);
+    if(numthreads == 1)
+      single = draws / seconds;
+    printf("%3d threads: %8.3f s, %8.1f maps/s, %.1fx the single thread rate\n",
+           numthreads, seconds, numthreads * draws / seconds,
+           (numthreads * draws / seconds) / single);
+    if(numthreads == maxthreads)
+      break;
+  }
+  if(failures)
+    printf("WARNING: %d draws failed\n", failures);
+
+  msFree(mapfile);
+  msCleanup();
+  return failures ? 1 : 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+  fprintf(stderr, "rasterbench requires a thread-safe (WITH_THREAD_SAFETY) pthreads build.\n");
+  return 1;
+}
+
+#endif
@@ -0,0 +1,131 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to time shapefile reads with stdio and memory mapping
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <cpl_conv.h>
+#include <string.h>
+#include <stdlib.h>
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/*
+** One request the way a shapefile layer serves it: open the shapefile,
+** read some shapes with all of their attributes and close it again. The
+** return value sums the vertices and attribute bytes read so the stdio
+** and mapped runs can be compared.
+*/
+static double runRequests(const char *filename, int numrequests, int numreads)
+{
+  shapefileObj shapefile;
+  shapeObj shape;
+  double checksum = 0;
+  int i, j, k, l, numfields;
+
+  srand(1);
+  for(i=0; i<numrequests; i++) {
+    if(msShapefileOpen(&shapefile, "rb", filename, MS_TRUE) == -1)
+      return -1;
+
+    numfields = msDBFGetFieldCount(shapefile.hDBF);
+    for(j=0; j<numreads && shapefile.numshapes > 0; j++) {
+      int shapeindex = rand() % shapefile.numshapes;
+
+      msInitShape(&shape);
+      msSHPReadShape(shapefile.hSHP, shapeindex, &shape);
+      for(k=0; k<shape.numlines; k++)
+        for(l=0; l<shape.line[k].numpoints; l++)
+          checksum += shape.line[k].point[l].x + shape.line[k].point[l].y;
+      msFreeShape(&shape);
+
+      for(k=0; k<numfields; k++)
+        checksum += strlen(msDBFReadStringAttribute(shapefile.hDBF, shapeindex, k));
+    }
+
+    msShapefileClose(&shapefile);
+  }
+
+  return checksum;
+}
+
+int main(int argc, char *argv[])
+{
+  struct mstimeval start;
+  double stdiotime, mmaptime, stdiosum, mmapsum;
+  int numrequests = 20000, numreads = 10;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    shpbench <shpfile> [<requests>] [<reads>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <shpfile>  is the name of a .shp file.\n");
+    fprintf(stdout," <requests> (optional) is the number of open/read/close cycles, default 20000.\n");
+    fprintf(stdout," <reads>    (optional) is the number of random shapes read per request,\n");
+    fprintf(stdout,"            with all their attributes, default 10.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) numrequests = MS_MAX(atoi(argv[2]), 1);
+  if(argc >= 4) numreads = MS_MAX(atoi(argv[3]), 0);
+
+  CPLSetConfigOption("MS_SHAPEFILE_MMAP", "NO");
+  msGettimeofday(&start, NULL);
+  stdiosum = runRequests(argv[1], numrequests, numreads);
+  stdiotime = elapsed(&start);
+  if(stdiosum < 0) {
+    fprintf(stdout, "Error opening shapefile %s.\n", argv[1]);
+    exit(1);
+  }
+
+  CPLSetConfigOption("MS_SHAPEFILE_MMAP", "YES");
+  msGettimeofday(&start, NULL);
+  mmapsum = runRequests(argv[1], numrequests, numreads);
+  mmaptime = elapsed(&start);
+
+  printf("%d requests of %d shapes on %s\n", numrequests, numreads, argv[1]);
+  printf("stdio: %10.0f requests/s\n", numrequests / stdiotime);
+  printf("mmap:  %10.0f requests/s\n", numrequests / mmaptime);
+  if(mmapsum != stdiosum)
+    printf("WARNING: the mapped reads returned different data\n");
+
+  msCleanup();
+
+  return(mmapsum == stdiosum ? 0 : 1);
+}
@@ -71,6 +71,7 @@ int main(int argc, char *argv[])
   treeObj *tree;
   int byte_order = MS_NEW_LSB_ORDER, i;
   int depth=0;
+  int hilbert = MS_FALSE;
 
   if(argc > 1 && strcmp(argv[1], "-v") == 0) {
     printf("%s\n", msGetVersion());
@@ -96,9 +97,15 @@ int main(int argc, char *argv[])
     fprintf(stdout," <depth>   (optional) is the maximum depth of the index\n");
     fprintf(stdout,"           to create, default is 0 meaning that shptree\n");
     fprintf(stdout,"           will calculate a reasonable default depth.\n");
+    fprintf(stdout,"           With the H format it is the number of entries\n");
+    fprintf(stdout,"           per node instead, 0 meaning %d.\n", MS_HILBERT_NODE_SIZE);
     fprintf(stdout," <index_format> (optional) is one of:\n");
     fprintf(stdout,"           NL: LSB byte order, using new index format\n");
     fprintf(stdout,"           NM: MSB byte order, using new index format\n");
+    fprintf(stdout,"           H:  packed Hilbert R-tree written to a %s file\n", MS_HILBERT_INDEX_EXTENSION);
+    fprintf(stdout,"               in native byte order, used in place of the\n");
+    fprintf(stdout,"               %s when both exist and the MS_SHAPEFILE_HILBERT_INDEX\n", MS_INDEX_EXTENSION);
+    fprintf(stdout,"               configuration option is set to YES\n");
     fprintf(stdout,"       The following old format options are deprecated:\n");
     fprintf(stdout,"           N:  Native byte order\n");
     fprintf(stdout,"           L:  LSB (intel) byte order\n");
@@ -122,6 +129,8 @@ int main(int argc, char *argv[])
       byte_order = MS_NEW_LSB_ORDER;
     if( !strcasecmp(argv[3],"NM" ))
       byte_order = MS_NEW_MSB_ORDER;
+    if( !strcasecmp(argv[3],"H" ))
+      hilbert = MS_TRUE;
   }
 
   if(msShapefileOpen(&shapefile, "rb", argv[1], MS_TRUE) == -1) {
@@ -129,6 +138,16 @@ int main(int argc, char *argv[])
     exit(0);
   }
 
+  if(hilbert) {
+    printf( "creating packed Hilbert R-tree index\n");
+    if(msWriteHilbertTree(&shapefile, argv[1], depth) != MS_TRUE) {
+      msWriteError(stdout);
+      exit(0);
+    }
+    msShapefileClose(&shapefile);
+    return(0);
+  }
+
   printf( "creating index of %s %s format\n",(byte_order < 1 ? "old (deprecated)" :"new"),
           ((byte_order == MS_NATIVE_ORDER) ? "native" :
            ((byte_order == MS_LSB_ORDER) || (byte_order == MS_NEW_LSB_ORDER)? " LSB":"MSB")));
@@ -0,0 +1,222 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to compare .qix and .hix spatial index searches
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+static void swapWord(int length, void *wordP)
+{
+  int i;
+  uchar temp;
+
+  for(i=0; i < length/2; i++) {
+    temp = ((uchar *) wordP)[i];
+    ((uchar *) wordP)[i] = ((uchar *) wordP)[length-i-1];
+    ((uchar *) wordP)[length-i-1] = temp;
+  }
+}
+
+/*
+** Walks the .qix the way msSearchDiskTree() does, counting the bytes read
+** and the shape ids found (each costing a bounds read from the .shp in
+** msFilterTreeSearch()).
+*/
+static int countDiskTreeNode(SHPTreeHandle disktree, rectObj aoi, size_t *bytes, int *candidates)
+{
+  int i;
+  ms_int32 offset, numshapes, numsubnodes;
+  rectObj rect;
+
+  if(fread(&offset, 4, 1, disktree->fp) != 1 ||
+      fread(&rect, sizeof(rectObj), 1, disktree->fp) != 1 ||
+      fread(&numshapes, 4, 1, disktree->fp) != 1)
+    return MS_FAILURE;
+  *bytes += 4 + sizeof(rectObj) + 4;
+
+  if(disktree->needswap) {
+    swapWord(4, &offset);
+    swapWord(8, &rect.minx);
+    swapWord(8, &rect.miny);
+    swapWord(8, &rect.maxx);
+    swapWord(8, &rect.maxy);
+    swapWord(4, &numshapes);
+  }
+
+  if(!msRectOverlap(&rect, &aoi))
+    return fseek(disktree->fp, offset + numshapes*4 + 4, SEEK_CUR) == 0 ? MS_SUCCESS : MS_FAILURE;
+
+  if(fseek(disktree->fp, numshapes*4, SEEK_CUR) != 0 ||
+      fread(&numsubnodes, 4, 1, disktree->fp) != 1)
+    return MS_FAILURE;
+  if(disktree->needswap) swapWord(4, &numsubnodes);
+  *bytes += numshapes*4 + 4;
+  *candidates += numshapes;
+
+  for(i=0; i<numsubnodes; i++)
+    if(countDiskTreeNode(disktree, aoi, bytes, candidates) != MS_SUCCESS)
+      return MS_FAILURE;
+
+  return MS_SUCCESS;
+}
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+int main(int argc, char *argv[])
+{
+  shapefileObj shapefile;
+  SHPTreeHandle qix;
+  SHPHilbertTreeHandle hix;
+  struct mstimeval start;
+  rectObj *aois, bounds;
+  ms_bitarray *results, *hixresults;
+  double size = 0.05, qixtime = 0, hixtime = 0;
+  size_t qixbytes = 0, hixbytes = 0, headerbytes;
+  int numqueries = 1000, i, j, hits = 0, candidates = 0, mismatches = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc < 2) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    shptreebench <shpfile> [<queries>] [<size>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <shpfile> is the name of a .shp file with both a %s and\n", MS_INDEX_EXTENSION);
+    fprintf(stdout,"           a %s index (see shptree).\n", MS_HILBERT_INDEX_EXTENSION);
+    fprintf(stdout," <queries> (optional) is the number of random searches, default 1000.\n");
+    fprintf(stdout," <size>    (optional) is the size of the searches relative to the\n");
+    fprintf(stdout,"           extent of the shapefile, default 0.05.\n");
+    exit(0);
+  }
+
+  if(argc >= 3) numqueries = MS_MAX(atoi(argv[2]), 1);
+  if(argc >= 4) size = atof(argv[3]);
+
+  if(msShapefileOpen(&shapefile, "rb", argv[1], MS_TRUE) == -1) {
+    fprintf(stdout, "Error opening shapefile %s.\n", argv[1]);
+    exit(1);
+  }
+
+  qix = msSHPDiskTreeOpen(argv[1], 0);
+  hix = msSHPHilbertTreeOpen(argv[1], 1);
+  if(!qix || !hix) {
+    fprintf(stdout, "Unable to open the %s and %s indexes of %s.\n", MS_INDEX_EXTENSION, MS_HILBERT_INDEX_EXTENSION, argv[1]);
+    exit(1);
+  }
+
+  /* the same random searches for both indexes */
+  bounds = shapefile.bounds;
+  aois = (rectObj *) msSmallMalloc(sizeof(rectObj) * numqueries);
+  results = (ms_bitarray *) msSmallMalloc(sizeof(ms_bitarray) * numqueries);
+  hixresults = (ms_bitarray *) msSmallMalloc(sizeof(ms_bitarray) * numqueries);
+  srand(1);
+  for(i=0; i<numqueries; i++) {
+    double width = (bounds.maxx - bounds.minx) * size, height = (bounds.maxy - bounds.miny) * size;
+    aois[i].minx = bounds.minx + (bounds.maxx - bounds.minx - width) * rand() / (double) RAND_MAX;
+    aois[i].miny = bounds.miny + (bounds.maxy - bounds.miny - height) * rand() / (double) RAND_MAX;
+    aois[i].maxx = aois[i].minx + width;
+    aois[i].maxy = aois[i].miny + height;
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Bytes read, on open handles plus one header per search.         */
+  /* -------------------------------------------------------------------- */
+  headerbytes = hix->bytesRead;
+  for(i=0; i<numqueries; i++) {
+    ms_bitarray status;
+
+    fseek(qix->fp, qix->version ? 16 : 8, SEEK_SET);
+    qixbytes += qix->version ? 16 : 8;
+    countDiskTreeNode(qix, aois[i], &qixbytes, &candidates);
+
+    status = msSHPHilbertTreeSearch(hix, aois[i]);
+    msFree(status);
+  }
+  qixbytes += candidates * 4 * sizeof(double);
+  hixbytes = hix->bytesRead + (numqueries - 1) * headerbytes;
+
+  msSHPDiskTreeClose(qix);
+  msSHPHilbertTreeClose(hix);
+
+  /* -------------------------------------------------------------------- */
+  /*      Latency, opening the index for each search as layers do.        */
+  /* -------------------------------------------------------------------- */
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numqueries; i++) {
+    results[i] = msSearchDiskTree(argv[1], aois[i], 0, shapefile.numshapes);
+    if(results[i])
+      msFilterTreeSearch(&shapefile, results[i], aois[i]);
+  }
+  qixtime = elapsed(&start);
+
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numqueries; i++)
+    hixresults[i] = msSearchDiskHilbertTree(argv[1], aois[i], 0, shapefile.numshapes);
+  hixtime = elapsed(&start);
+
+  for(i=0; i<numqueries; i++) {
+    ms_bitarray status = hixresults[i];
+
+    for(j=0; j<shapefile.numshapes; j++) {
+      int found = status && msGetBit(status, j);
+      if(found != (results[i] && msGetBit(results[i], j))) {
+        mismatches++;
+        break;
+      }
+      hits += found;
+    }
+    msFree(status);
+    msFree(results[i]);
+  }
+
+  printf("%d searches of %g of the extent of %s (%d shapes), %g shapes found per search\n",
+         numqueries, size, argv[1], shapefile.numshapes, hits / (double) numqueries);
+  printf("%s: %8.1f us/search %10.0f bytes/search\n", MS_INDEX_EXTENSION,
+         qixtime * 1.0e6 / numqueries, qixbytes / (double) numqueries);
+  printf("%s: %8.1f us/search %10.0f bytes/search\n", MS_HILBERT_INDEX_EXTENSION,
+         hixtime * 1.0e6 / numqueries, hixbytes / (double) numqueries);
+  if(mismatches)
+    printf("WARNING: %d searches returned different shapes\n", mismatches);
+
+  msFree(aois);
+  msFree(results);
+  msFree(hixresults);
+  msShapefileClose(&shapefile);
+
+  return(mismatches ? 1 : 0);
+}
@@ -0,0 +1,162 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Multi-threaded stress test of the per thread io, error and
+ *           debug contexts, as used by an embedding (e.g. mapscript)
+ *           application serving requests from many threads.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(USE_THREAD) && !defined(_WIN32)
+
+#include <pthread.h>
+
+typedef struct {
+  int iterations;
+  int failures;
+} threadBenchObj;
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/*
+** One iteration looks like a small mapscript request: output is captured
+** in a buffer, an error is raised and cleared and debug messages are
+** checked, all of which look up the per thread state several times.
+*/
+static void *benchThread(void *data)
+{
+  threadBenchObj *bench = (threadBenchObj *) data;
+  char *content_type;
+  int i;
+
+  for(i=0; i<bench->iterations; i++) {
+    msIO_installStdoutToBuffer();
+    msIO_printf("Content-Type: text/plain\r\n\r\n");
+    msIO_printf("request %d\n", i);
+    content_type = msIO_stripStdoutBufferContentType();
+    if(!content_type || strcmp(content_type, "text/plain") != 0)
+      bench->failures++;
+    msFree(content_type);
+    msIO_resetHandlers();
+
+    msSetError(MS_MISCERR, "Iteration %d.", "benchThread()", i);
+    if(msGetErrorObj()->code != MS_MISCERR)
+      bench->failures++;
+    msDebug("benchThread(): iteration %d\n", i);
+    msResetErrorList();
+  }
+
+  /* the thread's state is released when it exits */
+  return NULL;
+}
+
+static double runBench(int numthreads, int iterations, int *failures)
+{
+  pthread_t *threads;
+  threadBenchObj *benches;
+  struct mstimeval start;
+  double seconds;
+  int i;
+
+  threads = (pthread_t *) msSmallMalloc(sizeof(pthread_t) * numthreads);
+  benches = (threadBenchObj *) msSmallCalloc(numthreads, sizeof(threadBenchObj));
+
+  msGettimeofday(&start, NULL);
+  for(i=0; i<numthreads; i++) {
+    benches[i].iterations = iterations;
+    pthread_create(&threads[i], NULL, benchThread, &benches[i]);
+  }
+  for(i=0; i<numthreads; i++) {
+    pthread_join(threads[i], NULL);
+    *failures += benches[i].failures;
+  }
+  seconds = elapsed(&start);
+
+  free(threads);
+  free(benches);
+  return seconds;
+}
+
+int main(int argc, char *argv[])
+{
+  int numthreads = 32, iterations = 100000, failures = 0;
+  double single, multi;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc > 1 && strcmp(argv[1], "-h") == 0) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    threadbench [<threads>] [<iterations>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <threads>    (optional) is the number of threads, default 32.\n");
+    fprintf(stdout," <iterations> (optional) is the number of requests per thread,\n");
+    fprintf(stdout,"              default 100000.\n");
+    exit(0);
+  }
+
+  if(argc >= 2) numthreads = MS_MAX(atoi(argv[1]), 1);
+  if(argc >= 3) iterations = MS_MAX(atoi(argv[2]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  single = runBench(1, iterations, &failures);
+  multi = runBench(numthreads, iterations, &failures);
+
+  printf("1 thread:   %8.3f s, %10.0f requests/s\n", single, iterations / single);
+  printf("%d threads: %8.3f s, %10.0f requests/s, %.1fx the single thread rate\n",
+         numthreads, multi, (double) numthreads * iterations / multi,
+         ((double) numthreads * iterations / multi) / (iterations / single));
+  if(failures)
+    printf("WARNING: %d requests failed\n", failures);
+
+  msCleanup();
+  return failures ? 1 : 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+  fprintf(stderr, "threadbench requires a thread-safe (WITH_THREAD_SAFETY) pthreads build.\n");
+  return 1;
+}
+
+#endif
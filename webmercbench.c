@@ -0,0 +1,177 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Utility program to compare the built-in WGS84 <-> Web Mercator
+ *           reprojection with the PROJ pipeline for the same transform.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2026, MapServer contributors.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+
+#include "mapserver.h"
+#include "maptime.h"
+#include <string.h>
+#include <stdlib.h>
+
+/*
+** init=epsg:4326 to init=epsg:3857 uses the built-in formulas. The
+** +towgs84 definition is the same CRS, but isn't recognized by
+** msProjectGetWebMercatorRole() so it goes through PROJ.
+*/
+#define FASTPATH_LONLAT "init=epsg:4326"
+#define PROJ_LONLAT "+proj=longlat +ellps=WGS84 +towgs84=0,0,0"
+#define WEBMERC "init=epsg:3857"
+
+#define POINTS_PER_LINE 1000
+
+static double elapsed(struct mstimeval *start)
+{
+  struct mstimeval now;
+
+  msGettimeofday(&now, NULL);
+  return (now.tv_sec + now.tv_usec/1.0e6) - (start->tv_sec + start->tv_usec/1.0e6);
+}
+
+/*
+** Reprojects copies of points numruns times, POINTS_PER_LINE at a time
+** with msProjectLineEx(), into result. Returns the time taken, or -1.
+*/
+static double runProjection(const char *src, const char *dst, pointObj *points, pointObj *result,
+                            int numpoints, int numruns)
+{
+  projectionObj in, out;
+  reprojectionObj *reprojector;
+  struct mstimeval start;
+  lineObj line;
+  double seconds = -1;
+  int i, j;
+
+  msInitProjection(&in);
+  msInitProjection(&out);
+  if(msLoadProjectionString(&in, src) == 0 && msLoadProjectionString(&out, dst) == 0 &&
+      (reprojector = msProjectCreateReprojector(&in, &out)) != NULL) {
+    msGettimeofday(&start, NULL);
+    for(i=0; i<numruns; i++) {
+      memcpy(result, points, sizeof(pointObj) * numpoints);
+      for(j=0; j<numpoints; j+=POINTS_PER_LINE) {
+        line.point = result + j;
+        line.numpoints = MS_MIN(POINTS_PER_LINE, numpoints - j);
+        msProjectLineEx(reprojector, &line);
+      }
+    }
+    seconds = elapsed(&start);
+    msProjectDestroyReprojector(reprojector);
+  }
+  msFreeProjection(&in);
+  msFreeProjection(&out);
+
+  return seconds;
+}
+
+static double maxDifference(pointObj *a, pointObj *b, int numpoints)
+{
+  double maxdiff = 0;
+  int i;
+
+  for(i=0; i<numpoints; i++) {
+    maxdiff = MS_MAX(maxdiff, fabs(a[i].x - b[i].x));
+    maxdiff = MS_MAX(maxdiff, fabs(a[i].y - b[i].y));
+  }
+  return maxdiff;
+}
+
+int main(int argc, char *argv[])
+{
+  pointObj *lonlat, *merc, *fastpath, *proj;
+  double fastforward, projforward, fastinverse, projinverse;
+  double forwarddiff, inversediff;
+  int gridsize = 1000, numruns = 10, numpoints, i;
+
+  if(argc > 1 && strcmp(argv[1], "-v") == 0) {
+    printf("%s\n", msGetVersion());
+    exit(0);
+  }
+
+  if(argc > 1 && strcmp(argv[1], "-h") == 0) {
+    fprintf(stdout,"Syntax:\n");
+    fprintf(stdout,"    webmercbench [<grid>] [<runs>]\n");
+    fprintf(stdout,"Where:\n");
+    fprintf(stdout," <grid> (optional) is the size of the grid of points, default 1000.\n");
+    fprintf(stdout," <runs> (optional) is the number of times the grid is reprojected,\n");
+    fprintf(stdout,"        default 10.\n");
+    exit(0);
+  }
+
+  if(argc >= 2) gridsize = MS_MAX(atoi(argv[1]), 2);
+  if(argc >= 3) numruns = MS_MAX(atoi(argv[2]), 1);
+
+  if(msSetup() != MS_SUCCESS) {
+    msWriteError(stderr);
+    exit(1);
+  }
+
+  /* a grid over the valid Web Mercator area, away from the antimeridian */
+  numpoints = gridsize * gridsize;
+  lonlat = (pointObj *) msSmallCalloc(numpoints, sizeof(pointObj));
+  merc = (pointObj *) msSmallCalloc(numpoints, sizeof(pointObj));
+  fastpath = (pointObj *) msSmallCalloc(numpoints, sizeof(pointObj));
+  proj = (pointObj *) msSmallCalloc(numpoints, sizeof(pointObj));
+  for(i=0; i<numpoints; i++) {
+    lonlat[i].x = -179.9 + 359.8 * (i % gridsize) / (gridsize - 1);
+    lonlat[i].y = -85.0 + 170.0 * (i / gridsize) / (gridsize - 1);
+  }
+
+  fastforward = runProjection(FASTPATH_LONLAT, WEBMERC, lonlat, fastpath, numpoints, numruns);
+  projforward = runProjection(PROJ_LONLAT, WEBMERC, lonlat, proj, numpoints, numruns);
+  forwarddiff = maxDifference(fastpath, proj, numpoints);
+
+  memcpy(merc, proj, sizeof(pointObj) * numpoints);
+  fastinverse = runProjection(WEBMERC, FASTPATH_LONLAT, merc, fastpath, numpoints, numruns);
+  projinverse = runProjection(WEBMERC, PROJ_LONLAT, merc, proj, numpoints, numruns);
+  inversediff = maxDifference(fastpath, proj, numpoints);
+
+  if(fastforward < 0 || projforward < 0 || fastinverse < 0 || projinverse < 0) {
+    msWriteError(stderr);
+  } else {
+    printf("%d points, %d runs\n", numpoints, numruns);
+    printf("lon/lat to Web Mercator:\n");
+    printf("  built-in: %12.0f points/s, %.1fx\n", (double) numpoints * numruns / fastforward,
+           projforward / fastforward);
+    printf("  PROJ:     %12.0f points/s\n", (double) numpoints * numruns / projforward);
+    printf("  largest difference: %g m\n", forwarddiff);
+    printf("Web Mercator to lon/lat:\n");
+    printf("  built-in: %12.0f points/s, %.1fx\n", (double) numpoints * numruns / fastinverse,
+           projinverse / fastinverse);
+    printf("  PROJ:     %12.0f points/s\n", (double) numpoints * numruns / projinverse);
+    printf("  largest difference: %g degrees\n", inversediff);
+  }
+
+  msFree(lonlat);
+  msFree(merc);
+  msFree(fastpath);
+  msFree(proj);
+  msCleanup();
+
+  return (fastforward < 0 || projforward < 0 || fastinverse < 0 || projinverse < 0) ? 1 : 0;
+}